@@ -44,7 +44,8 @@ void internal_mark_start(
   size_t msg_len = len == 0 ? strlen(msg) : len;
 
   if (msg_len > 0) {
-    logger.writeBytes(EntryType::STRING_NAME, id, (const uint8_t*)msg, msg_len);
+    logger.writeInternedBytes(
+        EntryType::STRING_NAME, id, (const uint8_t*)msg, msg_len);
   }
 }
 
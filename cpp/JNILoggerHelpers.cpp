@@ -41,9 +41,17 @@ jint loggerWriteStandardEntry(
     tid = threadID();
   }
 
+  auto entry_type = static_cast<EntryType>(type);
+  if (entry_type == EntryType::TRACE_END ||
+      entry_type == EntryType::TRACE_ABORT ||
+      entry_type == EntryType::TRACE_TIMEOUT) {
+    // Must land inside the trace, i.e. before the entry that closes it.
+    Logger::get().writeDroppedWritesAnnotation(arg3);
+  }
+
   return Logger::get().write(StandardEntry{
       .id = 0,
-      .type = static_cast<decltype(StandardEntry::type)>(type),
+      .type = entry_type,
       .timestamp = timestamp,
       .tid = tid,
       .callid = arg1,
@@ -20,11 +20,13 @@
 #include <fbjni/fbjni.h>
 #include <jni.h>
 
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
 #include <profilo/JNILoggerHelpers.h>
 #include <profilo/Logger.h>
+#include <profilo/StringTable.h>
 #include <profilo/jni/NativeTraceWriter.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 #include "TraceProviders.h"
@@ -53,6 +55,12 @@ static jint loggerWriteAndWakeupTraceWriter(
     throw std::invalid_argument("writer cannot be null");
   }
 
+  auto entry_type = static_cast<decltype(StandardEntry::type)>(type);
+  if (entry_type == EntryType::TRACE_START ||
+      entry_type == EntryType::TRACE_BACKWARDS) {
+    Logger::get().startCountingDroppedWrites(traceId);
+  }
+
   //
   // We know the buffer is initialized, NativeTraceWriter is already using it.
   // Also, currentTail is only used because Cursor is not default constructible.
@@ -61,7 +69,7 @@ static jint loggerWriteAndWakeupTraceWriter(
   jint id = Logger::get().writeAndGetCursor(
       StandardEntry{
           .id = 0,
-          .type = static_cast<decltype(StandardEntry::type)>(type),
+          .type = entry_type,
           .timestamp = monotonicTime(),
           .tid = threadID(),
           .callid = arg1,
@@ -85,6 +93,10 @@ static void stopTraceWriter(
   writer->submit(cursor, writer::TraceWriter::kStopLoopTraceID);
 }
 
+static void setBlockingWrites(JNIEnv* env, jobject cls, jboolean blocking) {
+  Logger::setBlockingWrites(blocking);
+}
+
 static jint enableProviders(JNIEnv* env, jobject cls, jint providers) {
   return TraceProviders::get().enableProviders(
       static_cast<uint32_t>(providers));
@@ -113,8 +125,34 @@ static void refreshProviderNames(
   TraceProviders::get().initProviderNames(std::move(provider_names_vec));
 }
 
-static void initRingBuffer(JNIEnv* env, jobject cls, jint size) {
-  RingBuffer::init(size);
+static void initRingBuffer(
+    JNIEnv* env,
+    jobject cls,
+    jint size,
+    jboolean records,
+    jint shards,
+    jboolean resizable) {
+  if (records) {
+    // Same memory as `size` packet slots.
+    RingBuffer::initRecordBuffer(size * sizeof(TraceBufferSlot));
+  } else if (shards > 0) {
+    // Same slots overall, split between the shards.
+    RingBuffer::initSharded(shards, std::max<jint>(1, size / shards));
+  } else if (resizable) {
+    // Starts at `size` slots, the trace writer resizes it from there.
+    RingBuffer::initResizable(size);
+  } else {
+    RingBuffer::init(size);
+  }
+}
+
+static void initStringTable(JNIEnv* env, jobject cls, jint strings) {
+  // Same room per string as the default table.
+  logger::StringTable::init(
+      strings,
+      strings *
+          (logger::StringTable::kDefaultStorageBytes /
+           logger::StringTable::kDefaultSlots));
 }
 
 } // namespace profilo
@@ -149,7 +187,10 @@ JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void*) {
                 "loggerWriteAndWakeupTraceWriter",
                 profilo::loggerWriteAndWakeupTraceWriter),
             makeNativeMethod("nativeInitRingBuffer", profilo::initRingBuffer),
+            makeNativeMethod("nativeInitStringTable", profilo::initStringTable),
             makeNativeMethod("stopTraceWriter", profilo::stopTraceWriter),
+            makeNativeMethod(
+                "nativeSetBlockingWrites", profilo::setBlockingWrites),
         });
 
     profilo::writer::NativeTraceWriter::registerNatives();
@@ -38,6 +38,13 @@ enum QuickLogConstants {
   PROF_ERR_SIG_CRASHES = 8126464 | 27, // = 8126491
   PROF_ERR_SLOT_MISSES = 8126464 | 28, // = 8126492
   PROF_ERR_STACK_OVERFLOWS = 8126464 | 29, // = 8126493
+  // Also written by StackFrameThread.java, with the initial interval
+  CPU_SAMPLING_INTERVAL_MS = 8126464 | 31, // = 8126495
+  LOGGER_ERR_DROPPED_WRITES = 8126464 | 38, // = 8126502
+  PROF_SAMPLING_JITTER_AVG_US = 8126464 | 39, // = 8126503
+  PROF_SAMPLING_JITTER_MAX_US = 8126464 | 40, // = 8126504
+  PROF_SAMPLING_MISSED_TICKS = 8126464 | 41, // = 8126505
+  PROF_LOGGER_CPU_TIME_US = 8126464 | 42, // = 8126506
   THREAD_CPU_TIME = 9240576 | 5, // = 9240581
   LOADAVG_1M = 9240576 | 36, // = 9240612
   LOADAVG_5M = 9240576 | 37, // = 9240613
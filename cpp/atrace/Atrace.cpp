@@ -145,7 +145,7 @@ void log_systrace(const void* buf, size_t count) {
     name++; // skip '|' to the next character
     ssize_t len = msg + count - name;
     if (len > 0) {
-      logger.writeBytes(
+      logger.writeInternedBytes(
           EntryType::STRING_NAME,
           id,
           (const uint8_t*)name,
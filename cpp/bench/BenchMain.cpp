@@ -0,0 +1,122 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// Benchmarks for the logging hot path, packet reassembly, trace encoding and
+// compression. Runs on plain Linux, results go to stdout or to
+// --benchmark_out in the format picked by --benchmark_format. Compression
+// benchmarks read the traces in --traces, relative to the repository root
+// by default.
+//
+//   bench [--benchmark_filter=<substring>]
+//         [--benchmark_format=console|json|csv]
+//         [--benchmark_out=<file>]
+//         [--max_threads=<n>]
+//         [--traces=<folder>]
+//
+
+#include "Benchmark.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace facebook::profilo::bench;
+
+namespace {
+
+constexpr size_t kDefaultMaxThreads = 32;
+constexpr char kDefaultTracesDir[] = "python/demos/traces";
+
+bool parseFlag(const char* arg, const char* flag, std::string& value) {
+  auto length = std::strlen(flag);
+  if (std::strncmp(arg, flag, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  value = arg + length + 1;
+  return true;
+}
+
+int usage(const char* argv0) {
+  std::fprintf(
+      stderr,
+      "usage: %s [--benchmark_filter=<substring>] "
+      "[--benchmark_format=console|json|csv] [--benchmark_out=<file>] "
+      "[--max_threads=<n>] [--traces=<folder>]\n",
+      argv0);
+  return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string filter;
+  std::string format_name = "console";
+  std::string out_path;
+  std::string max_threads = std::to_string(kDefaultMaxThreads);
+  std::string traces_dir = kDefaultTracesDir;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!parseFlag(argv[i], "--benchmark_filter", filter) &&
+        !parseFlag(argv[i], "--benchmark_format", format_name) &&
+        !parseFlag(argv[i], "--benchmark_out", out_path) &&
+        !parseFlag(argv[i], "--max_threads", max_threads) &&
+        !parseFlag(argv[i], "--traces", traces_dir)) {
+      return usage(argv[0]);
+    }
+  }
+
+  Format format;
+  if (format_name == "console") {
+    format = Format::CONSOLE;
+  } else if (format_name == "json") {
+    format = Format::JSON;
+  } else if (format_name == "csv") {
+    format = Format::CSV;
+  } else {
+    return usage(argv[0]);
+  }
+
+  auto threads = std::strtoul(max_threads.c_str(), nullptr, 10);
+  if (threads == 0) {
+    return usage(argv[0]);
+  }
+
+  Runner runner(filter, threads);
+  runLoggerBenchmarks(runner);
+  runRingBufferBenchmarks(runner);
+  runReassemblerBenchmarks(runner);
+  runVisitorBenchmarks(runner);
+  runCompressionBenchmarks(runner, traces_dir);
+
+  auto out = stdout;
+  if (!out_path.empty()) {
+    out = std::fopen(out_path.c_str(), "w");
+    if (out == nullptr) {
+      std::fprintf(
+          stderr, "%s: %s\n", out_path.c_str(), std::strerror(errno));
+      return 1;
+    }
+  }
+  writeResults(out, format, runner.results());
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include <profilo/logger/buffer/RingBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+Runner::Runner(std::string filter, size_t max_threads)
+    : filter_(std::move(filter)), max_threads_(max_threads), results_() {}
+
+bool Runner::enabled(const std::string& name) const {
+  return filter_.empty() || name.find(filter_) != std::string::npos;
+}
+
+Result* Runner::run(
+    const std::string& name,
+    size_t threads,
+    uint64_t iterations,
+    const std::function<void(size_t)>& body) {
+  if (!enabled(name)) {
+    return nullptr;
+  }
+  auto elapsed = measureNanos(threads, body);
+  results_.push_back(Result{name,
+                            threads,
+                            iterations,
+                            elapsed / iterations,
+                            threads * iterations * 1e9 / elapsed,
+                            {}});
+  return &results_.back();
+}
+
+void Runner::report(Result result) {
+  if (enabled(result.name)) {
+    results_.push_back(std::move(result));
+  }
+}
+
+double measureNanos(size_t threads, const std::function<void(size_t)>& body) {
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (!go.load()) {
+      }
+      body(t);
+    });
+  }
+  while (ready.load() < threads) {
+    std::this_thread::yield();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+namespace {
+
+std::string jsonEscape(const std::string& value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+void writeConsole(std::FILE* out, const std::vector<Result>& results) {
+  std::fprintf(
+      out,
+      "%-48s %13s %14s %12s\n",
+      "Benchmark",
+      "Time",
+      "Items/s",
+      "Iterations");
+  std::fprintf(out, "%s\n", std::string(90, '-').c_str());
+  for (auto& result : results) {
+    std::fprintf(
+        out,
+        "%-48s %10.1f ns %14.0f %12llu",
+        result.name.c_str(),
+        result.real_time_ns,
+        result.items_per_second,
+        static_cast<unsigned long long>(result.iterations));
+    for (auto& counter : result.counters) {
+      std::fprintf(out, " %s=%g", counter.first.c_str(), counter.second);
+    }
+    std::fprintf(out, "\n");
+  }
+}
+
+//
+// Same layout as google-benchmark's JSON reporter, restricted to the
+// fields we fill in. Counters are flattened into the benchmark object.
+//
+void writeJson(std::FILE* out, const std::vector<Result>& results) {
+  char date[32];
+  auto now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%FT%T%z", std::localtime(&now));
+
+  std::fprintf(out, "{\n  \"context\": {\n");
+  std::fprintf(out, "    \"date\": \"%s\",\n", date);
+  std::fprintf(
+      out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+  std::fprintf(
+      out, "    \"ring_buffer_version\": %d,\n", RingBuffer::kVersion);
+#ifdef NDEBUG
+  std::fprintf(out, "    \"library_build_type\": \"release\"\n");
+#else
+  std::fprintf(out, "    \"library_build_type\": \"debug\"\n");
+#endif
+  std::fprintf(out, "  },\n  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto& result = results[i];
+    std::fprintf(out, i == 0 ? "\n" : ",\n");
+    std::fprintf(out, "    {\n");
+    std::fprintf(
+        out, "      \"name\": \"%s\",\n", jsonEscape(result.name).c_str());
+    std::fprintf(out, "      \"run_type\": \"iteration\",\n");
+    std::fprintf(out, "      \"threads\": %zu,\n", result.threads);
+    std::fprintf(
+        out,
+        "      \"iterations\": %llu,\n",
+        static_cast<unsigned long long>(result.iterations));
+    std::fprintf(out, "      \"real_time\": %.3f,\n", result.real_time_ns);
+    std::fprintf(out, "      \"time_unit\": \"ns\",\n");
+    for (auto& counter : result.counters) {
+      std::fprintf(
+          out,
+          "      \"%s\": %.3f,\n",
+          jsonEscape(counter.first).c_str(),
+          counter.second);
+    }
+    std::fprintf(
+        out, "      \"items_per_second\": %.3f\n", result.items_per_second);
+    std::fprintf(out, "    }");
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+}
+
+//
+// One row per benchmark. Counters go in the last column as
+// semicolon-separated key=value pairs since they differ per benchmark.
+//
+void writeCsv(std::FILE* out, const std::vector<Result>& results) {
+  std::fprintf(
+      out, "name,threads,iterations,real_time_ns,items_per_second,counters\n");
+  for (auto& result : results) {
+    std::fprintf(
+        out,
+        "\"%s\",%zu,%llu,%.3f,%.3f,",
+        result.name.c_str(),
+        result.threads,
+        static_cast<unsigned long long>(result.iterations),
+        result.real_time_ns,
+        result.items_per_second);
+    for (size_t i = 0; i < result.counters.size(); ++i) {
+      std::fprintf(
+          out,
+          "%s%s=%g",
+          i == 0 ? "" : ";",
+          result.counters[i].first.c_str(),
+          result.counters[i].second);
+    }
+    std::fprintf(out, "\n");
+  }
+}
+
+} // namespace
+
+void writeResults(
+    std::FILE* out,
+    Format format,
+    const std::vector<Result>& results) {
+  switch (format) {
+    case Format::CONSOLE:
+      writeConsole(out, results);
+      break;
+    case Format::JSON:
+      writeJson(out, results);
+      break;
+    case Format::CSV:
+      writeCsv(out, results);
+      break;
+  }
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
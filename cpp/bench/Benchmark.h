@@ -0,0 +1,109 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+struct Result {
+  std::string name;
+  size_t threads;
+  // Operations per thread.
+  uint64_t iterations;
+  // Wall time per operation, as seen by each thread.
+  double real_time_ns;
+  // Operations per second, summed over all threads.
+  double items_per_second;
+  std::vector<std::pair<std::string, double>> counters;
+};
+
+enum class Format { CONSOLE, JSON, CSV };
+
+//
+// Runs benchmarks that match the filter and collects their results.
+// Names follow google-benchmark conventions ("Group/case/threads:N") so
+// existing tooling can compare runs.
+//
+class Runner {
+ public:
+  Runner(std::string filter, size_t max_threads);
+
+  bool enabled(const std::string& name) const;
+
+  size_t maxThreads() const {
+    return max_threads_;
+  }
+
+  //
+  // Calls body(thread_index) on `threads` threads released at the same
+  // time; each call is expected to perform `iterations` operations.
+  // Returns nullptr if the benchmark is filtered out, otherwise the
+  // recorded result, to which the caller can add counters.
+  //
+  Result* run(
+      const std::string& name,
+      size_t threads,
+      uint64_t iterations,
+      const std::function<void(size_t)>& body);
+
+  //
+  // Records a result measured by the caller. The result is dropped if the
+  // benchmark is filtered out.
+  //
+  void report(Result result);
+
+  const std::vector<Result>& results() const {
+    return results_;
+  }
+
+ private:
+  std::string filter_;
+  size_t max_threads_;
+  std::vector<Result> results_;
+};
+
+//
+// Returns the wall time of running body(thread_index) on `threads` threads
+// released at the same time, in nanoseconds.
+//
+double measureNanos(size_t threads, const std::function<void(size_t)>& body);
+
+void writeResults(
+    std::FILE* out,
+    Format format,
+    const std::vector<Result>& results);
+
+// Benchmark groups, see LoggerBench.cpp, RingBufferBench.cpp,
+// ReassemblerBench.cpp, VisitorBench.cpp and CompressionBench.cpp.
+void runLoggerBenchmarks(Runner& runner);
+void runRingBufferBenchmarks(Runner& runner);
+void runReassemblerBenchmarks(Runner& runner);
+void runVisitorBenchmarks(Runner& runner);
+void runCompressionBenchmarks(Runner& runner, const std::string& traces_dir);
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,195 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// Trace file compression with each codec, over the traces in --traces
+// (gzip-compressed text traces, as pulled from devices). Whole traces are
+// compressed as one stream; the dictionary cases compress 64 KB chunks as
+// separate streams, with and without a dictionary trained on the other
+// half of the chunks.
+//
+
+#include "Benchmark.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/TraceCompression.h>
+
+#include <zstr/zstr.hpp>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+using writer::CompressionCodec;
+using writer::CompressionConfig;
+
+namespace {
+
+constexpr uint64_t kPasses = 5;
+constexpr size_t kChunkSize = 64 * 1024;
+
+struct Case {
+  const char* name;
+  CompressionCodec codec;
+  int level;
+};
+
+constexpr Case kCases[] = {
+    {"zlib", CompressionCodec::ZLIB, 1},
+    {"zlib", CompressionCodec::ZLIB, 3},
+    {"zlib", CompressionCodec::ZLIB, 6},
+    {"lz4", CompressionCodec::LZ4, 0},
+    {"lz4", CompressionCodec::LZ4, 9},
+    {"zstd", CompressionCodec::ZSTD, 1},
+    {"zstd", CompressionCodec::ZSTD, 3},
+    {"zstd", CompressionCodec::ZSTD, 9},
+};
+
+std::vector<std::string> loadTraces(const std::string& folder) {
+  std::vector<std::string> traces;
+  auto dir = opendir(folder.c_str());
+  if (dir == nullptr) {
+    return traces;
+  }
+  while (auto entry = readdir(dir)) {
+    auto path = folder + "/" + entry->d_name;
+    struct stat stat_out {};
+    if (stat(path.c_str(), &stat_out) || !S_ISREG(stat_out.st_mode)) {
+      continue;
+    }
+    // zstr reads both compressed and plain files.
+    zstr::ifstream input(path);
+    std::stringstream contents;
+    contents << input.rdbuf();
+    traces.push_back(contents.str());
+  }
+  closedir(dir);
+  return traces;
+}
+
+size_t compress(const CompressionConfig& config, const std::string& input) {
+  std::stringbuf sink;
+  {
+    auto buffer = writer::makeCompressingStreambuf(&sink, config);
+    std::ostream stream(buffer.get());
+    stream.write(input.data(), input.size());
+  }
+  return sink.str().size();
+}
+
+//
+// Compresses every input kPasses times and reports throughput and ratio.
+//
+void measure(
+    Runner& runner,
+    const std::string& name,
+    const CompressionConfig& config,
+    const std::vector<std::string>& inputs) {
+  if (!runner.enabled(name)) {
+    return;
+  }
+  size_t input_size = 0;
+  size_t output_size = 0;
+  auto elapsed = measureNanos(1, [&](size_t) {
+    for (uint64_t pass = 0; pass < kPasses; ++pass) {
+      input_size = 0;
+      output_size = 0;
+      for (auto const& input : inputs) {
+        input_size += input.size();
+        output_size += compress(config, input);
+      }
+    }
+  });
+
+  auto operations = kPasses * inputs.size();
+  runner.report(Result{
+      name,
+      1,
+      operations,
+      elapsed / operations,
+      operations * 1e9 / elapsed,
+      {{"MB/s", kPasses * input_size * 1e3 / elapsed},
+       {"ratio", static_cast<double>(input_size) / output_size}}});
+}
+
+void wholeTraces(Runner& runner, const std::vector<std::string>& traces) {
+  for (auto const& test : kCases) {
+    if (!writer::isCodecAvailable(test.codec)) {
+      continue;
+    }
+    CompressionConfig config;
+    config.codec = test.codec;
+    config.level = test.level;
+    measure(
+        runner,
+        std::string("Compression/") + test.name +
+            "/level:" + std::to_string(test.level),
+        config,
+        traces);
+  }
+}
+
+void dictionary(Runner& runner, const std::vector<std::string>& traces) {
+  std::vector<std::string> training;
+  std::vector<std::string> chunks;
+  for (auto const& trace : traces) {
+    for (size_t offset = 0; offset < trace.size(); offset += kChunkSize) {
+      auto& half = (offset / kChunkSize) % 2 == 0 ? training : chunks;
+      half.push_back(trace.substr(offset, kChunkSize));
+    }
+  }
+  if (chunks.empty() || !writer::isCodecAvailable(CompressionCodec::ZSTD)) {
+    return;
+  }
+
+  CompressionConfig config;
+  config.codec = CompressionCodec::ZSTD;
+  measure(runner, "Compression/zstd/chunks", config, chunks);
+
+  if (!runner.enabled("Compression/zstd/chunks/dictionary")) {
+    return;
+  }
+  config.dictionary = std::make_shared<const std::string>(
+      writer::trainCompressionDictionary(training));
+  measure(runner, "Compression/zstd/chunks/dictionary", config, chunks);
+}
+
+} // namespace
+
+void runCompressionBenchmarks(Runner& runner, const std::string& traces_dir) {
+  auto traces = loadTraces(traces_dir);
+  if (traces.empty()) {
+    std::fprintf(
+        stderr,
+        "No traces in %s, skipping compression benchmarks\n",
+        traces_dir.c_str());
+    return;
+  }
+  wholeTraces(runner, traces);
+  dictionary(runner, traces);
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
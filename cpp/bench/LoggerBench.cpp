@@ -0,0 +1,159 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// Logger::write() for each entry type, writeBytes() by payload size and
+// write scaling with the number of concurrent writers.
+//
+
+#include "Benchmark.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <profilo/Logger.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+namespace {
+
+constexpr size_t kBufferSlots = 1000;
+constexpr uint64_t kIterations = 1000000;
+constexpr uint64_t kIterationsPerThread = 100000;
+constexpr size_t kBytesSizes[] = {16, 256, 1024};
+constexpr size_t kThreadCounts[] = {1, 2, 4, 8, 16, 32};
+
+StandardEntry makeStandardEntry() {
+  StandardEntry entry{};
+  entry.type = EntryType::MARK_PUSH;
+  entry.timestamp = 123456789012;
+  entry.tid = 4242;
+  entry.callid = 17;
+  entry.extra = 99;
+  return entry;
+}
+
+//
+// A Logger writing to its own buffer, so that benchmarks don't depend on
+// the process-wide RingBuffer. The buffer is written around once up front
+// so that the first benchmark doesn't pay for faulting it in.
+//
+struct BenchLogger {
+  BenchLogger()
+      : buffer(TraceBuffer::allocate(kBufferSlots)),
+        logger([this]() -> logger::PacketBuffer& { return *buffer; }) {
+    for (size_t i = 0; i < kBufferSlots; ++i) {
+      logger.write(makeStandardEntry());
+    }
+  }
+
+  TraceBufferHolder buffer;
+  Logger logger;
+};
+
+void writeEntries(Runner& runner) {
+  {
+    BenchLogger bench;
+    runner.run("Logger/write/StandardEntry", 1, kIterations, [&](size_t) {
+      auto entry = makeStandardEntry();
+      for (uint64_t i = 0; i < kIterations; ++i) {
+        bench.logger.write(StandardEntry(entry));
+      }
+    });
+  }
+
+  std::vector<int64_t> frames(32);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    frames[i] = 0x7f0000000000 + i * 64;
+  }
+  for (size_t depth : {2, 32}) {
+    BenchLogger bench;
+    auto name = "Logger/write/FramesEntry/" + std::to_string(depth);
+    runner.run(name, 1, kIterations, [&](size_t) {
+      FramesEntry entry{};
+      entry.type = EntryType::STACK_FRAME;
+      entry.timestamp = 123456789012;
+      entry.tid = 4242;
+      entry.frames.values = frames.data();
+      entry.frames.size = depth;
+      for (uint64_t i = 0; i < kIterations; ++i) {
+        bench.logger.write(FramesEntry(entry));
+      }
+    });
+  }
+
+  {
+    std::vector<uint8_t> bytes(64, 'x');
+    BenchLogger bench;
+    runner.run("Logger/write/BytesEntry/64", 1, kIterations, [&](size_t) {
+      BytesEntry entry{};
+      entry.type = EntryType::STRING_VALUE;
+      entry.bytes.values = bytes.data();
+      entry.bytes.size = bytes.size();
+      for (uint64_t i = 0; i < kIterations; ++i) {
+        bench.logger.write(BytesEntry(entry));
+      }
+    });
+  }
+}
+
+void writeBytes(Runner& runner) {
+  for (auto size : kBytesSizes) {
+    std::vector<uint8_t> bytes(size, 'x');
+    BenchLogger bench;
+    auto name = "Logger/writeBytes/" + std::to_string(size);
+    runner.run(name, 1, kIterations, [&](size_t) {
+      for (uint64_t i = 0; i < kIterations; ++i) {
+        bench.logger.writeBytes(
+            EntryType::STRING_VALUE, 0, bytes.data(), bytes.size());
+      }
+    });
+  }
+}
+
+void writeScaling(Runner& runner) {
+  for (auto threads : kThreadCounts) {
+    if (threads > runner.maxThreads()) {
+      break;
+    }
+    BenchLogger bench;
+    auto name =
+        "Logger/write/StandardEntry/threads:" + std::to_string(threads);
+    runner.run(name, threads, kIterationsPerThread, [&](size_t) {
+      auto entry = makeStandardEntry();
+      for (uint64_t i = 0; i < kIterationsPerThread; ++i) {
+        bench.logger.write(StandardEntry(entry));
+      }
+    });
+  }
+}
+
+} // namespace
+
+void runLoggerBenchmarks(Runner& runner) {
+  writeEntries(runner);
+  writeBytes(runner);
+  writeScaling(runner);
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
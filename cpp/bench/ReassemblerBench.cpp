@@ -0,0 +1,117 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// PacketReassembler::process() and processBackwards() with a growing number
+// of payloads in flight, as when many threads interleave multi-packet
+// entries. Items are packets.
+//
+
+#include "Benchmark.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+using logger::Packet;
+using logger::StreamID;
+using writer::PacketReassembler;
+
+namespace {
+
+constexpr uint64_t kPasses = 20;
+constexpr size_t kPayloadsPerPass = 4096;
+constexpr size_t kPacketsPerPayload = 4;
+constexpr size_t kInFlight[] = {1, 16, 256, 1024};
+
+//
+// Keeps `in_flight` payloads open at a time: each packet continues a random
+// open payload, and a finished payload is replaced by a new stream.
+//
+std::vector<Packet> interleavedPackets(size_t in_flight) {
+  std::mt19937 rng(7);
+  std::vector<StreamID> open(in_flight);
+  std::vector<size_t> written(in_flight);
+  StreamID next_stream = 1;
+  for (auto& stream : open) {
+    stream = next_stream++;
+  }
+
+  std::vector<Packet> packets;
+  packets.reserve(kPayloadsPerPass * kPacketsPerPayload);
+  while (packets.size() < kPayloadsPerPass * kPacketsPerPayload) {
+    auto idx = rng() % in_flight;
+    Packet packet{};
+    packet.stream = open[idx];
+    packet.start = written[idx] == 0;
+    packet.next = written[idx] + 1 < kPacketsPerPayload;
+    packet.size = sizeof(packet.data);
+    std::memset(packet.data, static_cast<int>(packet.stream), packet.size);
+    packets.push_back(packet);
+    if (++written[idx] == kPacketsPerPayload) {
+      open[idx] = next_stream++;
+      written[idx] = 0;
+    }
+  }
+  return packets;
+}
+
+void reassemble(Runner& runner, bool backwards) {
+  for (auto in_flight : kInFlight) {
+    auto name = std::string("PacketReassembler/") +
+        (backwards ? "processBackwards" : "process") +
+        "/streams:" + std::to_string(in_flight);
+    if (!runner.enabled(name)) {
+      continue;
+    }
+
+    auto packets = interleavedPackets(in_flight);
+    uint64_t iterations = kPasses * packets.size();
+    runner.run(name, 1, iterations, [&](size_t) {
+      for (uint64_t pass = 0; pass < kPasses; ++pass) {
+        PacketReassembler reassembler([](const void*, size_t) {});
+        if (backwards) {
+          for (auto it = packets.rbegin(); it != packets.rend(); ++it) {
+            reassembler.processBackwards(*it);
+          }
+        } else {
+          for (auto const& packet : packets) {
+            reassembler.process(packet);
+          }
+        }
+      }
+    });
+  }
+}
+
+} // namespace
+
+void runReassemblerBenchmarks(Runner& runner) {
+  reassemble(runner, false);
+  reassemble(runner, true);
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// The primitives under the Logger: raw packet writes, a reader following
+// the writers with waitAndTryRead() and TurnSequencer turn handoffs.
+//
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/lfrb/TurnSequencer.h>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+using namespace logger;
+
+namespace {
+
+constexpr size_t kBufferSlots = 1000;
+constexpr uint64_t kIterations = 1000000;
+constexpr uint64_t kPacketsPerWriter = 200000;
+constexpr size_t kWriterCounts[] = {1, 2, 4, 8, 16};
+
+void write(Runner& runner) {
+  auto buffer = TraceBuffer::allocate(kBufferSlots);
+  runner.run("LockFreeRingBuffer/write", 1, kIterations, [&](size_t) {
+    Packet packet{};
+    packet.start = true;
+    packet.size = sizeof(packet.data);
+    for (uint64_t i = 0; i < kIterations; ++i) {
+      packet.stream = i;
+      buffer->write(packet);
+    }
+  });
+}
+
+//
+// One reader follows the writers from the first write. When it gets
+// lapped it skips to the middle of the readable window, the way a live
+// reader would, and counts the packets it missed.
+//
+void waitAndTryRead(Runner& runner) {
+  for (auto writers : kWriterCounts) {
+    if (writers + 1 > runner.maxThreads()) {
+      break;
+    }
+    auto name =
+        "LockFreeRingBuffer/waitAndTryRead/writers:" + std::to_string(writers);
+    if (!runner.enabled(name)) {
+      continue;
+    }
+
+    auto buffer = TraceBuffer::allocate(kBufferSlots);
+    const uint64_t total = writers * kPacketsPerWriter;
+    uint64_t reads = 0;
+    uint64_t lost = 0;
+    auto elapsed = measureNanos(writers + 1, [&](size_t thread) {
+      if (thread != 0) {
+        Packet packet{};
+        packet.size = sizeof(packet.data);
+        for (uint64_t i = 0; i < kPacketsPerWriter; ++i) {
+          buffer->write(packet);
+        }
+        return;
+      }
+
+      Packet packet;
+      auto cursor = buffer->begin();
+      auto end = buffer->begin();
+      end.moveForward(total);
+      while (cursor < end) {
+        if (buffer->waitAndTryRead(packet, cursor)) {
+          ++reads;
+          cursor.moveForward();
+          continue;
+        }
+        auto tail = buffer->currentTail(0.5);
+        auto skipped = std::max<uint64_t>(1, cursor.stepsTo(tail));
+        lost += skipped;
+        cursor.moveForward(skipped);
+      }
+    });
+
+    runner.report(Result{name,
+                         writers + 1,
+                         reads,
+                         elapsed / reads,
+                         reads * 1e9 / elapsed,
+                         {{"lost", static_cast<double>(lost)}}});
+  }
+}
+
+void turnHandoff(Runner& runner) {
+  for (size_t threads : {1, 2}) {
+    if (threads > runner.maxThreads()) {
+      break;
+    }
+    lfrb::TurnSequencer<std::atomic> sequencer;
+    auto name = "TurnSequencer/handoff/threads:" + std::to_string(threads);
+    // Each thread takes every threads-th turn, so with two threads every
+    // turn is handed over to the other thread.
+    runner.run(name, threads, kIterations, [&](size_t thread) {
+      std::atomic<uint32_t> spin_cutoff(0);
+      for (uint64_t i = 0; i < kIterations; ++i) {
+        uint32_t turn = i * threads + thread;
+        sequencer.waitForTurn(turn, spin_cutoff, true);
+        sequencer.completeTurn(turn);
+      }
+    });
+  }
+}
+
+} // namespace
+
+void runRingBufferBenchmarks(Runner& runner) {
+  write(runner);
+  waitAndTryRead(runner);
+  turnHandoff(runner);
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
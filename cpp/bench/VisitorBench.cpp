@@ -0,0 +1,187 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// The text trace encoding chain over a synthetic trace of 1M entries: the
+// chain of EntryVisitors against the same stages fused into a Pipeline.
+// Output goes to a stream that only counts bytes, so the numbers are the
+// encoding and formatting cost alone. Items are entries.
+//
+
+#include "Benchmark.h"
+
+#include <memory>
+#include <ostream>
+#include <random>
+#include <streambuf>
+#include <vector>
+
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/VisitorPipeline.h>
+
+namespace facebook {
+namespace profilo {
+namespace bench {
+
+using namespace entries;
+using namespace writer;
+
+namespace {
+
+constexpr size_t kEntries = 1000000;
+constexpr size_t kMaxStackDepth = 32;
+
+class CountingStreambuf : public std::streambuf {
+ public:
+  size_t bytes = 0;
+
+ protected:
+  int_type overflow(int_type ch) override {
+    ++bytes;
+    return ch;
+  }
+
+  std::streamsize xsputn(const char*, std::streamsize count) override {
+    bytes += count;
+    return count;
+  }
+};
+
+//
+// Roughly the mix of a sampling profiler trace: mostly stacks and markers,
+// some strings. Entries are kept unpacked so that replaying them only
+// measures the visitors.
+//
+struct SyntheticTrace {
+  std::vector<StandardEntry> standard;
+  std::vector<FramesEntry> frames;
+  std::vector<BytesEntry> bytes;
+  // Entry type and index of each entry, in trace order.
+  std::vector<std::pair<uint8_t, uint32_t>> order;
+  std::vector<int64_t> frame_values;
+  std::string string_value = "com.facebook.profilo.SomeClass";
+
+  SyntheticTrace() {
+    std::mt19937_64 rng(99);
+    int64_t timestamp = 1000000000;
+    frame_values.reserve(kEntries * kMaxStackDepth / 3);
+    frames.reserve(kEntries / 3);
+    for (int32_t id = 0; order.size() < kEntries; ++id) {
+      timestamp += rng() % 100000;
+      auto kind = rng() % 10;
+      if (kind < 4) {
+        auto depth = 4 + rng() % (kMaxStackDepth - 4);
+        for (size_t i = 0; i < depth; ++i) {
+          frame_values.push_back(0x7f0000000000 + (rng() % 4096) * 64);
+        }
+        FramesEntry entry{};
+        entry.id = id;
+        entry.type = EntryType::STACK_FRAME;
+        entry.timestamp = timestamp;
+        entry.tid = 4000 + rng() % 8;
+        entry.frames.values = frame_values.data() + frame_values.size() - depth;
+        entry.frames.size = depth;
+        order.emplace_back(2, frames.size());
+        frames.push_back(entry);
+      } else if (kind < 9) {
+        StandardEntry entry{};
+        entry.id = id;
+        entry.type = kind % 2 ? EntryType::MARK_PUSH : EntryType::MARK_POP;
+        entry.timestamp = timestamp;
+        entry.tid = 4000 + rng() % 8;
+        entry.callid = rng() % 1000;
+        entry.extra = rng() % 100;
+        order.emplace_back(1, standard.size());
+        standard.push_back(entry);
+      } else {
+        BytesEntry entry{};
+        entry.id = id;
+        entry.type = EntryType::STRING_VALUE;
+        entry.matchid = id - 1;
+        entry.bytes.values =
+            reinterpret_cast<const uint8_t*>(string_value.data());
+        entry.bytes.size = string_value.size();
+        order.emplace_back(3, bytes.size());
+        bytes.push_back(entry);
+      }
+    }
+  }
+
+  void replay(EntryVisitor& visitor) const {
+    for (auto const& entry : order) {
+      switch (entry.first) {
+        case 1:
+          visitor.visit(standard[entry.second]);
+          break;
+        case 2:
+          visitor.visit(frames[entry.second]);
+          break;
+        default:
+          visitor.visit(bytes[entry.second]);
+          break;
+      }
+    }
+  }
+};
+
+void encode(
+    Runner& runner,
+    const SyntheticTrace& trace,
+    const std::string& name,
+    bool fused) {
+  if (!runner.enabled(name)) {
+    return;
+  }
+  CountingStreambuf buf;
+  std::ostream out(&buf);
+  auto result = runner.run(name, 1, kEntries, [&](size_t) {
+    if (fused) {
+      Pipeline<InvertFrames, TruncateTimestamps, DeltaEncode, EntryPrinter>
+          pipeline(InvertFrames(), TruncateTimestamps(), DeltaEncode(), out);
+      trace.replay(pipeline);
+    } else {
+      PrintEntryVisitor print(out);
+      DeltaEncodingVisitor delta(print);
+      TimestampTruncatingVisitor truncate(delta);
+      StackTraceInvertingVisitor invert(truncate);
+      trace.replay(invert);
+    }
+  });
+  if (result != nullptr) {
+    result->counters.emplace_back(
+        "bytes_per_entry", static_cast<double>(buf.bytes) / kEntries);
+  }
+}
+
+} // namespace
+
+void runVisitorBenchmarks(Runner& runner) {
+  if (!runner.enabled("VisitorChain/text/chained") &&
+      !runner.enabled("VisitorChain/text/fused")) {
+    return;
+  }
+  SyntheticTrace trace;
+  encode(runner, trace, "VisitorChain/text/chained", false);
+  encode(runner, trace, "VisitorChain/text/fused", true);
+}
+
+} // namespace bench
+} // namespace profilo
+} // namespace facebook
@@ -36,9 +36,17 @@ class Language(object):
         return num in [Language.CPP, Language.JAVA]
 
 class MemoryDescription(namedtuple('MemoryDescription',
-                                     ['fields', 'typename'])):
+                                     ['fields', 'typename', 'compact'])):
     TYPE_ID = 1
 
+    # The compact variant of a format is identified by its type id with the
+    # high bit set, so existing type ids stay stable.
+    COMPACT_TYPE_FLAG = 0x80
+
+    def __new__(cls, fields=None, typename=None, compact=False):
+        return super(MemoryDescription, cls).__new__(
+            cls, fields, typename, compact)
+
     def __init__(self, **kwargs):
         super(MemoryDescription, self).__init__(self, **kwargs)
 
@@ -51,6 +59,14 @@ class MemoryDescription(namedtuple('MemoryDescription',
         self.type_id = MemoryDescription.TYPE_ID
         MemoryDescription.TYPE_ID += 1
 
+        if self.type_id >= MemoryDescription.COMPACT_TYPE_FLAG:
+            raise ValueError('Too many memory formats')
+
+        self.compact_type_id = None
+        if self.compact:
+            self.compact_type_id = \
+                self.type_id | MemoryDescription.COMPACT_TYPE_FLAG
+
 class EntryDescription(
     namedtuple('EntryDescription',
                ['id', 'name', 'memory_format'])):
@@ -168,12 +168,23 @@ NAMES = [
     'NATIVE_FREE',
     'NATIVE_ALLOC_FAILURE',
     'NATIVE_STACK_FRAME',
+
+    # Interned stacks, written by the trace writer in place of stack frames
+    'STACK_DEFINITION',
+    'STACK_SAMPLE',
+
+    # Interned strings, see Logger::writeInternedBytes
+    'STRING_REFERENCE',
+
+    # Text traces restart their encoding after this, see SharedTextEncoder
+    'SEGMENT_START',
 ]
 
 STACK_FRAME_ENTRIES = frozenset([
     'STACK_FRAME',
     'JAVASCRIPT_STACK_FRAME',
     'NATIVE_STACK_FRAME',
+    'STACK_DEFINITION',
 ])
 
 BYTES_ENTRIES = frozenset([
@@ -224,6 +235,7 @@ def get_entry_descriptions():
             ('extra', Types.int64),
         ],
         typename='StandardEntry',
+        compact=True,
     )
 
     frames_entry = get_frames_memory_format()
@@ -80,14 +80,14 @@ uint8_t peek_type(const void* src, size_t len);
 struct __attribute__((packed)) %%TYPENAME%% {
 
   static const uint8_t kSerializationType = %%TYPE_ID%%;
-
+%%COMPACT_TYPE_ID%%
 %%FIELDS%%
 
   static void pack(const %%TYPENAME%%& entry, void* dst, size_t size);
   static void unpack(%%TYPENAME%%& entry, const void* src, size_t size);
 
   static size_t calculateSize(%%TYPENAME%% const& entry);
-};
+%%COMPACT_METHODS%%};
 """.lstrip()
 
         fields = [
@@ -97,6 +97,23 @@ struct __attribute__((packed)) %%TYPENAME%% {
         fields = "\n".join(fields)
         fields = Codegen.indent(fields)
 
+        compact_type_id = ""
+        compact_methods = ""
+        if fmt.compact:
+            compact_type_id = """
+  static const uint8_t kCompactSerializationType = %%COMPACT_ID%%;
+""".replace('%%COMPACT_ID%%', str(fmt.compact_type_id))
+            compact_methods = """
+  // Compact variant: integers as LEB128 varints, signed ones zigzag-encoded.
+  // unpack() accepts both serialization types.
+  static void packCompact(const %%TYPENAME%%& entry, void* dst, size_t size);
+  static void unpackCompact(%%TYPENAME%%& entry, const void* src, size_t size);
+
+  static size_t calculateCompactSize(%%TYPENAME%% const& entry);
+"""
+
+        template = template.replace('%%COMPACT_TYPE_ID%%', compact_type_id)
+        template = template.replace('%%COMPACT_METHODS%%', compact_methods)
         template = template.replace('%%TYPENAME%%', fmt.typename)
         template = template.replace('%%TYPE_ID%%', str(fmt.type_id))
         template = template.replace('%%FIELDS%%', fields)
@@ -127,7 +144,7 @@ class CppEntryStructsCppCodegen(Codegen):
 namespace facebook {
 namespace profilo {
 namespace entries {
-
+%%COMPACT_HELPERS%%
 %%ENTRIES_CODE%%
 
 uint8_t peek_type(const void* src, size_t len) {
@@ -142,6 +159,10 @@ uint8_t peek_type(const void* src, size_t len) {
 
         code = self._generate_entries_code()
         template = template.replace('%%ENTRIES_CODE%%', code)
+        template = template.replace(
+            '%%COMPACT_HELPERS%%',
+            self._generate_compact_helpers(),
+        )
         template = template.replace('%%SIGNED_SOURCE%%', SIGNED_SOURCE)
         return template
 
@@ -154,6 +175,61 @@ uint8_t peek_type(const void* src, size_t len) {
 
         return structs
 
+    def _generate_compact_helpers(self):
+        if not any(fmt.compact for fmt in self.unique_types.values()):
+            return ""
+
+        return """
+namespace {
+
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline size_t varintSize(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline void writeVarint(uint8_t* dst, size_t& offset, uint64_t value) {
+  while (value >= 0x80) {
+    dst[offset++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  dst[offset++] = static_cast<uint8_t>(value);
+}
+
+inline void checkRemaining(size_t offset, size_t needed, size_t size) {
+  if (offset + needed > size) {
+      throw std::out_of_range("Truncated compact entry");
+  }
+}
+
+inline uint64_t readVarint(const uint8_t* src, size_t& offset, size_t size) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    checkRemaining(offset, 1, size);
+    uint8_t byte = src[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::invalid_argument("Malformed varint in compact entry");
+}
+
+} // namespace
+"""
+
     def _generate_entry_struct(self, fmt):
         template = """
 %%PACKCODE%%
@@ -171,6 +247,13 @@ uint8_t peek_type(const void* src, size_t len) {
         template = template.replace('%%UNPACKCODE%%', unpack_code)
         template = template.replace('%%CALCULATESIZECODE%%', calcsize_code)
 
+        if fmt.compact:
+            template += "\n" + "\n\n".join([
+                self._generate_compact_pack_code(fmt),
+                self._generate_compact_unpack_code(fmt),
+                self._generate_compact_calcsize_code(fmt),
+            ])
+
         return template
 
     def _generate_pack_code(self, fmt):
@@ -221,7 +304,7 @@ void %%TYPENAME%%::unpack(%%TYPENAME%%& entry, const void* src, size_t size) {
       throw std::invalid_argument("src == nullptr");
   }
   const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
-  if (*src_byte != kSerializationType) {
+%%COMPACT_DISPATCH%%  if (*src_byte != kSerializationType) {
       throw std::invalid_argument("Serialization type is incorrect");
   }
   size_t offset = 1;
@@ -229,6 +312,16 @@ void %%TYPENAME%%::unpack(%%TYPENAME%%& entry, const void* src, size_t size) {
 }
 """.lstrip()
 
+        compact_dispatch = ""
+        if fmt.compact:
+            compact_dispatch = """
+  if (*src_byte == kCompactSerializationType) {
+      unpackCompact(entry, src, size);
+      return;
+  }
+""".lstrip("\n")
+        template = template.replace('%%COMPACT_DISPATCH%%', compact_dispatch)
+
         memcopies = []
         for name, ftype in fmt.fields:
             memcpy = TypeConverter.get(ftype).generate_unpack_code(
@@ -267,3 +360,92 @@ size_t %%TYPENAME%%::calculateSize(%%TYPENAME%% const& entry) {
         template = template.replace('%%TYPENAME%%', fmt.typename)
         template = template.replace('%%EXPRESSIONS%%', expressions)
         return template
+
+    def _generate_compact_pack_code(self, fmt):
+        template = """
+void %%TYPENAME%%::packCompact(
+    const %%TYPENAME%%& entry,
+    void* dst,
+    size_t size) {
+  if (size < %%TYPENAME%%::calculateCompactSize(entry)) {
+      throw std::out_of_range("Cannot fit %%TYPENAME%% in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kCompactSerializationType;
+  size_t offset = 1;
+%%ENCODERS%%
+}
+""".lstrip()
+
+        encoders = [
+            TypeConverter.get(ftype).generate_compact_pack_code(
+                from_expression="entry.{name}".format(name=name),
+                to_expression="dst_byte",
+                offset_expr="offset",
+            ) for name, ftype in fmt.fields
+        ]
+        encoders = "".join(encoders)
+        encoders = Codegen.indent(encoders)
+
+        template = template.replace('%%TYPENAME%%', fmt.typename)
+        template = template.replace('%%ENCODERS%%', encoders)
+        return template
+
+    def _generate_compact_unpack_code(self, fmt):
+        template = """
+void %%TYPENAME%%::unpackCompact(
+    %%TYPENAME%%& entry,
+    const void* src,
+    size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 || *src_byte != kCompactSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  size_t offset = 1;
+%%DECODERS%%
+}
+""".lstrip()
+
+        decoders = [
+            TypeConverter.get(ftype).generate_compact_unpack_code(
+                from_expression="src_byte",
+                to_expression="entry.{name}".format(name=name),
+                offset_expr="offset",
+                size_expr="size",
+            ) for name, ftype in fmt.fields
+        ]
+        decoders = "".join(decoders)
+        decoders = Codegen.indent(decoders)
+
+        template = template.replace('%%TYPENAME%%', fmt.typename)
+        template = template.replace('%%DECODERS%%', decoders)
+        return template
+
+    def _generate_compact_calcsize_code(self, fmt):
+        template = """
+size_t %%TYPENAME%%::calculateCompactSize(%%TYPENAME%% const& entry) {
+  size_t offset = 1 /*serialization format*/;
+%%EXPRESSIONS%%
+  return offset;
+}
+""".lstrip()
+
+        expressions = [
+            TypeConverter.get(ftype).generate_compact_size_code(
+                "entry",
+                fname,
+                "offset",
+            ) for fname, ftype in fmt.fields
+        ]
+        expressions = "\n".join(expressions)
+        expressions = Codegen.indent(expressions)
+
+        template = template.replace('%%TYPENAME%%', fmt.typename)
+        template = template.replace('%%EXPRESSIONS%%', expressions)
+        return template
@@ -111,6 +111,11 @@ case %%ID%%: {
                  .replace('%%ID%%', str(x.type_id))
                  .replace('%%TYPE%%', x.typename)
                  for x in self.unique_types.values() ]
+        # unpack() handles both layouts of formats with a compact variant
+        cases += [ case_template
+                 .replace('%%ID%%', str(x.compact_type_id))
+                 .replace('%%TYPE%%', x.typename)
+                 for x in self.unique_types.values() if x.compact ]
         cases = "\n".join(cases)
         cases = Codegen.indent(cases)
         cases = Codegen.indent(cases)
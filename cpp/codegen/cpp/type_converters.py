@@ -62,6 +62,25 @@ class CppTypeConverter(object):
             offset=offset_expression,
         )
 
+    def generate_compact_pack_code(
+        self, from_expression, to_expression, offset_expr):
+        raise RuntimeError(
+            "Compact serialization is only supported for integer fields")
+
+    def generate_compact_unpack_code(
+        self, from_expression, to_expression, offset_expr, size_expr):
+        raise RuntimeError(
+            "Compact serialization is only supported for integer fields")
+
+    def generate_compact_size_code(
+        self,
+        entry_expression,
+        member_expression,
+        offset_expression,
+    ):
+        raise RuntimeError(
+            "Compact serialization is only supported for integer fields")
+
 
 class PrimitiveTypeConverter(CppTypeConverter):
     __metaclass__ = abc.ABCMeta
@@ -113,6 +132,80 @@ class IntegerTypeConverter(PrimitiveTypeConverter):
             bits=bits,
         )
 
+    # Compact encoding: single bytes are copied as is, wider integers are
+    # written as LEB128 varints, zigzag-encoded first if signed.
+
+    def _is_single_byte(self):
+        return self.abstract_type.constant_size == 1
+
+    def _encode_expression(self, expression):
+        if self.abstract_type.signed:
+            return "zigzagEncode({expr})".format(expr=expression)
+        return expression
+
+    def _decode_expression(self, expression):
+        if self.abstract_type.signed:
+            expression = "zigzagDecode({expr})".format(expr=expression)
+        return "static_cast<{type}>({expr})".format(
+            type=self.map_type(),
+            expr=expression,
+        )
+
+    def generate_compact_pack_code(
+        self, from_expression, to_expression, offset_expr):
+        if self._is_single_byte():
+            return self.generate_pack_code(
+                from_expression, to_expression, offset_expr)
+        return """
+writeVarint({to}, {offset}, {value});
+""".format(
+            to=to_expression,
+            offset=offset_expr,
+            value=self._encode_expression(from_expression),
+        )
+
+    def generate_compact_unpack_code(
+        self, from_expression, to_expression, offset_expr, size_expr):
+        if self._is_single_byte():
+            return """
+checkRemaining({offset}, {bytes}, {size});
+""".format(
+                bytes=self.abstract_type.constant_size,
+                offset=offset_expr,
+                size=size_expr,
+            ) + self.generate_unpack_code(
+                from_expression, to_expression, offset_expr).lstrip()
+        return """
+{to} = {value};
+""".format(
+            to=to_expression,
+            value=self._decode_expression(
+                "readVarint({from_}, {offset}, {size})".format(
+                    from_=from_expression,
+                    offset=offset_expr,
+                    size=size_expr,
+                )),
+        )
+
+    def generate_compact_size_code(
+        self,
+        entry_expression,
+        member_expression,
+        offset_expression,
+    ):
+        if self._is_single_byte():
+            return "({offset}) += {bytes};".format(
+                offset=offset_expression,
+                bytes=self.abstract_type.constant_size,
+            )
+        return "({offset}) += varintSize({value});".format(
+            offset=offset_expression,
+            value=self._encode_expression("{entry}.{member}".format(
+                entry=entry_expression,
+                member=member_expression,
+            )),
+        )
+
 
 class EntryTypeEnumConverter(IntegerTypeConverter):
 
@@ -1,4 +1,4 @@
-// @generated SignedSource<<dac133554c4c93a6470de853350a032e>>
+// @generated SignedSource<<0341c4a7d2a5e73f70548745cd48ad78>>
 
 #include <cstring>
 #include <stdexcept>
@@ -8,6 +8,55 @@ namespace facebook {
 namespace profilo {
 namespace entries {
 
+namespace {
+
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline size_t varintSize(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline void writeVarint(uint8_t* dst, size_t& offset, uint64_t value) {
+  while (value >= 0x80) {
+    dst[offset++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  dst[offset++] = static_cast<uint8_t>(value);
+}
+
+inline void checkRemaining(size_t offset, size_t needed, size_t size) {
+  if (offset + needed > size) {
+      throw std::out_of_range("Truncated compact entry");
+  }
+}
+
+inline uint64_t readVarint(const uint8_t* src, size_t& offset, size_t size) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    checkRemaining(offset, 1, size);
+    uint8_t byte = src[offset++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::invalid_argument("Malformed varint in compact entry");
+}
+
+} // namespace
+
 /* Alignment requirement: dst must be 4-byte aligned. */
 void StandardEntry::pack(const StandardEntry& entry, void* dst, size_t size) {
   if (size < StandardEntry::calculateSize(entry)) {
@@ -58,6 +107,10 @@ void StandardEntry::unpack(StandardEntry& entry, const void* src, size_t size) {
       throw std::invalid_argument("src == nullptr");
   }
   const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (*src_byte == kCompactSerializationType) {
+      unpackCompact(entry, src, size);
+      return;
+  }
   if (*src_byte != kSerializationType) {
       throw std::invalid_argument("Serialization type is incorrect");
   }
@@ -108,6 +161,85 @@ size_t StandardEntry::calculateSize(StandardEntry const& entry) {
 }
 
 
+void StandardEntry::packCompact(
+    const StandardEntry& entry,
+    void* dst,
+    size_t size) {
+  if (size < StandardEntry::calculateCompactSize(entry)) {
+      throw std::out_of_range("Cannot fit StandardEntry in destination");
+  }
+  if (dst == nullptr) {
+      throw std::invalid_argument("dst == nullptr");
+  }
+  uint8_t* dst_byte = reinterpret_cast<uint8_t*>(dst);
+  *dst_byte = kCompactSerializationType;
+  size_t offset = 1;
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.id));
+  
+  uint8_t entry_type_tmp = static_cast<uint8_t>(entry.type);
+  std::memcpy((dst_byte) + offset, &(entry_type_tmp), sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.timestamp));
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.tid));
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.callid));
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.matchid));
+  
+  writeVarint(dst_byte, offset, zigzagEncode(entry.extra));
+  
+}
+
+
+void StandardEntry::unpackCompact(
+    StandardEntry& entry,
+    const void* src,
+    size_t size) {
+  if (src == nullptr) {
+      throw std::invalid_argument("src == nullptr");
+  }
+  const uint8_t* src_byte = reinterpret_cast<const uint8_t*>(src);
+  if (size < 1 || *src_byte != kCompactSerializationType) {
+      throw std::invalid_argument("Serialization type is incorrect");
+  }
+  size_t offset = 1;
+  
+  entry.id = static_cast<int32_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+  checkRemaining(offset, 1, size);
+  uint8_t entry_type_tmp;
+  std::memcpy(&(entry_type_tmp), (src_byte) + offset, sizeof((entry_type_tmp)));
+  offset += sizeof((entry_type_tmp));
+  entry.type = static_cast<EntryType>(entry_type_tmp);
+  
+  entry.timestamp = static_cast<int64_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+  entry.tid = static_cast<int32_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+  entry.callid = static_cast<int32_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+  entry.matchid = static_cast<int32_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+  entry.extra = static_cast<int64_t>(zigzagDecode(readVarint(src_byte, offset, size)));
+  
+}
+
+
+size_t StandardEntry::calculateCompactSize(StandardEntry const& entry) {
+  size_t offset = 1 /*serialization format*/;
+  (offset) += varintSize(zigzagEncode(entry.id));
+  (offset) += 1;
+  (offset) += varintSize(zigzagEncode(entry.timestamp));
+  (offset) += varintSize(zigzagEncode(entry.tid));
+  (offset) += varintSize(zigzagEncode(entry.callid));
+  (offset) += varintSize(zigzagEncode(entry.matchid));
+  (offset) += varintSize(zigzagEncode(entry.extra));
+  return offset;
+}
+
 /* Alignment requirement: dst must be 4-byte aligned. */
 void FramesEntry::pack(const FramesEntry& entry, void* dst, size_t size) {
   if (size < FramesEntry::calculateSize(entry)) {
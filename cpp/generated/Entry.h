@@ -1,4 +1,4 @@
-// @generated SignedSource<<92e7f010a9d663922326eefa54f7b0e0>>
+// @generated SignedSource<<6898935ec98bb6f653e1a7ecffbb92be>>
 
 #include <cstdint>
 #include <cstring>
@@ -16,6 +16,8 @@ struct __attribute__((packed)) StandardEntry {
 
   static const uint8_t kSerializationType = 1;
 
+  static const uint8_t kCompactSerializationType = 129;
+
   int32_t id;
   EntryType type;
   int64_t timestamp;
@@ -28,6 +30,13 @@ struct __attribute__((packed)) StandardEntry {
   static void unpack(StandardEntry& entry, const void* src, size_t size);
 
   static size_t calculateSize(StandardEntry const& entry);
+
+  // Compact variant: integers as LEB128 varints, signed ones zigzag-encoded.
+  // unpack() accepts both serialization types.
+  static void packCompact(const StandardEntry& entry, void* dst, size_t size);
+  static void unpackCompact(StandardEntry& entry, const void* src, size_t size);
+
+  static size_t calculateCompactSize(StandardEntry const& entry);
 };
 
 struct __attribute__((packed)) FramesEntry {
@@ -1,4 +1,4 @@
-// @generated SignedSource<<d642034c7e1830efd4a46871d51c5ac6>>
+// @generated SignedSource<<21d801eac4376d9d25f6868ed1c6572a>>
 
 #pragma once
 
@@ -51,6 +51,13 @@ public:
         break;
       }
       
+      case 129: {
+        StandardEntry data;
+        StandardEntry::unpack(data, src, size);
+        visitor.visit(data);
+        break;
+      }
+      
       default: throw std::invalid_argument("Unknown type in to_stream");
     }
   }
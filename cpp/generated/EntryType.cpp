@@ -1,4 +1,4 @@
-// @generated SignedSource<<4a93e2d2cc2604d6d810cae8eefa2aad>>
+// @generated SignedSource<<feb65551aac4e829058e4e6ac4858822>>
 
 #include <stdexcept>
 #include <profilo/entries/EntryType.h>
@@ -109,6 +109,10 @@ const char* to_string(EntryType type) {
     case EntryType::NATIVE_FREE: return "NATIVE_FREE";
     case EntryType::NATIVE_ALLOC_FAILURE: return "NATIVE_ALLOC_FAILURE";
     case EntryType::NATIVE_STACK_FRAME: return "NATIVE_STACK_FRAME";
+    case EntryType::STACK_DEFINITION: return "STACK_DEFINITION";
+    case EntryType::STACK_SAMPLE: return "STACK_SAMPLE";
+    case EntryType::STRING_REFERENCE: return "STRING_REFERENCE";
+    case EntryType::SEGMENT_START: return "SEGMENT_START";
     default: throw std::invalid_argument("Unknown entry type");
   }
 }
@@ -1,4 +1,4 @@
-// @generated SignedSource<<ec48922e65b8784837dddbf002b59f64>>
+// @generated SignedSource<<8c3683a5e45a212a59d718dddbd53367>>
 
 #pragma once
 
@@ -106,6 +106,10 @@ enum class EntryType {
   NATIVE_FREE = 97,
   NATIVE_ALLOC_FAILURE = 98,
   NATIVE_STACK_FRAME = 99,
+  STACK_DEFINITION = 100,
+  STACK_SAMPLE = 101,
+  STRING_REFERENCE = 102,
+  SEGMENT_START = 103,
 };
 
 
@@ -1,4 +1,4 @@
-// @generated SignedSource<<15bfb82ff976b2cfeacdfd0c07d6c397>>
+// @generated SignedSource<<068cfc7f129822f3afa8a275f0b23720>>
 
 package com.facebook.profilo.entries;
 
@@ -104,6 +104,10 @@ public class EntryType {
   public static final int NATIVE_FREE = 97;
   public static final int NATIVE_ALLOC_FAILURE = 98;
   public static final int NATIVE_STACK_FRAME = 99;
+  public static final int STACK_DEFINITION = 100;
+  public static final int STACK_SAMPLE = 101;
+  public static final int STRING_REFERENCE = 102;
+  public static final int SEGMENT_START = 103;
 
   public static final String[] NAMES = {
     "UNKNOWN_TYPE",
@@ -206,5 +210,9 @@ public class EntryType {
     "NATIVE_FREE",
     "NATIVE_ALLOC_FAILURE",
     "NATIVE_STACK_FRAME",
+    "STACK_DEFINITION",
+    "STACK_SAMPLE",
+    "STRING_REFERENCE",
+    "SEGMENT_START",
   };
 }
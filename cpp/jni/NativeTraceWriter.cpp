@@ -33,38 +33,98 @@ namespace writer {
 NativeTraceWriter::NativeTraceWriter(
     std::string trace_folder,
     std::string trace_prefix,
-    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks)
-    :
-
-      callbacks_(std::make_shared<NativeTraceWriterCallbacksProxy>(callbacks)),
-      writer_(
-          std::move(trace_folder),
-          std::move(trace_prefix),
-          RingBuffer::get(),
-          callbacks_,
-          calculateHeaders(),
-          traceBackwards) {}
+    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+    jboolean pipelined)
+    : callbacks_(std::make_shared<NativeTraceWriterCallbacksProxy>(callbacks)),
+      writer_() {
+  auto records = RingBuffer::getRecordBuffer();
+  auto shards = RingBuffer::getShardedBuffer();
+  auto resizable = RingBuffer::getResizableBuffer();
+  if (resizable != nullptr) {
+    writer_ = std::make_unique<TraceWriter>(
+        std::move(trace_folder),
+        std::move(trace_prefix),
+        *resizable,
+        callbacks_,
+        calculateHeaders(),
+        [](entries::EntryVisitor& visitor,
+           TraceBuffer& buffer,
+           TraceBuffer::Cursor& cursor) {
+          traceBackwards(visitor, buffer, cursor);
+        });
+    writer_->enableResizing();
+    if (pipelined) {
+      writer_->enablePipeline();
+    }
+  } else if (shards != nullptr) {
+    writer_ = std::make_unique<TraceWriter>(
+        std::move(trace_folder),
+        std::move(trace_prefix),
+        *shards,
+        callbacks_,
+        calculateHeaders());
+  } else if (records != nullptr) {
+    writer_ = std::make_unique<TraceWriter>(
+        std::move(trace_folder),
+        std::move(trace_prefix),
+        *records,
+        callbacks_,
+        calculateHeaders(),
+        [scratch = std::vector<char>()](
+            entries::EntryVisitor& visitor,
+            RecordBuffer& buffer,
+            RecordBuffer::Cursor& cursor) mutable {
+          traceBackwards(visitor, buffer, cursor, scratch);
+        });
+  } else {
+    writer_ = std::make_unique<TraceWriter>(
+        std::move(trace_folder),
+        std::move(trace_prefix),
+        RingBuffer::get(),
+        callbacks_,
+        calculateHeaders(),
+        [](entries::EntryVisitor& visitor,
+           TraceBuffer& buffer,
+           TraceBuffer::Cursor& cursor) {
+          traceBackwards(visitor, buffer, cursor);
+        });
+    if (pipelined) {
+      writer_->enablePipeline();
+    }
+  }
+}
 
 void NativeTraceWriter::loop() {
-  writer_.loop();
+  writer_->loop();
 }
 
 void NativeTraceWriter::submit(TraceBuffer::Cursor cursor, int64_t trace_id) {
-  writer_.submit(cursor, trace_id);
+  writer_->submit(cursor, trace_id);
+}
+
+void NativeTraceWriter::setTraceCompression(
+    jlong trace_id,
+    jint level,
+    jint buffer_size) {
+  callbacks_->setCompression(
+      trace_id, level, buffer_size > 0 ? static_cast<size_t>(buffer_size) : 0);
 }
 
 local_ref<NativeTraceWriter::jhybriddata> NativeTraceWriter::initHybrid(
     alias_ref<jclass>,
     std::string trace_folder,
     std::string trace_prefix,
-    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks) {
-  return makeCxxInstance(trace_folder, trace_prefix, callbacks);
+    fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+    jboolean pipelined) {
+  return makeCxxInstance(trace_folder, trace_prefix, callbacks, pipelined);
 }
 
 void NativeTraceWriter::registerNatives() {
   registerHybrid({
       makeNativeMethod("initHybrid", NativeTraceWriter::initHybrid),
       makeNativeMethod("loop", NativeTraceWriter::loop),
+      makeNativeMethod(
+          "setTraceCompression", NativeTraceWriter::setTraceCompression),
   });
 }
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <fbjni/fbjni.h>
+#include <memory>
 
 #include <profilo/jni/NativeTraceWriterCallbacks.h>
 #include <profilo/writer/TraceWriter.h>
@@ -36,7 +37,8 @@ class NativeTraceWriter : public fbjni::HybridClass<NativeTraceWriter> {
       fbjni::alias_ref<jclass>,
       std::string trace_folder,
       std::string trace_prefix,
-      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks);
+      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+      jboolean pipelined);
 
   static void registerNatives();
 
@@ -44,16 +46,19 @@ class NativeTraceWriter : public fbjni::HybridClass<NativeTraceWriter> {
 
   void submit(TraceBuffer::Cursor cursor, int64_t trace_id);
 
+  void setTraceCompression(jlong trace_id, jint level, jint buffer_size);
+
  private:
   friend HybridBase;
 
   NativeTraceWriter(
       std::string trace_folder,
       std::string trace_prefix,
-      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks);
+      fbjni::alias_ref<JNativeTraceWriterCallbacks> callbacks,
+      jboolean pipelined);
 
-  std::shared_ptr<TraceCallbacks> callbacks_;
-  writer::TraceWriter writer_;
+  std::shared_ptr<NativeTraceWriterCallbacksProxy> callbacks_;
+  std::unique_ptr<writer::TraceWriter> writer_;
 };
 
 } // namespace writer
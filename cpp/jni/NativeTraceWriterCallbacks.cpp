@@ -51,7 +51,39 @@ void JNativeTraceWriterCallbacks::onTraceAbort(
 
 NativeTraceWriterCallbacksProxy::NativeTraceWriterCallbacksProxy(
     fbjni::alias_ref<JNativeTraceWriterCallbacks> javaCallbacks)
-    : TraceCallbacks(), javaCallbacks_(fbjni::make_global(javaCallbacks)) {}
+    : TraceCallbacks(),
+      javaCallbacks_(fbjni::make_global(javaCallbacks)),
+      compressionMutex_(),
+      compression_() {}
+
+constexpr int32_t NativeTraceWriterCallbacksProxy::kDefaultCompressionLevel;
+
+void NativeTraceWriterCallbacksProxy::setCompression(
+    int64_t trace_id,
+    int32_t level,
+    size_t buffer_size) {
+  std::lock_guard<std::mutex> lock(compressionMutex_);
+  compression_[trace_id] = CompressionOverride{level, buffer_size};
+}
+
+CompressionConfig NativeTraceWriterCallbacksProxy::getCompressionConfig(
+    int64_t trace_id,
+    int32_t flags) {
+  auto config = CompressionConfig::forFlags(flags);
+  std::lock_guard<std::mutex> lock(compressionMutex_);
+  auto it = compression_.find(trace_id);
+  if (it == compression_.end()) {
+    return config;
+  }
+  if (it->second.level != kDefaultCompressionLevel) {
+    config.level = it->second.level;
+  }
+  if (it->second.buffer_size > 0) {
+    config.buffer_size = it->second.buffer_size;
+  }
+  compression_.erase(it);
+  return config;
+}
 
 void NativeTraceWriterCallbacksProxy::onTraceStart(
     int64_t trace_id,
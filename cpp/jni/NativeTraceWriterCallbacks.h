@@ -19,6 +19,10 @@
 #include <fbjni/fbjni.h>
 #include <profilo/writer/TraceWriter.h>
 
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
 namespace fbjni = facebook::jni;
 
 namespace facebook {
@@ -40,9 +44,23 @@ struct JNativeTraceWriterCallbacks
 // delegates all TraceCallbacks calls to it.
 //
 struct NativeTraceWriterCallbacksProxy : public TraceCallbacks {
+  // Passed as the level to setCompression() to keep the codec's default.
+  static constexpr int32_t kDefaultCompressionLevel = INT32_MIN;
+
   NativeTraceWriterCallbacksProxy(
       fbjni::alias_ref<JNativeTraceWriterCallbacks> javaCallbacks);
 
+  //
+  // Overrides the compression level and buffer size of the trace, on top
+  // of what its flags select. Has to be called before the trace start is
+  // written, and buffer_size 0 keeps the default.
+  //
+  void setCompression(int64_t trace_id, int32_t level, size_t buffer_size);
+
+  virtual CompressionConfig getCompressionConfig(
+      int64_t trace_id,
+      int32_t flags) override;
+
   virtual void onTraceStart(int64_t trace_id, int32_t flags, std::string file)
       override;
 
@@ -51,7 +69,15 @@ struct NativeTraceWriterCallbacksProxy : public TraceCallbacks {
   virtual void onTraceAbort(int64_t trace_id, AbortReason reason) override;
 
  private:
+  struct CompressionOverride {
+    int32_t level;
+    size_t buffer_size;
+  };
+
   fbjni::global_ref<JNativeTraceWriterCallbacks> javaCallbacks_;
+  std::mutex compressionMutex_;
+  // Set from the thread starting the trace, consumed by the writer thread.
+  std::unordered_map<int64_t, CompressionOverride> compression_;
 };
 
 } // namespace writer
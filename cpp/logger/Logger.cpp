@@ -16,6 +16,8 @@
 
 #include "Logger.h"
 
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+
 #include <algorithm>
 #include <chrono>
 #include <cstring>
@@ -27,7 +29,15 @@ using namespace entries;
 
 Logger& Logger::get() {
   static Logger logger(
-      [&]() -> logger::PacketBuffer& { return RingBuffer::get(); },
+      [&]() -> logger::PacketBuffer& {
+        auto sharded = RingBuffer::getShardedBuffer();
+        return sharded != nullptr ? sharded->shardForCurrentThread()
+                                  : RingBuffer::get();
+      },
+      [&]() -> RecordBuffer* { return RingBuffer::getRecordBuffer(); },
+      [&]() -> ResizableTraceBuffer* {
+        return RingBuffer::getResizableBuffer();
+      },
       kInitialEntryId);
   return logger;
 }
@@ -53,6 +63,31 @@ int32_t Logger::writeBytes(
   return write(std::move(entry));
 }
 
+int32_t Logger::writeInternedBytes(
+    EntryType type,
+    int32_t arg1,
+    const uint8_t* arg2,
+    size_t len) {
+  if (arg2 == nullptr) {
+    throw std::invalid_argument("arg2 is null");
+  }
+  uint32_t string_id = interning_.load(std::memory_order_relaxed)
+      ? logger::StringTable::get().intern(arg2, len)
+      : 0;
+  if (string_id == 0) {
+    return writeBytes(type, arg1, arg2, len);
+  }
+  return write(StandardEntry{
+      .id = 0,
+      .type = EntryType::STRING_REFERENCE,
+      .timestamp = 0,
+      .tid = 0,
+      .callid = static_cast<int32_t>(string_id),
+      .matchid = arg1,
+      .extra = static_cast<int64_t>(type),
+  });
+}
+
 void Logger::writeStackFrames(
     int32_t tid,
     int64_t time,
@@ -82,5 +117,30 @@ void Logger::writeTraceAnnotation(int32_t key, int64_t value) {
   });
 }
 
+void Logger::startCountingDroppedWrites(int64_t trace_id) {
+  std::lock_guard<std::mutex> lock(dropped_writes_mutex_);
+  dropped_writes_at_start_[trace_id] = logger_.droppedWrites();
+}
+
+void Logger::writeDroppedWritesAnnotation(int64_t trace_id) {
+  uint64_t at_start;
+  {
+    std::lock_guard<std::mutex> lock(dropped_writes_mutex_);
+    auto it = dropped_writes_at_start_.find(trace_id);
+    if (it == dropped_writes_at_start_.end()) {
+      return;
+    }
+    at_start = it->second;
+    dropped_writes_at_start_.erase(it);
+  }
+  auto dropped = logger_.droppedWrites() - at_start;
+  if (dropped == 0) {
+    return;
+  }
+  writeTraceAnnotation(
+      QuickLogConstants::LOGGER_ERR_DROPPED_WRITES,
+      static_cast<int64_t>(dropped));
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -20,8 +20,13 @@
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryType.h>
 #include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+
+#include <mutex>
+#include <unordered_map>
 
 #include "PacketLogger.h"
+#include "StringTable.h"
 
 #define PROFILOEXPORT __attribute__((visibility("default")))
 
@@ -30,6 +35,109 @@ namespace profilo {
 
 using namespace entries;
 
+namespace detail {
+
+//
+// Entries whose format has a compact variant are written in it when
+// `compact` is set, everything else uses the fixed-width layout. EntryParser
+// understands both.
+//
+template <class T>
+auto calculatePackedSize(const T& entry, bool compact, int)
+    -> decltype(T::calculateCompactSize(entry)) {
+  return compact ? T::calculateCompactSize(entry) : T::calculateSize(entry);
+}
+
+template <class T>
+size_t calculatePackedSize(const T& entry, bool /* compact */, long) {
+  return T::calculateSize(entry);
+}
+
+template <class T>
+auto packEntry(const T& entry, bool compact, void* dst, size_t size, int)
+    -> decltype(T::packCompact(entry, dst, size)) {
+  if (compact) {
+    T::packCompact(entry, dst, size);
+  } else {
+    T::pack(entry, dst, size);
+  }
+}
+
+template <class T>
+void packEntry(
+    const T& entry,
+    bool /* compact */,
+    void* dst,
+    size_t size,
+    long) {
+  T::pack(entry, dst, size);
+}
+
+template <class T>
+auto entryTimestamp(const T& entry, int) -> decltype(entry.timestamp) {
+  return entry.timestamp;
+}
+
+template <class T>
+int64_t entryTimestamp(const T& /* entry */, long) {
+  return 0;
+}
+
+//
+// Holds back readers of the sharded buffer, if it's in use, until the
+// write of an entry with the given timestamp is committed, and wakes them
+// up after. Entries without one are merged along with the entry before
+// them and need no watermark.
+//
+class ShardWriteScope {
+ public:
+  explicit ShardWriteScope(int64_t timestamp)
+      : sharded_(RingBuffer::getShardedBuffer()), watermark_(nullptr) {
+    if (sharded_ != nullptr && timestamp > 0) {
+      watermark_ = &sharded_->watermarkForCurrentThread();
+      watermark_->begin(timestamp);
+    }
+  }
+
+  ~ShardWriteScope() {
+    if (watermark_ != nullptr) {
+      watermark_->end();
+    }
+    if (sharded_ != nullptr) {
+      sharded_->notifyWrite();
+    }
+  }
+
+  ShardWriteScope(const ShardWriteScope&) = delete;
+  ShardWriteScope& operator=(const ShardWriteScope&) = delete;
+
+ private:
+  ShardedTraceBuffer* sharded_;
+  ShardWatermark* watermark_;
+};
+
+//
+// Makes the calling thread's writes blocking for as long as it's in scope.
+//
+class BlockingWriteScope {
+ public:
+  BlockingWriteScope() : blocking_(logger::PacketLogger::isBlocking()) {
+    logger::PacketLogger::setBlocking(true);
+  }
+
+  ~BlockingWriteScope() {
+    logger::PacketLogger::setBlocking(blocking_);
+  }
+
+  BlockingWriteScope(const BlockingWriteScope&) = delete;
+  BlockingWriteScope& operator=(const BlockingWriteScope&) = delete;
+
+ private:
+  bool blocking_;
+};
+
+} // namespace detail
+
 class Logger {
   const int32_t TRACING_DISABLED = -1;
   const int32_t NO_MATCH = 0;
@@ -46,29 +154,60 @@ class Logger {
   int32_t write(T&& entry, uint16_t id_step = 1) {
     entry.id = nextID(id_step);
 
-    auto size = T::calculateSize(entry);
-    char payload[size];
-    T::pack(entry, payload, size);
-
-    logger_.write(payload, size);
+    // Packets are fixed-size, so only records gain from the compact layout.
+    auto compact = logger_.hasRecordBuffer();
+    auto size = detail::calculatePackedSize(entry, compact, 0);
+    detail::ShardWriteScope shard_write(detail::entryTimestamp(entry, 0));
+    logger_.writeInPlace(size, [&entry, compact](void* dst, size_t dst_size) {
+      detail::packEntry(entry, compact, dst, dst_size, 0);
+    });
     return entry.id;
   }
 
+  //
+  // For entries readers start from, such as TRACE_START. These are written
+  // in blocking mode regardless of the calling thread's, so that the cursor
+  // points to the entry rather than to where a dropped write would be.
+  //
   template <class T>
   int32_t writeAndGetCursor(T&& entry, TraceBuffer::Cursor& cursor) {
     entry.id = nextID();
 
-    auto size = T::calculateSize(entry);
-    char payload[size];
-    T::pack(entry, payload, size);
-
-    cursor = logger_.writeAndGetCursor(payload, size);
+    auto compact = logger_.hasRecordBuffer();
+    auto size = detail::calculatePackedSize(entry, compact, 0);
+    detail::ShardWriteScope shard_write(detail::entryTimestamp(entry, 0));
+    detail::BlockingWriteScope blocking_write;
+    cursor = logger_.writeInPlace(
+        size, [&entry, compact](void* dst, size_t dst_size) {
+          detail::packEntry(entry, compact, dst, dst_size, 0);
+        });
     return entry.id;
   }
 
   PROFILOEXPORT int32_t
   writeBytes(EntryType type, int32_t arg1, const uint8_t* arg2, size_t len);
 
+  //
+  // Same as writeBytes(), for strings that are logged over and over. The
+  // string is added to the process StringTable and logged as a compact
+  // STRING_REFERENCE entry: callid is the string ID, matchid is arg1 and
+  // extra is `type`. Falls back to writeBytes() when the table doesn't
+  // take the string, or interning is disabled.
+  //
+  PROFILOEXPORT int32_t writeInternedBytes(
+      EntryType type,
+      int32_t arg1,
+      const uint8_t* arg2,
+      size_t len);
+
+  //
+  // String IDs are only meaningful to the process that logged them.
+  // Disable interning when the buffer may be read by another process.
+  //
+  void setStringInterning(bool enabled) {
+    interning_.store(enabled, std::memory_order_relaxed);
+  }
+
   PROFILOEXPORT void writeStackFrames(
       int32_t tid,
       int64_t time,
@@ -79,14 +218,52 @@ class Logger {
 
   PROFILOEXPORT void writeTraceAnnotation(int32_t key, int64_t value);
 
+  //
+  // Non-blocking writers drop entries rather than wait for a writer that
+  // got lapped. Meant for latency-sensitive threads under heavy load, such
+  // as the UI thread. Applies to the calling thread only.
+  //
+  static void setBlockingWrites(bool blocking) {
+    logger::PacketLogger::setBlocking(blocking);
+  }
+
+  //
+  // Dropped writes are reported per trace: this takes note of the count
+  // when trace_id starts, and writeDroppedWritesAnnotation() annotates the
+  // trace with the writes dropped since then, if any, before it ends.
+  //
+  PROFILOEXPORT void startCountingDroppedWrites(int64_t trace_id);
+  PROFILOEXPORT void writeDroppedWritesAnnotation(int64_t trace_id);
+
   // This constructor is for internal framework use.
   // Client code should use Logger::get() method instead.
   Logger(logger::PacketBufferProvider provider, int32_t start_entry_id = 0)
-      : entryID_(start_entry_id), logger_(provider) {}
+      : entryID_(start_entry_id), interning_(true), logger_(provider) {}
+
+  Logger(
+      logger::PacketBufferProvider provider,
+      logger::RecordBufferProvider record_provider,
+      int32_t start_entry_id = 0)
+      : entryID_(start_entry_id),
+        interning_(true),
+        logger_(provider, record_provider) {}
+
+  Logger(
+      logger::PacketBufferProvider provider,
+      logger::RecordBufferProvider record_provider,
+      logger::ResizableBufferProvider resizable_provider,
+      int32_t start_entry_id = 0)
+      : entryID_(start_entry_id),
+        interning_(true),
+        logger_(provider, record_provider, resizable_provider) {}
 
  private:
   std::atomic<int32_t> entryID_;
+  std::atomic<bool> interning_;
   logger::PacketLogger logger_;
+  // Dropped writes at the start of each trace in progress, by trace ID.
+  std::mutex dropped_writes_mutex_;
+  std::unordered_map<int64_t, uint64_t> dropped_writes_at_start_;
 
   Logger(const Logger& other) = delete;
 
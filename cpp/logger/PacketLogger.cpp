@@ -16,12 +16,73 @@
 
 #include "PacketLogger.h"
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
 namespace facebook {
 namespace profilo {
 namespace logger {
 
+namespace {
+//
+// Fills `packet` with the part of the `size` byte payload of `stream` that
+// starts at `offset`. Returns the number of bytes it holds.
+//
+size_t fillPacket(
+    Packet& packet,
+    StreamID stream,
+    const char* payload,
+    size_t size,
+    size_t offset) {
+  constexpr auto kOnePacketSize = sizeof(Packet::data);
+  auto remaining = size - offset;
+  uint8_t write_size = std::min(kOnePacketSize, remaining);
+
+  packet.stream = stream;
+  packet.start = offset == 0;
+  packet.next = remaining > kOnePacketSize;
+  packet.size = write_size;
+  std::memcpy(packet.data, payload + offset, write_size);
+  return write_size;
+}
+} // namespace
+
+thread_local bool PacketLogger::blocking_ = true;
+
 PacketLogger::PacketLogger(PacketBufferProvider provider)
-    : streamID_(0), provider_(provider) {}
+    : streamID_(0),
+      droppedWrites_(0),
+      provider_(provider),
+      record_provider_(nullptr),
+      resizable_provider_(nullptr) {}
+
+PacketLogger::PacketLogger(
+    PacketBufferProvider provider,
+    RecordBufferProvider record_provider)
+    : streamID_(0),
+      droppedWrites_(0),
+      provider_(provider),
+      record_provider_(record_provider),
+      resizable_provider_(nullptr) {}
+
+PacketLogger::PacketLogger(
+    PacketBufferProvider provider,
+    RecordBufferProvider record_provider,
+    ResizableBufferProvider resizable_provider)
+    : streamID_(0),
+      droppedWrites_(0),
+      provider_(provider),
+      record_provider_(record_provider),
+      resizable_provider_(resizable_provider) {}
+
+void PacketLogger::setBlocking(bool blocking) {
+  blocking_ = blocking;
+}
+
+bool PacketLogger::isBlocking() {
+  return blocking_;
+}
 
 void PacketLogger::write(void* payload, size_t size) {
   writeAndGetCursor(payload, size);
@@ -38,38 +99,98 @@ PacketBuffer::Cursor PacketLogger::writeAndGetCursor(
     throw std::invalid_argument("payload is null");
   }
 
-  auto& buffer = provider_();
+  if (record_provider_ != nullptr) {
+    auto records = record_provider_();
+    if (records != nullptr) {
+      // Records are length-prefixed, no need to packetize.
+      RecordBuffer::Cursor cursor = records->currentHead();
+      if (size > RecordBuffer::kMaxRecordSize ||
+          !records->tryWrite(payload, static_cast<uint32_t>(size), cursor)) {
+        // Too large for a record. Dropped like a non-blocking write.
+        droppedWrites_.fetch_add(1, std::memory_order_relaxed);
+        return records->currentHead();
+      }
+      CheckpointIndex::onWrite(
+          *records, cursor, RecordBuffer::recordSpan(size));
+      return cursor;
+    }
+  }
 
-  PacketBuffer::Cursor cursor = buffer.currentTail();
-  bool cursor_set = false;
+  auto resizable = resizableBuffer();
+  if (resizable != nullptr) {
+    // The buffer must not be retired while the write is in progress.
+    WriterEpoch::Section section(resizable->epoch());
+    return writePackets(resizable->current(), payload, size);
+  }
+  return writePackets(provider_(), payload, size);
+}
 
+PacketBuffer::Cursor PacketLogger::writePackets(
+    PacketBuffer& buffer,
+    void* payload,
+    size_t size) {
   StreamID stream_id = streamID_.fetch_add(1, std::memory_order_relaxed);
 
-  size_t offset = 0;
-  while (offset < size) {
-    const auto kOnePacketSize = sizeof(Packet::data);
-
-    auto remaining = size - offset;
-    bool has_next = remaining > kOnePacketSize;
-    uint8_t write_size = std::min(kOnePacketSize, remaining);
+  constexpr auto kOnePacketSize = sizeof(Packet::data);
 
+  if (size <= kOnePacketSize) {
     Packet packet{.stream = stream_id,
-                  .start = offset == 0,
-                  .next = has_next,
-                  .size = write_size,
+                  .start = true,
+                  .next = false,
+                  .size = static_cast<uint16_t>(size),
                   .data = {}};
-
-    std::memcpy(packet.data, static_cast<char*>(payload) + offset, write_size);
-
-    if (!cursor_set) {
-      cursor = buffer.writeAndGetCursor(packet);
-      cursor_set = true;
+    std::memcpy(packet.data, payload, size);
+    if (isBlocking()) {
+      auto cursor = buffer.writeAndGetCursor(packet);
+      CheckpointIndex::onWrite(buffer, cursor, 1);
+      return cursor;
+    }
+    PacketBuffer::Cursor cursor = buffer.currentHead();
+    if (buffer.tryWriteAndGetCursor(packet, cursor)) {
+      CheckpointIndex::onWrite(buffer, cursor, 1);
     } else {
-      buffer.write(packet);
+      droppedWrites_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return cursor;
+  }
+
+  size_t total_packets = (size + kOnePacketSize - 1) / kOnePacketSize;
+  auto data = static_cast<const char*>(payload);
+
+  if (!isBlocking()) {
+    //
+    // All packets of the stream are claimed at once, so the entry is either
+    // written or dropped as a whole. Dropping only a later part would leave
+    // the earlier packets behind as a stream that never ends, which the
+    // reassembler would hold on to until the trace is done.
+    //
+    PacketBuffer::Cursor cursor = buffer.currentHead();
+    bool written = total_packets <= buffer.capacity() &&
+        buffer.tryWriteN(
+            static_cast<uint32_t>(total_packets),
+            cursor,
+            [&](uint32_t idx, Packet& packet) {
+              fillPacket(packet, stream_id, data, size, idx * kOnePacketSize);
+            });
+    if (!written) {
+      droppedWrites_.fetch_add(1, std::memory_order_relaxed);
+      return buffer.currentHead();
     }
-    offset += write_size;
+    CheckpointIndex::onWrite(buffer, cursor, total_packets);
+    return cursor;
   }
 
+  //
+  // A multi-packet stream claims its ring buffer tickets with a single
+  // atomic operation and each packet is filled in its slot directly,
+  // without staging the packets first.
+  //
+  auto cursor = buffer.writeN(
+      static_cast<uint32_t>(total_packets),
+      [&](uint32_t idx, Packet& packet) {
+        fillPacket(packet, stream_id, data, size, idx * kOnePacketSize);
+      });
+  CheckpointIndex::onWrite(buffer, cursor, total_packets);
   return cursor;
 }
 
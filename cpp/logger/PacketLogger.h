@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <profilo/logger/buffer/CheckpointIndex.h>
 #include <profilo/logger/buffer/Packet.h>
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 #include <functional>
@@ -31,20 +33,126 @@ namespace logger {
 
 using PacketBuffer = TraceBuffer;
 using PacketBufferProvider = std::function<PacketBuffer&()>;
+// Returns the record buffer to write to, or nullptr to use packets.
+using RecordBufferProvider = std::function<RecordBuffer*()>;
+// Returns the resizable buffer to write to, or nullptr to use the provider.
+using ResizableBufferProvider = std::function<ResizableTraceBuffer*()>;
 
 class PacketLogger {
  public:
   PacketLogger(PacketBufferProvider provider);
+  PacketLogger(
+      PacketBufferProvider provider,
+      RecordBufferProvider record_provider);
+  PacketLogger(
+      PacketBufferProvider provider,
+      RecordBufferProvider record_provider,
+      ResizableBufferProvider resizable_provider);
   PacketLogger(const PacketLogger& other) = delete;
 
   PROFILOEXPORT void write(void* payload, size_t size);
+
+  //
+  // Returns the cursor of the written entry. A dropped write, see
+  // setBlocking() and droppedWrites(), returns the cursor the next write
+  // will get instead.
+  //
   PROFILOEXPORT PacketBuffer::Cursor writeAndGetCursor(
       void* payload,
       size_t size);
 
+  //
+  // In non-blocking mode, writes that would wait for a lapped writer to
+  // finish with its slot are dropped and counted instead. The mode is per
+  // thread and applies to the calling thread only, blocking by default.
+  //
+  PROFILOEXPORT static void setBlocking(bool blocking);
+  PROFILOEXPORT static bool isBlocking();
+
+  //
+  // Returns the number of writes dropped since this logger was created:
+  // non-blocking writes, and records larger than the record buffer takes.
+  //
+  uint64_t droppedWrites() {
+    return droppedWrites_.load(std::memory_order_relaxed);
+  }
+
+  //
+  // Writes a <size> byte payload produced by pack(void* dst, size_t size).
+  // Payloads that fit in a single packet are packed directly into the
+  // claimed ring buffer slot, skipping the intermediate copy. Larger ones
+  // are packed on the stack once, since pack() needs contiguous memory and
+  // slots hold a packet header each, then split straight into their slots.
+  //
+  template <class PackFn>
+  PacketBuffer::Cursor writeInPlace(size_t size, PackFn pack) {
+    constexpr auto kOnePacketSize = sizeof(Packet::data);
+
+    // A claimed slot cannot be given back, so non-blocking writes always
+    // go through the copying path.
+    if (size == 0 || size > kOnePacketSize || !isBlocking() ||
+        hasRecordBuffer()) {
+      char payload[size == 0 ? 1 : size];
+      pack(payload, size);
+      return writeAndGetCursor(payload, size);
+    }
+
+    auto resizable = resizableBuffer();
+    if (resizable != nullptr) {
+      WriterEpoch::Section section(resizable->epoch());
+      return packInPlace(resizable->current(), size, pack);
+    }
+    return packInPlace(provider_(), size, pack);
+  }
+
+  //
+  // Whether writes go to the variable-length record buffer rather than to
+  // fixed-size packets.
+  //
+  bool hasRecordBuffer() {
+    return record_provider_ != nullptr && record_provider_() != nullptr;
+  }
+
  private:
+  template <class PackFn>
+  PacketBuffer::Cursor
+  packInPlace(PacketBuffer& buffer, size_t size, PackFn& pack) {
+    auto claim = buffer.claim();
+    Packet& packet = claim.value();
+    packet.stream = streamID_.fetch_add(1, std::memory_order_relaxed);
+    packet.start = true;
+    packet.next = false;
+    packet.size = static_cast<uint16_t>(size);
+    try {
+      pack(packet.data, size);
+    } catch (...) {
+      // The slot must be published regardless. A lone continuation packet
+      // is discarded by the reassembler.
+      packet.start = false;
+      packet.size = 0;
+      buffer.publish(claim);
+      throw;
+    }
+    auto cursor = buffer.publish(claim);
+    CheckpointIndex::onWrite(buffer, cursor, 1);
+    return cursor;
+  }
+
+  ResizableTraceBuffer* resizableBuffer() {
+    return resizable_provider_ != nullptr ? resizable_provider_() : nullptr;
+  }
+
+  PacketBuffer::Cursor
+  writePackets(PacketBuffer& buffer, void* payload, size_t size);
+
+
+  static thread_local bool blocking_;
+
   std::atomic<uint32_t> streamID_;
+  std::atomic<uint64_t> droppedWrites_;
   PacketBufferProvider provider_;
+  RecordBufferProvider record_provider_;
+  ResizableBufferProvider resizable_provider_;
 };
 
 } // namespace logger
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "StringTable.h"
+
+#include <cstring>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+namespace {
+
+uint32_t hashString(const uint8_t* data, size_t size) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t idx = 0; idx < size; ++idx) {
+    hash = (hash ^ data[idx]) * 16777619u;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+size_t roundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+// Strings are stored with their size in front.
+constexpr size_t kSizePrefix = sizeof(uint16_t);
+
+// Lives for the rest of the process once created, like the RingBuffer.
+std::atomic<StringTable*> process_table(nullptr);
+
+} // namespace
+
+constexpr size_t StringTable::kMaxStringSize;
+constexpr size_t StringTable::kDefaultSlots;
+constexpr size_t StringTable::kDefaultStorageBytes;
+constexpr size_t StringTable::kMaxProbes;
+constexpr uint32_t StringTable::kNoStorage;
+
+StringTable& StringTable::init(size_t slots, size_t storage_bytes) {
+  auto table = new StringTable(slots, storage_bytes);
+  StringTable* expected = nullptr;
+  if (!process_table.compare_exchange_strong(expected, table)) {
+    // Already initialized
+    delete table;
+    return *expected;
+  }
+  return *table;
+}
+
+StringTable& StringTable::get() {
+  auto table = process_table.load(std::memory_order_acquire);
+  if (table != nullptr) {
+    return *table;
+  }
+  return init();
+}
+
+StringTable::StringTable(size_t slots, size_t storage_bytes)
+    : mask_(roundUpToPowerOfTwo(slots) - 1),
+      slots_(new Slot[mask_ + 1]),
+      storage_size_(storage_bytes),
+      storage_(new uint8_t[storage_bytes]),
+      storage_used_(0),
+      full_(false) {
+  for (size_t idx = 0; idx <= mask_; ++idx) {
+    slots_[idx].hash.store(0, std::memory_order_relaxed);
+    slots_[idx].offset.store(0, std::memory_order_relaxed);
+  }
+}
+
+uint32_t StringTable::intern(const uint8_t* data, size_t size) {
+  if (size > kMaxStringSize || full()) {
+    return 0;
+  }
+  auto hash = hashString(data, size);
+  for (size_t probe = 0; probe < kMaxProbes && probe <= mask_; ++probe) {
+    auto index = (hash + probe) & mask_;
+    auto& slot = slots_[index];
+    auto id = static_cast<uint32_t>(index + 1);
+
+    auto slot_hash = slot.hash.load(std::memory_order_acquire);
+    if (slot_hash == 0) {
+      if (slot.hash.compare_exchange_strong(
+              slot_hash, hash, std::memory_order_acq_rel)) {
+        return store(slot, data, size) ? id : 0;
+      }
+      // Claimed by another thread in the meantime, slot_hash is its hash.
+    }
+    if (slot_hash != hash) {
+      continue;
+    }
+    auto offset = slot.offset.load(std::memory_order_acquire);
+    if (offset == 0) {
+      // Still being stored, possibly this very string.
+      return 0;
+    }
+    if (offset == kNoStorage) {
+      continue;
+    }
+    auto stored = lookup(id);
+    if (stored.size == size && std::memcmp(stored.data, data, size) == 0) {
+      return id;
+    }
+  }
+  // Every slot the string may go in is taken by others.
+  full_.store(true, std::memory_order_relaxed);
+  return 0;
+}
+
+StringTable::String StringTable::lookup(uint32_t id) const {
+  if (id == 0 || id > mask_ + 1) {
+    return String{nullptr, 0};
+  }
+  auto offset = slots_[id - 1].offset.load(std::memory_order_acquire);
+  if (offset == 0 || offset == kNoStorage) {
+    return String{nullptr, 0};
+  }
+  const uint8_t* stored = storage_.get() + offset - 1;
+  uint16_t size;
+  std::memcpy(&size, stored, sizeof(size));
+  return String{stored + kSizePrefix, size};
+}
+
+bool StringTable::store(Slot& slot, const uint8_t* data, size_t size) {
+  auto offset =
+      storage_used_.fetch_add(kSizePrefix + size, std::memory_order_relaxed);
+  if (offset + kSizePrefix + size > storage_size_) {
+    // Out of room for good; leave the slot to lookups of other strings.
+    slot.offset.store(kNoStorage, std::memory_order_release);
+    full_.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  auto stored = storage_.get() + offset;
+  auto stored_size = static_cast<uint16_t>(size);
+  std::memcpy(stored, &stored_size, sizeof(stored_size));
+  std::memcpy(stored + kSizePrefix, data, size);
+  slot.offset.store(
+      static_cast<uint32_t>(offset + 1), std::memory_order_release);
+  return true;
+}
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,126 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#define PROFILOEXPORT __attribute__((visibility("default")))
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+
+//
+// Strings logged over and over, such as section names, are stored here
+// once and logged by ID, see Logger::writeInternedBytes(). Both interning
+// and lookups are lock-free and never wait for another thread. The table
+// only grows: IDs stay valid for the lifetime of the process, which is
+// also why they mean nothing outside of it.
+//
+// intern() gives up, returning 0, rather than block or grow the table:
+// when the string is too long, when the table or its storage is full, or
+// when another thread is adding the same string right now. Once a string
+// found no room, the table counts as full and intern() returns 0 right
+// away, without hashing or probing: strings are then logged in full, as
+// if interning were off. init() sizes the process table for the strings
+// the app actually uses.
+//
+class StringTable {
+ public:
+  static constexpr size_t kMaxStringSize = 256;
+  static constexpr size_t kDefaultSlots = 4096;
+  static constexpr size_t kDefaultStorageBytes = 256 * 1024;
+
+  struct String {
+    const uint8_t* data;
+    size_t size;
+  };
+
+  //
+  // Creates the process table with the given size. Only the first call,
+  // or the first get(), takes effect; later calls return the existing
+  // table.
+  //
+  PROFILOEXPORT static StringTable& init(
+      size_t slots = kDefaultSlots,
+      size_t storage_bytes = kDefaultStorageBytes);
+
+  //
+  // Returns the process table, created with the default size if init()
+  // hasn't been called.
+  //
+  PROFILOEXPORT static StringTable& get();
+
+  //
+  // slots - maximum number of strings, rounded up to a power of two
+  // storage_bytes - room for the strings themselves
+  //
+  explicit StringTable(
+      size_t slots = kDefaultSlots,
+      size_t storage_bytes = kDefaultStorageBytes);
+
+  StringTable(const StringTable&) = delete;
+  StringTable& operator=(const StringTable&) = delete;
+
+  //
+  // Returns the ID of the string, adding it if need be, or 0.
+  //
+  PROFILOEXPORT uint32_t intern(const uint8_t* data, size_t size);
+
+  //
+  // Returns the string with ID `id`, or {nullptr, 0} if there is none.
+  //
+  PROFILOEXPORT String lookup(uint32_t id) const;
+
+  //
+  // Returns true once intern() no longer adds nor finds strings.
+  //
+  bool full() const {
+    return full_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Lookups probe this many slots at most, so the table can fill up
+  // before all of its slots are taken.
+  static constexpr size_t kMaxProbes = 16;
+  // Set as the storage offset of slots claimed when storage ran out.
+  static constexpr uint32_t kNoStorage = UINT32_MAX;
+
+  struct Slot {
+    // Hash of the string, never 0 once the slot is claimed.
+    std::atomic<uint32_t> hash;
+    // 1 + the offset of the string in storage_, 0 until it's stored.
+    std::atomic<uint32_t> offset;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  const size_t storage_size_;
+  std::unique_ptr<uint8_t[]> storage_;
+  std::atomic<size_t> storage_used_;
+  std::atomic<bool> full_;
+
+  bool store(Slot& slot, const uint8_t* data, size_t size);
+};
+
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
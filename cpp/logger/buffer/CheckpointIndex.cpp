@@ -0,0 +1,134 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "CheckpointIndex.h"
+
+#include <util/common.h>
+
+namespace facebook {
+namespace profilo {
+
+CheckpointIndex& CheckpointIndex::get() {
+  static CheckpointIndex index;
+  return index;
+}
+
+CheckpointIndex::CheckpointIndex()
+    : buffer_(nullptr), checkpoints_(nullptr), capacity_(0), interval_(1) {}
+
+void CheckpointIndex::reset(TraceBuffer* buffer) {
+  reset(buffer, buffer != nullptr ? buffer->capacity() : 0, kInterval);
+}
+
+void CheckpointIndex::reset(RecordBuffer* buffer) {
+  reset(buffer, buffer != nullptr ? buffer->capacity() : 0, kRecordInterval);
+}
+
+void CheckpointIndex::reset(
+    const void* buffer,
+    uint64_t size,
+    uint64_t interval) {
+  buffer_.store(nullptr);
+  if (buffer == nullptr) {
+    checkpoints_ = nullptr;
+    capacity_ = 0;
+    return;
+  }
+
+  // A little over what the buffer holds, so its oldest entries are covered.
+  interval_ = interval;
+  capacity_ = size / interval + 2;
+  checkpoints_ = std::make_unique<Checkpoint[]>(capacity_);
+  for (size_t idx = 0; idx < capacity_; ++idx) {
+    checkpoints_[idx].ticket.store(kWriting, std::memory_order_relaxed);
+    checkpoints_[idx].timestamp.store(0, std::memory_order_relaxed);
+  }
+  buffer_.store(buffer);
+}
+
+void CheckpointIndex::record(const void* buffer, uint64_t ticket) {
+  if (buffer_.load(std::memory_order_acquire) != buffer) {
+    return;
+  }
+  // Taken after the write, so every entry before `ticket` is older.
+  auto timestamp = monotonicTime();
+  auto& checkpoint =
+      checkpoints_[(ticket + interval_ - 1) / interval_ % capacity_];
+
+  checkpoint.ticket.store(kWriting, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  checkpoint.timestamp.store(timestamp, std::memory_order_relaxed);
+  checkpoint.ticket.store(ticket, std::memory_order_release);
+}
+
+bool CheckpointIndex::find(
+    TraceBuffer& buffer,
+    int64_t timestamp,
+    TraceBuffer::Cursor& cursor) {
+  uint64_t ticket;
+  if (!find(&buffer, timestamp, ticket)) {
+    return false;
+  }
+  cursor = TraceBuffer::Cursor(ticket);
+  return true;
+}
+
+bool CheckpointIndex::find(
+    RecordBuffer& buffer,
+    int64_t timestamp,
+    RecordBuffer::Cursor& cursor) {
+  uint64_t position;
+  if (!find(&buffer, timestamp, position)) {
+    return false;
+  }
+  cursor = RecordBuffer::Cursor(position);
+  return true;
+}
+
+bool CheckpointIndex::find(
+    const void* buffer,
+    int64_t timestamp,
+    uint64_t& result) {
+  if (buffer_.load(std::memory_order_acquire) != buffer) {
+    return false;
+  }
+
+  bool found = false;
+  uint64_t best = 0;
+  for (size_t idx = 0; idx < capacity_; ++idx) {
+    auto& checkpoint = checkpoints_[idx];
+    auto ticket = checkpoint.ticket.load(std::memory_order_acquire);
+    auto written = checkpoint.timestamp.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (ticket == kWriting ||
+        ticket != checkpoint.ticket.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    if (written <= timestamp && (!found || ticket > best)) {
+      best = ticket;
+      found = true;
+    }
+  }
+
+  if (found) {
+    result = best;
+  }
+  return found;
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,131 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <profilo/logger/buffer/RingBuffer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#define PROFILOEXPORT __attribute__((visibility("default")))
+
+namespace facebook {
+namespace profilo {
+
+//
+// A side index of the buffer set up by RingBuffer::init() or
+// RingBuffer::initRecordBuffer(): the cursor of an entry every kInterval
+// packets, or kRecordInterval bytes of records, with the time it was
+// written at. Readers can start from a point in time instead of walking the
+// buffer entry by entry, see writer::traceBackwards().
+//
+// The writer of the entry that crosses into the next interval records the
+// checkpoint, so the index costs a clock read per interval and nothing in
+// between. Like the buffer, it overwrites its oldest checkpoints.
+//
+class CheckpointIndex {
+ public:
+  static constexpr uint64_t kInterval = 256;
+  static constexpr uint64_t kRecordInterval = 16 * 1024;
+
+  PROFILOEXPORT static CheckpointIndex& get();
+
+  CheckpointIndex();
+  CheckpointIndex(const CheckpointIndex&) = delete;
+  CheckpointIndex& operator=(const CheckpointIndex&) = delete;
+
+  //
+  // Indexes `buffer` from now on, dropping all checkpoints. nullptr stops
+  // indexing. Must not race with writes, like RingBuffer::destroy().
+  //
+  PROFILOEXPORT void reset(TraceBuffer* buffer);
+  PROFILOEXPORT void reset(RecordBuffer* buffer);
+  void reset(std::nullptr_t) {
+    reset(static_cast<TraceBuffer*>(nullptr));
+  }
+
+  //
+  // Called after writing the first `packets` packets of an entry at
+  // `cursor` in `buffer`.
+  //
+  static void onWrite(
+      TraceBuffer& buffer,
+      TraceBuffer::Cursor cursor,
+      size_t packets) {
+    auto ticket = TraceBuffer::Cursor(0).stepsTo(cursor);
+    if (ticket % kInterval != 0 && ticket % kInterval + packets <= kInterval) {
+      return;
+    }
+    get().record(&buffer, ticket);
+  }
+
+  //
+  // Called after writing a record spanning `span` bytes at `cursor` in
+  // `buffer`.
+  //
+  static void onWrite(
+      RecordBuffer& buffer,
+      RecordBuffer::Cursor cursor,
+      uint64_t span) {
+    auto position = RecordBuffer::Cursor(0).stepsTo(cursor);
+    if (position % kRecordInterval != 0 &&
+        position % kRecordInterval + span <= kRecordInterval) {
+      return;
+    }
+    get().record(&buffer, position);
+  }
+
+  //
+  // Looks for the newest checkpoint in `buffer` written at or before
+  // `timestamp`, in nanoseconds of CLOCK_MONOTONIC. Every entry before it
+  // was written earlier than that. Returns false if there is none.
+  //
+  PROFILOEXPORT bool find(
+      TraceBuffer& buffer,
+      int64_t timestamp,
+      TraceBuffer::Cursor& cursor);
+  PROFILOEXPORT bool find(
+      RecordBuffer& buffer,
+      int64_t timestamp,
+      RecordBuffer::Cursor& cursor);
+
+ private:
+  struct Checkpoint {
+    // kWriting while the checkpoint is being written.
+    std::atomic<uint64_t> ticket;
+    std::atomic<int64_t> timestamp;
+  };
+
+  static constexpr uint64_t kWriting = UINT64_MAX;
+
+  // The indexed buffer, either kind.
+  std::atomic<const void*> buffer_;
+  std::unique_ptr<Checkpoint[]> checkpoints_;
+  size_t capacity_;
+  // kInterval or kRecordInterval, in the buffer's cursor steps.
+  uint64_t interval_;
+
+  void reset(const void* buffer, uint64_t size, uint64_t interval);
+  PROFILOEXPORT void record(const void* buffer, uint64_t ticket);
+  bool find(const void* buffer, int64_t timestamp, uint64_t& ticket);
+};
+
+} // namespace profilo
+} // namespace facebook
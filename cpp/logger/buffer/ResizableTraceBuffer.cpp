@@ -0,0 +1,79 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResizableTraceBuffer.h"
+
+#include <stdexcept>
+
+namespace facebook {
+namespace profilo {
+
+ResizableTraceBuffer::ResizableTraceBuffer(size_t slots)
+    : epoch_(),
+      mutex_(),
+      generation_count_(1),
+      current_(new Generation(TraceBuffer::allocate(slots))),
+      current_raw_(current_.get()) {
+  if (slots == 0) {
+    throw std::invalid_argument("slots is 0");
+  }
+}
+
+std::shared_ptr<ResizableTraceBuffer::Generation>
+ResizableTraceBuffer::acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_;
+}
+
+void ResizableTraceBuffer::resize(size_t slots) {
+  if (slots == 0) {
+    throw std::invalid_argument("slots is 0");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto base = generation_count_++ << kGenerationShift;
+  std::shared_ptr<Generation> next(
+      new Generation(TraceBuffer::allocate(slots, base)));
+  auto previous = std::move(current_);
+  current_ = next;
+  current_raw_.store(next.get(), std::memory_order_release);
+
+  // Writers that picked up the previous buffer before the swap finish first.
+  epoch_.synchronize();
+
+  //
+  // Nothing else will be written to the previous buffer. It is sealed
+  // before writing one last empty packet to wake up readers blocked at its
+  // head, so that they find the seal once woken. The reassembler drops the
+  // packet as it does not start a stream.
+  //
+  auto& buffer = previous->buffer();
+  auto end = buffer.currentHead();
+  end.moveForward();
+  previous->end_ = end;
+  previous->next_ = std::move(next);
+  previous->sealed_.store(true, std::memory_order_release);
+
+  logger::Packet wakeup{.stream = logger::Packet::kPacketIdNone,
+                        .start = false,
+                        .next = false,
+                        .size = 0,
+                        .data = {}};
+  buffer.write(wakeup);
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,122 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/buffer/WriterEpoch.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#define PROFILOEXPORT __attribute__((visibility("default")))
+
+namespace facebook {
+namespace profilo {
+
+//
+// A packet ring buffer that can be replaced by one of a different size
+// while tracing is active.
+//
+// Each buffer is a generation with its own range of tickets, so cursors keep
+// increasing across replacements. resize() installs the new generation,
+// waits for writers still on the old one (see WriterEpoch) and then seals
+// the old generation, linking it to the new one. Readers hold generations
+// through shared pointers and follow the links once they have read a
+// sealed generation to its end. A generation's memory is released as soon
+// as no reader holds it anymore.
+//
+class ResizableTraceBuffer {
+ public:
+  class Generation {
+   public:
+    TraceBuffer& buffer() {
+      return *buffer_;
+    }
+
+    //
+    // A sealed generation receives no more writes; end() and next() are
+    // only meaningful once it is sealed.
+    //
+    bool isSealed() const {
+      return sealed_.load(std::memory_order_acquire);
+    }
+
+    // Cursor one past the last write to this generation.
+    TraceBuffer::Cursor end() const {
+      return end_;
+    }
+
+    // The generation that replaced this one.
+    const std::shared_ptr<Generation>& next() const {
+      return next_;
+    }
+
+   private:
+    explicit Generation(TraceBufferHolder buffer)
+        : buffer_(std::move(buffer)), end_(0), next_(), sealed_(false) {}
+
+    TraceBufferHolder buffer_;
+    TraceBuffer::Cursor end_;
+    std::shared_ptr<Generation> next_;
+    std::atomic<bool> sealed_;
+
+    friend class ResizableTraceBuffer;
+  };
+
+  PROFILOEXPORT explicit ResizableTraceBuffer(size_t slots);
+  ResizableTraceBuffer(const ResizableTraceBuffer&) = delete;
+  ResizableTraceBuffer& operator=(const ResizableTraceBuffer&) = delete;
+
+  //
+  // The buffer writers should use. Only valid inside a Section of epoch(),
+  // which must be entered before the call and left after the write.
+  //
+  TraceBuffer& current() {
+    return current_raw_.load(std::memory_order_acquire)->buffer();
+  }
+
+  WriterEpoch& epoch() {
+    return epoch_;
+  }
+
+  //
+  // The current generation, for readers. It stays valid for as long as the
+  // returned pointer is held.
+  //
+  PROFILOEXPORT std::shared_ptr<Generation> acquire();
+
+  //
+  // Replaces the current buffer with one of <slots> slots. Writes already
+  // in the old buffer stay readable through the chain of generations.
+  // Blocks until writers in progress are done with the old buffer.
+  //
+  PROFILOEXPORT void resize(size_t slots);
+
+ private:
+  // Generations use disjoint ticket ranges of 2^48 writes each.
+  static constexpr uint64_t kGenerationShift = 48;
+
+  WriterEpoch epoch_;
+  std::mutex mutex_;
+  uint64_t generation_count_;
+  std::shared_ptr<Generation> current_;
+  std::atomic<Generation*> current_raw_;
+};
+
+} // namespace profilo
+} // namespace facebook
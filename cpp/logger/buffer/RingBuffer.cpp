@@ -16,10 +16,17 @@
 
 #include "RingBuffer.h"
 #include "../lfrb/LockFreeRingBuffer.h"
+#include "CheckpointIndex.h"
+#include "ResizableTraceBuffer.h"
+#include "ShardedTraceBuffer.h"
 
 #include <fb/log.h>
 
+#include <sys/mman.h>
+#include <unistd.h>
 #include <atomic>
+#include <cerrno>
+#include <cstring>
 #include <memory>
 
 namespace facebook {
@@ -29,29 +36,166 @@ namespace {
 
 TraceBufferHolder noop_buffer = TraceBuffer::allocate(1);
 std::atomic<TraceBufferHolder*> buffer(&noop_buffer);
+std::atomic<RecordBufferHolder*> record_buffer(nullptr);
+std::atomic<ShardedTraceBuffer*> sharded_buffer(nullptr);
+std::atomic<ResizableTraceBuffer*> resizable_buffer(nullptr);
+
+// Memory mapped by init() for a buffer allocated with flags, if any.
+void* buffer_mapping = nullptr;
+size_t buffer_mapping_size = 0;
+
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+bool isInitialized() {
+  return buffer.load() != &noop_buffer || record_buffer.load() != nullptr ||
+      sharded_buffer.load() != nullptr || resizable_buffer.load() != nullptr;
+}
+
+size_t alignUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+//
+// Populates the page tables for [addr, addr + size) with writable pages.
+// Touching one byte per page works everywhere, MADV_POPULATE_WRITE just
+// does it in one call.
+//
+void prefault(void* addr, size_t size) {
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(addr, size, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+#endif
+  auto page_size = sysconf(_SC_PAGESIZE);
+  auto bytes = static_cast<volatile char*>(addr);
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    bytes[offset] = bytes[offset];
+  }
+}
+
+void lock(void* addr, size_t size) {
+  if (mlock(addr, size) != 0) {
+    FBLOGW("Cannot lock the TraceBuffer: %s", strerror(errno));
+  }
+}
+
+//
+// Maps anonymous memory for a buffer of `size` bytes according to `flags`.
+// Updates `size` to the mapped size and returns nullptr on failure.
+//
+void* mapBuffer(size_t& size, int flags) {
+  constexpr auto kProt = PROT_READ | PROT_WRITE;
+  constexpr auto kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+  bool populate = flags & (RingBuffer::PREFAULT | RingBuffer::LOCKED);
+
+  if (flags & RingBuffer::HUGE_PAGES) {
+    auto huge_size = alignUp(size, kHugePageSize);
+#ifdef MAP_HUGETLB
+    auto hugetlb = mmap(
+        nullptr,
+        huge_size,
+        kProt,
+        kFlags | MAP_HUGETLB | (populate ? MAP_POPULATE : 0),
+        -1,
+        0);
+    if (hugetlb != MAP_FAILED) {
+      size = huge_size;
+      return hugetlb;
+    }
+#endif
+
+    //
+    // No huge pages reserved, fall back to transparent huge pages. Those
+    // are only used for aligned 2MB ranges, so over-map and trim.
+    //
+    auto map_size = huge_size + kHugePageSize;
+    auto map = mmap(nullptr, map_size, kProt, kFlags, -1, 0);
+    if (map == MAP_FAILED) {
+      return nullptr;
+    }
+    auto start = alignUp(reinterpret_cast<uintptr_t>(map), kHugePageSize);
+    auto head = start - reinterpret_cast<uintptr_t>(map);
+    if (head > 0) {
+      munmap(map, head);
+    }
+    munmap(
+        reinterpret_cast<char*>(start) + huge_size,
+        map_size - head - huge_size);
+
+    auto addr = reinterpret_cast<void*>(start);
+#ifdef MADV_HUGEPAGE
+    madvise(addr, huge_size, MADV_HUGEPAGE);
+#endif
+    if (populate) {
+      prefault(addr, huge_size);
+    }
+    size = huge_size;
+    return addr;
+  }
+
+  size = alignUp(size, sysconf(_SC_PAGESIZE));
+  auto addr =
+      mmap(nullptr, size, kProt, kFlags | (populate ? MAP_POPULATE : 0), -1, 0);
+  return addr != MAP_FAILED ? addr : nullptr;
+}
 
 } // namespace
 
-TraceBuffer& RingBuffer::init(size_t sz) {
-  if (buffer.load() != &noop_buffer) {
+TraceBuffer& RingBuffer::init(size_t sz, int flags) {
+  if (isInitialized()) {
     // Already initialized
     return get();
   }
 
-  return init(new TraceBufferHolder(TraceBuffer::allocate(sz)));
+  if (flags == 0) {
+    return init(new TraceBufferHolder(TraceBuffer::allocate(sz)));
+  }
+
+  auto size = TraceBuffer::allocationSize(sz);
+  auto addr = mapBuffer(size, flags);
+  if (addr == nullptr) {
+    FBLOGW("Cannot map the TraceBuffer, allocating it on the heap");
+    return init(new TraceBufferHolder(TraceBuffer::allocate(sz)));
+  }
+  if (flags & LOCKED) {
+    lock(addr, size);
+  }
+
+  auto& result = init(new TraceBufferHolder(TraceBuffer::allocateAt(sz, addr)));
+  if (&result != addr) {
+    // Lost the race to another init() call.
+    munmap(addr, size);
+    return result;
+  }
+  buffer_mapping = addr;
+  buffer_mapping_size = size;
+  return result;
 }
 
-TraceBuffer& RingBuffer::init(void* ptr, size_t sz) {
-  if (buffer.load() != &noop_buffer) {
+TraceBuffer& RingBuffer::init(void* ptr, size_t sz, int flags) {
+  if (isInitialized()) {
     // Already initialized
     return get();
   }
 
+  // madvise() only takes page-aligned ranges.
+  auto page_size = sysconf(_SC_PAGESIZE);
+  auto start = reinterpret_cast<uintptr_t>(ptr) / page_size * page_size;
+  auto end = reinterpret_cast<uintptr_t>(ptr) + TraceBuffer::allocationSize(sz);
+  auto addr = reinterpret_cast<void*>(start);
+  auto size = alignUp(end - start, page_size);
+  if (flags & (PREFAULT | LOCKED)) {
+    prefault(addr, size);
+  }
+  if (flags & LOCKED) {
+    lock(addr, size);
+  }
+
   return init(new TraceBufferHolder(TraceBuffer::allocateAt(sz, ptr)));
 }
 
 TraceBuffer& RingBuffer::init(TraceBufferHolder* new_buffer) {
-  if (buffer.load() != &noop_buffer) {
+  if (isInitialized()) {
     // Already initialized
     return get();
   }
@@ -61,19 +205,116 @@ TraceBuffer& RingBuffer::init(TraceBufferHolder* new_buffer) {
   if (!buffer.compare_exchange_strong(expected, new_buffer)) {
     delete new_buffer;
     FBLOGE("Second attempt to init the TraceBuffer");
+  } else {
+    // Writes that come first just don't leave checkpoints.
+    CheckpointIndex::get().reset(&**new_buffer);
   }
 
   return get();
 }
 
+RecordBuffer* RingBuffer::initRecordBuffer(size_t bytes) {
+  if (isInitialized()) {
+    // Already initialized
+    return getRecordBuffer();
+  }
+
+  return initRecordBuffer(
+      new RecordBufferHolder(RecordBuffer::allocate(bytes)));
+}
+
+RecordBuffer* RingBuffer::initRecordBuffer(void* ptr, size_t bytes) {
+  if (isInitialized()) {
+    // Already initialized
+    return getRecordBuffer();
+  }
+
+  return initRecordBuffer(
+      new RecordBufferHolder(RecordBuffer::allocateAt(bytes, ptr)));
+}
+
+RecordBuffer* RingBuffer::initRecordBuffer(RecordBufferHolder* new_buffer) {
+  RecordBufferHolder* expected = nullptr;
+  if (buffer.load() != &noop_buffer || sharded_buffer.load() != nullptr ||
+      resizable_buffer.load() != nullptr ||
+      !record_buffer.compare_exchange_strong(expected, new_buffer)) {
+    delete new_buffer;
+    FBLOGE("Second attempt to init the RecordBuffer");
+  } else {
+    CheckpointIndex::get().reset(new_buffer->get());
+  }
+
+  return getRecordBuffer();
+}
+
+ShardedTraceBuffer* RingBuffer::initSharded(
+    size_t shard_count,
+    size_t slots_per_shard) {
+  if (isInitialized()) {
+    // Already initialized
+    return getShardedBuffer();
+  }
+
+  auto new_buffer = new ShardedTraceBuffer(shard_count, slots_per_shard);
+  ShardedTraceBuffer* expected = nullptr;
+  if (buffer.load() != &noop_buffer || record_buffer.load() != nullptr ||
+      resizable_buffer.load() != nullptr ||
+      !sharded_buffer.compare_exchange_strong(expected, new_buffer)) {
+    delete new_buffer;
+    FBLOGE("Second attempt to init the ShardedTraceBuffer");
+  }
+
+  return getShardedBuffer();
+}
+
+ResizableTraceBuffer* RingBuffer::initResizable(size_t sz) {
+  if (isInitialized()) {
+    // Already initialized
+    return getResizableBuffer();
+  }
+
+  auto new_buffer = new ResizableTraceBuffer(sz);
+  ResizableTraceBuffer* expected = nullptr;
+  if (buffer.load() != &noop_buffer || record_buffer.load() != nullptr ||
+      sharded_buffer.load() != nullptr ||
+      !resizable_buffer.compare_exchange_strong(expected, new_buffer)) {
+    delete new_buffer;
+    FBLOGE("Second attempt to init the ResizableTraceBuffer");
+  }
+
+  return getResizableBuffer();
+}
+
 void RingBuffer::destroy() {
+  auto records = record_buffer.exchange(nullptr);
+  if (records != nullptr) {
+    CheckpointIndex::get().reset(nullptr);
+    delete records;
+  }
+
+  auto sharded = sharded_buffer.exchange(nullptr);
+  if (sharded != nullptr) {
+    delete sharded;
+  }
+
+  auto resizable = resizable_buffer.exchange(nullptr);
+  if (resizable != nullptr) {
+    delete resizable;
+  }
+
   if (buffer.load() == &noop_buffer) {
     return;
   }
 
   auto expected = buffer.load();
   if (buffer.compare_exchange_strong(expected, &noop_buffer)) {
+    CheckpointIndex::get().reset(nullptr);
     delete expected;
+    if (buffer_mapping != nullptr) {
+      munmap(buffer_mapping, buffer_mapping_size);
+      buffer_mapping = nullptr;
+      buffer_mapping_size = 0;
+    }
   }
 }
 
@@ -81,5 +322,18 @@ TraceBuffer& RingBuffer::get() {
   return **(buffer.load());
 }
 
+ShardedTraceBuffer* RingBuffer::getShardedBuffer() {
+  return sharded_buffer.load();
+}
+
+ResizableTraceBuffer* RingBuffer::getResizableBuffer() {
+  return resizable_buffer.load();
+}
+
+RecordBuffer* RingBuffer::getRecordBuffer() {
+  auto records = record_buffer.load();
+  return records != nullptr ? records->get() : nullptr;
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <profilo/logger/buffer/Packet.h>
+#include <profilo/logger/lfrb/LockFreeRecordBuffer.h>
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 
 #define PROFILOEXPORT __attribute__((visibility("default")))
@@ -24,42 +25,126 @@
 namespace facebook {
 namespace profilo {
 
+class ResizableTraceBuffer;
+class ShardedTraceBuffer;
+
 using TraceBuffer = logger::lfrb::LockFreeRingBuffer<logger::Packet>;
 using TraceBufferSlot = logger::lfrb::detail::RingBufferSlot<logger::Packet>;
 using TraceBufferHolder =
     logger::lfrb::LockFreeRingBufferHolder<logger::Packet>;
 
+using RecordBuffer = logger::lfrb::LockFreeRecordBuffer<>;
+using RecordBufferHolder = logger::lfrb::LockFreeRecordBufferHolder<>;
+
 class RingBuffer {
   static const size_t DEFAULT_SLOT_COUNT = 1000;
 
   PROFILOEXPORT static TraceBuffer& init(TraceBufferHolder* new_buffer);
+  PROFILOEXPORT static RecordBuffer* initRecordBuffer(
+      RecordBufferHolder* new_buffer);
 
  public:
-  constexpr static auto kVersion = 1;
+  constexpr static auto kVersion = 3;
+
+  //
+  // Allocation flags for init(). Writers fault in buffer pages on the first
+  // pass and, once the pages are reclaimed, again later; these move that
+  // cost to init() instead. All of them are best-effort: when the kernel
+  // refuses one, the buffer is still set up without it.
+  //
+  enum AllocationFlags {
+    // Populate the buffer pages at init() time.
+    PREFAULT = 1 << 0,
+    // Back the buffer with huge pages: MAP_HUGETLB when the system has some
+    // reserved, transparent huge pages otherwise. Only applies to buffers
+    // allocated by init().
+    HUGE_PAGES = 1 << 1,
+    // Keep the buffer resident with mlock(). Implies PREFAULT.
+    LOCKED = 1 << 2,
+  };
 
   //
   // sz - number of buffer slots
+  // flags - a combination of AllocationFlags. Without flags the buffer is
+  //         allocated on the heap, otherwise it is mapped separately.
   //
-  PROFILOEXPORT static TraceBuffer& init(size_t sz = DEFAULT_SLOT_COUNT);
+  PROFILOEXPORT static TraceBuffer& init(
+      size_t sz = DEFAULT_SLOT_COUNT,
+      int flags = 0);
   //
   // Constructs the buffer at the specified address
   // (for example in a memory mapped file)
   // sz - number of buffer slots
   // ptr - pointer to where allocate the buffer
+  // flags - a combination of AllocationFlags, applied to the pages that
+  //         hold the buffer. The caller keeps owning the memory.
   //
   PROFILOEXPORT static TraceBuffer& init(
       void* ptr,
+      size_t sz = DEFAULT_SLOT_COUNT,
+      int flags = 0);
+
+  //
+  // Selects the variable-length record format instead of fixed-size
+  // packets. Only one of init() and initRecordBuffer() takes effect per
+  // process; once records are selected, get() stays the no-op buffer and
+  // writers should use getRecordBuffer(). Returns nullptr if the packet
+  // buffer has already been initialized.
+  // bytes - capacity of the buffer in bytes
+  //
+  PROFILOEXPORT static RecordBuffer* initRecordBuffer(
+      size_t bytes = DEFAULT_SLOT_COUNT * sizeof(TraceBufferSlot));
+  //
+  // Constructs the record buffer at the specified address.
+  // ptr must point to at least RecordBuffer::allocationSize(bytes) bytes.
+  //
+  PROFILOEXPORT static RecordBuffer* initRecordBuffer(
+      void* ptr,
+      size_t bytes = DEFAULT_SLOT_COUNT * sizeof(TraceBufferSlot));
+
+  //
+  // Selects the sharded packet format: shard_count independent buffers of
+  // slots_per_shard slots each. Same exclusivity rules as
+  // initRecordBuffer(); once selected, writers should use
+  // getShardedBuffer(). Returns nullptr if another format is already in use.
+  //
+  PROFILOEXPORT static ShardedTraceBuffer* initSharded(
+      size_t shard_count,
+      size_t slots_per_shard = DEFAULT_SLOT_COUNT);
+
+  //
+  // Selects a packet buffer that can be resized while tracing, see
+  // ResizableTraceBuffer. Same exclusivity rules as initRecordBuffer();
+  // once selected, writers should use getResizableBuffer(). Returns nullptr
+  // if another format is already in use.
+  //
+  PROFILOEXPORT static ResizableTraceBuffer* initResizable(
       size_t sz = DEFAULT_SLOT_COUNT);
 
   //
   // Cleans-up current buffer and reverts back to no-op mode.
-  // DO NOTE USE: This operation is unsafe and currently serve merely as stub
-  // for future dynamic buffer management extensions. All tracing should be
-  // disabled before this method can be called.
+  // DO NOTE USE: This operation is unsafe. All tracing should be disabled
+  // before this method can be called. To change the buffer size while
+  // tracing, use initResizable() and ResizableTraceBuffer::resize().
   //
   PROFILOEXPORT static void destroy();
 
   PROFILOEXPORT static TraceBuffer& get();
+
+  //
+  // Returns the record buffer, or nullptr if the packet format is in use.
+  //
+  PROFILOEXPORT static RecordBuffer* getRecordBuffer();
+
+  //
+  // Returns the sharded buffer, or nullptr if it is not in use.
+  //
+  PROFILOEXPORT static ShardedTraceBuffer* getShardedBuffer();
+
+  //
+  // Returns the resizable buffer, or nullptr if it is not in use.
+  //
+  PROFILOEXPORT static ResizableTraceBuffer* getResizableBuffer();
 };
 
 } // namespace profilo
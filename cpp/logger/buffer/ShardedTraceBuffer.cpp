@@ -0,0 +1,71 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShardedTraceBuffer.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace facebook {
+namespace profilo {
+
+namespace {
+
+std::atomic<uint32_t> next_thread_index(0);
+
+uint32_t currentThreadIndex() {
+  static thread_local uint32_t index =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+} // namespace
+
+ShardedTraceBuffer::ShardedTraceBuffer(
+    size_t shard_count,
+    size_t slots_per_shard)
+    : shards_(), watermarks_(), writes_(0), waiters_(0) {
+  if (shard_count == 0) {
+    throw std::invalid_argument("shard_count is 0");
+  }
+
+  shards_.reserve(shard_count);
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards_.emplace_back(TraceBuffer::allocate(slots_per_shard));
+  }
+  watermarks_.reset(new PaddedWatermark[shard_count * kWatermarkLanes]);
+}
+
+constexpr size_t ShardedTraceBuffer::kWatermarkLanes;
+
+constexpr int64_t ShardWatermark::kIdle;
+constexpr int ShardWatermark::kCountShift;
+constexpr uint64_t ShardWatermark::kOneWrite;
+constexpr uint64_t ShardWatermark::kTimestampMask;
+
+TraceBuffer& ShardedTraceBuffer::shardForCurrentThread() {
+  return *shards_[currentThreadIndex() % shards_.size()];
+}
+
+ShardWatermark& ShardedTraceBuffer::watermarkForCurrentThread() {
+  auto index = currentThreadIndex();
+  auto shard = index % shards_.size();
+  auto lane = (index / shards_.size()) % kWatermarkLanes;
+  return watermark(shard, lane);
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,205 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/lfrb/Futex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define PROFILOEXPORT __attribute__((visibility("default")))
+
+namespace facebook {
+namespace profilo {
+
+//
+// Lowest timestamp among the writes in progress on one lane of a shard.
+// Entries of different threads can land in a shard out of timestamp order,
+// so readers merging the shards hold back everything past the lowest
+// watermark.
+//
+// The number of writes in progress and their lowest timestamp, in
+// microseconds, share one word so that begin() and end() stay consistent
+// without a lock. The timestamp only goes back up once no write is in
+// progress, which is why every thread of a shard gets its own lane, as far
+// as there are enough of them.
+//
+class ShardWatermark {
+ public:
+  // Returned by get() when no write is in progress.
+  static constexpr int64_t kIdle = INT64_MAX;
+
+  ShardWatermark() : state_(0) {}
+  ShardWatermark(const ShardWatermark&) = delete;
+  ShardWatermark& operator=(const ShardWatermark&) = delete;
+
+  //
+  // To be called before a write of an entry with the given timestamp
+  // claims its slots.
+  //
+  void begin(int64_t timestamp) {
+    uint64_t micros = timestamp > 0
+        ? std::min<uint64_t>(timestamp / 1000, kTimestampMask)
+        : 0;
+    auto state = state_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+      uint64_t lowest = (state >> kCountShift) == 0
+          ? micros
+          : std::min(state & kTimestampMask, micros);
+      next = (state + kOneWrite) & ~kTimestampMask;
+      next |= lowest;
+    } while (!state_.compare_exchange_weak(
+        state, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+  }
+
+  //
+  // To be called once the write begun by begin() is committed.
+  //
+  void end() {
+    state_.fetch_sub(kOneWrite, std::memory_order_release);
+  }
+
+  //
+  // Returns the lowest timestamp in progress, rounded down to the
+  // microsecond, or kIdle.
+  //
+  int64_t get() const {
+    auto state = state_.load(std::memory_order_acquire);
+    if ((state >> kCountShift) == 0) {
+      return kIdle;
+    }
+    return static_cast<int64_t>(state & kTimestampMask) * 1000;
+  }
+
+ private:
+  static constexpr int kCountShift = 48;
+  static constexpr uint64_t kOneWrite = uint64_t(1) << kCountShift;
+  static constexpr uint64_t kTimestampMask = kOneWrite - 1;
+
+  std::atomic<uint64_t> state_;
+};
+
+//
+// A set of independent packet ring buffers, each with its own ticket
+// counter. Threads are assigned to shards round-robin on their first write
+// and keep their shard for their lifetime, so all entries of a thread stay
+// in order within a single shard. Readers merge the shards by timestamp,
+// up to the shards' watermarks (see TraceWriter).
+//
+// Each shard has kWatermarkLanes watermarks and threads get one round-robin
+// as well. A thread that writes all the time then only holds back its own
+// lane, instead of keeping the lowest timestamp of every other write to the
+// shard around. Only threads beyond kWatermarkLanes per shard share a lane.
+//
+class ShardedTraceBuffer {
+ public:
+  static constexpr size_t kWatermarkLanes = 32;
+
+  PROFILOEXPORT ShardedTraceBuffer(size_t shard_count, size_t slots_per_shard);
+  ShardedTraceBuffer(const ShardedTraceBuffer&) = delete;
+  ShardedTraceBuffer& operator=(const ShardedTraceBuffer&) = delete;
+
+  size_t shardCount() const {
+    return shards_.size();
+  }
+
+  TraceBuffer& shard(size_t index) {
+    return *shards_[index];
+  }
+
+  ShardWatermark& watermark(size_t shard, size_t lane) {
+    return watermarks_[shard * kWatermarkLanes + lane].watermark;
+  }
+
+  //
+  // Returns the lowest timestamp in progress on any lane of the shard, or
+  // ShardWatermark::kIdle.
+  //
+  int64_t lowestWatermark(size_t shard) const {
+    int64_t lowest = ShardWatermark::kIdle;
+    for (size_t lane = 0; lane < kWatermarkLanes; ++lane) {
+      lowest = std::min(
+          lowest, watermarks_[shard * kWatermarkLanes + lane].watermark.get());
+    }
+    return lowest;
+  }
+
+  //
+  // Returns the shard the calling thread writes to.
+  //
+  PROFILOEXPORT TraceBuffer& shardForCurrentThread();
+
+  //
+  // Returns the calling thread's lane of the shardForCurrentThread()
+  // watermarks.
+  //
+  PROFILOEXPORT ShardWatermark& watermarkForCurrentThread();
+
+  //
+  // To be called once a write to any of the shards is committed and its
+  // watermark ended. Wakes up the readers blocked in waitForWrite(). Only
+  // reads a shared word unless a reader is waiting.
+  //
+  void notifyWrite() {
+    // Either this sees the waiter, or the waiter's recheck sees the write.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) != 0) {
+      writes_.fetch_add(1, std::memory_order_relaxed);
+      writes_.futexWake();
+    }
+  }
+
+  //
+  // Blocks until the next notifyWrite() or the deadline. `recheck` is
+  // called once the reader is registered and returns true if what the
+  // reader waits for has happened in the meantime, in which case it
+  // doesn't block.
+  //
+  template <class Recheck, class Clock, class Duration>
+  void waitForWrite(
+      Recheck recheck,
+      const std::chrono::time_point<Clock, Duration>& deadline) {
+    waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto writes = writes_.load(std::memory_order_relaxed);
+    if (!recheck()) {
+      writes_.futexWaitUntil(writes, deadline);
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+ private:
+  // Keeps the lanes written by different threads on separate cache lines.
+  struct PaddedWatermark {
+    ShardWatermark watermark;
+    char padding[64 - sizeof(ShardWatermark)];
+  };
+
+  std::vector<TraceBufferHolder> shards_;
+  std::unique_ptr<PaddedWatermark[]> watermarks_;
+  logger::lfrb::Futex<> writes_;
+  std::atomic<uint32_t> waiters_;
+};
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WriterEpoch.h"
+
+#include <thread>
+
+namespace facebook {
+namespace profilo {
+
+namespace {
+
+std::atomic<uint32_t> next_thread_index(0);
+
+uint32_t currentThreadIndex() {
+  static thread_local uint32_t index =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+} // namespace
+
+WriterEpoch::Section::Section(WriterEpoch& epoch) : counter_(epoch.enter()) {}
+
+WriterEpoch::Section::~Section() {
+  counter_.fetch_sub(1);
+}
+
+WriterEpoch::WriterEpoch() : epoch_(0), stripes_(), synchronize_mutex_() {
+  for (auto& stripe : stripes_) {
+    stripe.active[0].store(0);
+    stripe.active[1].store(0);
+  }
+}
+
+std::atomic<int32_t>& WriterEpoch::enter() {
+  auto& stripe = stripes_[currentThreadIndex() % kStripes];
+  while (true) {
+    auto epoch = epoch_.load();
+    auto& counter = stripe.active[epoch & 1];
+    counter.fetch_add(1);
+    //
+    // If the epoch moved on in the meantime, synchronize() may have already
+    // checked this counter. Register again under the new epoch.
+    //
+    if (epoch_.load() == epoch) {
+      return counter;
+    }
+    counter.fetch_sub(1);
+  }
+}
+
+void WriterEpoch::synchronize() {
+  std::lock_guard<std::mutex> lock(synchronize_mutex_);
+  auto previous = epoch_.fetch_add(1);
+  for (auto& stripe : stripes_) {
+    while (stripe.active[previous & 1].load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#define PROFILOEXPORT __attribute__((visibility("default")))
+
+namespace facebook {
+namespace profilo {
+
+//
+// Lets the owner of a buffer wait for writers that may still be using a
+// buffer it has replaced. Writers wrap each write in a Section, and
+// synchronize() returns once every Section that started before the call
+// has ended.
+//
+// Sections are counted per epoch parity, in stripes that live on separate
+// cache lines so that writers on different threads rarely share one.
+//
+class WriterEpoch {
+ public:
+  class Section {
+   public:
+    PROFILOEXPORT explicit Section(WriterEpoch& epoch);
+    PROFILOEXPORT ~Section();
+    Section(const Section&) = delete;
+    Section& operator=(const Section&) = delete;
+
+   private:
+    std::atomic<int32_t>& counter_;
+  };
+
+  PROFILOEXPORT WriterEpoch();
+  WriterEpoch(const WriterEpoch&) = delete;
+  WriterEpoch& operator=(const WriterEpoch&) = delete;
+
+  //
+  // Blocks until all Sections that started before the call have ended.
+  // Sections started after the call don't delay it.
+  //
+  PROFILOEXPORT void synchronize();
+
+ private:
+  static constexpr size_t kStripes = 8;
+  static constexpr size_t kCacheLineSize = 64;
+
+  struct Stripe {
+    std::atomic<int32_t> active[2];
+    char padding[kCacheLineSize - 2 * sizeof(std::atomic<int32_t>)];
+  };
+
+  std::atomic<uint32_t> epoch_;
+  Stripe stripes_[kStripes];
+  std::mutex synchronize_mutex_;
+
+  std::atomic<int32_t>& enter();
+};
+
+} // namespace profilo
+} // namespace facebook
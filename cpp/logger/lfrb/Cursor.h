@@ -0,0 +1,85 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+namespace lfrb {
+
+template <typename T, template <typename> class Atom>
+class LockFreeRingBuffer;
+
+template <template <typename> class Atom>
+class LockFreeRecordBuffer;
+
+/// Opaque pointer to a past or future write.
+/// Can be moved relative to its current location but not in absolute terms.
+///
+/// LockFreeRingBuffer cursors count writes, LockFreeRecordBuffer cursors
+/// count bytes. Sharing the type lets the same cursor travel from the
+/// Logger to the TraceWriter regardless of the buffer format.
+struct Cursor {
+  explicit Cursor(uint64_t initialTicket) noexcept : ticket(initialTicket) {}
+
+  /// Returns true if this cursor now points to a different
+  /// write, false otherwise.
+  bool moveForward(uint64_t steps = 1) noexcept {
+    uint64_t prevTicket = ticket;
+    ticket += steps;
+    return prevTicket != ticket;
+  }
+
+  /// Returns true if this cursor now points to a previous
+  /// write, false otherwise.
+  bool moveBackward(uint64_t steps = 1) noexcept {
+    uint64_t prevTicket = ticket;
+    if (steps > ticket) {
+      ticket = 0;
+    } else {
+      ticket -= steps;
+    }
+    return prevTicket != ticket;
+  }
+
+  /// Returns how many steps forward other is from this cursor, or 0 if
+  /// other does not point past this cursor.
+  uint64_t stepsTo(const Cursor& other) const noexcept {
+    return other.ticket > ticket ? other.ticket - ticket : 0;
+  }
+
+  bool operator<(const Cursor& other) const noexcept {
+    return ticket < other.ticket;
+  }
+
+ protected: // for test visibility reasons
+  uint64_t ticket;
+
+  template <typename T, template <typename> class Atom>
+  friend class LockFreeRingBuffer;
+
+  template <template <typename> class Atom>
+  friend class LockFreeRecordBuffer;
+};
+
+} // namespace lfrb
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
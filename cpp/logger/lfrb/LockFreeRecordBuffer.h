@@ -0,0 +1,418 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include <profilo/logger/lfrb/Cursor.h>
+#include <profilo/logger/lfrb/Futex.h>
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+namespace lfrb {
+
+template <template <typename> class Atom = std::atomic>
+struct LockFreeRecordBufferHolder;
+
+/// LockFreeRecordBuffer is a fixed-size, concurrent, byte-addressed ring
+/// buffer of variable-length records. It is the variable-length counterpart
+/// of LockFreeRingBuffer<Packet>: instead of splitting payloads into fixed
+/// slots, every write reserves exactly the bytes it needs (rounded up to
+/// kAlignment) with a single atomic increment of the byte head.
+///
+/// Each record is laid out as a RecordHeader followed by its payload. The
+/// header stores the absolute stream position of the record, which is
+/// published last with release semantics, and a checksum over the payload.
+///
+///  1. Writers never block. A writer that gets lapped by other writers while
+///     it is still copying its payload may corrupt newer records; readers
+///     detect this through the checksum and treat the record as missed.
+///  2. Writers cannot block on readers
+///  3. Readers can wait for writes that haven't occurred yet
+///  4. Readers can detect if they are lagging behind
+///
+/// As with LockFreeRingBuffer, reads are best-effort. Cursors point to byte
+/// positions in the unbounded stream of writes and are advanced past a
+/// record with moveForward(recordSpan(size)).
+///
+template <template <typename> class Atom = std::atomic>
+class LockFreeRecordBuffer {
+ public:
+  using Cursor = lfrb::Cursor;
+
+  struct RecordHeader {
+    uint64_t position;
+    uint32_t size;
+    uint32_t checksum;
+  };
+
+  static constexpr uint32_t kAlignment = sizeof(RecordHeader);
+
+  // Largest payload accepted by tryWrite().
+  static constexpr uint32_t kMaxRecordSize = 16 * 1024;
+
+  LockFreeRecordBuffer() = delete;
+  LockFreeRecordBuffer(LockFreeRecordBuffer const&) = delete;
+  LockFreeRecordBuffer& operator=(LockFreeRecordBuffer const&) = delete;
+
+  /// Capacity in bytes.
+  uint64_t capacity() {
+    return capacity_;
+  }
+
+  /// Number of stream bytes occupied by a record with a <size> byte payload.
+  static uint64_t recordSpan(uint32_t size) noexcept {
+    return sizeof(RecordHeader) + alignUp(size);
+  }
+
+  /// Perform a single write of <size> bytes from <payload>.
+  /// Payloads larger than kMaxRecordSize or than half the capacity are not
+  /// written, in which case this returns false. On success <cursor> points
+  /// to the just-written record.
+  bool tryWrite(const void* payload, uint32_t size, Cursor& cursor) noexcept {
+    uint64_t span = recordSpan(size);
+    if (size > kMaxRecordSize || span > capacity_ / 2) {
+      return false;
+    }
+
+    uint64_t position = head_.fetch_add(span);
+    copyIn(position + sizeof(RecordHeader), payload, size);
+
+    RecordHeader* header = headerAt(position);
+    header->size = size;
+    header->checksum = checksum(position, payload, size);
+    // Publishing the position marks the record as complete.
+    __atomic_store_n(&header->position, position, __ATOMIC_RELEASE);
+
+    // Pairs with waitAndTryRead(): either the reader sees this commit or
+    // this sees the reader. Both sides must be seq_cst, release/acquire
+    // lets the load of waiters_ pass the commit.
+    commits_.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+      commits_.futexWake();
+    }
+    cursor = Cursor(position);
+    return true;
+  }
+
+  /// Read the record at the cursor into <dest>, which must be able to hold
+  /// <dest_size> bytes. On success, <size> holds the payload size.
+  /// Returns true if the read succeeded, false otherwise. If the return
+  /// value is false, dest is to be considered partially read and in an
+  /// inconsistent state. Readers are advised to discard it.
+  bool tryRead(
+      void* dest,
+      uint32_t dest_size,
+      const Cursor& cursor,
+      uint32_t& size) noexcept {
+    return readRecord(dest, dest_size, cursor.ticket, size) ==
+        ReadResult::SUCCESS;
+  }
+
+  /// Read the record at the cursor or block if the write has not completed
+  /// yet. Same return value semantics as tryRead().
+  bool waitAndTryRead(
+      void* dest,
+      uint32_t dest_size,
+      const Cursor& cursor,
+      uint32_t& size) noexcept {
+    while (true) {
+      uint32_t commits = commits_.load(std::memory_order_acquire);
+      auto result = readRecord(dest, dest_size, cursor.ticket, size);
+      if (result != ReadResult::NOT_READY) {
+        return result == ReadResult::SUCCESS;
+      }
+
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      // Re-check after registering so that we can't miss the wakeup.
+      if (commits_.load(std::memory_order_seq_cst) == commits) {
+        commits_.futexWait(commits);
+      }
+      waiters_.fetch_sub(1);
+    }
+  }
+
+  /// Returns a Cursor pointing to the first write that has not occurred yet.
+  Cursor currentHead() noexcept {
+    return Cursor(head_.load());
+  }
+
+  /// Returns a Cursor pointing to the oldest record that is still readable,
+  /// or to the head if there is none.
+  Cursor currentTail() noexcept {
+    uint64_t head = head_.load();
+    uint64_t position = head > capacity_ ? head - capacity_ : 0;
+    // Records are aligned, so any record boundary is a multiple of
+    // kAlignment. Look for the first committed header past the window start.
+    for (; position < head; position += kAlignment) {
+      RecordHeader* header = headerAt(position);
+      if (__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) == position &&
+          header->size <= kMaxRecordSize) {
+        return Cursor(position);
+      }
+    }
+    return Cursor(head);
+  }
+
+  /// Writing the committed records from tail to head to the specified FD.
+  /// Each record is written with its header, so the dump is a
+  /// self-describing sequence of [RecordHeader][payload, padded] entries.
+  ///
+  /// Warning: FOR BREAKPAD USE ONLY! NOT THREAD-SAFE!
+  /// The only intended use of this method is to save the buffer during
+  /// crash time. Use of any locks is unsafe during crash handling, thus
+  /// this code assumes no race conditions can occur.
+  ///
+  /// Returns true if all writes were successful and false otherwise.
+  bool dumpDataToFile(const int fd) {
+    uint64_t head = head_.load();
+    uint64_t position = currentTail().ticket;
+
+    while (position < head) {
+      RecordHeader* header = headerAt(position);
+      if (__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) != position ||
+          header->size > kMaxRecordSize) {
+        // Uncommitted or torn record, resynchronize on the next boundary.
+        position += kAlignment;
+        continue;
+      }
+      uint64_t span = recordSpan(header->size);
+      uint64_t offset = position % capacity_;
+      uint64_t first = std::min(span, capacity_ - offset);
+      if (!writeFully(fd, data_ + offset, first) ||
+          !writeFully(fd, data_, span - first)) {
+        return false;
+      }
+      position += span;
+    }
+    return true;
+  }
+
+  // Returns the size in bytes required for storage of the buffer's dump
+  // produced by method dumpDataToFile(int)
+  uint64_t getDumpBytesCount() const {
+    return capacity_;
+  }
+
+  // Returns the number of bytes needed to place a buffer of <capacity> bytes
+  // with allocateAt.
+  static size_t allocationSize(uint64_t capacity) {
+    return sizeof(LockFreeRecordBuffer<Atom>) + alignUp(capacity);
+  }
+
+  static LockFreeRecordBufferHolder<Atom> allocateAt(
+      uint64_t capacity,
+      void* ptr) {
+    return allocateAt(capacity, ptr, true);
+  }
+
+  static LockFreeRecordBufferHolder<Atom> allocate(uint64_t capacity) {
+    char* alloc_area = new char[allocationSize(capacity)];
+    return allocateAt(capacity, reinterpret_cast<void*>(alloc_area), false);
+  }
+
+ private:
+  enum class ReadResult { SUCCESS, NOT_READY, LOST };
+
+  const uint64_t capacity_;
+  Atom<uint64_t> head_;
+  Futex<Atom> commits_;
+  Atom<uint32_t> waiters_;
+  alignas(kAlignment) char data_[];
+
+  explicit LockFreeRecordBuffer(uint64_t capacity) noexcept
+      : capacity_(capacity), head_(0), commits_(0), waiters_(0) {}
+
+  ~LockFreeRecordBuffer() = default;
+
+  static uint64_t alignUp(uint64_t value) noexcept {
+    return (value + kAlignment - 1) & ~(uint64_t)(kAlignment - 1);
+  }
+
+  static LockFreeRecordBufferHolder<Atom>
+  allocateAt(uint64_t capacity, void* ptr, bool is_external) {
+    capacity = alignUp(capacity);
+    auto buffer = new (ptr) LockFreeRecordBuffer<Atom>(capacity);
+    // Position 0 is a valid record position, so the headers must not start
+    // out looking committed.
+    std::memset(buffer->data_, 0xff, capacity);
+    return LockFreeRecordBufferHolder<Atom>(buffer, is_external);
+  }
+
+  static void deallocate(LockFreeRecordBuffer<Atom>* buffer) {
+    buffer->~LockFreeRecordBuffer();
+    delete[] reinterpret_cast<char*>(buffer);
+  }
+
+  RecordHeader* headerAt(uint64_t position) noexcept {
+    // capacity_ and position are both multiples of kAlignment, so a header
+    // never straddles the end of the data area.
+    return reinterpret_cast<RecordHeader*>(data_ + position % capacity_);
+  }
+
+  void copyIn(uint64_t position, const void* src, uint32_t size) noexcept {
+    uint64_t offset = position % capacity_;
+    uint64_t first = std::min<uint64_t>(size, capacity_ - offset);
+    std::memcpy(data_ + offset, src, first);
+    std::memcpy(data_, static_cast<const char*>(src) + first, size - first);
+  }
+
+  void copyOut(void* dest, uint64_t position, uint32_t size) noexcept {
+    uint64_t offset = position % capacity_;
+    uint64_t first = std::min<uint64_t>(size, capacity_ - offset);
+    std::memcpy(dest, data_ + offset, first);
+    std::memcpy(static_cast<char*>(dest) + first, data_, size - first);
+  }
+
+  static uint32_t
+  checksum(uint64_t position, const void* src, uint32_t size) noexcept {
+    constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ULL;
+    uint64_t hash = (position ^ size) * kMultiplier;
+    auto bytes = static_cast<const char*>(src);
+    uint32_t idx = 0;
+    for (; idx + sizeof(uint64_t) <= size; idx += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, bytes + idx, sizeof(word));
+      hash = (hash ^ word) * kMultiplier;
+    }
+    if (idx < size) {
+      uint64_t word = 0;
+      std::memcpy(&word, bytes + idx, size - idx);
+      hash = (hash ^ word) * kMultiplier;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+  }
+
+  static bool writeFully(int fd, const char* src, uint64_t size) {
+    while (size > 0) {
+      auto ret = ::write(fd, src, size);
+      if (ret <= 0) {
+        return false;
+      }
+      src += ret;
+      size -= ret;
+    }
+    return true;
+  }
+
+  ReadResult readRecord(
+      void* dest,
+      uint32_t dest_size,
+      uint64_t position,
+      uint32_t& size) noexcept {
+    if (position % kAlignment != 0) {
+      return ReadResult::LOST;
+    }
+
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (position >= head) {
+      return ReadResult::NOT_READY;
+    }
+    if (head - position > capacity_) {
+      return ReadResult::LOST;
+    }
+
+    RecordHeader* header = headerAt(position);
+    if (__atomic_load_n(&header->position, __ATOMIC_ACQUIRE) != position) {
+      // Reserved but not yet committed.
+      return ReadResult::NOT_READY;
+    }
+
+    uint32_t record_size = header->size;
+    uint32_t record_checksum = header->checksum;
+    if (record_size > dest_size || recordSpan(record_size) > capacity_) {
+      return ReadResult::LOST;
+    }
+    copyOut(dest, position + sizeof(RecordHeader), record_size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // The record is intact if no writer has reserved the bytes it occupies
+    // since, and no lapped writer has scribbled over it.
+    head = head_.load(std::memory_order_acquire);
+    if (head - position > capacity_ ||
+        checksum(position, dest, record_size) != record_checksum) {
+      return ReadResult::LOST;
+    }
+    size = record_size;
+    return ReadResult::SUCCESS;
+  }
+
+  friend LockFreeRecordBufferHolder<Atom>;
+}; // LockFreeRecordBuffer
+
+template <template <typename> class Atom>
+struct LockFreeRecordBufferHolder {
+  using Cursor = lfrb::Cursor;
+
+  LockFreeRecordBufferHolder() = delete;
+  LockFreeRecordBufferHolder(LockFreeRecordBufferHolder const&) = delete;
+  LockFreeRecordBufferHolder& operator=(LockFreeRecordBufferHolder const&) =
+      delete;
+
+  LockFreeRecordBufferHolder& operator=(LockFreeRecordBufferHolder&& other) {
+    isExternal_ = other.isExternal_;
+    buffer_ = other.buffer_;
+    other.isExternal_ = true;
+    return *this;
+  }
+
+  LockFreeRecordBufferHolder(LockFreeRecordBufferHolder&& other)
+      : buffer_(std::move(other.buffer_)),
+        isExternal_(std::move(other.isExternal_)) {
+    other.isExternal_ = true;
+  }
+
+  ~LockFreeRecordBufferHolder() {
+    if (isExternal_) {
+      return;
+    }
+    LockFreeRecordBuffer<Atom>::deallocate(buffer_);
+  }
+
+  LockFreeRecordBuffer<Atom>* operator->() {
+    return buffer_;
+  }
+
+  LockFreeRecordBuffer<Atom>& operator*() {
+    return *buffer_;
+  }
+
+  LockFreeRecordBuffer<Atom>* get() {
+    return buffer_;
+  }
+
+ private:
+  LockFreeRecordBuffer<Atom>* buffer_;
+  bool isExternal_;
+
+  explicit LockFreeRecordBufferHolder(
+      LockFreeRecordBuffer<Atom>* buffer,
+      bool isExternal)
+      : buffer_(buffer), isExternal_(isExternal) {}
+
+  friend LockFreeRecordBuffer<Atom>;
+};
+
+} // namespace lfrb
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
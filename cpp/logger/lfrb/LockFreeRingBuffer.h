@@ -18,11 +18,13 @@
 
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <memory>
 #include <type_traits>
 
+#include <profilo/logger/lfrb/Cursor.h>
 #include <profilo/logger/lfrb/TurnSequencer.h>
 
 namespace facebook {
@@ -59,6 +61,9 @@ ForwardIt _destroy_n(ForwardIt first, Size n) {
 }
 } // namespace
 
+/// Outcome of LockFreeRingBuffer::waitAndTryReadUntil().
+enum class ReadResult { SUCCESS, LOST, TIMEDOUT };
+
 namespace detail {
 template <typename T, template <typename> class Atom = std::atomic>
 class RingBufferSlot;
@@ -71,12 +76,13 @@ struct LockFreeRingBufferHolder;
 /// following semantics:
 ///
 ///  1. Writers cannot block on other writers UNLESS they are <capacity> writes
-///     apart from each other (writing to the same slot after a wrap-around)
+///     apart from each other (writing to the same slot after a wrap-around).
+///     The tryWrite() family drops the write in that case instead.
 ///  2. Writers cannot block on readers
 ///  3. Readers can wait for writes that haven't occurred yet
 ///  4. Readers can detect if they are lagging behind
 ///
-/// In this sense, reads from this buffer are best-effort but writes
+/// In this sense, reads from this buffer are best-effort but blocking writes
 /// are guaranteed.
 ///
 /// Another way to think about this is as an unbounded stream of writes. The
@@ -97,35 +103,7 @@ class LockFreeRingBuffer {
       "Element type must be trivially copyable");
 
  public:
-  /// Opaque pointer to a past or future write.
-  /// Can be moved relative to its current location but not in absolute terms.
-  struct Cursor {
-    explicit Cursor(uint64_t initialTicket) noexcept : ticket(initialTicket) {}
-
-    /// Returns true if this cursor now points to a different
-    /// write, false otherwise.
-    bool moveForward(uint64_t steps = 1) noexcept {
-      uint64_t prevTicket = ticket;
-      ticket += steps;
-      return prevTicket != ticket;
-    }
-
-    /// Returns true if this cursor now points to a previous
-    /// write, false otherwise.
-    bool moveBackward(uint64_t steps = 1) noexcept {
-      uint64_t prevTicket = ticket;
-      if (steps > ticket) {
-        ticket = 0;
-      } else {
-        ticket -= steps;
-      }
-      return prevTicket != ticket;
-    }
-
-   protected: // for test visibility reasons
-    uint64_t ticket;
-    friend class LockFreeRingBuffer;
-  };
+  using Cursor = lfrb::Cursor;
 
   LockFreeRingBuffer() = delete;
   LockFreeRingBuffer(LockFreeRingBuffer const&) = delete;
@@ -153,11 +131,125 @@ class LockFreeRingBuffer {
     return Cursor(ticket);
   }
 
+  /// Perform <count> writes of consecutive objects of type T.
+  /// The tickets for all writes are claimed with a single atomic increment,
+  /// so the values occupy a contiguous range of the stream and writers only
+  /// contend on ticket_ once per batch instead of once per value.
+  /// Writes can block under the same conditions as write().
+  /// Returns a Cursor pointing to the first of the written values.
+  Cursor writeN(T* values, uint32_t count) noexcept {
+    uint64_t ticket = ticket_.fetch_add(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      slots_[idx(ticket + i)].write(turn(ticket + i), values[i]);
+    }
+    return Cursor(ticket);
+  }
+
+  /// Same as writeN() above, but fill(i, value) writes the i-th value
+  /// directly into its slot, so that the values need not be staged first.
+  /// fill must not block or throw: readers of the slot and writers lapping
+  /// it wait until it returns.
+  template <class Fill>
+  Cursor writeN(uint32_t count, Fill fill) noexcept {
+    uint64_t ticket = ticket_.fetch_add(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto& slot = slots_[idx(ticket + i)];
+      fill(i, slot.beginWrite(turn(ticket + i)));
+      slot.endWrite(turn(ticket + i));
+    }
+    return Cursor(ticket);
+  }
+
+  /// Perform a single write of an object of type T without blocking.
+  /// If the slot the write would land in is still being written by a
+  /// previous writer (before the most recent wrap-around), the write is
+  /// dropped instead of waiting for that writer.
+  /// Returns true if the value was written, false if it was dropped.
+  bool tryWrite(T& value) noexcept {
+    Cursor cursor(0);
+    return tryWriteN(&value, 1, cursor);
+  }
+
+  /// Same as tryWrite(), on success <cursor> points to the just-written T.
+  bool tryWriteAndGetCursor(T& value, Cursor& cursor) noexcept {
+    return tryWriteN(&value, 1, cursor);
+  }
+
+  /// Non-blocking counterpart of writeN(). Either all <count> values are
+  /// written, or none are if any slot in the range is still busy.
+  /// On success <cursor> points to the first of the written values.
+  bool tryWriteN(T* values, uint32_t count, Cursor& cursor) noexcept {
+    return tryWriteN(count, cursor, [values](uint32_t i, T& value) {
+      value = values[i];
+    });
+  }
+
+  /// Same as tryWriteN() above, but fill(i, value) writes the i-th value
+  /// directly into its slot, so that the values need not be staged first.
+  /// fill must not block or throw.
+  template <class Fill>
+  bool tryWriteN(uint32_t count, Cursor& cursor, Fill fill) noexcept {
+    uint64_t ticket = ticket_.load();
+    do {
+      // Tickets are only handed out once the whole range is known to be
+      // free, so the writes below cannot wait on a lapped writer.
+      for (uint32_t i = 0; i < count; ++i) {
+        if (!slots_[idx(ticket + i)].isWritable(turn(ticket + i))) {
+          return false;
+        }
+      }
+    } while (!ticket_.compare_exchange_weak(ticket, ticket + count));
+
+    for (uint32_t i = 0; i < count; ++i) {
+      auto& slot = slots_[idx(ticket + i)];
+      fill(i, slot.beginWrite(turn(ticket + i)));
+      slot.endWrite(turn(ticket + i));
+    }
+    cursor = Cursor(ticket);
+    return true;
+  }
+
+  /// A slot reserved by claim() that has not been published yet.
+  class Claim {
+   public:
+    T& value() noexcept {
+      return value_;
+    }
+
+   private:
+    Claim(T& value, uint64_t ticket) noexcept
+        : value_(value), ticket_(ticket) {}
+
+    T& value_;
+    uint64_t ticket_;
+    friend class LockFreeRingBuffer<T, Atom>;
+  };
+
+  /// Reserve the next slot for an in-place write. The caller constructs the
+  /// value directly in claim.value() and must then call publish(), without
+  /// blocking in between: readers of the slot and writers lapping it wait
+  /// until the claim is published.
+  /// Claiming can block under the same conditions as write().
+  Claim claim() noexcept {
+    uint64_t ticket = ticket_.fetch_add(1);
+    return Claim(slots_[idx(ticket)].beginWrite(turn(ticket)), ticket);
+  }
+
+  /// Make an in-place write visible to readers.
+  /// Returns a Cursor pointing to the just-written T.
+  Cursor publish(const Claim& claim) noexcept {
+    slots_[idx(claim.ticket_)].endWrite(turn(claim.ticket_));
+    return Cursor(claim.ticket_);
+  }
+
   /// Read the value at the cursor.
   /// Returns true if the read succeeded, false otherwise. If the return
   /// value is false, dest is to be considered partially read and in an
   /// inconsistent state. Readers are advised to discard it.
   bool tryRead(T& dest, const Cursor& cursor) noexcept {
+    if (cursor.ticket < base_) {
+      return false;
+    }
     return slots_[idx(cursor.ticket)].tryRead(dest, turn(cursor.ticket));
   }
 
@@ -166,9 +258,27 @@ class LockFreeRingBuffer {
   /// value is false, dest is to be considered partially read and in an
   /// inconsistent state. Readers are advised to discard it.
   bool waitAndTryRead(T& dest, const Cursor& cursor) noexcept {
+    if (cursor.ticket < base_) {
+      return false;
+    }
     return slots_[idx(cursor.ticket)].waitAndTryRead(dest, turn(cursor.ticket));
   }
 
+  /// Same as waitAndTryRead() but stops blocking at deadline.
+  /// Returns TIMEDOUT if the write has not occurred by then, LOST if the
+  /// read failed as above.
+  template <class Clock, class Duration>
+  ReadResult waitAndTryReadUntil(
+      T& dest,
+      const Cursor& cursor,
+      const std::chrono::time_point<Clock, Duration>& deadline) noexcept {
+    if (cursor.ticket < base_) {
+      return ReadResult::LOST;
+    }
+    return slots_[idx(cursor.ticket)].waitAndTryReadUntil(
+        dest, turn(cursor.ticket), deadline);
+  }
+
   /// Returns a Cursor pointing to the first write that has not occurred yet.
   Cursor currentHead() noexcept {
     return Cursor(ticket_.load());
@@ -188,7 +298,7 @@ class LockFreeRingBuffer {
     backStep = std::max<uint64_t>(1, backStep);
 
     // can't go back more steps than we've taken
-    backStep = std::min(ticket, backStep);
+    backStep = std::min(ticket - base_, backStep);
 
     return Cursor(ticket - backStep);
   }
@@ -210,7 +320,7 @@ class LockFreeRingBuffer {
     }
 #endif
     auto head = ticket_.load();
-    auto ticket = head < capacity_ ? 0 : head - capacity_;
+    auto ticket = head - base_ < capacity_ ? base_ : head - capacity_;
 
     static const auto dataSize = sizeof(T);
 
@@ -237,21 +347,38 @@ class LockFreeRingBuffer {
     return sizeof(T) * capacity_;
   }
 
+  /// Returns the number of bytes needed to place a buffer of <capacity>
+  /// slots with allocateAt.
+  static size_t allocationSize(uint32_t capacity) {
+    return sizeof(LockFreeRingBuffer<T, Atom>) +
+        capacity * sizeof(detail::RingBufferSlot<T, Atom>);
+  }
+
   static LockFreeRingBufferHolder<T, Atom> allocateAt(
       uint32_t capacity,
       void* ptr) {
     return allocateAt(capacity, ptr, true);
   }
 
-  static LockFreeRingBufferHolder<T, Atom> allocate(uint32_t capacity) {
-    size_t alloc_size = sizeof(LockFreeRingBuffer<T, Atom>) +
-        capacity * sizeof(detail::RingBufferSlot<T, Atom>);
-    char* alloc_area = new char[alloc_size];
-    return allocateAt(capacity, reinterpret_cast<void*>(alloc_area), false);
+  /// <base> is the ticket of the first write. Buffers that replace each
+  /// other can use disjoint ticket ranges, so that a Cursor is never
+  /// mistaken for a write to the wrong buffer.
+  static LockFreeRingBufferHolder<T, Atom> allocate(
+      uint32_t capacity,
+      uint64_t base = 0) {
+    char* alloc_area = new char[allocationSize(capacity)];
+    return allocateAt(
+        capacity, reinterpret_cast<void*>(alloc_area), false, base);
+  }
+
+  /// Returns a Cursor pointing to the first write this buffer can hold.
+  Cursor begin() const noexcept {
+    return Cursor(base_);
   }
 
  private:
   const uint32_t capacity_;
+  const uint64_t base_;
   Atom<uint64_t> ticket_;
   detail::RingBufferSlot<T, Atom> slots_[];
 
@@ -259,10 +386,13 @@ class LockFreeRingBuffer {
     _destroy_n(slots_, capacity_);
   }
 
-  static LockFreeRingBufferHolder<T, Atom>
-  allocateAt(uint32_t capacity, void* ptr, bool is_external) {
+  static LockFreeRingBufferHolder<T, Atom> allocateAt(
+      uint32_t capacity,
+      void* ptr,
+      bool is_external,
+      uint64_t base = 0) {
     LockFreeRingBuffer<T, Atom>* buffer =
-        new (ptr) LockFreeRingBuffer<T, Atom>(capacity);
+        new (ptr) LockFreeRingBuffer<T, Atom>(capacity, base);
     _uninitialized_default_construct_n(buffer->slots_, capacity);
 
     return LockFreeRingBufferHolder<T, Atom>(buffer, is_external);
@@ -273,15 +403,15 @@ class LockFreeRingBuffer {
     delete[] reinterpret_cast<char*>(buffer);
   }
 
-  explicit LockFreeRingBuffer(uint32_t capacity) noexcept
-      : capacity_(capacity), ticket_(0) {}
+  LockFreeRingBuffer(uint32_t capacity, uint64_t base) noexcept
+      : capacity_(capacity), base_(base), ticket_(base) {}
 
   uint32_t idx(uint64_t ticket) noexcept {
-    return ticket % capacity_;
+    return (ticket - base_) % capacity_;
   }
 
   uint32_t turn(uint64_t ticket) noexcept {
-    return (uint32_t)(ticket / capacity_);
+    return (uint32_t)((ticket - base_) / capacity_);
   }
 
   friend LockFreeRingBufferHolder<T, Atom>;
@@ -294,13 +424,25 @@ class RingBufferSlot {
   explicit RingBufferSlot() noexcept : sequencer_(), data() {}
 
   void write(const uint32_t turn, T& value) noexcept {
+    beginWrite(turn) = std::move(value);
+    endWrite(turn);
+  }
+
+  bool isWritable(const uint32_t turn) const noexcept {
+    // The write for the previous turn has completed.
+    return sequencer_.isTurn(turn * 2);
+  }
+
+  T& beginWrite(const uint32_t turn) noexcept {
     Atom<uint32_t> cutoff(0);
     sequencer_.waitForTurn(turn * 2, cutoff, false);
 
     // Change to an odd-numbered turn to indicate write in process
     sequencer_.completeTurn(turn * 2);
+    return data;
+  }
 
-    data = std::move(value);
+  void endWrite(const uint32_t turn) noexcept {
     sequencer_.completeTurn(turn * 2 + 1);
     // At (turn + 1) * 2
   }
@@ -318,6 +460,28 @@ class RingBufferSlot {
     return sequencer_.isTurn(desired_turn);
   }
 
+  template <class Clock, class Duration>
+  ReadResult waitAndTryReadUntil(
+      T& dest,
+      uint32_t turn,
+      const std::chrono::time_point<Clock, Duration>& deadline) noexcept {
+    uint32_t desired_turn = (turn + 1) * 2;
+    Atom<uint32_t> cutoff(0);
+    switch (sequencer_.tryWaitForTurn(desired_turn, cutoff, false, &deadline)) {
+      case TurnSequencer<Atom>::TryWaitResult::SUCCESS:
+        break;
+      case TurnSequencer<Atom>::TryWaitResult::TIMEDOUT:
+        return ReadResult::TIMEDOUT;
+      default:
+        return ReadResult::LOST;
+    }
+    memcpy(&dest, &data, sizeof(T));
+
+    // if it's still the same turn, we read the value successfully
+    return sequencer_.isTurn(desired_turn) ? ReadResult::SUCCESS
+                                           : ReadResult::LOST;
+  }
+
   bool tryRead(T& dest, uint32_t turn) noexcept {
     // The write that started at turn 0 ended at turn 2
     if (!sequencer_.isTurn((turn + 1) * 2)) {
@@ -73,7 +73,7 @@ void logMemoryMappings(JNIEnv*, jobject) {
         .tid = tid,
         .timestamp = time,
     });
-    auto keyId = logger.writeBytes(
+    auto keyId = logger.writeInternedBytes(
         EntryType::STRING_KEY,
         mappingId,
         reinterpret_cast<const uint8_t*>(kAndroidMappingKey),
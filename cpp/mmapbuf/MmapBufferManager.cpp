@@ -16,6 +16,7 @@
 
 #include "MmapBufferManager.h"
 
+#include <profilo/Logger.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 
 #include <fcntl.h>
@@ -90,15 +91,20 @@ bool MmapBufferManager::allocateBuffer(
   mmapBufferPrefix->header.versionCode = version_code;
   mmapBufferPrefix->header.configId = config_id;
 
-  // Buffer initialization
+  // Buffer initialization. Always in the packet format, whatever the
+  // process uses otherwise: MmapBufferTraceWriter reads the file back as a
+  // TraceBuffer.
   RingBuffer::init(
       reinterpret_cast<char*>(map_ptr) + sizeof(MmapBufferPrefix), buffer_size);
+  // The buffer outlives the process, and with it the string IDs.
+  Logger::get().setStringInterning(false);
 
   return true;
 }
 
 void MmapBufferManager::deallocateBuffer() {
   RingBuffer::destroy();
+  Logger::get().setStringInterning(true);
   munmap(buffer_prefix_.load(), size_);
   unlink(path_.c_str());
 }
@@ -180,10 +180,14 @@ size_t getCppStackTrace(
   uint8_t depth = 0;
 
   int64_t ints[kStackSize];
+  uint8_t name_depths[kStackSize];
   char const* method_names[kStackSize];
   char const* class_descriptors[kStackSize];
-  auto ret = tracer->collectJavaStack(
-      nullptr, ints, method_names, class_descriptors, depth, kStackSize);
+  // Without known frames and with room for the whole stack, entry n names
+  // the frame at depth n.
+  profiler::FrameNames names{
+      nullptr, kStackSize, 0, name_depths, method_names, class_descriptors};
+  auto ret = tracer->collectJavaStack(nullptr, ints, &names, depth, kStackSize);
   for (size_t idx = 0; idx < depth; idx++) {
     JavaFrame frame{};
     frame.class_descriptor = class_descriptors[idx];
@@ -68,8 +68,7 @@ namespace {
 struct unwinder_data {
   ucontext_t* ucontext;
   int64_t* frames;
-  char const** method_names;
-  char const** class_descriptors;
+  FrameNames* names;
   uint8_t depth;
   uint8_t max_depth;
 };
@@ -82,12 +81,11 @@ bool unwind_cb(uintptr_t frame, void* data) {
   }
   ud->frames[ud->depth] = get_method_trace_id(frame);
 
-  if (ud->method_names != nullptr && ud->class_descriptors != nullptr) {
+  if (ud->names != nullptr && ud->names->wants(ud->frames[ud->depth])) {
     auto declaring_class = get_declaring_class(frame);
     auto class_string_t = get_class_descriptor(declaring_class);
     auto method_string_t = get_method_name(frame);
-    ud->method_names[ud->depth] = method_string_t.data;
-    ud->class_descriptors[ud->depth] = class_string_t.data;
+    ud->names->add(ud->depth, method_string_t.data, class_string_t.data);
   }
 
   ++ud->depth;
@@ -103,15 +101,13 @@ template <>
 StackCollectionRetcode ArtUnwindcTracer<kVersion>::collectJavaStack(
     ucontext_t* ucontext,
     int64_t* frames,
-    char const** method_names,
-    char const** class_descriptors,
+    FrameNames* names,
     uint8_t& depth,
     uint8_t max_depth) {
   unwinder_data data{
       .ucontext = ucontext,
       .frames = frames,
-      .method_names = method_names,
-      .class_descriptors = class_descriptors,
+      .names = names,
       .depth = 0,
       .max_depth = max_depth,
   };
@@ -133,7 +129,7 @@ StackCollectionRetcode ArtUnwindcTracer<kVersion>::collectStack(
     int64_t* frames,
     uint8_t& depth,
     uint8_t max_depth) {
-  return collectJavaStack(ucontext, frames, nullptr, nullptr, depth, max_depth);
+  return collectJavaStack(ucontext, frames, nullptr, depth, max_depth);
 }
 
 template <>
@@ -51,8 +51,7 @@ class ArtUnwindcTracer : public JavaBaseTracer {
   StackCollectionRetcode collectJavaStack(
       ucontext_t* ucontext,
       int64_t* frames,
-      char const** method_names,
-      char const** class_descriptors,
+      FrameNames* names,
       uint8_t& depth,
       uint8_t max_depth) override;
 
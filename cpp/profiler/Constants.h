@@ -23,11 +23,34 @@
 #define MAX_STACK_DEPTH 255
 
 /**
- * The maximum number of frames to track stack traces
+ * The number of frames per stack trace that can be named at once. Frames
+ * left out are named the next time they are sampled.
  */
-#define MAX_STACKS_COUNT 24
+#define MAX_NAMED_FRAMES 32
 
 /**
- * Number of full stacks upon which should flush stacks to the Profilo buffer
+ * Capacity of the table of frames the logger has seen, see FrameNameCache
+ */
+#define KNOWN_FRAMES_CAPACITY 8192
+
+/**
+ * Number of frames the logger keeps besides those that don't fit in the
+ * table of known frames, see FrameNameCache
+ */
+#define MAX_OVERFLOW_FRAMES 1024
+
+/**
+ * Default number of per-thread stack slot rings, see StackSlotPool
+ */
+#define DEFAULT_STACK_SLOT_RINGS 16
+
+/**
+ * Default number of stack slots in each ring
+ */
+#define DEFAULT_STACK_SLOTS_PER_RING 8
+
+/**
+ * Number of full stacks upon which should flush stacks to the Profilo buffer,
+ * initially. The logger adapts it to how full the slot rings get.
  */
 #define FLUSH_STACKS_COUNT 4
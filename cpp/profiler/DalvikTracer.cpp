@@ -71,8 +71,7 @@ DalvikTracer::DalvikTracer()
 StackCollectionRetcode DalvikTracer::collectJavaStack(
     ucontext_t*,
     int64_t* frames,
-    char const** method_names,
-    char const** class_descriptors,
+    FrameNames* names,
     uint8_t& depth,
     uint8_t max_depth) {
   Thread* thread = dvmThreadSelf_();
@@ -97,12 +96,11 @@ StackCollectionRetcode DalvikTracer::collectJavaStack(
       continue;
     }
 
-    if (method_names != nullptr && class_descriptors != nullptr) {
-      method_names[depth] = method->name;
-      class_descriptors[depth] = method->clazz->descriptor;
-    }
-
     frames[depth] = dalvikGetMethodIdForSymbolication(method);
+
+    if (names != nullptr && names->wants(frames[depth])) {
+      names->add(depth, method->name, method->clazz->descriptor);
+    }
     depth++;
   }
 
@@ -117,7 +115,7 @@ StackCollectionRetcode DalvikTracer::collectStack(
     int64_t* frames,
     uint8_t& depth,
     uint8_t max_depth) {
-  return collectJavaStack(ucontext, frames, nullptr, nullptr, depth, max_depth);
+  return collectJavaStack(ucontext, frames, nullptr, depth, max_depth);
 }
 
 void DalvikTracer::flushStack(
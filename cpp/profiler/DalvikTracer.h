@@ -45,8 +45,7 @@ class DalvikTracer : public JavaBaseTracer {
   StackCollectionRetcode collectJavaStack(
       ucontext_t* ucontext,
       int64_t* frames,
-      char const** method_names,
-      char const** class_descriptors,
+      FrameNames* names,
       uint8_t& depth,
       uint8_t max_depth) override;
 
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "FrameNameCache.h"
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+FrameNameCache::FrameNameCache(size_t capacity, size_t max_overflow)
+    : known_(capacity),
+      max_overflow_(max_overflow),
+      entries_(new Entry[known_.capacity() + max_overflow]()),
+      overflow_(),
+      unkept_name_(),
+      generation_(1),
+      size_(0),
+      stale_cursor_(0) {
+  overflow_.reserve(max_overflow);
+}
+
+bool FrameNameCache::contains(int64_t frame) const {
+  if (known_.contains(frame)) {
+    return true;
+  }
+  return overflow_.find(frame) != overflow_.end();
+}
+
+std::string const* FrameNameCache::add(
+    int64_t frame,
+    char const* class_descriptor,
+    char const* method_name) {
+  std::unique_ptr<std::string> name;
+  if (class_descriptor != nullptr && method_name != nullptr) {
+    name.reset(new std::string(class_descriptor));
+    *name += method_name;
+  }
+
+  size_t idx = known_.insertAt(frame);
+  if (idx == KnownFrames::kNoIndex) {
+    auto it = overflow_.find(frame);
+    if (it != overflow_.end()) {
+      idx = it->second;
+    } else if (overflow_.size() < max_overflow_) {
+      idx = known_.capacity() + overflow_.size();
+      overflow_.emplace(frame, idx);
+    } else {
+      if (name == nullptr) {
+        return nullptr;
+      }
+      unkept_name_ = std::move(*name);
+      return &unkept_name_;
+    }
+  }
+
+  Entry& entry = entries_[idx];
+  if (!used(entry)) {
+    ++size_;
+  }
+  entry.frame = frame;
+  entry.generation = generation_;
+  entry.name = std::move(name);
+  return entry.name.get();
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <profiler/KnownFrames.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+//
+// The names of the Java frames the sampling profiler has seen, kept for as
+// long as the process profiles.
+//
+// Frames are keyed by method id in an open-addressed KnownFrames table that
+// the signal handlers read without locks, to skip looking up names of
+// frames the cache already has. Everything else is only touched by the
+// logger thread: the names themselves, put together once per frame, and the
+// trace generation each name was last logged in.
+//
+// Every trace start begins a new generation. Names logged before it are not
+// part of the new trace, so the logger dumps them again in bulk; names
+// learned afterwards are logged once and reach every trace in flight. A
+// name's generation thus tells which traces have received it: all those
+// that started no later than that generation.
+//
+// Frames that don't fit in the table are kept in a map instead, up to a
+// fixed number of them. The handlers keep looking up their names, but the
+// logger still logs each one once per generation. Frames past that are not
+// kept at all and get named again every time they are sampled.
+//
+class FrameNameCache {
+ public:
+  //
+  // capacity is rounded up to a power of two. At most max_overflow frames
+  // that don't fit in the table are kept besides.
+  //
+  FrameNameCache(size_t capacity, size_t max_overflow);
+
+  FrameNameCache(const FrameNameCache&) = delete;
+  FrameNameCache& operator=(const FrameNameCache&) = delete;
+
+  KnownFrames const& known() const {
+    return known_;
+  }
+
+  bool contains(int64_t frame) const;
+
+  //
+  // Adds a frame that was not in the cache. Frames without a name are
+  // remembered as seen but never logged. Returns the name, or nullptr. If
+  // the frame could not be kept, the name is only valid until the next
+  // add().
+  //
+  std::string const* add(
+      int64_t frame,
+      char const* class_descriptor,
+      char const* method_name);
+
+  uint32_t generation() const {
+    return generation_;
+  }
+
+  //
+  // Begins a new generation. Names logged before it are stale until
+  // forEachStale() hands them out again.
+  //
+  void startGeneration() {
+    ++generation_;
+    stale_cursor_ = 0;
+  }
+
+  //
+  // Calls fn(frame, name) for up to max named frames not logged in the
+  // current generation yet, and then counts them as logged. Each call picks
+  // up where the previous one stopped. Returns true once every stale name
+  // has been handed out.
+  //
+  template <typename Fn>
+  bool forEachStale(Fn&& fn, size_t max = SIZE_MAX);
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  struct Entry {
+    int64_t frame;
+    uint32_t generation;
+    std::unique_ptr<std::string> name;
+  };
+
+  KnownFrames known_;
+  size_t max_overflow_;
+  // The table's entries, at the same indices as in known_, followed by the
+  // overflow entries in the order they were added.
+  std::unique_ptr<Entry[]> entries_;
+  // Index into entries_ of each overflow frame.
+  std::unordered_map<int64_t, size_t> overflow_;
+  // The name of the last frame that could not be kept.
+  std::string unkept_name_;
+  uint32_t generation_;
+  size_t size_;
+  // Index into entries_ where forEachStale() continues.
+  size_t stale_cursor_;
+
+  // Generations start at 1, 0 marks unused entries.
+  static bool used(Entry const& entry) {
+    return entry.generation != 0;
+  }
+
+  template <typename Fn>
+  bool logIfStale(Entry& entry, Fn& fn);
+};
+
+template <typename Fn>
+bool FrameNameCache::logIfStale(Entry& entry, Fn& fn) {
+  if (!used(entry) || entry.name == nullptr ||
+      entry.generation == generation_) {
+    return false;
+  }
+  fn(entry.frame, *entry.name);
+  entry.generation = generation_;
+  return true;
+}
+
+template <typename Fn>
+bool FrameNameCache::forEachStale(Fn&& fn, size_t max) {
+  size_t end = known_.capacity() + overflow_.size();
+  size_t logged = 0;
+  while (stale_cursor_ < end) {
+    if (logged == max) {
+      return false;
+    }
+    logged += logIfStale(entries_[stale_cursor_], fn);
+    ++stale_cursor_;
+  }
+  return true;
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -20,6 +20,7 @@
 #include <set>
 #include <string>
 #include "profiler/BaseTracer.h"
+#include "profiler/KnownFrames.h"
 
 namespace facebook {
 namespace profilo {
@@ -30,13 +31,48 @@ struct framework_prefix {
   size_t length;
 };
 
+//
+// Names of some of the frames of a Java stack, in caller-provided arrays of
+// `capacity` entries. Entry n names the frame at depths[n].
+//
+// Tracers skip the frames in `known` and stop naming frames once the arrays
+// are full, the rest of the stack still gets collected.
+//
+struct FrameNames {
+  KnownFrames const* known;
+  uint8_t capacity;
+  uint8_t count;
+  uint8_t* depths;
+  char const** method_names;
+  char const** class_descriptors;
+
+  void reset(KnownFrames const* known_frames) {
+    known = known_frames;
+    count = 0;
+  }
+
+  bool wants(int64_t frame) const {
+    return count < capacity && (known == nullptr || !known->contains(frame));
+  }
+
+  void add(uint8_t depth, char const* method_name, char const* descriptor) {
+    depths[count] = depth;
+    method_names[count] = method_name;
+    class_descriptors[count] = descriptor;
+    ++count;
+  }
+};
+
 class JavaBaseTracer : public BaseTracer {
  public:
+  //
+  // Same as collectStack() but also names the frames `names` wants,
+  // if given.
+  //
   virtual StackCollectionRetcode collectJavaStack(
       ucontext_t* ucontext,
       int64_t* frames,
-      char const** method_names,
-      char const** class_descriptors,
+      FrameNames* names,
       uint8_t& depth,
       uint8_t max_depth) = 0;
 
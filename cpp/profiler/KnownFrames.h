@@ -0,0 +1,150 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+//
+// Set of frame ids the logger has already seen. Written only by the logger
+// thread and read by the signal handlers, which use it to skip looking up
+// the names of known frames.
+//
+// The table is allocated upfront and never grows. When an insert finds no
+// room within a few probes it fails, and readers keep treating the frame as
+// unknown, which only costs a name lookup. Frames are never removed while
+// handlers may read the set, so a frame seen as known stays known; the
+// logger must still not rely on a frame being named just because it is
+// missing from the set.
+//
+class KnownFrames {
+ public:
+  static constexpr size_t kNoIndex = SIZE_MAX;
+
+  // capacity is rounded up to a power of two.
+  explicit KnownFrames(size_t capacity) : slots_(), mask_(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    slots_.reset(new std::atomic<int64_t>[size]);
+    mask_ = size - 1;
+    clear();
+  }
+
+  KnownFrames(const KnownFrames&) = delete;
+  KnownFrames& operator=(const KnownFrames&) = delete;
+
+  // Async-signal-safe.
+  bool contains(int64_t frame) const {
+    return indexAt(frame) != kNoIndex;
+  }
+
+  // Returns false if the frame did not fit.
+  bool insert(int64_t frame) {
+    return insertAt(frame) != kNoIndex;
+  }
+
+  //
+  // Like insert() but returns the index of the frame, below capacity(), or
+  // kNoIndex if it did not fit. A frame keeps its index until clear(), so
+  // the writer can keep more about it in an array of its own.
+  //
+  size_t insertAt(int64_t frame) {
+    int64_t key = toKey(frame);
+    if (key == kEmpty) {
+      return kNoIndex;
+    }
+    size_t idx = indexOf(key);
+    for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+      size_t pos = (idx + probe) & mask_;
+      auto& slot = slots_[pos];
+      int64_t stored = slot.load(std::memory_order_relaxed);
+      if (stored == key) {
+        return pos;
+      }
+      if (stored == kEmpty) {
+        slot.store(key, std::memory_order_relaxed);
+        return pos;
+      }
+    }
+    return kNoIndex;
+  }
+
+  //
+  // The index insertAt() would return, without inserting.
+  // Async-signal-safe.
+  //
+  size_t indexAt(int64_t frame) const {
+    int64_t key = toKey(frame);
+    if (key == kEmpty) {
+      return kNoIndex;
+    }
+    size_t idx = indexOf(key);
+    for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+      size_t pos = (idx + probe) & mask_;
+      int64_t stored = slots_[pos].load(std::memory_order_relaxed);
+      if (stored == key) {
+        return pos;
+      }
+      if (stored == kEmpty) {
+        return kNoIndex;
+      }
+    }
+    return kNoIndex;
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  // Empties the set. Not to be called while handlers may read it.
+  void clear() {
+    for (size_t idx = 0; idx <= mask_; ++idx) {
+      slots_[idx].store(kEmpty, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  static constexpr size_t kMaxProbes = 8;
+  static constexpr int64_t kEmpty = 0;
+
+  std::unique_ptr<std::atomic<int64_t>[]> slots_;
+  size_t mask_;
+
+  // Frame ids are opaque and may be 0, flip them so that 0 marks empty
+  // slots. That leaves -1 out, it never becomes known.
+  static int64_t toKey(int64_t frame) {
+    return ~frame;
+  }
+
+  size_t indexOf(int64_t key) const {
+    uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash >> 32) & mask_;
+  }
+};
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
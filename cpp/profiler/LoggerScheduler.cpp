@@ -0,0 +1,230 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LoggerScheduler.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+constexpr int64_t kNanosecondsInMillisecond = 1000000;
+constexpr int64_t kNanosecondsInSecond = 1000000000;
+
+int64_t nowNs() {
+  struct timespec ts {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * kNanosecondsInSecond + ts.tv_nsec;
+}
+
+struct timespec toTimespec(int64_t ns) {
+  struct timespec ts {};
+  ts.tv_sec = ns / kNanosecondsInSecond;
+  ts.tv_nsec = ns % kNanosecondsInSecond;
+  return ts;
+}
+
+} // namespace
+
+LoggerScheduler::LoggerScheduler(int max_flush_delay_ms)
+    : max_flush_delay_ms_(max_flush_delay_ms),
+      event_fd_(-1),
+      timer_fd_(-1),
+      pending_(0),
+      batch_(1),
+      max_batch_(1),
+      wake_posted_(false),
+      flush_requested_(false),
+      stopping_(false),
+      period_ns_(0),
+      next_deadline_ns_(0),
+      last_flush_ns_(0),
+      stats_() {}
+
+LoggerScheduler::~LoggerScheduler() {
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+  }
+  if (timer_fd_ >= 0) {
+    close(timer_fd_);
+  }
+}
+
+bool LoggerScheduler::init() {
+  if (event_fd_ < 0) {
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+      return false;
+    }
+  }
+  if (timer_fd_ < 0) {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd_ < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LoggerScheduler::reset(uint32_t initial_batch, uint32_t max_batch) {
+  uint64_t count;
+  while (read(event_fd_, &count, sizeof(count)) == sizeof(count)) {
+  }
+  errno = 0;
+  startSampling(0);
+
+  max_batch_ = std::max<uint32_t>(max_batch, 1);
+  batch_.store(std::min(std::max<uint32_t>(initial_batch, 1), max_batch_));
+  pending_.store(0);
+  wake_posted_.store(false);
+  stopping_.store(false);
+  last_flush_ns_ = nowNs();
+  stats_ = Stats();
+}
+
+bool LoggerScheduler::startSampling(int period_ms) {
+  struct itimerspec spec {};
+  period_ns_ = period_ms > 0 ? period_ms * kNanosecondsInMillisecond : 0;
+  if (period_ns_ > 0) {
+    next_deadline_ns_ = nowNs() + period_ns_;
+    spec.it_value = toTimespec(next_deadline_ns_);
+    spec.it_interval = toTimespec(period_ns_);
+  }
+  return timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+void LoggerScheduler::onSample() {
+  uint32_t pending = pending_.fetch_add(1) + 1;
+  if (pending >= batch_.load(std::memory_order_relaxed) &&
+      !wake_posted_.exchange(true)) {
+    wake();
+  }
+}
+
+void LoggerScheduler::flush() {
+  // Signal handlers call this on every missed slot, one wake-up will do.
+  if (!flush_requested_.exchange(true)) {
+    wake();
+  }
+}
+
+void LoggerScheduler::stop() {
+  stopping_.store(true);
+  wake();
+}
+
+void LoggerScheduler::wake() {
+  int saved_errno = errno;
+  uint64_t one = 1;
+  // Can only fail if the counter is about to overflow, which still leaves
+  // the descriptor readable.
+  write(event_fd_, &one, sizeof(one));
+  errno = saved_errno;
+}
+
+uint32_t LoggerScheduler::wait() {
+  int timeout_ms = -1;
+  if (pending_.load() > 0) {
+    int64_t waited_ns = nowNs() - last_flush_ns_;
+    timeout_ms = std::max<int64_t>(
+        0, max_flush_delay_ms_ - waited_ns / kNanosecondsInMillisecond);
+  }
+
+  struct pollfd fds[2] = {
+      {event_fd_, POLLIN, 0},
+      {timer_fd_, POLLIN, 0},
+  };
+  int res = poll(fds, 2, timeout_ms);
+  if (res < 0) {
+    return 0;
+  }
+
+  uint32_t events = 0;
+  uint64_t count;
+  if (fds[0].revents & POLLIN) {
+    if (read(event_fd_, &count, sizeof(count)) == sizeof(count)) {
+      // Samples from now on may post a new wake-up, this one is handled.
+      wake_posted_.store(false);
+    }
+    // Woken up by stop() unless samples are pending or flush() was called.
+    bool flush_requested = flush_requested_.exchange(false);
+    if (pending_.load() > 0 || flush_requested) {
+      events |= FLUSH;
+    }
+  }
+  if (fds[1].revents & POLLIN) {
+    if (read(timer_fd_, &count, sizeof(count)) == sizeof(count)) {
+      onDeadlines(count);
+      events |= SAMPLE;
+    }
+  }
+  if (pending_.load() > 0 &&
+      nowNs() - last_flush_ns_ >=
+          max_flush_delay_ms_ * kNanosecondsInMillisecond) {
+    events |= FLUSH;
+  }
+  if (stopping_.load()) {
+    events |= STOP;
+  }
+  return events;
+}
+
+void LoggerScheduler::onDeadlines(uint64_t expirations) {
+  if (period_ns_ == 0 || expirations == 0) {
+    return;
+  }
+  int64_t last_deadline_ns = next_deadline_ns_ + (expirations - 1) * period_ns_;
+  next_deadline_ns_ = last_deadline_ns + period_ns_;
+
+  int64_t jitter_ns = std::max<int64_t>(0, nowNs() - last_deadline_ns);
+  stats_.ticks += expirations;
+  stats_.missed_ticks += expirations - 1;
+  stats_.jitter_total_ns += jitter_ns;
+  stats_.jitter_max_ns = std::max(stats_.jitter_max_ns, jitter_ns);
+}
+
+void LoggerScheduler::onFlush(size_t max_occupancy, size_t ring_size) {
+  pending_.store(0);
+  last_flush_ns_ = nowNs();
+  if (ring_size == 0) {
+    return;
+  }
+
+  uint32_t batch = batch_.load(std::memory_order_relaxed);
+  if (max_occupancy * 2 > ring_size) {
+    batch = std::max<uint32_t>(batch / 2, 1);
+  } else if (max_occupancy * 4 <= ring_size) {
+    // The count is shared by all rings, so a single busy thread fills its
+    // own ring by up to `batch` samples before the loop wakes up.
+    uint32_t half_ring = std::max<uint32_t>(ring_size / 2, 1);
+    batch = std::min({batch * 2, max_batch_, half_ring});
+  }
+  batch_.store(batch, std::memory_order_relaxed);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,166 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstddef>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+//
+// Decides when the sampling profiler's logger loop wakes up.
+//
+// The loop waits on two file descriptors:
+//  - an eventfd that signal handlers write to once enough samples are
+//    waiting to be flushed (the high-water mark), and
+//  - a timerfd with absolute, periodic deadlines for when the loop itself
+//    drives sampling (sleep-based wall-clock mode). Deadlines don't drift
+//    with the time spent signalling threads or flushing; a late wake-up is
+//    recorded as jitter and skipped deadlines as missed ticks.
+//
+// The high-water mark adapts to how full the fullest slot ring was at each
+// flush: it halves when a ring was more than half full and doubles, up to
+// a limit, when every ring was at most a quarter full. Many threads
+// sampling at once thus get batched into fewer flushes, while a single busy
+// thread keeps being flushed before its ring overflows.
+//
+class LoggerScheduler {
+ public:
+  enum Events : uint32_t {
+    // A sampling deadline passed.
+    SAMPLE = 1 << 0,
+    // Samples are waiting to be flushed, because the high-water mark was
+    // reached or because they have been waiting for too long.
+    FLUSH = 1 << 1,
+    // stop() was called.
+    STOP = 1 << 2,
+  };
+
+  struct Stats {
+    // Sampling deadlines that passed, including missed ones.
+    uint64_t ticks;
+    // Deadlines that passed while the loop was busy or late.
+    uint64_t missed_ticks;
+    // Delay between the last deadline that passed and the wake-up.
+    int64_t jitter_total_ns;
+    int64_t jitter_max_ns;
+  };
+
+  //
+  // max_flush_delay_ms bounds how long samples wait for the high-water mark
+  // before the loop flushes them anyway.
+  //
+  explicit LoggerScheduler(int max_flush_delay_ms = kDefaultMaxFlushDelayMs);
+  ~LoggerScheduler();
+
+  LoggerScheduler(const LoggerScheduler&) = delete;
+  LoggerScheduler& operator=(const LoggerScheduler&) = delete;
+
+  //
+  // Creates the file descriptors. Returns false, with errno set, on
+  // failure.
+  //
+  bool init();
+
+  //
+  // Gets ready for a new profiling session: forgets pending samples and a
+  // previous stop(), disarms the sampling timer, resets the stats and sets
+  // the high-water mark to `initial_batch`, which it will not adapt past
+  // `max_batch`.
+  //
+  void reset(uint32_t initial_batch, uint32_t max_batch);
+
+  //
+  // Arms SAMPLE events every period_ms, starting one period from now.
+  // Returns false, with errno set, on failure.
+  //
+  bool startSampling(int period_ms);
+
+  //
+  // Counts a sample ready to be flushed and wakes the loop up at the
+  // high-water mark. Async-signal-safe.
+  //
+  void onSample();
+
+  //
+  // Wakes the loop up with FLUSH, whether samples are pending or not.
+  // Async-signal-safe.
+  //
+  void flush();
+
+  //
+  // Wakes the loop up with STOP. Async-signal-safe.
+  //
+  void stop();
+
+  //
+  // Blocks until at least one event is due and returns them, or 0 if the
+  // wait was interrupted. Only one thread may wait.
+  //
+  uint32_t wait();
+
+  //
+  // To be called by the loop right before it drains the slots.
+  // max_occupancy is the fill level of the fullest ring out of ring_size
+  // slots. The high-water mark adapts to it, without growing past half a
+  // ring.
+  //
+  void onFlush(size_t max_occupancy, size_t ring_size);
+
+  bool stopping() const {
+    return stopping_.load();
+  }
+
+  uint32_t batch() const {
+    return batch_.load(std::memory_order_relaxed);
+  }
+
+  // Only consistent when read from the waiting thread.
+  Stats stats() const {
+    return stats_;
+  }
+
+ private:
+  static constexpr int kDefaultMaxFlushDelayMs = 100;
+
+  const int max_flush_delay_ms_;
+  int event_fd_;
+  int timer_fd_;
+
+  std::atomic<uint32_t> pending_;
+  std::atomic<uint32_t> batch_;
+  uint32_t max_batch_;
+  std::atomic_bool wake_posted_;
+  std::atomic_bool flush_requested_;
+  std::atomic_bool stopping_;
+
+  int64_t period_ns_;
+  int64_t next_deadline_ns_;
+  int64_t last_flush_ns_;
+  Stats stats_;
+
+  void wake();
+  void onDeadlines(uint64_t expirations);
+};
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -20,16 +20,18 @@
 #include <abort_with_reason.h>
 #include <errno.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <setjmp.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
+#include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <random>
 #include <string>
+#include <vector>
 
 #include <fb/log.h>
 #include <fbjni/fbjni.h>
@@ -68,7 +70,15 @@ namespace profilo {
 namespace profiler {
 
 namespace {
-constexpr auto kMicrosecondsInMillisecond = 1000;
+constexpr auto kNanosecondsInMicrosecond = 1000;
+constexpr auto kMicrosecondsInSecond = 1000 * 1000;
+// Logger loop iterations between looking for rings of exited threads.
+constexpr auto kReleaseRingsInterval = 128;
+// How long the logger loop observes the profiler's overhead before adapting
+// the sampling rate.
+constexpr int64_t kSamplingWindowNs = 1000 * 1000 * 1000;
+// Known frame names the logger loop logs per iteration when a trace starts.
+constexpr size_t kFrameNamesPerIteration = 128;
 
 EntryType errorToTraceEntry(StackCollectionRetcode error) {
 #pragma clang diagnostic push
@@ -148,75 +158,18 @@ sigmux_action SamplingProfiler::FaultHandler(
   ProfileState& state =
       reinterpret_cast<SamplingProfiler*>(handler_data)->state_;
 
-  int32_t tid = threadID();
-  uint32_t targetBusyState = (tid << 16) | StackSlotState::BUSY_WITH_METADATA;
-
   // Find the most recent slot occupied by this thread.
   // This allows us to handle crashes during nested unwinding from
   // the most inner one out.
-  int64_t max_time = -1;
-  int max_idx = -1;
-
-  for (int i = 0; i < MAX_STACKS_COUNT; i++) {
-    auto& slot = state.stacks[i];
-    if (slot.state.load() == targetBusyState && slot.time > max_time) {
-      max_time = slot.time;
-      max_idx = i;
-    }
-  }
-
-  if (max_idx >= 0) {
+  StackSlot* slot = state.stacks.findInnermost(threadID());
+  if (slot != nullptr) {
     state.errSigCrashes.fetch_add(1);
-    sigmux_longjmp(siginfo, state.stacks[max_idx].sig_jmp_buf, 1);
+    sigmux_longjmp(siginfo, slot->sig_jmp_buf, 1);
   }
 
   return SIGMUX_CONTINUE_SEARCH;
 }
 
-void SamplingProfiler::maybeSignalReader() {
-  uint32_t prevSlotCounter = state_.fullSlotsCounter.fetch_add(1);
-  if ((prevSlotCounter + 1) % FLUSH_STACKS_COUNT == 0) {
-    if (state_.useSleepBasedWallProfiler) {
-      state_.enoughStacks.store(true);
-    } else {
-      int res = sem_post(&state_.slotsCounterSem);
-      if (res != 0) {
-        abort(); // Something went wrong
-      }
-    }
-  }
-}
-
-// Finds the next FREE slot and atomically sets its state to BUSY, so that
-// the acquiring thread can safely write to it, and returns the index via
-// <outSlot>. Returns true if a FREE slot was found, false otherwise.
-bool getSlotIndex(ProfileState& state_, uint32_t tid, uint32_t& outSlot) {
-  auto slotIndex = state_.currentSlot.fetch_add(1);
-  for (int i = 0; i < MAX_STACKS_COUNT; i++) {
-    auto nextSlotIndex = (slotIndex + i) % MAX_STACKS_COUNT;
-    auto& slot = state_.stacks[nextSlotIndex];
-    uint32_t expected = StackSlotState::FREE;
-    uint32_t targetBusyState = (tid << 16) | StackSlotState::BUSY;
-    if (slot.state.compare_exchange_strong(expected, targetBusyState)) {
-      outSlot = nextSlotIndex;
-
-      slot.time = monotonicTime();
-      memset(&slot.sig_jmp_buf, 0, sizeof(slot.sig_jmp_buf));
-
-      expected = targetBusyState;
-      targetBusyState = (tid << 16) | StackSlotState::BUSY_WITH_METADATA;
-      if (!slot.state.compare_exchange_strong(expected, targetBusyState)) {
-        abortWithReason(
-            "Invariant violation - BUSY to BUSY_WITH_METADATA failed");
-      }
-      return true;
-    }
-  }
-  // We didn't find an empty slot, so bump our counter
-  state_.errSlotMisses.fetch_add(1);
-  return false;
-}
-
 sigmux_action SamplingProfiler::UnwindStackHandler(
     struct sigmux_siginfo* siginfo,
     void* handler_data) {
@@ -241,27 +194,27 @@ sigmux_action SamplingProfiler::UnwindStackHandler(
       }
     }
 
-    uint32_t slotIndex;
-    bool slot_found = getSlotIndex(state, tid, slotIndex);
-    if (!slot_found) {
-      // We're out of slots, no tracer is likely to succeed.
+    StackSlot* acquired = state.stacks.acquire(tid);
+    if (acquired == nullptr) {
+      // Every ring is full, no tracer is likely to succeed. The samples in
+      // them may not add up to a flush yet if other threads are idle.
+      state.errSlotMisses.fetch_add(1);
+      state.scheduler.flush();
       break;
     }
 
-    auto& slot = state.stacks[slotIndex];
+    auto& slot = *acquired;
 
     // Can finally occupy the slot
     if (sigsetjmp(slot.sig_jmp_buf, 1) == 0) {
-      memset(slot.method_names, 0, sizeof(slot.method_names));
-      memset(slot.class_descriptors, 0, sizeof(slot.class_descriptors));
+      slot.names.reset(&state.frameNames.known());
       uint8_t ret{StackSlotState::FREE};
       if (JavaBaseTracer::isJavaTracer(tracerType)) {
         ret = reinterpret_cast<JavaBaseTracer*>(tracerEntry.second.get())
                   ->collectJavaStack(
                       (ucontext_t*)siginfo->context,
                       slot.frames,
-                      slot.method_names,
-                      slot.class_descriptors,
+                      &slot.names,
                       slot.depth,
                       (uint8_t)MAX_STACK_DEPTH);
       } else {
@@ -277,17 +230,19 @@ sigmux_action SamplingProfiler::UnwindStackHandler(
         state.errStackOverflows.fetch_add(1);
       }
 
-      // Ignore TRACER_DISABLED errors for now and free the slot.
+      // Ignore TRACER_DISABLED errors for now and discard the slot.
       // TODO T42938550
       if (StackCollectionRetcode::TRACER_DISABLED == ret) {
         if (!slot.state.compare_exchange_strong(
-                busyState, StackSlotState::FREE)) {
+                busyState, StackSlotState::DISCARDED)) {
           abortWithReason(
-              "Invariant violation - BUSY_WITH_METADATA to FREE failed");
+              "Invariant violation - BUSY_WITH_METADATA to DISCARDED failed");
         }
         continue;
       }
 
+      // The slot is the logger's once committed, time included.
+      int64_t handlerTimeNs = monotonicTime() - slot.time;
       if (!slot.state.compare_exchange_strong(busyState, (tid << 16) | ret)) {
         // Slot was overwritten by another thread.
         // This is an ordering violation, so abort.
@@ -295,7 +250,9 @@ sigmux_action SamplingProfiler::UnwindStackHandler(
             "Invariant violation - BUSY_WITH_METADATA to return code failed");
       }
 
-      profiler->maybeSignalReader();
+      state.handlerTimeNs.fetch_add(handlerTimeNs);
+      state.handlerSamples.fetch_add(1);
+      state.scheduler.onSample();
       continue;
     } else {
       // We came from the longjmp in sigcatch_handler.
@@ -430,82 +387,79 @@ void SamplingProfiler::unregisterSignalHandlers() {
   }
 }
 
-void SamplingProfiler::flushStackTraces(
-    std::unordered_set<uint64_t>& loggedFramesSet) {
-  int processedCount = 0;
-  for (size_t i = 0; i < MAX_STACKS_COUNT; i++) {
-    auto& slot = state_.stacks[i];
-
-    uint32_t slotStateCombo = slot.state.load();
+void SamplingProfiler::flushStackTraces() {
+  state_.stacks.drain([&](StackSlot& slot, uint32_t slotStateCombo) {
     uint32_t slotState = slotStateCombo & 0xffff;
-    if (slotState == StackSlotState::FREE ||
-        slotState == StackSlotState::BUSY ||
-        slotState == StackSlotState::BUSY_WITH_METADATA) {
-      continue;
-    }
 
     // Ignore remains from a previous trace
-    if (slot.time > state_.profileStartTime) {
-      auto& tracer = state_.tracersMap[slot.profilerType];
-      auto tid = slotStateCombo >> 16;
+    if (slot.time <= state_.profileStartTime) {
+      return;
+    }
 
-      if (StackCollectionRetcode::SUCCESS == slotState) {
-        tracer->flushStack(slot.frames, slot.depth, tid, slot.time);
-      } else {
-        StandardEntry entry{};
-        entry.type =
-            errorToTraceEntry(static_cast<StackCollectionRetcode>(slotState));
-        entry.timestamp = slot.time;
-        entry.tid = tid;
-        entry.extra = slot.profilerType;
-        Logger::get().write(std::move(entry));
-      }
+    auto& tracer = state_.tracersMap[slot.profilerType];
+    auto tid = slotStateCombo >> 16;
+
+    if (StackCollectionRetcode::SUCCESS == slotState) {
+      tracer->flushStack(slot.frames, slot.depth, tid, slot.time);
+    } else {
+      StandardEntry entry{};
+      entry.type =
+          errorToTraceEntry(static_cast<StackCollectionRetcode>(slotState));
+      entry.timestamp = slot.time;
+      entry.tid = tid;
+      entry.extra = slot.profilerType;
+      Logger::get().write(std::move(entry));
+    }
+
+    if (JavaBaseTracer::isJavaTracer(slot.profilerType)) {
+      // Only frames that were unknown when sampled have names. Frames left
+      // out stay unknown and get named by a later sample.
+      auto& frameNames = state_.frameNames;
+      auto& names = slot.names;
+      for (int n = 0; n < names.count; n++) {
+        int64_t frame = slot.frames[names.depths[n]];
+        if (frameNames.contains(frame)) {
+          continue;
+        }
 
-      if (JavaBaseTracer::isJavaTracer(slot.profilerType)) {
-        for (int i = 0; i < slot.depth; i++) {
-          bool expectedResetState = true;
-          if (state_.resetFrameworkSymbols.compare_exchange_strong(
-                  expectedResetState, false)) {
-            loggedFramesSet.clear();
-          }
-
-          if (loggedFramesSet.find(slot.frames[i]) == loggedFramesSet.end() &&
-              JavaBaseTracer::isFramework(slot.class_descriptors[i])) {
-            StandardEntry entry{};
-            entry.tid = tid;
-            entry.timestamp = slot.time;
-            entry.type = EntryType::JAVA_FRAME_NAME;
-            entry.extra = slot.frames[i];
-            int32_t id = Logger::get().write(std::move(entry));
-
-            std::string full_name{slot.class_descriptors[i]};
-            full_name += slot.method_names[i];
-            Logger::get().writeBytes(
-                EntryType::STRING_VALUE,
-                id,
-                (const uint8_t*)full_name.c_str(),
-                full_name.length());
-          }
-          // Mark the frame as "logged" or "visited" so that we don't do a
-          // string comparison for it next time, regardless of whether it was
-          // a framework frame or not
-          loggedFramesSet.insert(slot.frames[i]);
+        // Remember the frame regardless of whether it was a framework frame
+        // or not, so that we don't do a string comparison for it next time.
+        // Samples stop naming it too.
+        std::string const* name = nullptr;
+        if (JavaBaseTracer::isFramework(names.class_descriptors[n])) {
+          name = frameNames.add(
+              frame, names.class_descriptors[n], names.method_names[n]);
+        } else {
+          frameNames.add(frame, nullptr, nullptr);
+        }
+        if (name != nullptr) {
+          logFrameName(frame, *name, tid, slot.time);
         }
       }
     }
+  });
+}
 
-    uint32_t expected = slotStateCombo;
-    // Release the slot
-    if (!slot.state.compare_exchange_strong(expected, StackSlotState::FREE)) {
-      // Slot was re-used in the middle of the processing by another thread.
-      // Aborting.
-      abort();
-    }
-    processedCount++;
-  }
+void SamplingProfiler::logFrameName(
+    int64_t frame,
+    std::string const& name,
+    int32_t tid,
+    int64_t time) {
+  StandardEntry entry{};
+  entry.tid = tid;
+  entry.timestamp = time;
+  entry.type = EntryType::JAVA_FRAME_NAME;
+  entry.extra = frame;
+  int32_t id = Logger::get().write(std::move(entry));
+
+  Logger::get().writeBytes(
+      EntryType::STRING_VALUE,
+      id,
+      (const uint8_t*)name.c_str(),
+      name.length());
 }
 
-void logProfilingErrAnnotation(int32_t key, uint16_t value) {
+void logProfilingAnnotation(int32_t key, int64_t value) {
   if (value == 0) {
     return;
   }
@@ -524,10 +478,9 @@ bool SamplingProfiler::initialize(
   state_.tracersMap = std::move(tracers);
   state_.timerManager.reset();
 
-  // Init semaphore for stacks flush to the Ring Buffer
-  int res = sem_init(&state_.slotsCounterSem, 0, 0);
-  if (res != 0) {
-    FBLOGV("Can not init slotsCounterSem semaphore: %s", strerror(errno));
+  // Init the logger's wake-up and sampling timer descriptors
+  if (!state_.scheduler.init()) {
+    FBLOGV("Can not init logger scheduler: %s", strerror(errno));
     errno = 0;
     return false;
   }
@@ -535,57 +488,153 @@ bool SamplingProfiler::initialize(
   return true;
 }
 
+int64_t threadCpuTimeUs() {
+  struct timespec ts {};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return ts.tv_sec * kMicrosecondsInSecond +
+      ts.tv_nsec / kNanosecondsInMicrosecond;
+}
+
+/**
+ * Sends SIGPROF to the whitelisted threads, in sleep-based wall-clock mode.
+ * Threads that no longer exist are removed from the whitelist.
+ */
+void SamplingProfiler::signalTargetThreads() {
+  std::vector<int32_t> tids;
+  {
+    std::unique_lock<std::mutex> lock(state_.whitelist->whitelistedThreadsMtx);
+    tids.assign(
+        state_.whitelist->whitelistedThreads.begin(),
+        state_.whitelist->whitelistedThreads.end());
+  }
+
+  std::vector<int32_t> exited;
+  for (int32_t tid : tids) {
+    int res = syscall(__NR_tgkill, state_.processId, tid, SIGPROF);
+    if (res != 0 && errno == ESRCH) {
+      exited.push_back(tid);
+    }
+  }
+  errno = 0;
+
+  if (!exited.empty()) {
+    std::unique_lock<std::mutex> lock(state_.whitelist->whitelistedThreadsMtx);
+    for (int32_t tid : exited) {
+      state_.whitelist->whitelistedThreads.erase(tid);
+    }
+  }
+}
+
 /**
  * Called via JNI from CPUProfiler
  *
  * Must only be called if SamplingProfiler::startProfiling() returns true.
  *
- * Waits in a loop for semaphore wakeup and then flushes the current profiling
- * stacks.
+ * Waits for the scheduler to wake it up and then samples the whitelisted
+ * threads, flushes the current profiling stacks, or both. Flushes whatever is
+ * left once profiling stops.
  */
 void SamplingProfiler::loggerLoop() {
   FBLOGV("Logger thread %d is going into the loop...", threadID());
 
   // If we are targeting a subset of all the threads, then the setitimer logic
-  // is not used; instead, we make this thread sleep the right amount of time
-  // and, when it wakes up, we send a tgkill(SIGPROF) to the interested threads
+  // is not used; instead, the scheduler wakes this thread up at every
+  // sampling deadline and we send a tgkill(SIGPROF) to the interested threads
+
+  auto& scheduler = state_.scheduler;
+  auto& rateController = state_.rateController;
+  int64_t cpuTimeStartUs = threadCpuTimeUs();
+  int iterations = 0;
 
-  int res = 0;
-  std::unordered_set<uint64_t> loggedFramesSet{};
+  int64_t windowStartNs = monotonicTime();
+  uint16_t windowSlotMisses = state_.errSlotMisses.load();
+  size_t windowMaxOccupancy = 0;
 
+  auto& frameNames = state_.frameNames;
+  bool dumpingFrameNames = false;
+
+  uint32_t events;
   do {
-    if (state_.useSleepBasedWallProfiler) {
-      // sleep-based-wall-profiling mode
-      usleep(state_.samplingRateMs * kMicrosecondsInMillisecond);
-      std::unique_lock<std::mutex> lock(
-          state_.whitelist->whitelistedThreadsMtx);
-      for (int32_t tid : state_.whitelist->whitelistedThreads) {
-        res = syscall(__NR_tgkill, state_.processId, tid, SIGPROF);
-        if (res != 0 && errno == ESRCH) {
-          // If the thread id is bad or no longer exists, remove it from our
-          // whitelist.
-          state_.whitelist->whitelistedThreads.erase(tid);
-        }
-        if (res == 0 && state_.enoughStacks.load()) {
-          flushStackTraces(loggedFramesSet);
-          state_.enoughStacks.store(false);
-        }
+    events = scheduler.wait();
+    if (state_.dumpFrameNames.exchange(false)) {
+      // A trace started and only has the names logged from now on. Samples
+      // don't name known frames, so log all of them again.
+      frameNames.startGeneration();
+      dumpingFrameNames = true;
+    }
+    if (dumpingFrameNames) {
+      // A few at a time, so that a small buffer doesn't wrap over the start
+      // of the trace before the writer gets to it. Wake up again for the
+      // rest.
+      int32_t tid = threadID();
+      int64_t now = monotonicTime();
+      dumpingFrameNames = !frameNames.forEachStale(
+          [&](int64_t frame, std::string const& name) {
+            logFrameName(frame, name, tid, now);
+          },
+          kFrameNamesPerIteration);
+      if (dumpingFrameNames) {
+        scheduler.flush();
       }
-    } else {
-      // setitimer and thread-specific timers
-      res = sem_wait(&state_.slotsCounterSem);
-      if (res == 0) {
-        flushStackTraces(loggedFramesSet);
+    }
+    if (events & LoggerScheduler::SAMPLE) {
+      signalTargetThreads();
+    }
+    if (events & (LoggerScheduler::FLUSH | LoggerScheduler::STOP)) {
+      size_t occupancy = state_.stacks.maxOccupancy();
+      windowMaxOccupancy = std::max(windowMaxOccupancy, occupancy);
+      scheduler.onFlush(occupancy, state_.stacks.slotsPerRing());
+      flushStackTraces();
+    }
+    int64_t now = monotonicTime();
+    if (rateController.enabled() && !(events & LoggerScheduler::STOP) &&
+        now - windowStartNs >= kSamplingWindowNs) {
+      uint16_t slotMisses = state_.errSlotMisses.load();
+      SamplingWindow window{
+          state_.handlerSamples.exchange(0),
+          state_.handlerTimeNs.exchange(0),
+          static_cast<uint16_t>(slotMisses - windowSlotMisses),
+          windowMaxOccupancy,
+          state_.stacks.slotsPerRing(),
+      };
+      if (rateController.update(window)) {
+        setSamplingRate(rateController.intervalMs());
       }
+      windowStartNs = now;
+      windowSlotMisses = slotMisses;
+      windowMaxOccupancy = 0;
+    }
+    if (++iterations % kReleaseRingsInterval == 0) {
+      // Let new threads reuse the rings of the ones that exited.
+      state_.stacks.releaseExitedThreads(state_.processId);
     }
-  } while (!state_.isLoggerLoopDone && (res == 0 || errno == EINTR));
+  } while (!(events & LoggerScheduler::STOP));
+
+  auto stats = scheduler.stats();
+  if (stats.ticks > 0) {
+    logProfilingAnnotation(
+        QuickLogConstants::PROF_SAMPLING_JITTER_AVG_US,
+        stats.jitter_total_ns / stats.ticks / kNanosecondsInMicrosecond);
+    logProfilingAnnotation(
+        QuickLogConstants::PROF_SAMPLING_JITTER_MAX_US,
+        stats.jitter_max_ns / kNanosecondsInMicrosecond);
+    logProfilingAnnotation(
+        QuickLogConstants::PROF_SAMPLING_MISSED_TICKS, stats.missed_ticks);
+  }
+  logProfilingAnnotation(
+      QuickLogConstants::PROF_LOGGER_CPU_TIME_US,
+      threadCpuTimeUs() - cpuTimeStartUs);
   FBLOGV("Logger thread is shutting down...");
 }
 
 bool SamplingProfiler::startProfilingTimers() {
   FBLOGI("Starting profiling timers w/sample rate %d", state_.samplingRateMs);
   if (!state_.useThreadSpecificProfiler) {
-    return startSetitimer(state_.samplingRateMs); // use global CPU timer
+    if (!startSetitimer(state_.samplingRateMs)) { // use global CPU timer
+      return false;
+    }
   } else { // thread-specific timers
     state_.timerManager.reset(new TimerManager(
         state_.threadDetectIntervalMs,
@@ -594,10 +643,14 @@ bool SamplingProfiler::startProfilingTimers() {
         state_.wallClockModeEnabled ? state_.whitelist : nullptr));
     state_.timerManager->start();
   }
+  std::unique_lock<std::mutex> lock(state_.timersMtx);
+  state_.timersRunning = true;
   return true;
 }
 
 bool SamplingProfiler::stopProfilingTimers() {
+  std::unique_lock<std::mutex> lock(state_.timersMtx);
+  state_.timersRunning = false;
   if (!state_.useThreadSpecificProfiler) {
     return stopSetitimer(); // use global CPU timer
   } else { // thread-specific timers
@@ -607,18 +660,59 @@ bool SamplingProfiler::stopProfilingTimers() {
   return true;
 }
 
+/**
+ * Called by the logger loop when the rate controller picks a new interval.
+ * Logs the new interval so that samples can be weighted by it.
+ */
+void SamplingProfiler::setSamplingRate(int sampling_rate_ms) {
+  FBLOGV("Changing sample rate to %d", sampling_rate_ms);
+  if (state_.useSleepBasedWallProfiler) {
+    // Only the logger thread touches the sampling timer in this mode
+    if (!state_.scheduler.startSampling(sampling_rate_ms)) {
+      FBLOGV("Can not change the sampling timer: %s", strerror(errno));
+      errno = 0;
+      return;
+    }
+  } else {
+    std::unique_lock<std::mutex> lock(state_.timersMtx);
+    if (!state_.timersRunning) {
+      return;
+    }
+    if (!state_.useThreadSpecificProfiler) {
+      if (!startSetitimer(sampling_rate_ms)) {
+        return;
+      }
+    } else {
+      state_.timerManager->setSamplingRate(sampling_rate_ms);
+    }
+  }
+  state_.samplingRateMs = sampling_rate_ms;
+  Logger::get().writeTraceAnnotation(
+      QuickLogConstants::CPU_SAMPLING_INTERVAL_MS, sampling_rate_ms);
+}
+
 bool SamplingProfiler::startProfiling(
     int requested_tracers,
     int sampling_rate_ms,
     bool use_thread_specific_profiler,
     int thread_detect_interval_ms,
-    bool wall_clock_mode_enabled) {
+    bool wall_clock_mode_enabled,
+    int stack_slot_rings,
+    int stack_slots_per_ring,
+    int min_sampling_rate_ms,
+    int max_sampling_rate_ms) {
   if (state_.isProfiling) {
     throw std::logic_error("startProfiling called while already profiling");
   }
   state_.isProfiling = true;
   FBLOGV("Start profiling");
 
+  // No handler can touch the slots until the handlers are registered.
+  state_.stacks.reset(
+      stack_slot_rings > 0 ? stack_slot_rings : DEFAULT_STACK_SLOT_RINGS,
+      stack_slots_per_ring > 0 ? stack_slots_per_ring
+                               : DEFAULT_STACK_SLOTS_PER_RING);
+
   registerSignalHandlers();
 
   state_.profileStartTime = monotonicTime();
@@ -640,8 +734,13 @@ bool SamplingProfiler::startProfiling(
   state_.useThreadSpecificProfiler = use_thread_specific_profiler;
   state_.threadDetectIntervalMs = thread_detect_interval_ms;
 
-  state_.enoughStacks = false;
-  state_.isLoggerLoopDone = false;
+  state_.handlerSamples = 0;
+  state_.handlerTimeNs = 0;
+  state_.rateController.reset(
+      sampling_rate_ms, min_sampling_rate_ms, max_sampling_rate_ms);
+  // Samples are counted across rings, so flushing at half a ring keeps a
+  // single busy thread from filling its own.
+  state_.scheduler.reset(FLUSH_STACKS_COUNT, state_.stacks.slotsPerRing() / 2);
 
   for (const auto& tracerEntry : state_.tracersMap) {
     if (tracerEntry.first & state_.currentTracers) {
@@ -651,6 +750,11 @@ bool SamplingProfiler::startProfiling(
 
   if (state_.useSleepBasedWallProfiler) {
     // sleep-based wall-clock profiling is handled by the logger thread
+    if (!state_.scheduler.startSampling(sampling_rate_ms)) {
+      FBLOGV("Can not start the sampling timer: %s", strerror(errno));
+      errno = 0;
+      return false;
+    }
     return true;
   }
   return startProfilingTimers();
@@ -670,26 +774,17 @@ void SamplingProfiler::stopProfiling() {
 
   FBLOGV("Stopping profiling");
 
-  if (state_.useSleepBasedWallProfiler) {
-    state_.isLoggerLoopDone.store(true);
-  } else {
-    if (!stopProfilingTimers()) {
-      abort();
-    }
-    state_.isLoggerLoopDone.store(true);
-    int res = sem_post(&state_.slotsCounterSem);
-    if (res != 0) {
-      FBLOGV("Can not execute sem_post for logger thread");
-      errno = 0;
-    }
+  if (!state_.useSleepBasedWallProfiler && !stopProfilingTimers()) {
+    abort();
   }
+  state_.scheduler.stop();
 
   // Logging errors
-  logProfilingErrAnnotation(
+  logProfilingAnnotation(
       QuickLogConstants::PROF_ERR_SIG_CRASHES, state_.errSigCrashes);
-  logProfilingErrAnnotation(
+  logProfilingAnnotation(
       QuickLogConstants::PROF_ERR_SLOT_MISSES, state_.errSlotMisses);
-  logProfilingErrAnnotation(
+  logProfilingAnnotation(
       QuickLogConstants::PROF_ERR_STACK_OVERFLOWS, state_.errStackOverflows);
 
   FBLOGV(
@@ -698,7 +793,6 @@ void SamplingProfiler::stopProfiling() {
       state_.errSigCrashes.load(),
       state_.errSlotMisses.load());
 
-  state_.currentSlot = 0;
   state_.errSigCrashes = 0;
   state_.errSlotMisses = 0;
   state_.errStackOverflows = 0;
@@ -725,9 +819,10 @@ void SamplingProfiler::removeFromWhitelist(int targetThread) {
   state_.whitelist->whitelistedThreads.erase(targetThread);
 }
 
-void SamplingProfiler::resetFrameworkNamesSet() {
-  // Let the logger loop know we should reset our cache of frames
-  state_.resetFrameworkSymbols.store(true);
+void SamplingProfiler::onTraceStarted() {
+  // Let the logger loop know the new trace needs the names of known frames
+  state_.dumpFrameNames.store(true);
+  state_.scheduler.flush();
 }
 
 std::unordered_map<int32_t, std::shared_ptr<BaseTracer>>
@@ -18,7 +18,6 @@
 
 #include "TimerManager.h"
 
-#include <semaphore.h>
 #include <setjmp.h>
 #include <sigmux.h>
 #include <mutex>
@@ -33,6 +32,10 @@
 #include <fbjni/fbjni.h>
 #include <profiler/BaseTracer.h>
 #include <profiler/Constants.h>
+#include <profiler/FrameNameCache.h>
+#include <profiler/LoggerScheduler.h>
+#include <profiler/SamplingRateController.h>
+#include <profiler/StackSlotPool.h>
 #include <profilo/ExternalApiGlue.h>
 
 namespace fbjni = facebook::jni;
@@ -41,39 +44,6 @@ namespace facebook {
 namespace profilo {
 namespace profiler {
 
-enum StackSlotState {
-  FREE = StackCollectionRetcode::MAXVAL + 1,
-  BUSY,
-  BUSY_WITH_METADATA,
-};
-
-//
-// Slots are preallocated storage for the sampling profiler. They
-// are necessary because unwinding happens in a signal context and thus
-// allocation via the traditional APIs is not possible.
-//
-// The slot state encodes the tid in the high 16 bits and the
-// state (StackSlotState) in the lower 16 bits.
-//
-// Each slot goes through a lifecycle:
-//   FREE -> BUSY -> BUSY_WITH_METADATA -> {StackCollectionRetcode}
-//
-struct StackSlot {
-  std::atomic<uint32_t> state;
-  uint8_t depth;
-  int64_t time;
-  jmp_buf sig_jmp_buf;
-  uint32_t profilerType;
-  int64_t frames[MAX_STACK_DEPTH]; // frame pointer addresses
-  char const* method_names[MAX_STACK_DEPTH];
-  char const* class_descriptors[MAX_STACK_DEPTH];
-#ifdef PROFILER_COLLECT_PC
-  u2 pcs[MAX_STACK_DEPTH];
-#endif
-
-  StackSlot() : state(StackSlotState::FREE), depth(0) {}
-};
-
 struct Whitelist {
   std::unordered_set<int32_t> whitelistedThreads;
   std::mutex whitelistedThreadsMtx; // Guards whitelistedThreads
@@ -88,19 +58,19 @@ struct ProfileState {
   std::atomic_bool isProfiling{};
 
   // Slots/Stacks
-  StackSlot stacks[MAX_STACKS_COUNT];
-  std::atomic<uint32_t> currentSlot;
-  std::atomic<uint32_t> fullSlotsCounter;
+  StackSlotPool stacks;
 
   // Error stats
   std::atomic<uint16_t> errSigCrashes;
   std::atomic<uint16_t> errSlotMisses;
   std::atomic<uint16_t> errStackOverflows;
 
+  // Handler cost, for adapting the sampling rate
+  std::atomic<uint64_t> handlerSamples;
+  std::atomic<int64_t> handlerTimeNs;
+
   // Logger
-  sem_t slotsCounterSem;
-  std::atomic_bool enoughStacks;
-  std::atomic_bool isLoggerLoopDone;
+  LoggerScheduler scheduler;
 
   // Config parameters
   bool wallClockModeEnabled;
@@ -114,10 +84,19 @@ struct ProfileState {
   std::shared_ptr<Whitelist> whitelist;
 
   std::unique_ptr<TimerManager> timerManager;
-
-  // If a secondary trace starts, we need to tell the logger loop to clear
-  // its cache of logged frames, so that the new trace won't miss any symbols
-  std::atomic_bool resetFrameworkSymbols;
+  // Guards changing the sampling rate of running timers against stopping
+  // them.
+  std::mutex timersMtx;
+  bool timersRunning;
+  SamplingRateController rateController;
+
+  // If a trace starts, we need to tell the logger loop to log the frame
+  // names it knows again, so that the new trace won't miss any symbols
+  std::atomic_bool dumpFrameNames;
+
+  // The frames the logger loop has logged names for, or decided it doesn't
+  // need to, across traces. Signal handlers don't look up names for these.
+  FrameNameCache frameNames{KNOWN_FRAMES_CAPACITY, MAX_OVERFLOW_FRAMES};
 };
 
 /**
@@ -145,13 +124,17 @@ class SamplingProfiler {
       int sampling_rate_ms,
       bool use_thread_specific_profiler,
       int thread_detect_interval_ms,
-      bool wall_clock_mode_enabled);
+      bool wall_clock_mode_enabled,
+      int stack_slot_rings = DEFAULT_STACK_SLOT_RINGS,
+      int stack_slots_per_ring = DEFAULT_STACK_SLOTS_PER_RING,
+      int min_sampling_rate_ms = 0,
+      int max_sampling_rate_ms = 0);
 
   void addToWhitelist(int targetThread);
 
   void removeFromWhitelist(int targetThread);
 
-  void resetFrameworkNamesSet();
+  void onTraceStarted();
 
   static std::unordered_map<int32_t, std::shared_ptr<BaseTracer>>
   ComputeAvailableTracers(uint32_t available_tracers);
@@ -166,13 +149,19 @@ class SamplingProfiler {
   // Profiling timer management
   bool startProfilingTimers();
   bool stopProfilingTimers();
+  void setSamplingRate(int sampling_rate_ms);
 
   void registerSignalHandlers();
   void unregisterSignalHandlers();
 
   // Logger
-  void maybeSignalReader();
-  void flushStackTraces(std::unordered_set<uint64_t>& loggedFramesSet);
+  void signalTargetThreads();
+  void flushStackTraces();
+  void logFrameName(
+      int64_t frame,
+      std::string const& name,
+      int32_t tid,
+      int64_t time);
 
   static sigmux_action FaultHandler(sigmux_siginfo*, void*);
   static sigmux_action UnwindStackHandler(sigmux_siginfo*, void*);
@@ -0,0 +1,92 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SamplingRateController.h"
+
+#include <algorithm>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+constexpr double kNanosecondsInMillisecond = 1000 * 1000;
+} // namespace
+
+constexpr double SamplingRateController::kMaxOverhead;
+constexpr int SamplingRateController::kCalmWindows;
+
+SamplingRateController::SamplingRateController()
+    : interval_ms_(0),
+      min_interval_ms_(0),
+      max_interval_ms_(0),
+      calm_windows_(0) {}
+
+void SamplingRateController::reset(
+    int interval_ms,
+    int min_interval_ms,
+    int max_interval_ms) {
+  calm_windows_ = 0;
+  if (min_interval_ms <= 0 || max_interval_ms <= min_interval_ms) {
+    interval_ms_ = interval_ms;
+    min_interval_ms_ = max_interval_ms_ = interval_ms;
+    return;
+  }
+  min_interval_ms_ = min_interval_ms;
+  max_interval_ms_ = max_interval_ms;
+  interval_ms_ =
+      std::min(std::max(interval_ms, min_interval_ms), max_interval_ms);
+}
+
+bool SamplingRateController::update(const SamplingWindow& window) {
+  if (!enabled()) {
+    return false;
+  }
+
+  double overhead = 0;
+  if (window.samples > 0) {
+    double cost_ms =
+        window.handler_time_ns / kNanosecondsInMillisecond / window.samples;
+    overhead = cost_ms / interval_ms_;
+  }
+  bool backlogged = window.max_occupancy * 2 > window.ring_size;
+  bool calm = window.max_occupancy * 4 <= window.ring_size &&
+      overhead < kMaxOverhead / 4;
+
+  int interval_ms = interval_ms_;
+  if (window.slot_misses > 0 || backlogged || overhead > kMaxOverhead) {
+    calm_windows_ = 0;
+    interval_ms = std::min(
+        std::max(interval_ms_ + interval_ms_ / 2, interval_ms_ + 1),
+        max_interval_ms_);
+  } else if (calm && ++calm_windows_ >= kCalmWindows) {
+    calm_windows_ = 0;
+    interval_ms = std::max(
+        std::min(interval_ms_ - interval_ms_ / 4, interval_ms_ - 1),
+        min_interval_ms_);
+  } else if (!calm) {
+    calm_windows_ = 0;
+  }
+
+  bool changed = interval_ms != interval_ms_;
+  interval_ms_ = interval_ms;
+  return changed;
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
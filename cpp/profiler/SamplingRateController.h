@@ -0,0 +1,89 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+//
+// What the sampling profiler observed over one adaptation window.
+//
+struct SamplingWindow {
+  // Samples committed by the signal handlers.
+  uint64_t samples;
+  // Time the handlers spent on them, from acquiring a slot to committing it.
+  int64_t handler_time_ns;
+  // Samples dropped because a slot ring was full.
+  uint64_t slot_misses;
+  // The most slots waiting in one ring at any flush, out of ring_size.
+  size_t max_occupancy;
+  size_t ring_size;
+};
+
+//
+// Picks the sampling interval for the next window, between a minimum and a
+// maximum, from what the previous window cost.
+//
+// The interval backs off by half when samples were missed, when a ring got
+// more than half full before the logger drained it, or when the handlers
+// took more than kMaxOverhead of the interval on average. It only shrinks,
+// by a quarter, after kCalmWindows windows in a row without any of that and
+// with the handlers well under budget. Idle windows count as calm, so short
+// interactions after a quiet period get sampled closely.
+//
+class SamplingRateController {
+ public:
+  // Largest fraction of the interval the handlers may take per sample.
+  static constexpr double kMaxOverhead = 0.05;
+  static constexpr int kCalmWindows = 2;
+
+  SamplingRateController();
+
+  //
+  // Starts at interval_ms, clamped to [min_interval_ms, max_interval_ms].
+  // Adapts nothing unless max_interval_ms > min_interval_ms > 0.
+  //
+  void reset(int interval_ms, int min_interval_ms, int max_interval_ms);
+
+  //
+  // Returns true if the interval changed.
+  //
+  bool update(const SamplingWindow& window);
+
+  bool enabled() const {
+    return max_interval_ms_ > min_interval_ms_;
+  }
+
+  int intervalMs() const {
+    return interval_ms_;
+  }
+
+ private:
+  int interval_ms_;
+  int min_interval_ms_;
+  int max_interval_ms_;
+  int calm_windows_;
+};
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
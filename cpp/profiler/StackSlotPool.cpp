@@ -0,0 +1,258 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StackSlotPool.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <util/common.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+uint32_t roundUpToPowerOfTwo(size_t value) {
+  uint32_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace
+
+StackSlotPool::StackSlotPool()
+    : rings_(),
+      slots_(),
+      names_(),
+      homes_(),
+      borrowed_(),
+      ring_count_(0),
+      ring_mask_(0) {}
+
+void StackSlotPool::reset(size_t rings, size_t slots_per_ring) {
+  uint32_t ring_size = roundUpToPowerOfTwo(slots_per_ring);
+  if (rings != ring_count_ || ring_size != ring_mask_ + 1) {
+    rings_.reset(rings > 0 ? new Ring[rings] : nullptr);
+    slots_.reset(rings > 0 ? new StackSlot[rings * ring_size] : nullptr);
+    names_.reset(rings > 0 ? new SlotNames[rings * ring_size] : nullptr);
+    homes_.reset(rings > 0 ? new uint32_t[rings * ring_size] : nullptr);
+    borrowed_.reset(
+        rings > 0 ? new std::atomic<uint32_t>[rings * rings] : nullptr);
+    ring_count_ = rings;
+    ring_mask_ = ring_size - 1;
+  }
+
+  for (size_t idx = 0; idx < ring_count_; ++idx) {
+    rings_[idx].owner.store(0);
+    rings_[idx].head.store(0);
+    rings_[idx].tail.store(0);
+  }
+  for (size_t idx = 0; idx < ring_count_ * ring_count_; ++idx) {
+    borrowed_[idx].store(0);
+  }
+  for (size_t idx = 0; idx < ring_count_ * ring_size; ++idx) {
+    auto& slot = slots_[idx];
+    auto& names = names_[idx];
+    slot.state.store(StackSlotState::FREE);
+    slot.names = FrameNames{
+        nullptr,
+        MAX_NAMED_FRAMES,
+        0,
+        names.depths,
+        names.method_names,
+        names.class_descriptors,
+    };
+  }
+}
+
+StackSlotPool::Ring* StackSlotPool::claimRing(uint32_t tid) {
+  if (ring_count_ == 0) {
+    return nullptr;
+  }
+  size_t home = tid % ring_count_;
+  for (size_t probe = 0; probe < ring_count_; ++probe) {
+    auto& ring = rings_[(home + probe) % ring_count_];
+    uint32_t owner = ring.owner.load(std::memory_order_relaxed);
+    if (owner == tid) {
+      return &ring;
+    }
+    if (owner == 0 && ring.owner.compare_exchange_strong(owner, tid)) {
+      return &ring;
+    }
+    if (owner == tid) {
+      // Lost the race to a handler interrupting us on this thread.
+      return &ring;
+    }
+  }
+  return &rings_[home];
+}
+
+StackSlotPool::Ring* StackSlotPool::findRing(uint32_t tid) {
+  if (ring_count_ == 0) {
+    return nullptr;
+  }
+  size_t home = tid % ring_count_;
+  for (size_t probe = 0; probe < ring_count_; ++probe) {
+    auto& ring = rings_[(home + probe) % ring_count_];
+    if (ring.owner.load(std::memory_order_relaxed) == tid) {
+      return &ring;
+    }
+  }
+  return &rings_[home];
+}
+
+StackSlot* StackSlotPool::acquire(uint32_t tid) {
+  Ring* ring = claimRing(tid);
+  if (ring == nullptr) {
+    return nullptr;
+  }
+
+  //
+  // A full ring is usually one shared with a thread that got preempted in
+  // its handler, whose slot holds up the drain of the ring. Borrow a slot
+  // from the next rings rather than miss the sample.
+  //
+  size_t home = ring - rings_.get();
+  auto slot = acquireFrom(home, home, tid);
+  for (size_t probe = 1; slot == nullptr && probe < ring_count_; ++probe) {
+    size_t lender = (home + probe) % ring_count_;
+    // Counted before the slot is taken, so that findInnermost() never
+    // misses it.
+    auto& borrowed = borrowed_[home * ring_count_ + lender];
+    borrowed.fetch_add(1);
+    slot = acquireFrom(lender, home, tid);
+    if (slot == nullptr) {
+      borrowed.fetch_sub(1);
+    }
+  }
+  return slot;
+}
+
+StackSlot* StackSlotPool::acquireFrom(size_t idx, size_t home, uint32_t tid) {
+  auto& ring = rings_[idx];
+  uint32_t head = ring.head.load(std::memory_order_relaxed);
+  do {
+    uint32_t tail = ring.tail.load(std::memory_order_acquire);
+    if (head - tail > ring_mask_) {
+      return nullptr;
+    }
+  } while (!ring.head.compare_exchange_weak(head, head + 1));
+
+  homes_[slotIndex(idx, head)] = home;
+  auto& slot = slotAt(idx, head);
+  slot.state.store((tid << 16) | StackSlotState::BUSY);
+  slot.time = monotonicTime();
+  memset(&slot.sig_jmp_buf, 0, sizeof(slot.sig_jmp_buf));
+  slot.state.store((tid << 16) | StackSlotState::BUSY_WITH_METADATA);
+  return &slot;
+}
+
+StackSlot* StackSlotPool::findInRing(Ring& ring, uint32_t busyState) {
+  size_t idx = &ring - rings_.get();
+  uint32_t tail = ring.tail.load(std::memory_order_acquire);
+  uint32_t head = ring.head.load(std::memory_order_acquire);
+  // Walk backwards, later slots belong to the inner handlers.
+  while (head != tail) {
+    --head;
+    auto& slot = slotAt(idx, head);
+    if (slot.state.load() == busyState) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+StackSlot* StackSlotPool::findInnermost(uint32_t tid) {
+  Ring* ring = findRing(tid);
+  if (ring == nullptr) {
+    return nullptr;
+  }
+
+  uint32_t busyState = (tid << 16) | StackSlotState::BUSY_WITH_METADATA;
+  StackSlot* slot = findInRing(*ring, busyState);
+
+  //
+  // The thread may also hold slots it borrowed from other rings while its
+  // own was full. Only rings that lent slots to this one can have them,
+  // and the most recent matching slot among them is the innermost.
+  //
+  size_t home = ring - rings_.get();
+  for (size_t lender = 0; lender < ring_count_; ++lender) {
+    if (lender == home || borrowed_[home * ring_count_ + lender].load() == 0) {
+      continue;
+    }
+    auto candidate = findInRing(rings_[lender], busyState);
+    if (candidate != nullptr &&
+        (slot == nullptr || candidate->time > slot->time)) {
+      slot = candidate;
+    }
+  }
+  return slot;
+}
+
+size_t StackSlotPool::releaseExitedThreads(pid_t pid) {
+  size_t released = 0;
+  for (size_t idx = 0; idx < ring_count_; ++idx) {
+    auto& ring = rings_[idx];
+    uint32_t owner = ring.owner.load();
+    if (owner == 0 || ring.tail.load() != ring.head.load()) {
+      continue;
+    }
+    if (syscall(__NR_tgkill, pid, owner, 0) == 0 || errno != ESRCH) {
+      continue;
+    }
+    errno = 0;
+    //
+    // A new thread reusing the tid may have started acquiring from the ring
+    // in the meantime. That only makes it share the ring with whoever claims
+    // it next, which rings support.
+    //
+    if (ring.owner.compare_exchange_strong(owner, 0)) {
+      ++released;
+    }
+  }
+  return released;
+}
+
+size_t StackSlotPool::maxOccupancy() const {
+  size_t result = 0;
+  for (size_t idx = 0; idx < ring_count_; ++idx) {
+    auto& ring = rings_[idx];
+    uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    result = std::max<size_t>(result, head - tail);
+  }
+  return result;
+}
+
+StackSlot const* StackSlotPool::threadSlots(uint32_t tid) {
+  Ring* ring = findRing(tid);
+  if (ring == nullptr) {
+    return nullptr;
+  }
+  return &slots_[(ring - rings_.get()) * (ring_mask_ + 1)];
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,241 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <setjmp.h>
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <profiler/BaseTracer.h>
+#include <profiler/Constants.h>
+#include <profiler/JavaBaseTracer.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+enum StackSlotState {
+  FREE = StackCollectionRetcode::MAXVAL + 1,
+  BUSY,
+  BUSY_WITH_METADATA,
+  // Given back without a stack, e.g. when the tracer is disabled. Drained
+  // like the other final states but never handed to the logger.
+  DISCARDED,
+};
+
+//
+// Slots are preallocated storage for the sampling profiler. They
+// are necessary because unwinding happens in a signal context and thus
+// allocation via the traditional APIs is not possible.
+//
+// The slot state encodes the tid in the high 16 bits and the
+// state (StackSlotState) in the lower 16 bits.
+//
+// Each slot goes through a lifecycle:
+//   FREE -> BUSY -> BUSY_WITH_METADATA -> {StackCollectionRetcode, DISCARDED}
+//
+// The fields every sample touches come first. Frame names are only needed
+// for frames the logger has not seen yet, so they live in a separate,
+// smaller array owned by the pool; `names` points into it.
+//
+struct StackSlot {
+  std::atomic<uint32_t> state;
+  uint8_t depth;
+  uint32_t profilerType;
+  int64_t time;
+  FrameNames names;
+  jmp_buf sig_jmp_buf;
+  int64_t frames[MAX_STACK_DEPTH]; // frame pointer addresses
+#ifdef PROFILER_COLLECT_PC
+  u2 pcs[MAX_STACK_DEPTH];
+#endif
+
+  StackSlot() : state(StackSlotState::FREE), depth(0), names() {}
+};
+
+//
+// Hands out StackSlots to signal handlers from per-thread rings.
+//
+// Every sampled thread claims a ring of its own the first time it acquires
+// a slot and keeps it until it exits, so acquiring a slot does not contend
+// with other threads and a fault only has to look at the slots of the
+// faulting thread. Slots are handed out in ring order and the logger drains
+// each ring in the same order, stopping at the first slot still being
+// filled in.
+//
+// When every ring is taken, a thread shares the ring its tid hashes to.
+// Rings accept concurrent producers, so sharing (and a handler interrupting
+// another one on the same thread) only costs ring capacity. A thread whose
+// ring is full borrows slots from other rings, so samples are only missed
+// once the whole pool is full. The pool counts the slots each ring lent to
+// threads of each other ring until they are drained, so a fault only looks
+// further than the thread's own ring when the thread may have borrowed.
+//
+// All storage is allocated by reset(). acquire() and findInnermost() only
+// touch atomics and are async-signal-safe.
+//
+class StackSlotPool {
+ public:
+  StackSlotPool();
+
+  //
+  // Reallocates the pool to hold `rings` rings of `slots_per_ring` slots
+  // each and marks every slot FREE. `slots_per_ring` is rounded up to a
+  // power of two. Must not race with any other method.
+  //
+  void reset(size_t rings, size_t slots_per_ring);
+
+  //
+  // Takes the next slot of the ring of `tid` and moves it to
+  // BUSY_WITH_METADATA, with the time set and the jump buffer cleared. If
+  // the ring is full, takes one from the next ring with room instead.
+  // Returns nullptr if every ring is full.
+  //
+  StackSlot* acquire(uint32_t tid);
+
+  //
+  // Returns the most recently acquired slot of `tid` that is still in
+  // BUSY_WITH_METADATA, or nullptr.
+  //
+  StackSlot* findInnermost(uint32_t tid);
+
+  //
+  // Drains the committed slots of every ring in acquisition order. Calls
+  // fn(slot, state) with the state the slot was committed with, unless it
+  // was DISCARDED, then frees the slot. Only one thread may drain at a time.
+  // Returns the number of slots drained.
+  //
+  template <typename Fn>
+  size_t drain(Fn&& fn);
+
+  //
+  // Gives back the rings of threads that no longer exist in process `pid`.
+  // Calls into the kernel once per owned ring, so only call it
+  // occasionally from the draining thread.
+  //
+  size_t releaseExitedThreads(pid_t pid);
+
+  //
+  // The number of slots acquired but not drained yet in the fullest ring.
+  //
+  size_t maxOccupancy() const;
+
+  size_t ringCount() const {
+    return ring_count_;
+  }
+
+  size_t slotsPerRing() const {
+    return ring_mask_ + 1;
+  }
+
+  //
+  // All slots, ring by ring. Only for inspection after profiling stopped.
+  //
+  StackSlot const* slots() const {
+    return slots_.get();
+  }
+
+  //
+  // The slots of the ring `tid` acquires from, or nullptr if the pool has
+  // no rings.
+  //
+  StackSlot const* threadSlots(uint32_t tid);
+
+ private:
+  struct Ring {
+    // tid of the owning thread, 0 if the ring is unclaimed.
+    std::atomic<uint32_t> owner;
+    // Sequence number of the next slot to hand out.
+    std::atomic<uint32_t> head;
+    // Sequence number of the next slot to drain.
+    std::atomic<uint32_t> tail;
+  };
+
+  // Backing storage for StackSlot::names.
+  struct SlotNames {
+    uint8_t depths[MAX_NAMED_FRAMES];
+    char const* method_names[MAX_NAMED_FRAMES];
+    char const* class_descriptors[MAX_NAMED_FRAMES];
+  };
+
+  std::unique_ptr<Ring[]> rings_;
+  std::unique_ptr<StackSlot[]> slots_;
+  std::unique_ptr<SlotNames[]> names_;
+  // For every slot, the ring of the thread that acquired it.
+  std::unique_ptr<uint32_t[]> homes_;
+  // Slots lent and not drained yet, at [home * ring_count_ + lender].
+  std::unique_ptr<std::atomic<uint32_t>[]> borrowed_;
+  size_t ring_count_;
+  uint32_t ring_mask_;
+
+  // Returns the ring of tid, claiming a free one if it has none yet.
+  Ring* claimRing(uint32_t tid);
+  // Returns the ring of tid without claiming one.
+  Ring* findRing(uint32_t tid);
+  StackSlot* acquireFrom(size_t ring, size_t home, uint32_t tid);
+  StackSlot* findInRing(Ring& ring, uint32_t busyState);
+
+  size_t slotIndex(size_t ring, uint32_t sequence) const {
+    return ring * (ring_mask_ + 1) + (sequence & ring_mask_);
+  }
+
+  StackSlot& slotAt(size_t ring, uint32_t sequence) {
+    return slots_[slotIndex(ring, sequence)];
+  }
+};
+
+template <typename Fn>
+size_t StackSlotPool::drain(Fn&& fn) {
+  size_t drained = 0;
+  for (size_t idx = 0; idx < ring_count_; ++idx) {
+    auto& ring = rings_[idx];
+    uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint32_t head = ring.head.load(std::memory_order_acquire);
+    while (tail != head) {
+      size_t slot_idx = slotIndex(idx, tail);
+      auto& slot = slots_[slot_idx];
+      uint32_t state = slot.state.load(std::memory_order_acquire);
+      uint32_t slotState = state & 0xffff;
+      if (slotState == StackSlotState::FREE ||
+          slotState == StackSlotState::BUSY ||
+          slotState == StackSlotState::BUSY_WITH_METADATA) {
+        // Still being filled in, later slots have to wait for it.
+        break;
+      }
+      if (slotState != StackSlotState::DISCARDED) {
+        fn(slot, state);
+      }
+      uint32_t home = homes_[slot_idx];
+      if (home != idx) {
+        borrowed_[home * ring_count_ + idx].fetch_sub(1);
+      }
+      slot.state.store(StackSlotState::FREE, std::memory_order_relaxed);
+      ++tail;
+      // Publishes the FREE state to the next acquire() of this slot.
+      ring.tail.store(tail, std::memory_order_release);
+      ++drained;
+    }
+  }
+  return drained;
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
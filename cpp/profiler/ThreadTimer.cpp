@@ -153,6 +153,14 @@ ThreadTimer::ThreadTimer(
   }
 }
 
+bool ThreadTimer::setSamplingRate(int samplingRateMs) {
+  if (!startThreadTimer(timerId_, samplingRateMs)) {
+    return false;
+  }
+  samplingRateMs_ = samplingRateMs;
+  return true;
+}
+
 ThreadTimer::~ThreadTimer() {
   if (timerId_ == INVALID_TIMER_ID) {
     // Expected when creating new ThreadTimer objects
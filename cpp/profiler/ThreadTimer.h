@@ -45,6 +45,12 @@ class ThreadTimer {
         wallClockModeEnabled_(other.wallClockModeEnabled_),
         timerId_(std::exchange(other.timerId_, INVALID_TIMER_ID)) {}
 
+  //
+  // Restarts the timer with a new interval. Returns false, with errno set,
+  // if the timer could not be changed, e.g. because the thread died.
+  //
+  bool setSamplingRate(int samplingRateMs);
+
  private:
   int32_t tid_;
   int samplingRateMs_;
@@ -114,6 +114,20 @@ void TimerManager::updateThreadTimers() {
   }
 }
 
+void TimerManager::updateSamplingRate() {
+  // Same threading rules as updateThreadTimers()
+  if (!state_.samplingRateChanged.exchange(false)) {
+    return;
+  }
+  int samplingRateMs = state_.samplingRateMs.load();
+  for (auto& entry : state_.threadTimers) {
+    if (!entry.second.setSamplingRate(samplingRateMs)) {
+      // thread may have ended, the next update will drop its timer
+      FBLOGV("ThreadTimer could not be updated for tid %d", entry.first);
+    }
+  }
+}
+
 // must be started after sampling is enabled
 void TimerManager::threadDetectLoop() {
   {
@@ -134,6 +148,10 @@ void TimerManager::threadDetectLoop() {
   do {
     res = sem_timedwait(&state_.threadDetectSem, &nextThreadDetectWakeup);
     done = state_.isThreadDetectLoopDone.load();
+    if (!done && res == 0) {
+      // woken up by setSamplingRate()
+      updateSamplingRate();
+    }
     if (!done && res == -1 && errno == ETIMEDOUT) {
       // timed out
       nextThreadDetectWakeup =
@@ -158,6 +176,7 @@ TimerManager::TimerManager(
     std::shared_ptr<Whitelist> whitelist) {
   state_.threadDetectIntervalMs = threadDetectIntervalMs;
   state_.samplingRateMs = samplingRateMs;
+  state_.samplingRateChanged = false;
   state_.wallClockModeEnabled = wallClockModeEnabled;
   state_.whitelist = whitelist;
 
@@ -174,6 +193,12 @@ void TimerManager::start() {
       std::thread(&TimerManager::threadDetectLoop, this);
 }
 
+void TimerManager::setSamplingRate(int samplingRateMs) {
+  state_.samplingRateMs.store(samplingRateMs);
+  state_.samplingRateChanged.store(true);
+  sem_post(&state_.threadDetectSem); // wake up
+}
+
 void TimerManager::stop() {
   state_.isThreadDetectLoopDone.store(true);
   sem_post(&state_.threadDetectSem); // wake up
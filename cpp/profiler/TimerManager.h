@@ -39,7 +39,9 @@ struct Whitelist;
 
 struct TimerManagerState {
   int threadDetectIntervalMs;
-  int samplingRateMs;
+  std::atomic<int> samplingRateMs;
+  // Set by setSamplingRate() until the thread detect loop applies the rate.
+  std::atomic_bool samplingRateChanged;
   bool wallClockModeEnabled;
 
   // whitelist is optional; use null for "all threads"
@@ -62,9 +64,16 @@ class TimerManager {
   void start(); // potentially blocks
   void stop(); // potentially blocks
 
+  //
+  // Moves every thread timer, and the ones started from now on, to a new
+  // interval. Applied asynchronously by the thread detect loop.
+  //
+  void setSamplingRate(int samplingRateMs);
+
  private:
   TimerManagerState state_;
   void updateThreadTimers();
+  void updateSamplingRate();
   void threadDetectLoop();
 };
 
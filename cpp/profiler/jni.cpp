@@ -60,17 +60,25 @@ static jboolean nativeStartProfiling(
     jint sampling_rate_ms,
     jboolean use_thread_specific_profiler,
     jint thread_detect_interval_ms,
-    jboolean wall_clock_mode) {
+    jboolean wall_clock_mode,
+    jint stack_slot_rings,
+    jint stack_slots_per_ring,
+    jint min_sampling_rate_ms,
+    jint max_sampling_rate_ms) {
   return SamplingProfiler::getInstance().startProfiling(
       requested_tracers,
       sampling_rate_ms,
       use_thread_specific_profiler,
       thread_detect_interval_ms,
-      wall_clock_mode);
+      wall_clock_mode,
+      stack_slot_rings,
+      stack_slots_per_ring,
+      min_sampling_rate_ms,
+      max_sampling_rate_ms);
 }
 
-static void nativeResetFrameworkNamesSet(fbjni::alias_ref<jobject>) {
-  return SamplingProfiler::getInstance().resetFrameworkNamesSet();
+static void nativeOnTraceStarted(fbjni::alias_ref<jobject>) {
+  return SamplingProfiler::getInstance().onTraceStarted();
 }
 
 static void nativeAddToWhitelist(fbjni::alias_ref<jobject>, jint tid) {
@@ -93,8 +101,7 @@ JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void*) {
             makeNativeMethod("nativeLoggerLoop", nativeLoggerLoop),
             makeNativeMethod("nativeStopProfiling", nativeStopProfiling),
             makeNativeMethod("nativeStartProfiling", nativeStartProfiling),
-            makeNativeMethod(
-                "nativeResetFrameworkNamesSet", nativeResetFrameworkNamesSet),
+            makeNativeMethod("nativeOnTraceStarted", nativeOnTraceStarted),
         });
     fbjni::registerNatives(
         StackFrameThreadType,
@@ -0,0 +1,242 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/BinaryTraceReader.h>
+#include <profilo/writer/BinaryTraceWriter.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Keeps a copy of everything it visits, with frames and bytes flattened
+// into std::vectors.
+//
+struct RecordingVisitor : public EntryVisitor {
+  struct Frames {
+    FramesEntry entry;
+    std::vector<int64_t> frames;
+  };
+  struct Bytes {
+    BytesEntry entry;
+    std::string bytes;
+  };
+
+  std::vector<StandardEntry> standard;
+  std::vector<Frames> frames;
+  std::vector<Bytes> bytes;
+  // 's', 'f' or 'b' per visited entry, in order.
+  std::string order;
+
+  void visit(const StandardEntry& entry) override {
+    standard.push_back(entry);
+    order += 's';
+  }
+
+  void visit(const FramesEntry& entry) override {
+    frames.push_back(Frames{
+        entry,
+        std::vector<int64_t>(
+            entry.frames.values, entry.frames.values + entry.frames.size)});
+    order += 'f';
+  }
+
+  void visit(const BytesEntry& entry) override {
+    bytes.push_back(Bytes{
+        entry,
+        std::string(
+            reinterpret_cast<const char*>(entry.bytes.values),
+            entry.bytes.size)});
+    order += 'b';
+  }
+};
+
+StandardEntry makeStandardEntry(int32_t id, int64_t timestamp) {
+  return StandardEntry{
+      .id = id,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = timestamp,
+      .tid = 100 + id % 3,
+      .callid = -id,
+      .matchid = id * 7,
+      .extra = static_cast<int64_t>(id) << 40,
+  };
+}
+
+std::vector<std::pair<std::string, std::string>> kHeaders = {
+    {"key1", "value1"},
+    {"key2", "value2"},
+};
+
+TEST(BinaryTraceFormat, testHeadersRoundTrip) {
+  std::stringstream stream;
+  BinaryTraceWriter writer(stream, "AAAAAAAAAAB", 6, kHeaders);
+  writer.finish();
+
+  BinaryTraceReader reader(stream);
+  EXPECT_EQ(reader.version(), kBinaryTraceFormatVersion);
+  std::vector<std::pair<std::string, std::string>> expected = {
+      {"id", "AAAAAAAAAAB"},
+      {"prec", "6"},
+      {"key1", "value1"},
+      {"key2", "value2"},
+  };
+  EXPECT_EQ(reader.headers(), expected);
+
+  RecordingVisitor visitor;
+  EXPECT_FALSE(reader.readBlock(visitor));
+  EXPECT_TRUE(visitor.order.empty());
+}
+
+TEST(BinaryTraceFormat, testEntriesRoundTrip) {
+  std::stringstream stream;
+  BinaryTraceWriter writer(stream, "AAAAAAAAAAB", 6, kHeaders);
+
+  int64_t frames[] = {0x7f0000001000, 0x7f0000000800, -1, 42};
+  const char* kName = "some_name";
+
+  writer.visit(makeStandardEntry(1, 1000));
+  writer.visit(FramesEntry{
+      .id = 2,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 1010,
+      .tid = 101,
+      .matchid = 3,
+      .frames = {.values = frames, .size = 4}});
+  for (int i = 0; i < 2; ++i) {
+    writer.visit(BytesEntry{
+        .id = 3 + i,
+        .type = EntryType::STRING_NAME,
+        .matchid = 2,
+        .bytes = {.values = reinterpret_cast<const uint8_t*>(kName),
+                  .size = static_cast<uint16_t>(std::strlen(kName))}});
+  }
+  writer.visit(makeStandardEntry(5, 900)); // Timestamps can go backwards.
+  writer.finish();
+
+  BinaryTraceReader reader(stream);
+  RecordingVisitor visitor;
+  reader.read(visitor);
+
+  EXPECT_EQ(visitor.order, "sfbbs");
+  ASSERT_EQ(visitor.standard.size(), 2);
+  for (auto& entry : visitor.standard) {
+    auto expected = makeStandardEntry(entry.id, entry.timestamp);
+    EXPECT_EQ(entry.type, expected.type);
+    EXPECT_EQ(entry.tid, expected.tid);
+    EXPECT_EQ(entry.callid, expected.callid);
+    EXPECT_EQ(entry.matchid, expected.matchid);
+    EXPECT_EQ(entry.extra, expected.extra);
+  }
+  EXPECT_EQ(visitor.standard[0].timestamp, 1000);
+  EXPECT_EQ(visitor.standard[1].timestamp, 900);
+
+  ASSERT_EQ(visitor.frames.size(), 1);
+  auto& stack = visitor.frames[0];
+  EXPECT_EQ(stack.entry.id, 2);
+  EXPECT_EQ(stack.entry.type, EntryType::STACK_FRAME);
+  EXPECT_EQ(stack.entry.timestamp, 1010);
+  EXPECT_EQ(stack.entry.tid, 101);
+  EXPECT_EQ(stack.entry.matchid, 3);
+  EXPECT_EQ(stack.frames, std::vector<int64_t>(frames, frames + 4));
+
+  ASSERT_EQ(visitor.bytes.size(), 2);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(visitor.bytes[i].entry.id, 3 + i);
+    EXPECT_EQ(visitor.bytes[i].entry.type, EntryType::STRING_NAME);
+    EXPECT_EQ(visitor.bytes[i].entry.matchid, 2);
+    EXPECT_EQ(visitor.bytes[i].bytes, kName);
+  }
+}
+
+TEST(BinaryTraceFormat, testManyBlocks) {
+  constexpr int kEntries = 3 * BinaryTraceWriter::kBlockRows + 5;
+  std::stringstream stream;
+  BinaryTraceWriter writer(stream, "AAAAAAAAAAB", 6, kHeaders);
+  for (int i = 0; i < kEntries; ++i) {
+    writer.visit(makeStandardEntry(i, 1000 + i * 13));
+  }
+  writer.finish();
+
+  BinaryTraceReader reader(stream);
+  RecordingVisitor visitor;
+  int blocks = 0;
+  while (reader.readBlock(visitor)) {
+    ++blocks;
+  }
+  EXPECT_EQ(blocks, 4);
+  ASSERT_EQ(visitor.standard.size(), kEntries);
+  for (int i = 0; i < kEntries; ++i) {
+    EXPECT_EQ(visitor.standard[i].id, i);
+    EXPECT_EQ(visitor.standard[i].timestamp, 1000 + i * 13);
+    EXPECT_EQ(visitor.standard[i].extra, static_cast<int64_t>(i) << 40);
+  }
+}
+
+TEST(BinaryTraceFormat, testRepeatedStringsAreStoredOnce) {
+  std::stringstream stream;
+  BinaryTraceWriter writer(stream, "AAAAAAAAAAB", 6, kHeaders);
+  std::string payload(1000, 'x');
+  for (int i = 0; i < 100; ++i) {
+    writer.visit(BytesEntry{
+        .id = i,
+        .type = EntryType::STRING_VALUE,
+        .matchid = i,
+        .bytes = {.values = reinterpret_cast<const uint8_t*>(payload.data()),
+                  .size = static_cast<uint16_t>(payload.size())}});
+  }
+  writer.finish();
+
+  EXPECT_LT(stream.str().size(), 2 * payload.size());
+
+  BinaryTraceReader reader(stream);
+  RecordingVisitor visitor;
+  reader.read(visitor);
+  ASSERT_EQ(visitor.bytes.size(), 100);
+  EXPECT_EQ(visitor.bytes.back().bytes, payload);
+}
+
+TEST(BinaryTraceFormat, testTruncatedTraceThrows) {
+  std::stringstream stream;
+  BinaryTraceWriter writer(stream, "AAAAAAAAAAB", 6, kHeaders);
+  for (int i = 0; i < 10; ++i) {
+    writer.visit(makeStandardEntry(i, i));
+  }
+  writer.finish();
+
+  auto data = stream.str();
+  std::stringstream truncated(data.substr(0, data.size() - 10));
+  BinaryTraceReader reader(truncated);
+  RecordingVisitor visitor;
+  EXPECT_THROW(reader.read(visitor), std::runtime_error);
+}
+
+TEST(BinaryTraceFormat, testTextTraceIsRejected) {
+  std::stringstream stream("dt\nver|3\n");
+  EXPECT_THROW(BinaryTraceReader reader(stream), std::runtime_error);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -303,6 +303,95 @@ TEST(EntryCodegen, testPackTooSmallThrows) {
   }
 }
 
+TEST(EntryCodegen, testPackUnpackCompactStandardEntry) {
+  StandardEntry input{.id = 10,
+                      .type = EntryType::TRACE_START,
+                      .timestamp = 123456789012345,
+                      .tid = 4321,
+                      .callid = -1,
+                      .matchid = 0,
+                      .extra = std::numeric_limits<int64_t>::min()};
+
+  auto size = StandardEntry::calculateCompactSize(input);
+  char buffer[sizeof(input) * 2]{};
+  StandardEntry::packCompact(input, buffer, sizeof(buffer));
+  EXPECT_EQ(
+      static_cast<int>(peek_type(buffer, size)),
+      static_cast<int>(StandardEntry::kCompactSerializationType));
+
+  TestVisitor visitor;
+  EntryParser::parse(buffer, size, visitor);
+
+  auto& entry = visitor.standardEntry;
+  EXPECT_EQ(input.id, entry.id);
+  EXPECT_EQ(input.type, entry.type);
+  EXPECT_EQ(input.timestamp, entry.timestamp);
+  EXPECT_EQ(input.tid, entry.tid);
+  EXPECT_EQ(input.callid, entry.callid);
+  EXPECT_EQ(input.matchid, entry.matchid);
+  EXPECT_EQ(input.extra, entry.extra);
+}
+
+TEST(EntryCodegen, testCompactStandardEntryIsSmaller) {
+  StandardEntry input{.id = 1024,
+                      .type = EntryType::MARK_PUSH,
+                      .timestamp = 12345678901234,
+                      .tid = 12345,
+                      .callid = 1,
+                      .matchid = 2,
+                      .extra = 3};
+
+  // 1 + 2 (id) + 1 (type) + 7 (timestamp) + 3 (tid) + 3 * 1
+  EXPECT_EQ(StandardEntry::calculateCompactSize(input), 17);
+  EXPECT_LT(
+      StandardEntry::calculateCompactSize(input) * 2,
+      StandardEntry::calculateSize(input));
+}
+
+TEST(EntryCodegen, testPrintCompactStandardEntry) {
+  StandardEntry input{.id = 10,
+                      .type = EntryType::TRACE_START,
+                      .timestamp = 123,
+                      .tid = 0,
+                      .callid = 1,
+                      .matchid = 2,
+                      .extra = 3};
+
+  char buffer[sizeof(StandardEntry)]{};
+  StandardEntry::packCompact(input, buffer, sizeof(buffer));
+
+  std::stringstream stream;
+  PrintEntryVisitor visitor(stream);
+  EntryParser::parse(
+      buffer, StandardEntry::calculateCompactSize(input), visitor);
+
+  EXPECT_EQ(stream.str(), "10|TRACE_START|123|0|1|2|3\n");
+}
+
+TEST(EntryCodegen, testUnpackTruncatedCompactThrows) {
+  StandardEntry input{.id = 10,
+                      .type = EntryType::TRACE_START,
+                      .timestamp = 123456789,
+                      .tid = 1,
+                      .callid = 1,
+                      .matchid = 2,
+                      .extra = 300};
+
+  char buffer[sizeof(StandardEntry)]{};
+  auto size = StandardEntry::calculateCompactSize(input);
+  StandardEntry::packCompact(input, buffer, sizeof(buffer));
+
+  StandardEntry output{};
+  try {
+    StandardEntry::unpack(output, buffer, size - 1);
+    FAIL() << "Expected std::out_of_range";
+  } catch (const std::out_of_range& ex) {
+    // intentionally empty
+  } catch (...) {
+    FAIL() << "Expected std::out_of_range";
+  }
+}
+
 } // namespace entries
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,156 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include <profiler/FrameNameCache.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+std::unordered_map<int64_t, std::string> takeStale(FrameNameCache& cache) {
+  std::unordered_map<int64_t, std::string> stale;
+  cache.forEachStale([&](int64_t frame, std::string const& name) {
+    EXPECT_TRUE(stale.emplace(frame, name).second);
+  });
+  return stale;
+}
+
+} // namespace
+
+TEST(FrameNameCacheTest, testAddsNamedAndUnnamedFrames) {
+  FrameNameCache cache(64, 0);
+  EXPECT_FALSE(cache.contains(1));
+
+  auto name = cache.add(1, "Ljava/lang/Object;", "hashCode");
+  ASSERT_NE(name, nullptr);
+  EXPECT_EQ(*name, "Ljava/lang/Object;hashCode");
+  EXPECT_EQ(cache.add(2, nullptr, nullptr), nullptr);
+
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_TRUE(cache.contains(2));
+  EXPECT_TRUE(cache.known().contains(1));
+  EXPECT_TRUE(cache.known().contains(2));
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(FrameNameCacheTest, testNewGenerationGetsNamesAgain) {
+  FrameNameCache cache(64, 0);
+  cache.add(1, "Ljava/lang/Object;", "hashCode");
+  cache.add(2, nullptr, nullptr);
+
+  // Logged when added, nothing is stale yet.
+  EXPECT_TRUE(takeStale(cache).empty());
+
+  cache.startGeneration();
+  cache.add(3, "Landroid/view/View;", "draw");
+  auto stale = takeStale(cache);
+  ASSERT_EQ(stale.size(), 1);
+  EXPECT_EQ(stale[1], "Ljava/lang/Object;hashCode");
+
+  // Each generation gets each name once.
+  EXPECT_TRUE(takeStale(cache).empty());
+
+  cache.startGeneration();
+  cache.startGeneration();
+  EXPECT_EQ(takeStale(cache).size(), 2);
+}
+
+TEST(FrameNameCacheTest, testKeepsFramesThatDontFit) {
+  FrameNameCache cache(4, 64);
+  for (int64_t frame = 1; frame <= 64; ++frame) {
+    EXPECT_NE(cache.add(frame, "Ljava/lang/Object;", "hashCode"), nullptr);
+  }
+  EXPECT_EQ(cache.size(), 64);
+
+  size_t inTable = 0;
+  for (int64_t frame = 1; frame <= 64; ++frame) {
+    EXPECT_TRUE(cache.contains(frame));
+    inTable += cache.known().contains(frame);
+  }
+  EXPECT_LE(inTable, 4);
+
+  cache.startGeneration();
+  EXPECT_EQ(takeStale(cache).size(), 64);
+}
+
+TEST(FrameNameCacheTest, testNamesFramesPastTheOverflowEveryTime) {
+  FrameNameCache cache(4, 8);
+  for (int64_t frame = 1; frame <= 64; ++frame) {
+    cache.add(frame, "Ljava/lang/Object;", "hashCode");
+  }
+  EXPECT_LE(cache.size(), 12);
+
+  int64_t unkept = 0;
+  for (int64_t frame = 1; frame <= 64 && unkept == 0; ++frame) {
+    if (!cache.contains(frame)) {
+      unkept = frame;
+    }
+  }
+  ASSERT_NE(unkept, 0);
+
+  size_t size = cache.size();
+  auto name = cache.add(unkept, "Landroid/view/View;", "draw");
+  ASSERT_NE(name, nullptr);
+  EXPECT_EQ(*name, "Landroid/view/View;draw");
+  EXPECT_FALSE(cache.contains(unkept));
+  EXPECT_EQ(cache.size(), size);
+  EXPECT_EQ(cache.add(unkept, nullptr, nullptr), nullptr);
+}
+
+TEST(FrameNameCacheTest, testHandsOutStaleNamesInSlices) {
+  FrameNameCache cache(4, 32);
+  for (int64_t frame = 1; frame <= 20; ++frame) {
+    cache.add(frame, "Ljava/lang/Object;", "hashCode");
+  }
+  ASSERT_EQ(cache.size(), 20);
+
+  cache.startGeneration();
+  std::unordered_map<int64_t, std::string> stale;
+  auto collect = [&](int64_t frame, std::string const& name) {
+    EXPECT_TRUE(stale.emplace(frame, name).second);
+  };
+  EXPECT_FALSE(cache.forEachStale(collect, 8));
+  EXPECT_EQ(stale.size(), 8);
+
+  // Added during the dump, already logged in this generation.
+  cache.add(21, "Landroid/view/View;", "draw");
+
+  EXPECT_FALSE(cache.forEachStale(collect, 8));
+  EXPECT_EQ(stale.size(), 16);
+  EXPECT_TRUE(cache.forEachStale(collect, 8));
+  EXPECT_EQ(stale.size(), 20);
+  EXPECT_EQ(stale.count(21), 0);
+  EXPECT_TRUE(cache.forEachStale(collect, 8));
+  EXPECT_EQ(stale.size(), 20);
+
+  // A new generation starts over.
+  cache.startGeneration();
+  stale.clear();
+  EXPECT_TRUE(cache.forEachStale(collect));
+  EXPECT_EQ(stale.size(), 21);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,98 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <profiler/JavaBaseTracer.h>
+#include <profiler/KnownFrames.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+TEST(KnownFramesTest, testInsertAndClear) {
+  KnownFrames known(64);
+  EXPECT_FALSE(known.contains(42));
+
+  EXPECT_TRUE(known.insert(42));
+  EXPECT_TRUE(known.insert(0));
+  EXPECT_TRUE(known.contains(42));
+  EXPECT_TRUE(known.contains(0));
+  EXPECT_FALSE(known.contains(43));
+
+  known.clear();
+  EXPECT_FALSE(known.contains(42));
+  EXPECT_FALSE(known.contains(0));
+}
+
+TEST(KnownFramesTest, testFullSetRejectsInserts) {
+  KnownFrames known(16);
+
+  int inserted = 0;
+  for (int64_t frame = 1; frame <= 64; ++frame) {
+    if (known.insert(frame)) {
+      ++inserted;
+      EXPECT_TRUE(known.contains(frame));
+    } else {
+      EXPECT_FALSE(known.contains(frame));
+    }
+  }
+  EXPECT_LE(inserted, 16);
+  EXPECT_GT(inserted, 0);
+}
+
+TEST(KnownFramesTest, testFramesKeepTheirIndex) {
+  KnownFrames known(64);
+  EXPECT_TRUE(known.indexAt(42) == KnownFrames::kNoIndex);
+
+  size_t idx = known.insertAt(42);
+  ASSERT_LT(idx, known.capacity());
+  EXPECT_EQ(known.indexAt(42), idx);
+  EXPECT_EQ(known.insertAt(42), idx);
+  EXPECT_NE(known.insertAt(43), idx);
+
+  // -1 would be stored as the empty key.
+  EXPECT_TRUE(known.insertAt(-1) == KnownFrames::kNoIndex);
+  EXPECT_FALSE(known.contains(-1));
+}
+
+TEST(KnownFramesTest, testFrameNamesSkipKnownFrames) {
+  KnownFrames known(64);
+  known.insert(2);
+
+  uint8_t depths[2];
+  char const* method_names[2];
+  char const* class_descriptors[2];
+  FrameNames names{nullptr, 2, 0, depths, method_names, class_descriptors};
+  names.reset(&known);
+
+  for (uint8_t depth = 0; depth < 4; ++depth) {
+    int64_t frame = depth + 1;
+    if (names.wants(frame)) {
+      names.add(depth, "method", "Lclass;");
+    }
+  }
+
+  // Frame 2 is known and the arrays fill up before frame 4.
+  ASSERT_EQ(names.count, 2);
+  EXPECT_EQ(depths[0], 0);
+  EXPECT_EQ(depths[1], 2);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,206 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <profilo/PacketLogger.h>
+#include <profilo/writer/LiveStreamReader.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace logger;
+
+//
+// Records everything it receives. While `blocked` is set, onEntry() waits
+// until unblock() is called, which lets the writers lap the reader.
+//
+struct RecordingSink : public StreamSink {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> entries;
+  uint64_t lost = 0;
+  bool blocked = false;
+
+  void onEntry(const void* data, size_t size) override {
+    std::unique_lock<std::mutex> lock(mutex);
+    entries.emplace_back(static_cast<const char*>(data), size);
+    cv.notify_all();
+    cv.wait(lock, [this] { return !blocked; });
+  }
+
+  void onLoss(uint64_t packets) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    lost += packets;
+    cv.notify_all();
+  }
+
+  bool hasEntries() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !entries.empty();
+  }
+
+  void waitForLoss() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return lost > 0; });
+  }
+
+  void unblock() {
+    std::lock_guard<std::mutex> lock(mutex);
+    blocked = false;
+    cv.notify_all();
+  }
+};
+
+class LiveStreamReaderTest : public ::testing::Test {
+ protected:
+  explicit LiveStreamReaderTest(size_t slots = 1000)
+      : holder_(TraceBuffer::allocate(slots)),
+        logger_([this]() -> PacketBuffer& { return *holder_; }),
+        sink_(std::make_shared<RecordingSink>()),
+        reader_(*holder_, sink_) {}
+
+  void start() {
+    thread_ = std::thread([this] { reader_.loop(); });
+    // The reader only sees writes made after it started, keep writing until
+    // one comes through.
+    while (!sink_->hasEntries()) {
+      write("ready");
+      std::this_thread::yield();
+    }
+  }
+
+  void stop() {
+    reader_.stop();
+    thread_.join();
+  }
+
+  void write(std::string payload) {
+    logger_.write(&payload[0], payload.size());
+  }
+
+  TraceBufferHolder holder_;
+  PacketLogger logger_;
+  std::shared_ptr<RecordingSink> sink_;
+  LiveStreamReader reader_;
+  std::thread thread_;
+};
+
+class LiveStreamReaderLapTest : public LiveStreamReaderTest {
+ protected:
+  LiveStreamReaderLapTest() : LiveStreamReaderTest(8) {}
+};
+
+TEST_F(LiveStreamReaderTest, testForwardsEntriesInOrder) {
+  start();
+  write("first");
+  write(std::string(200, 'x')); // Spans several packets.
+  write("last");
+  stop();
+
+  auto& entries = sink_->entries;
+  ASSERT_GE(entries.size(), 4);
+  EXPECT_EQ(entries[entries.size() - 3], "first");
+  EXPECT_EQ(entries[entries.size() - 2], std::string(200, 'x'));
+  EXPECT_EQ(entries[entries.size() - 1], "last");
+  EXPECT_EQ(sink_->lost, 0);
+  EXPECT_EQ(reader_.lostPackets(), 0);
+}
+
+TEST_F(LiveStreamReaderLapTest, testReportsLostPacketsWhenLapped) {
+  sink_->blocked = true;
+  start();
+
+  // The reader is stuck in the sink, go around the buffer a few times.
+  for (int i = 0; i < 32; ++i) {
+    write("lapped");
+  }
+  sink_->unblock();
+  sink_->waitForLoss();
+  write("last");
+  stop();
+
+  EXPECT_GT(reader_.lostPackets(), 0);
+  EXPECT_EQ(sink_->lost, reader_.lostPackets());
+  EXPECT_EQ(sink_->entries.back(), "last");
+}
+
+TEST_F(LiveStreamReaderTest, testStopWakesUpWaitingReader) {
+  start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  stop();
+  EXPECT_EQ(reader_.lostPackets(), 0);
+}
+
+TEST(FdStreamSink, testFramesEntriesAndLosses) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  FdStreamSink sink(fds[1]);
+  sink.onEntry("abc", 4);
+  sink.onLoss(7);
+  close(fds[1]);
+
+  char buf[64];
+  auto size = read(fds[0], buf, sizeof(buf));
+  close(fds[0]);
+  ASSERT_EQ(size, 4 + 4 + 4 + 8);
+
+  uint32_t length;
+  std::memcpy(&length, buf, sizeof(length));
+  EXPECT_EQ(length, 4);
+  EXPECT_STREQ(buf + 4, "abc");
+
+  uint32_t marker;
+  uint64_t lost;
+  std::memcpy(&marker, buf + 8, sizeof(marker));
+  std::memcpy(&lost, buf + 12, sizeof(lost));
+  EXPECT_EQ(marker, 0);
+  EXPECT_EQ(lost, 7);
+}
+
+TEST(FdStreamSink, testThrowsOnClosedFd) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  close(fds[0]);
+  close(fds[1]);
+
+  FdStreamSink sink(fds[1]);
+  EXPECT_THROW(sink.onLoss(1), std::system_error);
+}
+
+TEST(LiveStreamReader, testRejectsNoopProcessBuffer) {
+  ASSERT_NE(RingBuffer::initRecordBuffer(4096), nullptr);
+  auto sink = std::make_shared<RecordingSink>();
+  EXPECT_THROW(
+      LiveStreamReader(RingBuffer::get(), sink), std::invalid_argument);
+  RingBuffer::destroy();
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,240 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <folly/experimental/TestUtil.h>
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <profilo/logger/lfrb/LockFreeRecordBuffer.h>
+
+namespace test = folly::test;
+
+namespace facebook {
+namespace profilo {
+namespace logger {
+namespace lfrb {
+
+using TestBuffer = LockFreeRecordBuffer<>;
+using TestBufferHolder = LockFreeRecordBufferHolder<>;
+
+std::vector<char> makePayload(size_t size, char seed) {
+  std::vector<char> payload(size);
+  for (size_t i = 0; i < size; ++i) {
+    payload[i] = static_cast<char>(seed + i);
+  }
+  return payload;
+}
+
+TestBuffer::Cursor write(TestBuffer& buf, const std::vector<char>& payload) {
+  TestBuffer::Cursor cursor(0);
+  EXPECT_TRUE(buf.tryWrite(payload.data(), payload.size(), cursor));
+  return cursor;
+}
+
+TEST(LockFreeRecordBuffer, testWriteAndRead) {
+  TestBufferHolder buf = TestBuffer::allocate(1024);
+  auto first = makePayload(39, 'a');
+  auto second = makePayload(100, 'b');
+
+  auto cursor = write(*buf, first);
+  write(*buf, second);
+
+  char dest[TestBuffer::kMaxRecordSize];
+  uint32_t size;
+  ASSERT_TRUE(buf->tryRead(dest, sizeof(dest), cursor, size));
+  EXPECT_EQ(size, first.size());
+  EXPECT_EQ(std::memcmp(dest, first.data(), size), 0);
+
+  cursor.moveForward(TestBuffer::recordSpan(size));
+  ASSERT_TRUE(buf->tryRead(dest, sizeof(dest), cursor, size));
+  EXPECT_EQ(size, second.size());
+  EXPECT_EQ(std::memcmp(dest, second.data(), size), 0);
+
+  cursor.moveForward(TestBuffer::recordSpan(size));
+  EXPECT_FALSE(buf->tryRead(dest, sizeof(dest), cursor, size));
+}
+
+TEST(LockFreeRecordBuffer, testRecordsUseOnlyTheirSize) {
+  TestBufferHolder buf = TestBuffer::allocate(1024);
+  auto payload = makePayload(39, 'a');
+
+  auto before = buf->currentHead();
+  write(*buf, payload);
+  auto after = buf->currentHead();
+
+  before.moveForward(TestBuffer::recordSpan(payload.size()));
+  EXPECT_FALSE(before < after);
+  EXPECT_FALSE(after < before);
+  EXPECT_EQ(TestBuffer::recordSpan(39), 64);
+}
+
+TEST(LockFreeRecordBuffer, testWrapAround) {
+  TestBufferHolder buf = TestBuffer::allocate(256);
+  char dest[TestBuffer::kMaxRecordSize];
+  uint32_t size;
+
+  // 100 byte payloads take 128 bytes each, the third write overwrites the
+  // first one and the fifth straddles the end of the data area.
+  std::vector<TestBuffer::Cursor> cursors;
+  for (int i = 0; i < 5; ++i) {
+    auto payload = makePayload(100 - i, 'a' + i);
+    cursors.push_back(write(*buf, payload));
+  }
+
+  EXPECT_FALSE(buf->tryRead(dest, sizeof(dest), cursors[0], size));
+  EXPECT_FALSE(buf->tryRead(dest, sizeof(dest), cursors[2], size));
+  for (int i = 3; i < 5; ++i) {
+    auto payload = makePayload(100 - i, 'a' + i);
+    ASSERT_TRUE(buf->tryRead(dest, sizeof(dest), cursors[i], size));
+    EXPECT_EQ(size, payload.size());
+    EXPECT_EQ(std::memcmp(dest, payload.data(), size), 0);
+  }
+
+  auto tail = buf->currentTail();
+  EXPECT_FALSE(tail < cursors[3]);
+  EXPECT_FALSE(cursors[3] < tail);
+}
+
+TEST(LockFreeRecordBuffer, testOversizedWriteIsDropped) {
+  TestBufferHolder buf = TestBuffer::allocate(256);
+  auto payload = makePayload(200, 'a');
+  auto head = buf->currentHead();
+
+  TestBuffer::Cursor cursor(0);
+  EXPECT_FALSE(buf->tryWrite(payload.data(), payload.size(), cursor));
+  EXPECT_FALSE(head < buf->currentHead());
+
+  TestBufferHolder large = TestBuffer::allocate(1 << 20);
+  auto oversized = makePayload(TestBuffer::kMaxRecordSize + 1, 'a');
+  EXPECT_FALSE(large->tryWrite(oversized.data(), oversized.size(), cursor));
+  EXPECT_EQ(TestBuffer::Cursor(0).stepsTo(large->currentHead()), 0);
+}
+
+TEST(LockFreeRecordBuffer, testReadIntoSmallBufferFails) {
+  TestBufferHolder buf = TestBuffer::allocate(1024);
+  auto payload = makePayload(100, 'a');
+  auto cursor = write(*buf, payload);
+
+  char dest[64];
+  uint32_t size;
+  EXPECT_FALSE(buf->tryRead(dest, sizeof(dest), cursor, size));
+}
+
+TEST(LockFreeRecordBuffer, testWaitAndTryReadBlocksUntilWrite) {
+  TestBufferHolder buf = TestBuffer::allocate(1024);
+  auto payload = makePayload(77, 'a');
+  auto cursor = buf->currentHead();
+
+  std::thread writer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    write(*buf, payload);
+  });
+
+  char dest[TestBuffer::kMaxRecordSize];
+  uint32_t size;
+  ASSERT_TRUE(buf->waitAndTryRead(dest, sizeof(dest), cursor, size));
+  EXPECT_EQ(size, payload.size());
+  EXPECT_EQ(std::memcmp(dest, payload.data(), size), 0);
+  writer.join();
+}
+
+TEST(LockFreeRecordBuffer, testConcurrentWritersAllReadable) {
+  constexpr auto kThreads = 4;
+  constexpr auto kWrites = 200;
+  TestBufferHolder buf = TestBuffer::allocate(1 << 20);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&buf, t] {
+      for (int i = 0; i < kWrites; ++i) {
+        auto payload = makePayload(1 + (i * 7 + t) % 500, 'a' + t);
+        write(*buf, payload);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  char dest[TestBuffer::kMaxRecordSize];
+  uint32_t size;
+  auto cursor = buf->currentTail();
+  int records = 0;
+  while (buf->tryRead(dest, sizeof(dest), cursor, size)) {
+    ++records;
+    cursor.moveForward(TestBuffer::recordSpan(size));
+  }
+  EXPECT_EQ(records, kThreads * kWrites);
+}
+
+TEST(LockFreeRecordBuffer, testAllocateAt) {
+  constexpr auto kCapacity = 512;
+  std::vector<char> storage(TestBuffer::allocationSize(kCapacity) + 16);
+  // The buffer is placed at an aligned address inside the storage.
+  void* ptr = storage.data();
+  size_t space = storage.size();
+  ASSERT_NE(std::align(16, storage.size() - 16, ptr, space), nullptr);
+
+  TestBufferHolder buf = TestBuffer::allocateAt(kCapacity, ptr);
+  EXPECT_EQ(static_cast<void*>(buf.get()), ptr);
+  EXPECT_EQ(buf->capacity(), kCapacity);
+
+  auto payload = makePayload(40, 'a');
+  auto cursor = write(*buf, payload);
+  char dest[TestBuffer::kMaxRecordSize];
+  uint32_t size;
+  ASSERT_TRUE(buf->tryRead(dest, sizeof(dest), cursor, size));
+  EXPECT_EQ(std::memcmp(dest, payload.data(), size), 0);
+}
+
+TEST(LockFreeRecordBuffer, testDumpContainsLiveRecords) {
+  test::TemporaryFile dump_file("test_dump");
+  TestBufferHolder buf = TestBuffer::allocate(256);
+  for (int i = 0; i < 5; ++i) {
+    auto payload = makePayload(100 - i, 'a' + i);
+    write(*buf, payload);
+  }
+
+  ASSERT_TRUE(buf->dumpDataToFile(dump_file.fd()));
+  struct stat dump_stat;
+  fstat(dump_file.fd(), &dump_stat);
+  // The last two records survive, each with its header.
+  EXPECT_EQ(
+      dump_stat.st_size,
+      TestBuffer::recordSpan(97) + TestBuffer::recordSpan(96));
+  EXPECT_LE(dump_stat.st_size, buf->getDumpBytesCount());
+
+  std::vector<char> dump(dump_stat.st_size);
+  ASSERT_EQ(
+      pread(dump_file.fd(), dump.data(), dump.size(), 0),
+      (ssize_t)dump.size());
+  TestBuffer::RecordHeader header;
+  std::memcpy(&header, dump.data(), sizeof(header));
+  EXPECT_EQ(header.size, 97);
+  auto payload = makePayload(97, 'd');
+  EXPECT_EQ(
+      std::memcmp(dump.data() + sizeof(header), payload.data(), header.size),
+      0);
+}
+
+} // namespace lfrb
+} // namespace logger
+} // namespace profilo
+} // namespace facebook
@@ -19,6 +19,7 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <chrono>
 #include <climits>
 
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
@@ -173,6 +174,220 @@ TEST(LockFreeRingBuffer, testAllocationCorrectness) {
   EXPECT_EQ(crc, crc_after);
 }
 
+TEST(LockFreeRingBuffer, testWriteNIsContiguous) {
+  constexpr auto kBufferSize = 10;
+  constexpr auto kBatchSize = 4;
+  TestBufferHolder ringBuffer = TestBuffer::allocate(kBufferSize);
+
+  TestPacket single{.payload = {}};
+  single.payload[0] = 'a';
+  ringBuffer->write(single);
+
+  TestPacket batch[kBatchSize];
+  for (int i = 0; i < kBatchSize; ++i) {
+    std::memset(batch[i].payload, 0, kPayloadSize);
+    batch[i].payload[0] = 'b' + i;
+  }
+  auto cursor = ringBuffer->writeN(batch, kBatchSize);
+
+  TestPacket dest;
+  for (int i = 0; i < kBatchSize; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], 'b' + i);
+    cursor.moveForward();
+  }
+  EXPECT_FALSE(ringBuffer->tryRead(dest, cursor))
+      << "must not read past the batch";
+}
+
+TEST(LockFreeRingBuffer, testWriteNWrapsAround) {
+  constexpr auto kBufferSize = 3;
+  constexpr auto kBatchSize = 5;
+  TestBufferHolder ringBuffer = TestBuffer::allocate(kBufferSize);
+
+  TestPacket batch[kBatchSize];
+  for (int i = 0; i < kBatchSize; ++i) {
+    std::memset(batch[i].payload, 0, kPayloadSize);
+    batch[i].payload[0] = i;
+  }
+  ringBuffer->writeN(batch, kBatchSize);
+
+  // Only the last kBufferSize values survive the wrap-around.
+  auto cursor = ringBuffer->currentTail();
+  TestPacket dest;
+  for (int i = kBatchSize - kBufferSize; i < kBatchSize; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], i);
+    cursor.moveForward();
+  }
+}
+
+TEST(LockFreeRingBuffer, testWriteNFillsSlotsInPlace) {
+  constexpr auto kBatchSize = 4;
+  TestBufferHolder ringBuffer = TestBuffer::allocate(3);
+
+  auto cursor =
+      ringBuffer->writeN(kBatchSize, [](uint32_t idx, TestPacket& packet) {
+        std::memset(packet.payload, 0, kPayloadSize);
+        packet.payload[0] = 'a' + idx;
+      });
+
+  // The first value was lapped by the last one.
+  TestPacket dest;
+  EXPECT_FALSE(ringBuffer->tryRead(dest, cursor));
+  for (int i = 1; i < kBatchSize; ++i) {
+    cursor.moveForward();
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], 'a' + i);
+  }
+}
+
+TEST(LockFreeRingBuffer, testClaimIsReadableOnlyAfterPublish) {
+  TestBufferHolder ringBuffer = TestBuffer::allocate(10);
+
+  auto claim = ringBuffer->claim();
+  std::memset(claim.value().payload, 0, kPayloadSize);
+  claim.value().payload[0] = 'a';
+
+  TestPacket dest;
+  auto cursor = ringBuffer->currentTail();
+  EXPECT_FALSE(ringBuffer->tryRead(dest, cursor))
+      << "must not read an unpublished claim";
+
+  auto published = ringBuffer->publish(claim);
+  EXPECT_FALSE(published < cursor);
+  EXPECT_FALSE(cursor < published);
+  ASSERT_TRUE(ringBuffer->tryRead(dest, published));
+  EXPECT_EQ(dest.payload[0], 'a');
+}
+
+TEST(LockFreeRingBuffer, testClaimsInterleaveWithWrites) {
+  TestBufferHolder ringBuffer = TestBuffer::allocate(10);
+
+  auto claim = ringBuffer->claim();
+  TestPacket packet{.payload = {}};
+  packet.payload[0] = 'b';
+  ringBuffer->write(packet);
+  claim.value().payload[0] = 'a';
+  ringBuffer->publish(claim);
+
+  auto cursor = ringBuffer->currentTail();
+  TestPacket dest;
+  for (char expected : {'a', 'b'}) {
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], expected);
+    cursor.moveForward();
+  }
+}
+
+TEST(LockFreeRingBuffer, testTryWriteDropsOnBusySlot) {
+  TestBufferHolder ringBuffer = TestBuffer::allocate(2);
+
+  // An unpublished claim stands in for a writer preempted mid-write.
+  auto claim = ringBuffer->claim();
+  TestPacket packet{.payload = {}};
+  packet.payload[0] = 'a';
+  ASSERT_TRUE(ringBuffer->tryWrite(packet));
+
+  auto head = ringBuffer->currentHead();
+  packet.payload[0] = 'b';
+  EXPECT_FALSE(ringBuffer->tryWrite(packet))
+      << "must not wait for the lapped writer";
+  auto after = ringBuffer->currentHead();
+  EXPECT_FALSE(head < after) << "dropped write must not claim a ticket";
+
+  ringBuffer->publish(claim);
+  ASSERT_TRUE(ringBuffer->tryWrite(packet));
+  TestPacket dest;
+  ASSERT_TRUE(ringBuffer->tryRead(dest, head));
+  EXPECT_EQ(dest.payload[0], 'b');
+}
+
+TEST(LockFreeRingBuffer, testTryWriteNIsAllOrNothing) {
+  constexpr auto kBatchSize = 3;
+  TestBufferHolder ringBuffer = TestBuffer::allocate(4);
+
+  TestPacket batch[kBatchSize];
+  for (int i = 0; i < kBatchSize; ++i) {
+    std::memset(batch[i].payload, 0, kPayloadSize);
+    batch[i].payload[0] = 'a' + i;
+  }
+  auto claim = ringBuffer->claim();
+  auto cursor = ringBuffer->currentHead();
+  ASSERT_TRUE(ringBuffer->tryWriteN(batch, kBatchSize, cursor));
+
+  // Slots 0 and 1 come next. Slot 0 is still claimed, so neither is written.
+  auto head = ringBuffer->currentHead();
+  EXPECT_FALSE(ringBuffer->tryWriteN(batch, 2, cursor));
+  auto after = ringBuffer->currentHead();
+  EXPECT_FALSE(head < after);
+
+  TestPacket dest;
+  for (int i = 0; i < kBatchSize; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], 'a' + i);
+    cursor.moveForward();
+  }
+  ringBuffer->publish(claim);
+}
+
+TEST(LockFreeRingBuffer, testBaseTicketOffsetsCursors) {
+  constexpr auto kBase = 1000;
+  TestBufferHolder ringBuffer = TestBuffer::allocate(3, kBase);
+
+  auto begin = ringBuffer->begin();
+  auto tail = ringBuffer->currentTail();
+  EXPECT_FALSE(tail < begin) << "tail must not point before the base";
+
+  TestPacket packet{.payload = {}};
+  for (int i = 0; i < 5; ++i) {
+    packet.payload[0] = 'a' + i;
+    ringBuffer->write(packet);
+  }
+
+  TestPacket dest;
+  auto cursor = ringBuffer->currentTail();
+  for (int i = 2; i < 5; ++i) {
+    ASSERT_TRUE(ringBuffer->tryRead(dest, cursor));
+    EXPECT_EQ(dest.payload[0], 'a' + i);
+    cursor.moveForward();
+  }
+
+  auto before = begin;
+  before.moveBackward();
+  EXPECT_FALSE(ringBuffer->tryRead(dest, before));
+}
+
+TEST(LockFreeRingBuffer, testWaitAndTryReadUntil) {
+  TestBufferHolder ringBuffer = TestBuffer::allocate(2);
+  auto cursor = ringBuffer->currentHead();
+  TestPacket dest;
+
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+  EXPECT_EQ(
+      ringBuffer->waitAndTryReadUntil(dest, cursor, deadline),
+      ReadResult::TIMEDOUT);
+  EXPECT_FALSE(deadline > std::chrono::steady_clock::now())
+      << "must wait until the deadline";
+
+  TestPacket packet{.payload = {}};
+  packet.payload[0] = 'a';
+  ringBuffer->write(packet);
+  EXPECT_EQ(
+      ringBuffer->waitAndTryReadUntil(dest, cursor, deadline),
+      ReadResult::SUCCESS);
+  EXPECT_EQ(dest.payload[0], 'a');
+
+  // Lap the reader.
+  for (int i = 0; i < 2; ++i) {
+    ringBuffer->write(packet);
+  }
+  EXPECT_EQ(
+      ringBuffer->waitAndTryReadUntil(dest, cursor, deadline),
+      ReadResult::LOST);
+}
+
 // Expect not to send an error signal, such as SIGSEGV.
 TEST(LockFreeRingBuffer, testDeallocationAfterMove) {
   TestBufferHolder ringBuffer = TestBuffer::allocate(10);
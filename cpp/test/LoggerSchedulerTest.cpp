@@ -0,0 +1,231 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <time.h>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <profiler/LoggerScheduler.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+constexpr int kLongFlushDelayMs = 60 * 1000;
+
+int64_t elapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+} // namespace
+
+TEST(LoggerSchedulerTest, testWakesUpAtHighWaterMark) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+
+  std::thread producer([&] {
+    for (int i = 0; i < 4; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      scheduler.onSample();
+    }
+  });
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+  producer.join();
+}
+
+TEST(LoggerSchedulerTest, testFlushesLateSamplesAfterDelay) {
+  constexpr int kFlushDelayMs = 50;
+  LoggerScheduler scheduler(kFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+
+  auto start = std::chrono::steady_clock::now();
+  scheduler.onSample();
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+  EXPECT_GE(elapsedMs(start), kFlushDelayMs - 1);
+}
+
+TEST(LoggerSchedulerTest, testStopWakesUp) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+
+  std::thread stopper([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    scheduler.stop();
+  });
+  EXPECT_TRUE(scheduler.wait() & LoggerScheduler::STOP);
+  EXPECT_TRUE(scheduler.stopping());
+  stopper.join();
+}
+
+TEST(LoggerSchedulerTest, testFlushWakesUpWithoutSamples) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+
+  scheduler.flush();
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+}
+
+TEST(LoggerSchedulerTest, testFlushWakesUpWhileSamplesPending) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+
+  scheduler.onSample();
+  scheduler.flush();
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+  scheduler.onFlush(0, 8);
+
+  // The first request was consumed along with the pending sample.
+  scheduler.flush();
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+}
+
+TEST(LoggerSchedulerTest, testResetForgetsStop) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(1, 16);
+  scheduler.stop();
+
+  scheduler.reset(1, 16);
+  EXPECT_FALSE(scheduler.stopping());
+  scheduler.onSample();
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+}
+
+TEST(LoggerSchedulerTest, testSamplesAtDeadlines) {
+  constexpr int kPeriodMs = 5;
+  constexpr int kTicks = 10;
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+  ASSERT_TRUE(scheduler.startSampling(kPeriodMs));
+
+  auto start = std::chrono::steady_clock::now();
+  while (scheduler.stats().ticks < kTicks) {
+    auto events = scheduler.wait();
+    EXPECT_EQ(events, LoggerScheduler::SAMPLE);
+  }
+  // Deadlines are absolute, so they don't drift with the time spent
+  // between waits.
+  EXPECT_GE(elapsedMs(start), kTicks * kPeriodMs - 1);
+
+  auto stats = scheduler.stats();
+  EXPECT_GE(stats.jitter_max_ns, 0);
+  EXPECT_LE(stats.jitter_total_ns, stats.jitter_max_ns * (int64_t)stats.ticks);
+}
+
+TEST(LoggerSchedulerTest, testCountsMissedDeadlines) {
+  constexpr int kPeriodMs = 5;
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+  ASSERT_TRUE(scheduler.startSampling(kPeriodMs));
+
+  // Busy for 4 periods and then some.
+  std::this_thread::sleep_for(std::chrono::milliseconds(kPeriodMs * 4 + 2));
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::SAMPLE);
+
+  auto stats = scheduler.stats();
+  EXPECT_GE(stats.ticks, 4);
+  EXPECT_EQ(stats.missed_ticks, stats.ticks - 1);
+  EXPECT_GT(stats.jitter_max_ns, 0);
+}
+
+TEST(LoggerSchedulerTest, testStopsSampling) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+  ASSERT_TRUE(scheduler.startSampling(1));
+  ASSERT_TRUE(scheduler.startSampling(0));
+
+  std::thread stopper([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    scheduler.stop();
+  });
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::STOP);
+  EXPECT_EQ(scheduler.stats().ticks, 0);
+  stopper.join();
+}
+
+TEST(LoggerSchedulerTest, testAdaptsBatchToRingOccupancy) {
+  constexpr size_t kRingSize = 8;
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(4, 16);
+  EXPECT_EQ(scheduler.batch(), 4);
+
+  // More than half full: flush earlier.
+  scheduler.onFlush(5, kRingSize);
+  EXPECT_EQ(scheduler.batch(), 2);
+  scheduler.onFlush(8, kRingSize);
+  EXPECT_EQ(scheduler.batch(), 1);
+  scheduler.onFlush(8, kRingSize);
+  EXPECT_EQ(scheduler.batch(), 1);
+
+  // In between: keep the batch.
+  scheduler.onFlush(3, kRingSize);
+  EXPECT_EQ(scheduler.batch(), 1);
+
+  // At most a quarter full: batch more, but never past half a ring...
+  for (int i = 0; i < 10; ++i) {
+    scheduler.onFlush(2, kRingSize);
+  }
+  EXPECT_EQ(scheduler.batch(), kRingSize / 2);
+
+  // ...nor past the limit.
+  for (int i = 0; i < 10; ++i) {
+    scheduler.onFlush(2, kRingSize * 8);
+  }
+  EXPECT_EQ(scheduler.batch(), 16);
+
+  scheduler.reset(64, 16);
+  EXPECT_EQ(scheduler.batch(), 16);
+}
+
+TEST(LoggerSchedulerTest, testWakesUpOncePerBatch) {
+  LoggerScheduler scheduler(kLongFlushDelayMs);
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(2, 16);
+
+  for (int i = 0; i < 10; ++i) {
+    scheduler.onSample();
+  }
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::FLUSH);
+  scheduler.onFlush(0, 8);
+
+  // The single wake-up was consumed, nothing is pending.
+  std::thread stopper([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    scheduler.stop();
+  });
+  EXPECT_EQ(scheduler.wait(), LoggerScheduler::STOP);
+  stopper.join();
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
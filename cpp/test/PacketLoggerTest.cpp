@@ -14,9 +14,15 @@
  * limitations under the License.
  */
 
+#include <chrono>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
+#include <profilo/Logger.h>
 #include <profilo/PacketLogger.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/logger/lfrb/LockFreeRecordBuffer.h>
 #include <profilo/logger/lfrb/LockFreeRingBuffer.h>
 #include <profilo/writer/PacketReassembler.h>
 
@@ -116,5 +122,279 @@ TEST(Logger, testPacketizedWriteBackwards) {
   }
 }
 
+TEST(Logger, testInPlaceWrite) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(1000);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  //
+  // Payloads up to a packet are packed straight into the buffer, larger
+  // ones go through the packetized path. Both must read back the same.
+  //
+  for (size_t size = 1; size <= 3 * sizeof(Packet::data); ++size) {
+    PacketBuffer::Cursor head = buffer->currentHead();
+    auto cursor = logger.writeInPlace(size, [](void* dst, size_t dst_size) {
+      for (size_t j = 0; j < dst_size; ++j) {
+        static_cast<char*>(dst)[j] = static_cast<char>(j);
+      }
+    });
+    EXPECT_FALSE(cursor < head);
+    EXPECT_FALSE(head < cursor);
+
+    size_t calls = 0;
+    PacketReassembler reassembler([&](const void* read_data, size_t read_size) {
+      EXPECT_EQ(read_size, size) << "read must be the same size as write";
+      auto bytes = static_cast<const char*>(read_data);
+      for (size_t j = 0; j < read_size; ++j) {
+        EXPECT_EQ(bytes[j], static_cast<char>(j)) << "data must be the same";
+      }
+      ++calls;
+    });
+
+    Packet packet;
+    while (buffer->tryRead(packet, cursor)) {
+      reassembler.process(packet);
+      cursor.moveForward();
+    }
+    EXPECT_EQ(calls, 1) << "must read exactly one payload";
+  }
+}
+
+TEST(Logger, testInPlaceWriteThrowingPackPublishesSlot) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(1000);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  auto head = buffer->currentHead();
+  EXPECT_THROW(
+      logger.writeInPlace(
+          8, [](void*, size_t) { throw std::runtime_error("pack failed"); }),
+      std::runtime_error);
+
+  size_t calls = 0;
+  PacketReassembler reassembler([&](const void*, size_t) { ++calls; });
+  Packet packet;
+  ASSERT_TRUE(buffer->tryRead(packet, head)) << "slot must be published";
+  reassembler.process(packet);
+  EXPECT_EQ(calls, 0) << "failed write must not produce a payload";
+}
+
+TEST(Logger, testNonBlockingWriteDropsOnBusySlot) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(4);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+  PacketLogger::setBlocking(false);
+
+  // Hold the first slot, as a writer preempted mid-write would.
+  auto claim = buffer->claim();
+  std::vector<char> data(2 * sizeof(Packet::data), 'x');
+  for (int i = 0; i < 3; ++i) {
+    logger.write(data.data(), 1);
+  }
+  EXPECT_EQ(logger.droppedWrites(), 0);
+
+  // The next lap starts at the held slot.
+  auto head = buffer->currentHead();
+  logger.write(data.data(), 1);
+  logger.write(data.data(), data.size());
+  logger.write(data.data(), 1);
+  EXPECT_EQ(logger.droppedWrites(), 3);
+
+  buffer->publish(claim);
+  logger.write(data.data(), 1);
+  EXPECT_EQ(logger.droppedWrites(), 3);
+  Packet packet;
+  EXPECT_TRUE(buffer->tryRead(packet, head));
+  PacketLogger::setBlocking(true);
+}
+
+TEST(Logger, testNonBlockingWriteDropsLongEntriesAsAWhole) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(64);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+  PacketLogger::setBlocking(false);
+
+  // Hold the first slot and fill up to the tenth.
+  auto claim = buffer->claim();
+  char byte = 'x';
+  for (int i = 0; i < 9; ++i) {
+    logger.write(&byte, 1);
+  }
+
+  // Needs more packets than a batch, the last ones on the next lap.
+  auto head = buffer->currentHead();
+  std::vector<char> data(60 * sizeof(Packet::data), 'x');
+  logger.write(data.data(), data.size());
+  EXPECT_EQ(logger.droppedWrites(), 1);
+  EXPECT_EQ(head.stepsTo(buffer->currentHead()), 0);
+
+  // Never fits.
+  buffer->publish(claim);
+  std::vector<char> huge(65 * sizeof(Packet::data), 'x');
+  logger.write(huge.data(), huge.size());
+  EXPECT_EQ(logger.droppedWrites(), 2);
+  EXPECT_EQ(head.stepsTo(buffer->currentHead()), 0);
+
+  logger.write(data.data(), data.size());
+  EXPECT_EQ(logger.droppedWrites(), 2);
+  EXPECT_EQ(head.stepsTo(buffer->currentHead()), 60);
+  PacketLogger::setBlocking(true);
+}
+
+TEST(Logger, testOversizedRecordIsDropped) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(4);
+  auto records = RecordBuffer::allocate(1024 * 1024);
+  PacketLogger logger(
+      [&]() -> PacketBuffer& { return *buffer; },
+      [&]() { return records.get(); });
+
+  auto head = records->currentHead();
+  std::vector<char> data(RecordBuffer::kMaxRecordSize + 1, 'x');
+  auto cursor = logger.writeAndGetCursor(data.data(), data.size());
+  EXPECT_EQ(logger.droppedWrites(), 1);
+  EXPECT_EQ(head.stepsTo(records->currentHead()), 0);
+  EXPECT_EQ(head.stepsTo(cursor), 0);
+
+  logger.write(data.data(), RecordBuffer::kMaxRecordSize);
+  EXPECT_EQ(logger.droppedWrites(), 1);
+}
+
+TEST(Logger, testOnlyRecordsUseTheCompactLayout) {
+  entries::StandardEntry entry{
+      .id = 0,
+      .type = entries::EntryType::MARK_PUSH,
+      .timestamp = 12345678901234,
+      .tid = 12345,
+      .callid = 1,
+      .matchid = 2,
+      .extra = 3,
+  };
+
+  PacketBufferHolder buffer = PacketBuffer::allocate(64);
+  Logger packet_logger([&]() -> PacketBuffer& { return *buffer; });
+  auto head = buffer->currentHead();
+  entry.id = packet_logger.write(entries::StandardEntry(entry));
+  Packet packet;
+  ASSERT_TRUE(buffer->tryRead(packet, head));
+  EXPECT_EQ(
+      static_cast<uint8_t>(packet.data[0]),
+      uint8_t{entries::StandardEntry::kSerializationType});
+  EXPECT_EQ(packet.size, entries::StandardEntry::calculateSize(entry));
+
+  auto records = RecordBuffer::allocate(64 * 1024);
+  Logger record_logger(
+      [&]() -> PacketBuffer& { return *buffer; },
+      [&]() { return records.get(); });
+  auto record_head = records->currentHead();
+  entry.id = record_logger.write(entries::StandardEntry(entry));
+  char record[64];
+  uint32_t size = 0;
+  ASSERT_TRUE(records->tryRead(record, sizeof(record), record_head, size));
+  EXPECT_EQ(
+      static_cast<uint8_t>(record[0]),
+      uint8_t{entries::StandardEntry::kCompactSerializationType});
+  EXPECT_EQ(size, entries::StandardEntry::calculateCompactSize(entry));
+}
+
+TEST(Logger, testCursorWritesKeepTheThreadMode) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(64);
+  Logger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  Logger::setBlockingWrites(false);
+  TraceBuffer::Cursor cursor = buffer->currentHead();
+  logger.writeAndGetCursor(
+      entries::StandardEntry{
+          .id = 0,
+          .type = entries::EntryType::TRACE_START,
+          .timestamp = 1,
+          .tid = 0,
+          .callid = 0,
+          .matchid = 0,
+          .extra = 0,
+      },
+      cursor);
+  EXPECT_FALSE(PacketLogger::isBlocking());
+  Logger::setBlockingWrites(true);
+  EXPECT_TRUE(PacketLogger::isBlocking());
+}
+
+TEST(Logger, testNonBlockingModeIsPerThread) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(4);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  auto claim = buffer->claim();
+  char data = 'x';
+  for (int i = 0; i < 3; ++i) {
+    logger.write(&data, 1);
+  }
+
+  std::thread([&] {
+    PacketLogger::setBlocking(false);
+    logger.write(&data, 1);
+  }).join();
+  EXPECT_EQ(logger.droppedWrites(), 1);
+
+  // Blocks on the held slot instead of dropping the write.
+  std::thread blocking([&] { logger.write(&data, 1); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  buffer->publish(claim);
+  blocking.join();
+  EXPECT_EQ(logger.droppedWrites(), 1);
+}
+
+namespace {
+
+class AnnotationVisitor : public entries::EntryVisitor {
+ public:
+  std::vector<int64_t> dropped;
+
+  void visit(const entries::StandardEntry& entry) override {
+    if (entry.type == entries::EntryType::TRACE_ANNOTATION &&
+        entry.callid == QuickLogConstants::LOGGER_ERR_DROPPED_WRITES) {
+      dropped.push_back(entry.extra);
+    }
+  }
+
+  void visit(const entries::FramesEntry&) override {}
+  void visit(const entries::BytesEntry&) override {}
+};
+
+} // namespace
+
+TEST(Logger, testDroppedWritesArePerTrace) {
+  PacketBufferHolder buffer = PacketBuffer::allocate(64);
+  Logger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  // Drops one write: the slot it lands on is still held from the last lap.
+  auto dropWrite = [&] {
+    auto claim = buffer->claim();
+    for (int i = 0; i < 63; ++i) {
+      logger.writeTraceAnnotation(0, 0);
+    }
+    Logger::setBlockingWrites(false);
+    logger.writeTraceAnnotation(0, 0);
+    Logger::setBlockingWrites(true);
+    buffer->publish(claim);
+  };
+
+  logger.startCountingDroppedWrites(1);
+  dropWrite();
+  logger.startCountingDroppedWrites(2);
+  dropWrite();
+  auto start = buffer->currentHead();
+  logger.writeDroppedWritesAnnotation(2);
+  logger.writeDroppedWritesAnnotation(1);
+  // Unknown or already annotated traces get nothing.
+  logger.writeDroppedWritesAnnotation(1);
+
+  AnnotationVisitor visitor;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    entries::EntryParser::parse(data, size, visitor);
+  });
+  Packet packet;
+  for (auto cursor = start; buffer->tryRead(packet, cursor);
+       cursor.moveForward()) {
+    reassembler.process(packet);
+  }
+  std::vector<int64_t> expected{1, 2};
+  EXPECT_EQ(visitor.dropped, expected);
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,214 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/PacketReassembler.h>
+
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace profilo {
+
+using namespace logger;
+using namespace writer;
+
+namespace {
+
+constexpr size_t kStreams = 500;
+
+std::vector<char> payloadFor(StreamID stream) {
+  // Between 1 and 8 packets, with a partial last packet most of the time.
+  std::vector<char> payload((stream % 8) * sizeof(Packet::data) + stream % 53);
+  if (payload.empty()) {
+    payload.resize(1);
+  }
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<char>(stream * 31 + i);
+  }
+  return payload;
+}
+
+std::vector<Packet> packetize(StreamID stream, std::vector<char> const& data) {
+  std::vector<Packet> packets;
+  for (size_t offset = 0; offset < data.size();
+       offset += sizeof(Packet::data)) {
+    Packet packet{};
+    packet.stream = stream;
+    packet.start = offset == 0;
+    packet.size = std::min(sizeof(Packet::data), data.size() - offset);
+    packet.next = offset + packet.size < data.size();
+    std::memcpy(packet.data, data.data() + offset, packet.size);
+    packets.push_back(packet);
+  }
+  return packets;
+}
+
+//
+// Interleaves the packets of kStreams streams, keeping the order within
+// each stream, the way concurrent writers would.
+//
+std::vector<Packet> interleave(std::vector<std::vector<Packet>> streams) {
+  std::mt19937 rng(42);
+  std::vector<size_t> positions(streams.size());
+  std::vector<size_t> pending(streams.size());
+  for (size_t i = 0; i < streams.size(); ++i) {
+    pending[i] = i;
+  }
+  std::vector<Packet> packets;
+  while (!pending.empty()) {
+    auto pick = rng() % pending.size();
+    auto idx = pending[pick];
+    packets.push_back(streams[idx][positions[idx]++]);
+    if (positions[idx] == streams[idx].size()) {
+      pending[pick] = pending.back();
+      pending.pop_back();
+    }
+  }
+  return packets;
+}
+
+struct InterleavedStreams {
+  std::vector<std::vector<char>> payloads;
+  std::vector<Packet> packets;
+
+  explicit InterleavedStreams(StreamID first_stream = 1) {
+    std::vector<std::vector<Packet>> streams;
+    for (StreamID i = 0; i < kStreams; ++i) {
+      payloads.push_back(payloadFor(first_stream + i));
+      streams.push_back(packetize(first_stream + i, payloads.back()));
+    }
+    packets = interleave(std::move(streams));
+  }
+};
+
+} // namespace
+
+TEST(PacketReassemblerTest, testInterleavedStreams) {
+  InterleavedStreams input;
+  std::vector<std::string> seen;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    seen.emplace_back(static_cast<const char*>(data), size);
+  });
+
+  for (auto const& packet : input.packets) {
+    reassembler.process(packet);
+  }
+
+  ASSERT_EQ(seen.size(), kStreams) << "must read every payload once";
+  std::vector<std::string> expected;
+  for (auto const& payload : input.payloads) {
+    expected.emplace_back(payload.begin(), payload.end());
+  }
+  std::sort(seen.begin(), seen.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(seen, expected);
+}
+
+TEST(PacketReassemblerTest, testInterleavedStreamsBackwards) {
+  InterleavedStreams input;
+  std::vector<std::string> seen;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    seen.emplace_back(static_cast<const char*>(data), size);
+  });
+
+  for (auto it = input.packets.rbegin(); it != input.packets.rend(); ++it) {
+    reassembler.processBackwards(*it);
+  }
+
+  ASSERT_EQ(seen.size(), kStreams) << "must read every payload once";
+  std::vector<std::string> expected;
+  for (auto const& payload : input.payloads) {
+    expected.emplace_back(payload.begin(), payload.end());
+  }
+  std::sort(seen.begin(), seen.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(seen, expected);
+}
+
+TEST(PacketReassemblerTest, testReusedStreamIds) {
+  // Every round reuses the stream IDs of the previous one, so the table
+  // keeps erasing and inserting the same keys.
+  size_t calls = 0;
+  size_t bytes = 0;
+  PacketReassembler reassembler([&](const void*, size_t size) {
+    ++calls;
+    bytes += size;
+  });
+
+  size_t expected_bytes = 0;
+  for (int round = 0; round < 20; ++round) {
+    InterleavedStreams input;
+    for (auto const& packet : input.packets) {
+      reassembler.process(packet);
+    }
+    for (auto const& payload : input.payloads) {
+      expected_bytes += payload.size();
+    }
+  }
+  EXPECT_EQ(calls, 20 * kStreams);
+  EXPECT_EQ(bytes, expected_bytes);
+}
+
+TEST(PacketReassemblerTest, testStreamsCutOffAtTheStart) {
+  //
+  // The read starts in the middle of some payloads. Their remaining
+  // packets must be ignored without affecting the streams around them.
+  //
+  InterleavedStreams input;
+  std::vector<bool> started(kStreams + 1);
+  std::vector<Packet> packets;
+  for (size_t i = input.packets.size() / 3; i < input.packets.size(); ++i) {
+    packets.push_back(input.packets[i]);
+    if (packets.back().start) {
+      started[packets.back().stream] = true;
+    }
+  }
+
+  size_t expected = 0;
+  for (StreamID i = 1; i <= kStreams; ++i) {
+    expected += started[i];
+  }
+
+  size_t calls = 0;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    auto first = static_cast<const char*>(data)[0];
+    auto stream = static_cast<StreamID>(
+        std::find_if(
+            input.payloads.begin(),
+            input.payloads.end(),
+            [&](std::vector<char> const& payload) {
+              return payload.size() == size && payload[0] == first &&
+                  std::memcmp(payload.data(), data, size) == 0;
+            }) -
+        input.payloads.begin());
+    ASSERT_LT(stream, kStreams) << "payload must match a written one";
+    EXPECT_TRUE(started[stream + 1]) << "cut off payload must be ignored";
+    ++calls;
+  });
+  for (auto const& packet : packets) {
+    reassembler.process(packet);
+  }
+  EXPECT_EQ(calls, expected);
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,171 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <profilo/PacketLogger.h>
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
+
+namespace facebook {
+namespace profilo {
+
+using namespace logger;
+
+using Generation = ResizableTraceBuffer::Generation;
+
+struct ResizableLogger {
+  explicit ResizableLogger(size_t slots)
+      : buffer(slots),
+        logger(
+            [this]() -> PacketBuffer& { return buffer.current(); },
+            []() -> RecordBuffer* { return nullptr; },
+            [this]() -> ResizableTraceBuffer* { return &buffer; }) {}
+
+  ResizableTraceBuffer buffer;
+  PacketLogger logger;
+};
+
+//
+// Counts the packets with a payload in the generation and every generation
+// after it. Sealed generations are read up to their end, the current one
+// up to its head.
+//
+size_t countPayloadPackets(std::shared_ptr<Generation> generation) {
+  size_t count = 0;
+  while (true) {
+    auto& buffer = generation->buffer();
+    bool sealed = generation->isSealed();
+    auto end = sealed ? generation->end() : buffer.currentHead();
+    Packet packet;
+    for (auto cursor = buffer.begin(); cursor < end; cursor.moveForward()) {
+      EXPECT_TRUE(buffer.tryRead(packet, cursor));
+      if (packet.size > 0) {
+        ++count;
+      }
+    }
+    if (!sealed) {
+      return count;
+    }
+    generation = generation->next();
+  }
+}
+
+TEST(ResizableTraceBuffer, testResizeSealsPreviousGeneration) {
+  ResizableLogger test(10);
+  auto& buffer = test.buffer;
+  auto& logger = test.logger;
+  auto first = buffer.acquire();
+
+  char payload[] = "abc";
+  for (int i = 0; i < 3; ++i) {
+    logger.write(payload, sizeof(payload));
+  }
+  EXPECT_FALSE(first->isSealed());
+
+  buffer.resize(20);
+  auto second = buffer.acquire();
+  ASSERT_TRUE(first->isSealed());
+  EXPECT_EQ(first->next(), second);
+  EXPECT_FALSE(second->isSealed());
+  EXPECT_EQ(second->buffer().capacity(), 20);
+
+  // Three writes and the empty packet that wakes up readers.
+  auto end = first->buffer().begin();
+  end.moveForward(4);
+  EXPECT_FALSE(end < first->end());
+  EXPECT_FALSE(first->end() < end);
+  EXPECT_TRUE(first->end() < second->buffer().begin())
+      << "generations must not share tickets";
+}
+
+TEST(ResizableTraceBuffer, testRetiredGenerationStaysReadable) {
+  ResizableLogger test(10);
+  auto& buffer = test.buffer;
+  auto& logger = test.logger;
+  auto first = buffer.acquire();
+
+  char payload[] = "abc";
+  logger.write(payload, sizeof(payload));
+  buffer.resize(5);
+  logger.write(payload, sizeof(payload));
+  buffer.resize(40);
+  logger.write(payload, sizeof(payload));
+
+  EXPECT_EQ(countPayloadPackets(first), 3);
+
+  Packet packet;
+  ASSERT_TRUE(first->buffer().tryRead(packet, first->buffer().begin()));
+  EXPECT_EQ(std::memcmp(packet.data, payload, sizeof(payload)), 0);
+}
+
+TEST(ResizableTraceBuffer, testOldCursorsDoNotReadNewGeneration) {
+  ResizableLogger test(10);
+  auto& buffer = test.buffer;
+  auto& logger = test.logger;
+
+  char payload[] = "abc";
+  auto cursor = logger.writeAndGetCursor(payload, sizeof(payload));
+  buffer.resize(10);
+  logger.write(payload, sizeof(payload));
+
+  Packet packet;
+  EXPECT_FALSE(buffer.current().tryRead(packet, cursor));
+}
+
+TEST(ResizableTraceBuffer, testNoWritesLostAcrossConcurrentResizes) {
+  constexpr auto kThreads = 4;
+  constexpr auto kWrites = 2000;
+  constexpr auto kResizes = 20;
+  // Large enough that no generation wraps around.
+  constexpr auto kSlots = 2 * kThreads * kWrites;
+
+  ResizableLogger test(kSlots);
+  auto& buffer = test.buffer;
+  auto& logger = test.logger;
+  auto first = buffer.acquire();
+
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&] {
+      while (!go.load()) {
+      }
+      char payload[] = "abc";
+      for (int i = 0; i < kWrites; ++i) {
+        logger.write(payload, sizeof(payload));
+      }
+    });
+  }
+
+  go.store(true);
+  for (int i = 0; i < kResizes; ++i) {
+    buffer.resize(kSlots + i);
+    std::this_thread::yield();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(countPayloadPackets(first), kThreads * kWrites);
+}
+
+} // namespace profilo
+} // namespace facebook
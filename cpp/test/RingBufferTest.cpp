@@ -0,0 +1,97 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+
+#include <profilo/logger/buffer/RingBuffer.h>
+
+namespace facebook {
+namespace profilo {
+
+using namespace logger;
+
+class RingBufferTest : public ::testing::TestWithParam<int> {
+ protected:
+  ~RingBufferTest() override {
+    RingBuffer::destroy();
+  }
+};
+
+void expectWritable(TraceBuffer& buffer, size_t slots) {
+  EXPECT_EQ(buffer.capacity(), slots);
+
+  // Go around the buffer twice to touch every slot.
+  Packet packet{};
+  for (size_t i = 0; i < 2 * slots; ++i) {
+    packet.stream = i;
+    buffer.write(packet);
+  }
+
+  Packet read;
+  ASSERT_TRUE(buffer.tryRead(read, buffer.currentTail()));
+  EXPECT_EQ(read.stream, slots);
+}
+
+TEST_P(RingBufferTest, testInitWithFlags) {
+  constexpr size_t kSlots = 5000;
+  auto& buffer = RingBuffer::init(kSlots, GetParam());
+  EXPECT_EQ(&buffer, &RingBuffer::get());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&buffer) % sysconf(_SC_PAGESIZE), 0)
+      << "buffers allocated with flags are mapped separately";
+  expectWritable(buffer, kSlots);
+
+  RingBuffer::destroy();
+  EXPECT_EQ(RingBuffer::get().capacity(), 1);
+}
+
+TEST_P(RingBufferTest, testInitAtAddressWithFlags) {
+  constexpr size_t kSlots = 5000;
+  constexpr size_t kOffset = 128;
+  auto size = kOffset + TraceBuffer::allocationSize(kSlots);
+  auto map = mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  ASSERT_NE(map, MAP_FAILED);
+
+  auto ptr = static_cast<char*>(map) + kOffset;
+  auto& buffer = RingBuffer::init(ptr, kSlots, GetParam());
+  EXPECT_EQ(reinterpret_cast<void*>(&buffer), ptr);
+  expectWritable(buffer, kSlots);
+
+  RingBuffer::destroy();
+  munmap(map, size);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    AllocationFlags,
+    RingBufferTest,
+    ::testing::Values(
+        RingBuffer::PREFAULT,
+        RingBuffer::HUGE_PAGES,
+        RingBuffer::LOCKED,
+        RingBuffer::PREFAULT | RingBuffer::HUGE_PAGES | RingBuffer::LOCKED));
+
+} // namespace profilo
+} // namespace facebook
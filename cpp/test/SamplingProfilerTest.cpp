@@ -51,19 +51,19 @@ class SamplingProfilerTestAccessor {
     return profiler_.state_.isProfiling.load();
   }
 
-  bool isLoggerLoopDone() const {
-    return profiler_.state_.isLoggerLoopDone.load();
+  bool isLoggerStopping() const {
+    return profiler_.state_.scheduler.stopping();
   }
 
   int countSlotsWithPredicate(std::function<bool(StackSlot const&)> pred) {
+    auto& stacks = profiler_.state_.stacks;
+    auto slots = stacks.slots();
     return std::count_if(
-        std::begin(profiler_.state_.stacks),
-        std::end(profiler_.state_.stacks),
-        pred);
+        slots, slots + stacks.ringCount() * stacks.slotsPerRing(), pred);
   }
 
-  StackSlot const* getSlots() {
-    return profiler_.state_.stacks;
+  StackSlot const* getThreadSlots(int32_t tid) {
+    return profiler_.state_.stacks.threadSlots(tid);
   }
 
  private:
@@ -787,9 +787,9 @@ TEST_F(SamplingProfilerTest, stopProfilingWhileExecutingTracer) {
   ASSERT_TRUE(access.isProfiling());
   sequencer.advance(STOP_PROFILING);
 
-  while (!access.isLoggerLoopDone()) {
+  while (!access.isLoggerStopping()) {
     // Give the control thread a chance to enter stopProfiling(),
-    // isLoggerLoopDone becoming true is part of the tear down, before we're
+    // the logger stopping is part of the tear down, before we're
     // supposed to block.
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
@@ -850,7 +850,9 @@ TEST_F(SamplingProfilerTest, nestedFaultingTracersUnstackProperly) {
       kDefaultUseWallClockSetting));
 
   // Target thread that will receive the profiling signal.
+  std::atomic<int32_t> worker_tid{0};
   std::thread worker_thread([&] {
+    worker_tid = threadID();
     sequencer.waitAndAdvance(START_WORKER_THREAD, SEND_PROFILING_SIGNAL);
 
     sequencer.waitAndAdvance(END_WORKER_THREAD, END);
@@ -985,8 +987,9 @@ TEST_F(SamplingProfilerTest, nestedFaultingTracersUnstackProperly) {
   // the fault handler. Therefore, the earliest slot should exit last and have
   // the highest timestamp. We can use strict inequality because we arrange the
   // exit times to be at least 1ms apart.
-  EXPECT_GT(access.getSlots()[0].time, access.getSlots()[1].time);
-  EXPECT_GT(access.getSlots()[1].time, access.getSlots()[2].time);
+  auto worker_slots = access.getThreadSlots(worker_tid);
+  EXPECT_GT(worker_slots[0].time, worker_slots[1].time);
+  EXPECT_GT(worker_slots[1].time, worker_slots[2].time);
 
   worker_thread.join();
 
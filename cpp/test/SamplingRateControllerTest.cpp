@@ -0,0 +1,136 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <profiler/SamplingRateController.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+constexpr size_t kRingSize = 8;
+constexpr int64_t kNanosecondsInMicrosecond = 1000;
+
+SamplingWindow calmWindow() {
+  return SamplingWindow{100, 100 * kNanosecondsInMicrosecond, 0, 1, kRingSize};
+}
+
+} // namespace
+
+TEST(SamplingRateControllerTest, testFixedWithoutBounds) {
+  SamplingRateController controller;
+  controller.reset(10, 0, 0);
+  EXPECT_FALSE(controller.enabled());
+  EXPECT_FALSE(controller.update(SamplingWindow{1, 0, 100, 8, kRingSize}));
+  EXPECT_EQ(controller.intervalMs(), 10);
+
+  controller.reset(10, 20, 5);
+  EXPECT_FALSE(controller.enabled());
+  EXPECT_EQ(controller.intervalMs(), 10);
+}
+
+TEST(SamplingRateControllerTest, testStartsWithinBounds) {
+  SamplingRateController controller;
+  controller.reset(1, 5, 20);
+  EXPECT_TRUE(controller.enabled());
+  EXPECT_EQ(controller.intervalMs(), 5);
+
+  controller.reset(50, 5, 20);
+  EXPECT_EQ(controller.intervalMs(), 20);
+}
+
+TEST(SamplingRateControllerTest, testBacksOffOnSlotMisses) {
+  SamplingRateController controller;
+  controller.reset(10, 5, 20);
+
+  auto window = calmWindow();
+  window.slot_misses = 1;
+  EXPECT_TRUE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 15);
+  EXPECT_TRUE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 20);
+  EXPECT_FALSE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 20);
+}
+
+TEST(SamplingRateControllerTest, testBacksOffOnBacklog) {
+  SamplingRateController controller;
+  controller.reset(10, 5, 20);
+
+  auto window = calmWindow();
+  window.max_occupancy = kRingSize / 2 + 1;
+  EXPECT_TRUE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 15);
+}
+
+TEST(SamplingRateControllerTest, testBacksOffOnHandlerCost) {
+  SamplingRateController controller;
+  controller.reset(10, 5, 40);
+
+  // 1ms per sample is 10% of a 10ms interval.
+  auto window = calmWindow();
+  window.handler_time_ns = window.samples * 1000 * kNanosecondsInMicrosecond;
+  EXPECT_TRUE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 15);
+  EXPECT_TRUE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 22);
+  // 1ms is under 5% of 22ms.
+  EXPECT_FALSE(controller.update(window));
+  EXPECT_EQ(controller.intervalMs(), 22);
+}
+
+TEST(SamplingRateControllerTest, testSpeedsUpAfterCalmWindows) {
+  SamplingRateController controller;
+  controller.reset(16, 5, 20);
+
+  EXPECT_FALSE(controller.update(calmWindow()));
+  EXPECT_EQ(controller.intervalMs(), 16);
+  EXPECT_TRUE(controller.update(calmWindow()));
+  EXPECT_EQ(controller.intervalMs(), 12);
+
+  // Anything but calm starts the count over.
+  auto busy = calmWindow();
+  busy.max_occupancy = 3;
+  EXPECT_FALSE(controller.update(calmWindow()));
+  EXPECT_FALSE(controller.update(busy));
+  EXPECT_FALSE(controller.update(calmWindow()));
+  EXPECT_EQ(controller.intervalMs(), 12);
+  EXPECT_TRUE(controller.update(calmWindow()));
+  EXPECT_EQ(controller.intervalMs(), 9);
+
+  for (int i = 0; i < 10; ++i) {
+    controller.update(calmWindow());
+  }
+  EXPECT_EQ(controller.intervalMs(), 5);
+}
+
+TEST(SamplingRateControllerTest, testIdleWindowsAreCalm) {
+  SamplingRateController controller;
+  controller.reset(20, 5, 20);
+
+  SamplingWindow idle{0, 0, 0, 0, kRingSize};
+  EXPECT_FALSE(controller.update(idle));
+  EXPECT_TRUE(controller.update(idle));
+  EXPECT_EQ(controller.intervalMs(), 15);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,423 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profiler/LoggerScheduler.h>
+#include <profiler/StackSlotPool.h>
+#include <util/common.h>
+
+namespace facebook {
+namespace profilo {
+namespace profiler {
+
+namespace {
+
+constexpr uint32_t kTid = 1234;
+
+uint32_t committed(uint32_t tid, StackCollectionRetcode retcode) {
+  return (tid << 16) | retcode;
+}
+
+std::vector<int64_t> drainTimes(StackSlotPool& pool) {
+  std::vector<int64_t> times;
+  pool.drain([&](StackSlot& slot, uint32_t) { times.push_back(slot.time); });
+  return times;
+}
+
+} // namespace
+
+TEST(StackSlotPoolTest, testDrainsInAcquisitionOrder) {
+  StackSlotPool pool;
+  pool.reset(4, 4);
+
+  std::vector<int64_t> times;
+  for (int i = 0; i < 3; ++i) {
+    auto slot = pool.acquire(kTid);
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(
+        slot->state.load(),
+        (kTid << 16) | StackSlotState::BUSY_WITH_METADATA);
+    slot->time = i;
+    slot->state.store(committed(kTid, SUCCESS));
+    times.push_back(i);
+  }
+
+  EXPECT_EQ(drainTimes(pool), times);
+  EXPECT_TRUE(drainTimes(pool).empty());
+}
+
+TEST(StackSlotPoolTest, testSlotsHaveTheirOwnNames) {
+  StackSlotPool pool;
+  pool.reset(1, 2);
+
+  auto first = pool.acquire(kTid);
+  auto second = pool.acquire(kTid);
+  for (auto slot : {first, second}) {
+    EXPECT_EQ(slot->names.capacity, MAX_NAMED_FRAMES);
+    EXPECT_EQ(slot->names.count, 0);
+  }
+  EXPECT_NE(first->names.depths, second->names.depths);
+  EXPECT_NE(first->names.method_names, second->names.method_names);
+  EXPECT_NE(first->names.class_descriptors, second->names.class_descriptors);
+}
+
+TEST(StackSlotPoolTest, testFullPoolMissesUntilDrained) {
+  StackSlotPool pool;
+  pool.reset(2, 3);
+  ASSERT_EQ(pool.slotsPerRing(), 4);
+
+  for (int i = 0; i < 8; ++i) {
+    auto slot = pool.acquire(kTid);
+    ASSERT_NE(slot, nullptr);
+    slot->state.store(committed(kTid, SUCCESS));
+  }
+  EXPECT_EQ(pool.acquire(kTid), nullptr);
+  EXPECT_EQ(pool.acquire(kTid + 1), nullptr);
+
+  EXPECT_EQ(drainTimes(pool).size(), 8);
+  EXPECT_NE(pool.acquire(kTid), nullptr);
+}
+
+TEST(StackSlotPoolTest, testFullRingBorrowsFromOtherRings) {
+  StackSlotPool pool;
+  pool.reset(2, 4);
+
+  // Holds up the drain of its ring, like a handler that got preempted.
+  auto stuck = pool.acquire(kTid);
+  for (int i = 0; i < 3; ++i) {
+    pool.acquire(kTid)->state.store(committed(kTid, SUCCESS));
+  }
+  EXPECT_TRUE(drainTimes(pool).empty());
+
+  auto borrowed = pool.acquire(kTid);
+  ASSERT_NE(borrowed, nullptr);
+  EXPECT_EQ(pool.findInnermost(kTid), borrowed);
+  borrowed->state.store(committed(kTid, SUCCESS));
+  EXPECT_EQ(pool.findInnermost(kTid), stuck);
+
+  EXPECT_EQ(drainTimes(pool).size(), 1);
+  stuck->state.store(committed(kTid, SUCCESS));
+  EXPECT_EQ(drainTimes(pool).size(), 4);
+}
+
+TEST(StackSlotPoolTest, testDrainWaitsForSlotsInFlight) {
+  StackSlotPool pool;
+  pool.reset(1, 4);
+
+  auto outer = pool.acquire(kTid);
+  auto inner = pool.acquire(kTid);
+  ASSERT_NE(outer, nullptr);
+  ASSERT_NE(inner, nullptr);
+  inner->state.store(committed(kTid, EMPTY_STACK));
+
+  EXPECT_TRUE(drainTimes(pool).empty());
+
+  outer->state.store(committed(kTid, SUCCESS));
+  EXPECT_EQ(drainTimes(pool).size(), 2);
+}
+
+TEST(StackSlotPoolTest, testDiscardedSlotsAreNotReported) {
+  StackSlotPool pool;
+  pool.reset(1, 4);
+
+  auto discarded = pool.acquire(kTid);
+  auto reported = pool.acquire(kTid);
+  discarded->state.store(StackSlotState::DISCARDED);
+  reported->state.store(committed(kTid, SUCCESS));
+
+  std::vector<StackSlot*> slots;
+  EXPECT_EQ(
+      pool.drain([&](StackSlot& slot, uint32_t) { slots.push_back(&slot); }),
+      2);
+  EXPECT_EQ(slots, std::vector<StackSlot*>{reported});
+}
+
+TEST(StackSlotPoolTest, testFullPoolSharesRings) {
+  StackSlotPool pool;
+  pool.reset(2, 4);
+
+  for (uint32_t tid = kTid; tid < kTid + 4; ++tid) {
+    auto slot = pool.acquire(tid);
+    ASSERT_NE(slot, nullptr);
+    slot->state.store(committed(tid, SUCCESS));
+  }
+
+  std::vector<uint32_t> tids;
+  pool.drain([&](StackSlot&, uint32_t state) { tids.push_back(state >> 16); });
+  std::sort(tids.begin(), tids.end());
+  EXPECT_EQ(tids, (std::vector<uint32_t>{kTid, kTid + 1, kTid + 2, kTid + 3}));
+}
+
+TEST(StackSlotPoolTest, testFindInnermostReturnsLatestBusySlot) {
+  StackSlotPool pool;
+  pool.reset(4, 4);
+
+  EXPECT_EQ(pool.findInnermost(kTid), nullptr);
+
+  auto outer = pool.acquire(kTid);
+  auto other = pool.acquire(kTid + 1);
+  auto inner = pool.acquire(kTid);
+  EXPECT_EQ(pool.findInnermost(kTid), inner);
+  EXPECT_EQ(pool.findInnermost(kTid + 1), other);
+
+  inner->state.store(committed(kTid, SIGNAL_INTERRUPT));
+  EXPECT_EQ(pool.findInnermost(kTid), outer);
+
+  outer->state.store(committed(kTid, SIGNAL_INTERRUPT));
+  EXPECT_EQ(pool.findInnermost(kTid), nullptr);
+}
+
+TEST(StackSlotPoolTest, testReleasesRingsOfExitedThreads) {
+  StackSlotPool pool;
+  pool.reset(1, 4);
+
+  uint32_t exited_tid = 0;
+  std::thread thread([&] {
+    exited_tid = threadID();
+    auto slot = pool.acquire(exited_tid);
+    slot->state.store(committed(exited_tid, SUCCESS));
+  });
+  thread.join();
+
+  // Rings with slots left to drain are kept.
+  EXPECT_EQ(pool.releaseExitedThreads(getpid()), 0);
+  EXPECT_EQ(drainTimes(pool).size(), 1);
+  EXPECT_EQ(pool.releaseExitedThreads(getpid()), 1);
+
+  // The ring is free for the next thread to claim.
+  auto slot = pool.acquire(threadID());
+  ASSERT_NE(slot, nullptr);
+  EXPECT_EQ(pool.threadSlots(threadID()), pool.slots());
+  slot->state.store(committed(threadID(), SUCCESS));
+  EXPECT_EQ(pool.releaseExitedThreads(getpid()), 0);
+}
+
+namespace {
+
+struct StressState {
+  StackSlotPool pool;
+  LoggerScheduler scheduler;
+  std::atomic<uint32_t> samples{0};
+};
+
+StressState* stress_state = nullptr;
+
+// Same slot handling as SamplingProfiler's signal handler.
+void stressSignalHandler(int) {
+  auto& state = *stress_state;
+  auto tid = threadID();
+  auto slot = state.pool.acquire(tid);
+  if (slot == nullptr) {
+    state.scheduler.flush();
+    return;
+  }
+  slot->frames[0] = tid;
+  slot->depth = 1;
+  slot->state.store(committed(tid, SUCCESS));
+  state.samples.fetch_add(1);
+  state.scheduler.onSample();
+}
+
+} // namespace
+
+//
+// Deterministic version of 64 threads sampled every 1ms with the shipped
+// pool size, stepping through one signal handler at a time. Each tick every
+// thread takes a sample; a few handlers per tick stay preempted with their
+// slot claimed for kStuckTicks ticks. Whenever LoggerScheduler would wake
+// the logger loop, the drain only happens kWakeupLag samples later, a whole
+// tick's worth, which is far slower than the loop ever is on a busy device.
+// Not a single sample may miss a slot.
+//
+TEST(StackSlotPoolTest, testNoSlotMissesWith64ThreadsAt1msSampling) {
+  constexpr int kThreads = 64;
+  constexpr int kTicks = 1000;
+  constexpr int kStuckHandlers = 4;
+  constexpr int kStuckTicks = 3;
+  constexpr uint32_t kWakeupLag = kThreads;
+
+  StackSlotPool pool;
+  pool.reset(DEFAULT_STACK_SLOT_RINGS, DEFAULT_STACK_SLOTS_PER_RING);
+  LoggerScheduler scheduler;
+  ASSERT_TRUE(scheduler.init());
+  scheduler.reset(FLUSH_STACKS_COUNT, pool.slotsPerRing() / 2);
+
+  std::vector<StackSlot*> held(kThreads, nullptr);
+  uint32_t handlers = 0;
+  uint32_t samples = 0;
+  uint32_t misses = 0;
+  uint32_t drained = 0;
+  uint32_t pending = 0;
+  int64_t drain_at = -1;
+  for (int tick = 0; tick < kTicks; ++tick) {
+    auto period = tick / kStuckTicks;
+    for (int i = 0; i < kThreads; ++i) {
+      auto tid = kTid + i;
+      bool stuck = false;
+      for (int j = 0; j < kStuckHandlers; ++j) {
+        stuck |= (period * 7 + j * 13) % kThreads == i;
+      }
+      if (held[i] != nullptr) {
+        if (stuck) {
+          continue;
+        }
+        held[i]->state.store(committed(tid, SUCCESS));
+        held[i] = nullptr;
+      }
+
+      ++handlers;
+      auto slot = pool.acquire(tid);
+      if (slot == nullptr) {
+        ++misses;
+        scheduler.flush();
+        if (drain_at < 0) {
+          drain_at = handlers + kWakeupLag;
+        }
+      } else {
+        slot->frames[0] = tid;
+        slot->depth = 1;
+        if (stuck) {
+          held[i] = slot;
+        } else {
+          slot->state.store(committed(tid, SUCCESS));
+        }
+        ++samples;
+        scheduler.onSample();
+        if (drain_at < 0 && ++pending >= scheduler.batch()) {
+          drain_at = handlers + kWakeupLag;
+        }
+      }
+
+      if (drain_at >= 0 && handlers >= drain_at) {
+        ASSERT_TRUE(scheduler.wait() & LoggerScheduler::FLUSH);
+        scheduler.onFlush(pool.maxOccupancy(), pool.slotsPerRing());
+        drained += pool.drain([](StackSlot&, uint32_t) {});
+        pending = 0;
+        drain_at = -1;
+      }
+    }
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    if (held[i] != nullptr) {
+      held[i]->state.store(committed(kTid + i, SUCCESS));
+    }
+  }
+  drained += pool.drain([](StackSlot&, uint32_t) {});
+
+  EXPECT_GT(samples, 0);
+  EXPECT_EQ(misses, 0);
+  EXPECT_EQ(drained, samples);
+}
+
+//
+// Mirrors wall-clock sampling of many threads with the shipped pool size:
+// every thread gets a SIGPROF from its own 1ms timer and a single thread
+// drains the slots whenever LoggerScheduler wakes it up, like the logger
+// loop. Checks that every sample is drained intact; whether slots run out
+// depends on how the host schedules the drainer, which the deterministic
+// test above covers.
+//
+TEST(StackSlotPoolTest, testConcurrentSamplingDrainsEverySample) {
+  constexpr int kThreads = 64;
+  constexpr auto kSamplingRate = std::chrono::milliseconds(1);
+  constexpr auto kDuration = std::chrono::milliseconds(500);
+
+  StressState state;
+  state.pool.reset(DEFAULT_STACK_SLOT_RINGS, DEFAULT_STACK_SLOTS_PER_RING);
+  ASSERT_TRUE(state.scheduler.init());
+  state.scheduler.reset(FLUSH_STACKS_COUNT, state.pool.slotsPerRing() / 2);
+  stress_state = &state;
+
+  struct sigaction act {};
+  act.sa_handler = stressSignalHandler;
+  act.sa_flags = SA_RESTART;
+  struct sigaction old_act {};
+  ASSERT_EQ(sigaction(SIGPROF, &act, &old_act), 0);
+
+  std::atomic<uint32_t> drained{0};
+  std::atomic<uint32_t> wrong_frames{0};
+  std::thread drainer([&] {
+    uint32_t events;
+    do {
+      events = state.scheduler.wait();
+      if (events & (LoggerScheduler::FLUSH | LoggerScheduler::STOP)) {
+        state.scheduler.onFlush(
+            state.pool.maxOccupancy(), state.pool.slotsPerRing());
+        drained += state.pool.drain([&](StackSlot& slot, uint32_t slot_state) {
+          if (slot.depth != 1 || slot.frames[0] != (slot_state >> 16)) {
+            ++wrong_frames;
+          }
+        });
+      }
+    } while (!(events & LoggerScheduler::STOP));
+  });
+
+  std::atomic_bool stop{false};
+  std::vector<std::thread> threads;
+  std::atomic_int running{0};
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&] {
+      timer_t timer;
+      struct sigevent sigev {};
+      sigev.sigev_notify = SIGEV_THREAD_ID;
+      sigev.sigev_signo = SIGPROF;
+      sigev._sigev_un._tid = threadID();
+      ASSERT_EQ(timer_create(CLOCK_MONOTONIC, &sigev, &timer), 0);
+
+      struct itimerspec spec {};
+      spec.it_interval.tv_nsec =
+          std::chrono::nanoseconds(kSamplingRate).count();
+      spec.it_value = spec.it_interval;
+      ASSERT_EQ(timer_settime(timer, 0, &spec, nullptr), 0);
+
+      ++running;
+      while (!stop) {
+        pause();
+      }
+      timer_delete(timer);
+    });
+  }
+
+  std::this_thread::sleep_for(kDuration);
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  state.scheduler.stop();
+  drainer.join();
+
+  ASSERT_EQ(sigaction(SIGPROF, &old_act, nullptr), 0);
+  stress_state = nullptr;
+
+  EXPECT_EQ(running.load(), kThreads);
+  EXPECT_GT(state.samples.load(), 0);
+  EXPECT_EQ(drained.load(), state.samples.load());
+  EXPECT_EQ(wrong_frames.load(), 0);
+}
+
+} // namespace profiler
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,222 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profilo/Logger.h>
+#include <profilo/StringTable.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/logger/lfrb/LockFreeRingBuffer.h>
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+
+using namespace logger;
+using namespace writer;
+
+namespace {
+
+uint32_t intern(StringTable& table, const std::string& string) {
+  return table.intern(
+      reinterpret_cast<const uint8_t*>(string.data()), string.size());
+}
+
+std::string lookup(const StringTable& table, uint32_t id) {
+  auto string = table.lookup(id);
+  return std::string(reinterpret_cast<const char*>(string.data), string.size);
+}
+
+class EntryCollector : public EntryVisitor {
+ public:
+  std::vector<StandardEntry> standard;
+  std::vector<std::string> bytes;
+
+  void visit(const StandardEntry& entry) override {
+    standard.push_back(entry);
+  }
+
+  void visit(const FramesEntry&) override {}
+
+  void visit(const BytesEntry& entry) override {
+    bytes.emplace_back(
+        reinterpret_cast<const char*>(entry.bytes.values), entry.bytes.size);
+  }
+};
+
+} // namespace
+
+TEST(StringTableTest, testInternReturnsStableIds) {
+  StringTable table;
+  auto first = intern(table, "Choreographer#doFrame");
+  auto second = intern(table, "RV OnLayout");
+
+  EXPECT_NE(first, 0);
+  EXPECT_NE(second, 0);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(intern(table, "Choreographer#doFrame"), first);
+  EXPECT_EQ(intern(table, "RV OnLayout"), second);
+  EXPECT_EQ(lookup(table, first), "Choreographer#doFrame");
+  EXPECT_EQ(lookup(table, second), "RV OnLayout");
+}
+
+TEST(StringTableTest, testEmptyString) {
+  StringTable table;
+  auto id = intern(table, "");
+
+  EXPECT_NE(id, 0);
+  EXPECT_EQ(intern(table, ""), id);
+  EXPECT_NE(table.lookup(id).data, nullptr);
+  EXPECT_EQ(table.lookup(id).size, 0);
+}
+
+TEST(StringTableTest, testUnknownIds) {
+  StringTable table(16);
+  EXPECT_EQ(table.lookup(0).data, nullptr);
+  EXPECT_EQ(table.lookup(1).data, nullptr);
+  EXPECT_EQ(table.lookup(17).data, nullptr);
+}
+
+TEST(StringTableTest, testGivesUpWhenFull) {
+  StringTable table(4, 64);
+  auto too_long = std::string(StringTable::kMaxStringSize + 1, 'x');
+  EXPECT_EQ(intern(table, too_long), 0);
+
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < 8; ++i) {
+    ids.push_back(intern(table, "string " + std::to_string(i)));
+  }
+  // 4 slots, and room for 6 strings of 10 bytes with their size.
+  EXPECT_EQ(std::count(ids.begin(), ids.end(), 0), 4);
+  EXPECT_TRUE(table.full());
+  for (int i = 0; i < 8; ++i) {
+    if (ids[i] != 0) {
+      EXPECT_EQ(lookup(table, ids[i]), "string " + std::to_string(i));
+      // Full tables don't look strings up anymore, IDs stay valid.
+      EXPECT_EQ(intern(table, "string " + std::to_string(i)), 0);
+    }
+  }
+}
+
+TEST(StringTableTest, testFullOnceStorageRunsOut) {
+  StringTable table(16, 24);
+  EXPECT_NE(intern(table, "string 0"), 0);
+  EXPECT_NE(intern(table, "string 1"), 0);
+  EXPECT_FALSE(table.full());
+  EXPECT_EQ(intern(table, "string 2"), 0);
+  EXPECT_TRUE(table.full());
+  EXPECT_EQ(intern(table, "string 0"), 0);
+}
+
+TEST(StringTableTest, testInitSizesProcessTable) {
+  auto& table = StringTable::init(8, 64);
+  EXPECT_EQ(&StringTable::get(), &table);
+  // Only the first call takes effect.
+  EXPECT_EQ(&StringTable::init(), &table);
+}
+
+TEST(StringTableTest, testConcurrentInterning) {
+  StringTable table;
+  const int kThreads = 8;
+  const int kStrings = 500;
+  std::vector<std::vector<uint32_t>> ids(kThreads);
+  std::atomic<bool> go(false);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      while (!go.load()) {
+      }
+      for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < kStrings; ++i) {
+          auto id = intern(table, "section " + std::to_string(i));
+          if (round == 3) {
+            ids[t].push_back(id);
+          }
+        }
+      }
+    });
+  }
+  go.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // By the last round, every string is in the table with a single ID.
+  for (int i = 0; i < kStrings; ++i) {
+    ASSERT_NE(ids[0][i], 0);
+    EXPECT_EQ(lookup(table, ids[0][i]), "section " + std::to_string(i));
+    for (int t = 1; t < kThreads; ++t) {
+      EXPECT_EQ(ids[t][i], ids[0][i]);
+    }
+  }
+}
+
+TEST(StringTableTest, testLoggerWritesReferences) {
+  auto buffer = TraceBuffer::allocate(100);
+  Logger logger([&]() -> TraceBuffer& { return *buffer; });
+  auto cursor = buffer->currentHead();
+  const std::string name = "an interned name";
+  const std::string unique(StringTable::kMaxStringSize + 1, 'u');
+
+  logger.writeInternedBytes(
+      EntryType::STRING_NAME,
+      42,
+      reinterpret_cast<const uint8_t*>(name.data()),
+      name.size());
+  logger.setStringInterning(false);
+  logger.writeInternedBytes(
+      EntryType::STRING_NAME,
+      43,
+      reinterpret_cast<const uint8_t*>(name.data()),
+      name.size());
+  logger.setStringInterning(true);
+  logger.writeInternedBytes(
+      EntryType::STRING_VALUE,
+      44,
+      reinterpret_cast<const uint8_t*>(unique.data()),
+      unique.size());
+
+  EntryCollector entries;
+  PacketReassembler reassembler([&](const void* data, size_t size) {
+    EntryParser::parse(data, size, entries);
+  });
+  Packet packet;
+  while (buffer->tryRead(packet, cursor)) {
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+
+  ASSERT_EQ(entries.standard.size(), 1);
+  auto& reference = entries.standard[0];
+  EXPECT_EQ(reference.type, EntryType::STRING_REFERENCE);
+  EXPECT_EQ(reference.matchid, 42);
+  EXPECT_EQ(reference.extra, static_cast<int64_t>(EntryType::STRING_NAME));
+  EXPECT_EQ(
+      lookup(StringTable::get(), static_cast<uint32_t>(reference.callid)),
+      name);
+  EXPECT_EQ(entries.bytes, std::vector<std::string>({name, unique}));
+}
+
+} // namespace profilo
+} // namespace facebook
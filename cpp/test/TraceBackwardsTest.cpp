@@ -0,0 +1,246 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <time.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profilo/PacketLogger.h>
+#include <profilo/entries/Entry.h>
+#include <profilo/logger/buffer/CheckpointIndex.h>
+#include <profilo/writer/trace_backwards.h>
+
+namespace facebook {
+namespace profilo {
+
+using namespace entries;
+using namespace logger;
+using namespace writer;
+
+namespace {
+
+int64_t now() {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+class IdVisitor : public EntryVisitor {
+ public:
+  std::vector<int32_t> ids;
+
+  void visit(const StandardEntry& entry) override {
+    ids.push_back(entry.id);
+  }
+
+  void visit(const FramesEntry& entry) override {
+    ids.push_back(entry.id);
+  }
+
+  void visit(const BytesEntry& entry) override {
+    ids.push_back(entry.id);
+  }
+};
+
+} // namespace
+
+class TraceBackwardsTest : public ::testing::Test {
+ protected:
+  TraceBackwardsTest()
+      : buffer_(TraceBuffer::allocate(4096)),
+        logger_([this]() -> PacketBuffer& { return *buffer_; }) {}
+
+  ~TraceBackwardsTest() override {
+    CheckpointIndex::get().reset(nullptr);
+  }
+
+  TraceBufferHolder buffer_;
+  PacketLogger logger_;
+
+  TraceBuffer::Cursor write(
+      int32_t id,
+      EntryType type = EntryType::MARK_PUSH,
+      int64_t timestamp = now()) {
+    char payload[sizeof(StandardEntry) + 1]{};
+    StandardEntry entry{
+        .id = id,
+        .type = type,
+        .timestamp = timestamp,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = 0,
+    };
+    StandardEntry::pack(entry, payload, sizeof(payload));
+    return logger_.writeAndGetCursor(payload, sizeof(payload));
+  }
+};
+
+TEST_F(TraceBackwardsTest, testVisitsEntriesInOrder) {
+  for (int32_t id = 1; id <= 10; ++id) {
+    write(id);
+  }
+  auto cursor = write(11, EntryType::TRACE_BACKWARDS);
+
+  IdVisitor visitor;
+  traceBackwards(visitor, *buffer_, cursor);
+
+  std::vector<int32_t> expected{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(visitor.ids, expected);
+}
+
+TEST_F(TraceBackwardsTest, testStartsFromCheckpointBeforeWindow) {
+  CheckpointIndex::get().reset(&*buffer_);
+
+  // Tickets 0 and 256 get checkpoints in the first half, 512 in the second.
+  for (int32_t id = 1; id <= 300; ++id) {
+    write(id);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto window_start = now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  for (int32_t id = 301; id <= 600; ++id) {
+    write(id);
+  }
+  auto cursor = write(
+      601,
+      EntryType::TRACE_BACKWARDS,
+      window_start + kTraceBackdatingWindowUs * 1000);
+
+  IdVisitor visitor;
+  traceBackwards(visitor, *buffer_, cursor);
+
+  ASSERT_EQ(visitor.ids.size(), 600 - 256);
+  EXPECT_EQ(visitor.ids.front(), 257);
+  EXPECT_EQ(visitor.ids.back(), 600);
+}
+
+TEST_F(TraceBackwardsTest, testCheckpointsLongStreamsAtTheirStart) {
+  CheckpointIndex::get().reset(&*buffer_);
+  write(1);
+
+  // One stream from ticket 1 past ticket 256, claimed in one go.
+  std::vector<char> payload(300 * sizeof(Packet::data));
+  logger_.write(payload.data(), payload.size());
+
+  // Readers starting from the checkpoint get the whole stream.
+  TraceBuffer::Cursor cursor{0};
+  ASSERT_TRUE(CheckpointIndex::get().find(*buffer_, now(), cursor));
+  EXPECT_EQ(TraceBuffer::Cursor(0).stepsTo(cursor), 1);
+}
+
+TEST_F(TraceBackwardsTest, testCheckpointsOnlyCoverTheirBuffer) {
+  auto other = TraceBuffer::allocate(4096);
+  CheckpointIndex::get().reset(&*other);
+  for (int32_t id = 1; id <= 600; ++id) {
+    write(id);
+  }
+
+  TraceBuffer::Cursor cursor{0};
+  EXPECT_FALSE(CheckpointIndex::get().find(*buffer_, now(), cursor));
+  EXPECT_FALSE(CheckpointIndex::get().find(*other, now(), cursor));
+}
+
+class TraceBackwardsRecordTest : public ::testing::Test {
+ protected:
+  TraceBackwardsRecordTest()
+      : buffer_(TraceBuffer::allocate(1)),
+        records_(RecordBuffer::allocate(1024 * 1024)),
+        logger_(
+            [this]() -> PacketBuffer& { return *buffer_; },
+            [this]() { return records_.get(); }) {}
+
+  ~TraceBackwardsRecordTest() override {
+    CheckpointIndex::get().reset(nullptr);
+  }
+
+  static constexpr size_t kPayloadSize = sizeof(StandardEntry) + 1;
+
+  TraceBufferHolder buffer_;
+  RecordBufferHolder records_;
+  PacketLogger logger_;
+  std::vector<char> scratch_;
+
+  RecordBuffer::Cursor write(
+      int32_t id,
+      EntryType type = EntryType::MARK_PUSH,
+      int64_t timestamp = now()) {
+    char payload[kPayloadSize]{};
+    StandardEntry entry{
+        .id = id,
+        .type = type,
+        .timestamp = timestamp,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = 0,
+    };
+    StandardEntry::pack(entry, payload, sizeof(payload));
+    return logger_.writeAndGetCursor(payload, sizeof(payload));
+  }
+};
+
+TEST_F(TraceBackwardsRecordTest, testVisitsEntriesInOrder) {
+  for (int32_t id = 1; id <= 10; ++id) {
+    write(id);
+  }
+  auto cursor = write(11, EntryType::TRACE_BACKWARDS);
+
+  IdVisitor visitor;
+  traceBackwards(visitor, *records_, cursor, scratch_);
+
+  std::vector<int32_t> expected{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(visitor.ids, expected);
+}
+
+TEST_F(TraceBackwardsRecordTest, testStartsFromCheckpointBeforeWindow) {
+  CheckpointIndex::get().reset(records_.get());
+
+  auto span = RecordBuffer::recordSpan(kPayloadSize);
+  auto per_interval =
+      static_cast<int32_t>(CheckpointIndex::kRecordInterval / span);
+  // The record crossing into the second interval is the last checkpoint
+  // before the window.
+  auto first_half = per_interval * 3 / 2;
+  for (int32_t id = 1; id <= first_half; ++id) {
+    write(id);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto window_start = now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto last = first_half * 2;
+  for (int32_t id = first_half + 1; id <= last; ++id) {
+    write(id);
+  }
+  auto cursor = write(
+      last + 1,
+      EntryType::TRACE_BACKWARDS,
+      window_start + kTraceBackdatingWindowUs * 1000);
+
+  IdVisitor visitor;
+  traceBackwards(visitor, *records_, cursor, scratch_);
+
+  ASSERT_EQ(visitor.ids.size(), static_cast<size_t>(last - per_interval));
+  EXPECT_EQ(visitor.ids.front(), per_interval + 1);
+  EXPECT_EQ(visitor.ids.back(), last);
+}
+
+} // namespace profilo
+} // namespace facebook
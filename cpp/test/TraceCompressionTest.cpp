@@ -0,0 +1,398 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#ifdef PROFILO_WITH_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef PROFILO_WITH_ZSTD
+#include <zstd.h>
+#endif
+#include <chrono>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/TraceChunks.h>
+#include <profilo/writer/TraceCompression.h>
+
+#include <zstr/zstr.hpp>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+#ifdef PROFILO_WITH_LZ4
+std::string decompressLz4(const std::string& input) {
+  LZ4F_dctx* context = nullptr;
+  EXPECT_FALSE(LZ4F_isError(
+      LZ4F_createDecompressionContext(&context, LZ4F_VERSION)));
+  std::string output;
+  std::vector<char> buffer(64 * 1024);
+  size_t offset = 0;
+  while (offset < input.size()) {
+    size_t written = buffer.size();
+    size_t read = input.size() - offset;
+    auto result = LZ4F_decompress(
+        context,
+        buffer.data(),
+        &written,
+        input.data() + offset,
+        &read,
+        nullptr);
+    if (LZ4F_isError(result)) {
+      ADD_FAILURE() << LZ4F_getErrorName(result);
+      break;
+    }
+    output.append(buffer.data(), written);
+    offset += read;
+  }
+  LZ4F_freeDecompressionContext(context);
+  return output;
+}
+#endif
+
+#ifdef PROFILO_WITH_ZSTD
+std::string decompressZstd(
+    const std::string& input,
+    const std::string* dictionary = nullptr) {
+  auto context = ZSTD_createDCtx();
+  if (dictionary != nullptr) {
+    ZSTD_DCtx_loadDictionary(context, dictionary->data(), dictionary->size());
+  }
+  std::string output;
+  std::vector<char> buffer(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer in{input.data(), input.size(), 0};
+  while (in.pos < in.size) {
+    ZSTD_outBuffer out{buffer.data(), buffer.size(), 0};
+    auto result = ZSTD_decompressStream(context, &out, &in);
+    if (ZSTD_isError(result)) {
+      ADD_FAILURE() << ZSTD_getErrorName(result);
+      break;
+    }
+    output.append(buffer.data(), out.pos);
+  }
+  ZSTD_freeDCtx(context);
+  return output;
+}
+#endif
+
+std::string decompressZlib(const std::string& input) {
+  std::stringstream compressed(input);
+  zstr::istream stream(compressed);
+  std::stringstream output;
+  output << stream.rdbuf();
+  return output.str();
+}
+
+std::string decompress(CompressionCodec codec, const std::string& input) {
+  switch (codec) {
+    case CompressionCodec::ZLIB:
+      return decompressZlib(input);
+#ifdef PROFILO_WITH_LZ4
+    case CompressionCodec::LZ4:
+      return decompressLz4(input);
+#endif
+#ifdef PROFILO_WITH_ZSTD
+    case CompressionCodec::ZSTD:
+      return decompressZstd(input);
+#endif
+    default:
+      ADD_FAILURE() << "Codec not built in";
+  }
+  return "";
+}
+
+std::vector<CompressionCodec> availableCodecs() {
+  std::vector<CompressionCodec> codecs;
+  for (auto codec : {CompressionCodec::ZLIB,
+                     CompressionCodec::LZ4,
+                     CompressionCodec::ZSTD}) {
+    if (isCodecAvailable(codec)) {
+      codecs.push_back(codec);
+    }
+  }
+  return codecs;
+}
+
+// Somewhat trace-like text that compresses but not trivially.
+std::string makeTraceLines(size_t lines) {
+  std::stringstream text;
+  for (size_t i = 0; i < lines; ++i) {
+    text << i << "|MARK_PUSH|" << (i * 37) % 1000 << "|" << 4242 + i % 7
+         << "|0|" << i % 13 << "|0\n";
+  }
+  return text.str();
+}
+
+std::string compress(
+    const CompressionConfig& config,
+    const std::string& input) {
+  std::stringbuf sink;
+  {
+    auto buffer = makeCompressingStreambuf(&sink, config);
+    std::ostream stream(buffer.get());
+    stream << input;
+    stream.flush();
+  }
+  return sink.str();
+}
+
+} // namespace
+
+class TraceCompressionTest
+    : public ::testing::TestWithParam<CompressionCodec> {
+ protected:
+  CompressionConfig config() {
+    CompressionConfig config;
+    config.codec = GetParam();
+    config.level = CompressionConfig::defaultLevel(GetParam());
+    // Small enough for the inputs below to span several buffers.
+    config.buffer_size = 4096;
+    return config;
+  }
+};
+
+TEST_P(TraceCompressionTest, testRoundTrip) {
+  auto input = makeTraceLines(10000);
+  auto compressed = compress(config(), input);
+
+  EXPECT_LT(compressed.size(), input.size());
+  EXPECT_EQ(decompress(GetParam(), compressed), input);
+}
+
+TEST_P(TraceCompressionTest, testSyncCompletesFrame) {
+  auto first = makeTraceLines(100);
+  std::stringbuf sink;
+  auto buffer = makeCompressingStreambuf(&sink, config());
+  std::ostream stream(buffer.get());
+
+  stream << first;
+  stream.flush();
+  EXPECT_EQ(decompress(GetParam(), sink.str()), first);
+
+  stream << "more";
+  stream.flush();
+  EXPECT_EQ(decompress(GetParam(), sink.str()), first + "more");
+}
+
+TEST_P(TraceCompressionTest, testDestructionCompletesFrame) {
+  auto input = makeTraceLines(100);
+  std::stringbuf sink;
+  {
+    auto buffer = makeCompressingStreambuf(&sink, config());
+    std::ostream stream(buffer.get());
+    stream << input;
+  }
+  EXPECT_EQ(decompress(GetParam(), sink.str()), input);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Codecs,
+    TraceCompressionTest,
+    ::testing::ValuesIn(availableCodecs()));
+
+class TraceChunksTest : public TraceCompressionTest {
+ protected:
+  // Writes `input` through a ChunkingStreambuf, in pieces of `piece` bytes.
+  std::string writeChunked(
+      const std::string& input,
+      size_t chunk_size,
+      size_t piece = 1000) {
+    std::stringbuf sink;
+    {
+      ChunkingStreambuf buffer(
+          &sink,
+          makeCompressingStreambuf(&sink, config()),
+          GetParam(),
+          chunk_size,
+          std::chrono::milliseconds(0),
+          [this](const TraceChunk& chunk) { chunks_.push_back(chunk); });
+      std::ostream stream(&buffer);
+      for (size_t offset = 0; offset < input.size(); offset += piece) {
+        stream << input.substr(offset, piece);
+      }
+    }
+    return sink.str();
+  }
+
+  static std::string slice(const std::string& file, const TraceChunk& chunk) {
+    return file.substr(chunk.file_offset, chunk.file_size);
+  }
+
+  std::vector<TraceChunk> chunks_;
+};
+
+void expectSameChunks(
+    const std::vector<TraceChunk>& actual,
+    const std::vector<TraceChunk>& expected) {
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_EQ(actual[i].index, i);
+    EXPECT_EQ(actual[i].raw_offset, expected[i].raw_offset);
+    EXPECT_EQ(actual[i].raw_size, expected[i].raw_size);
+    EXPECT_EQ(actual[i].file_offset, expected[i].file_offset);
+    EXPECT_EQ(actual[i].file_size, expected[i].file_size);
+  }
+}
+
+TEST_P(TraceChunksTest, testChunksDecompressIndependently) {
+  auto input = makeTraceLines(10000);
+  auto file = writeChunked(input, 32 * 1024);
+
+  ASSERT_GT(chunks_.size(), 4);
+  expectSameChunks(parseChunkIndex(file), chunks_);
+  uint64_t raw_offset = 0;
+  for (auto& chunk : chunks_) {
+    EXPECT_EQ(chunk.raw_offset, raw_offset);
+    EXPECT_EQ(
+        decompress(GetParam(), slice(file, chunk)),
+        input.substr(chunk.raw_offset, chunk.raw_size));
+    raw_offset += chunk.raw_size;
+  }
+  EXPECT_EQ(raw_offset, input.size());
+}
+
+TEST_P(TraceChunksTest, testWholeFileDecompresses) {
+  auto input = makeTraceLines(10000);
+  auto file = writeChunked(input, 32 * 1024);
+
+  EXPECT_EQ(decompress(GetParam(), file), input);
+}
+
+TEST_P(TraceChunksTest, testTruncatedFileKeepsCompleteChunks) {
+  auto input = makeTraceLines(10000);
+  auto file = writeChunked(input, 32 * 1024);
+  ASSERT_GT(chunks_.size(), 2);
+
+  // Cut in the middle of the third chunk.
+  auto& third = chunks_[2];
+  auto truncated = file.substr(0, third.file_offset + third.file_size / 2);
+  chunks_.resize(2);
+  expectSameChunks(parseChunkIndex(truncated), chunks_);
+}
+
+TEST_P(TraceChunksTest, testSyncCutsChunk) {
+  auto first = makeTraceLines(100);
+  std::stringbuf sink;
+  ChunkingStreambuf buffer(
+      &sink,
+      makeCompressingStreambuf(&sink, config()),
+      GetParam(),
+      0,
+      std::chrono::milliseconds(0),
+      [this](const TraceChunk& chunk) { chunks_.push_back(chunk); });
+  std::ostream stream(&buffer);
+
+  stream << first;
+  EXPECT_TRUE(chunks_.empty());
+  stream.flush();
+  ASSERT_EQ(chunks_.size(), 1);
+  EXPECT_EQ(chunks_[0].raw_size, first.size());
+  EXPECT_EQ(decompress(GetParam(), slice(sink.str(), chunks_[0])), first);
+
+  // Nothing written since, nothing to cut.
+  stream.flush();
+  EXPECT_EQ(chunks_.size(), 1);
+}
+
+TEST_P(TraceChunksTest, testUnchunkedFileHasNoIndex) {
+  auto input = makeTraceLines(1000);
+  EXPECT_TRUE(parseChunkIndex(compress(config(), input)).empty());
+  EXPECT_TRUE(parseChunkIndex("").empty());
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Codecs,
+    TraceChunksTest,
+    ::testing::ValuesIn(availableCodecs()));
+
+TEST(TraceCompressionConfigTest, testFlagsSelectCodec) {
+  auto orZlib = [](CompressionCodec codec) {
+    return isCodecAvailable(codec) ? codec : CompressionCodec::ZLIB;
+  };
+  EXPECT_EQ(CompressionConfig::forFlags(0).codec, CompressionCodec::ZLIB);
+  EXPECT_EQ(
+      CompressionConfig::forFlags(kCompressionLz4Flag).codec,
+      orZlib(CompressionCodec::LZ4));
+  EXPECT_EQ(
+      CompressionConfig::forFlags(kCompressionZstdFlag).codec,
+      orZlib(CompressionCodec::ZSTD));
+  EXPECT_EQ(CompressionConfig::forFlags(0).level, 3);
+}
+
+TEST(TraceCompressionConfigTest, testMissingCodecThrows) {
+  for (auto codec : {CompressionCodec::LZ4, CompressionCodec::ZSTD}) {
+    if (isCodecAvailable(codec)) {
+      continue;
+    }
+    std::stringbuf sink;
+    CompressionConfig config;
+    config.codec = codec;
+    EXPECT_THROW(
+        makeCompressingStreambuf(&sink, config), std::invalid_argument);
+  }
+}
+
+TEST(TraceCompressionConfigTest, testChunkedFlagSetsLimits) {
+  auto config = CompressionConfig::forFlags(0);
+  EXPECT_EQ(config.chunk_size, 0);
+  EXPECT_EQ(config.chunk_interval.count(), 0);
+
+  config = CompressionConfig::forFlags(kChunkedTraceFlag);
+  EXPECT_EQ(config.codec, CompressionCodec::ZLIB);
+  EXPECT_EQ(config.chunk_size, CompressionConfig::kDefaultChunkSize);
+  EXPECT_EQ(config.chunk_interval, CompressionConfig::kDefaultChunkInterval);
+}
+
+TEST(TraceCompressionConfigTest, testZeroBufferSizeThrows) {
+  std::stringbuf sink;
+  CompressionConfig config;
+  config.buffer_size = 0;
+  EXPECT_THROW(makeCompressingStreambuf(&sink, config), std::invalid_argument);
+}
+
+#ifdef PROFILO_WITH_ZSTD
+TEST(TraceCompressionDictionaryTest, testDictionaryRoundTrip) {
+  std::vector<std::string> samples;
+  for (size_t i = 0; i < 200; ++i) {
+    samples.push_back(makeTraceLines(20 + i % 10));
+  }
+  auto dictionary = std::make_shared<const std::string>(
+      trainCompressionDictionary(samples, 16 * 1024));
+  ASSERT_FALSE(dictionary->empty());
+
+  CompressionConfig config;
+  config.codec = CompressionCodec::ZSTD;
+  auto input = makeTraceLines(25);
+  auto plain = compress(config, input);
+  config.dictionary = dictionary;
+  auto with_dictionary = compress(config, input);
+
+  EXPECT_LT(with_dictionary.size(), plain.size());
+  EXPECT_EQ(decompressZstd(with_dictionary, dictionary.get()), input);
+}
+#endif
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -15,10 +15,16 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
+#include <unordered_map>
 
 #include <folly/experimental/TestUtil.h>
 #include <gmock/gmock.h>
@@ -31,9 +37,13 @@
 #include <profilo/PacketLogger.h>
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryType.h>
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
 #include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+#include <profilo/writer/BinaryTraceReader.h>
 #include <profilo/writer/TraceCallbacks.h>
 #include <profilo/writer/TraceWriter.h>
+#include <profilo/writer/trace_backwards.h>
 
 using namespace facebook::profilo::logger;
 using namespace facebook::profilo::writer;
@@ -86,7 +96,7 @@ class TraceWriterTest : public ::testing::Test {
   std::shared_ptr<::testing::NiceMock<MockCallbacks>> callbacks_;
   TraceWriter writer_;
 
-  void writeTraceStart(int64_t trace_id = kTraceID) {
+  void writeTraceStart(int64_t trace_id = kTraceID, int32_t flags = 0) {
     char payload[sizeof(StandardEntry) + 1]{};
     StandardEntry start{
         .id = 1,
@@ -94,7 +104,7 @@ class TraceWriterTest : public ::testing::Test {
         .timestamp = 123,
         .tid = 0,
         .callid = 0,
-        .matchid = 0,
+        .matchid = flags,
         .extra = trace_id,
     };
     StandardEntry::pack(start, payload, sizeof(payload));
@@ -303,6 +313,76 @@ TEST_F(TraceWriterTest, testHeadersPropagateToFile) {
   EXPECT_NE(trace.find("key2|value2"), std::string::npos);
 }
 
+TEST_F(TraceWriterTest, testBinaryFormatFlagWritesBinaryTrace) {
+  writeTraceStart(kTraceID, kBinaryTraceFormatFlag);
+  writeFillerEvent();
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  std::stringstream contents(getOnlyTraceFileContents());
+  BinaryTraceReader reader(contents);
+  auto headers = reader.headers();
+  auto expected_headers = generateHeaders();
+  expected_headers.insert(
+      expected_headers.begin(),
+      {std::make_pair("id", kTraceIDString), std::make_pair("prec", "6")});
+  EXPECT_EQ(headers, expected_headers);
+
+  struct TypeVisitor : public EntryVisitor {
+    std::vector<EntryType> types;
+    void visit(const StandardEntry& entry) override {
+      types.push_back(entry.type);
+    }
+    void visit(const FramesEntry&) override {}
+    void visit(const BytesEntry&) override {}
+  } visitor;
+  reader.read(visitor);
+  EXPECT_EQ(
+      visitor.types,
+      std::vector<EntryType>({EntryType::TRACE_START,
+                              EntryType::MARK_PUSH,
+                              EntryType::TRACE_END}));
+}
+
+#ifdef PROFILO_WITH_LZ4
+TEST_F(TraceWriterTest, testCompressionFlagSelectsCodec) {
+  writeTraceStart(kTraceID, kCompressionLz4Flag);
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  std::ifstream input(getOnlyTraceFile().generic_string(), std::ios::binary);
+  char magic[4]{};
+  input.read(magic, sizeof(magic));
+  // LZ4 frame magic number, little-endian.
+  EXPECT_EQ(std::string(magic, sizeof(magic)), "\x04\x22\x4d\x18");
+}
+#endif
+
+TEST_F(TraceWriterTest, testChunkedFlagWritesChunkIndex) {
+  writeTraceStart(kTraceID, kChunkedTraceFlag);
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  // The whole trace fits in one chunk, cut when the trace ends.
+  auto chunks = readChunkIndex(getOnlyTraceFile().generic_string());
+  ASSERT_EQ(chunks.size(), 1);
+  EXPECT_EQ(chunks[0].raw_offset, 0);
+  EXPECT_GT(chunks[0].raw_size, 0);
+  EXPECT_EQ(chunks[0].file_offset, 0);
+}
+
 void TraceWriterTest::testCallbackCalls(std::function<void()> expectations) {
   ::testing::InSequence dummy_;
 
@@ -433,5 +513,577 @@ TEST_F(TraceWriterTest, testCallbacksMultiTracingAbort) {
   thread.join();
 }
 
+TEST_F(TraceWriterTest, testOverlappingTracesShareEncoding) {
+  auto buffer_start = buffer_->currentHead();
+  writeTraceStart(kTraceID);
+  writeTraceStart(kSecondTraceID);
+  writeFillerEvent();
+  writeTraceEnd(kTraceID);
+  writeTraceEnd(kSecondTraceID);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(buffer_start, kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  EXPECT_EQ(getFileCount(), 2);
+  std::unordered_map<std::string, std::string> traces;
+  for (auto it = fs::recursive_directory_iterator(trace_dir_.path());
+       it != fs::recursive_directory_iterator();
+       ++it) {
+    if (!fs::is_regular_file(it->path())) {
+      continue;
+    }
+    std::stringstream output;
+    zstr::ifstream input(it->path().generic_string());
+    output << input.rdbuf();
+    auto contents = output.str();
+    auto trace_id = it->path().parent_path().filename().generic_string();
+    traces[trace_id] = contents.substr(contents.find("\n\n") + 2);
+  }
+
+  // The filler event is encoded once, after which each trace ends in a
+  // segment of its own.
+  EXPECT_EQ(
+      traces[kTraceIDString],
+      "1|TRACE_START|0|0|0|0|1\n"
+      "0|SEGMENT_START|0|0|0|0|0\n"
+      "2|MARK_PUSH|0|0|0|0|0\n"
+      "0|SEGMENT_START|0|0|0|0|0\n"
+      "2|TRACE_END|0|0|0|0|1\n");
+  EXPECT_EQ(
+      traces["AAAAAAAAAAC"],
+      "1|TRACE_START|0|0|0|0|2\n"
+      "0|SEGMENT_START|0|0|0|0|0\n"
+      "2|MARK_PUSH|0|0|0|0|0\n"
+      "0|SEGMENT_START|0|0|0|0|0\n"
+      "2|TRACE_END|0|0|0|0|2\n");
+}
+
+TEST(TraceWriterRecordsTest, testTraceFileCreatedFromRecords) {
+  test::TemporaryDirectory trace_dir("trace-folder-");
+  RecordBufferHolder buffer = RecordBuffer::allocate(4096);
+  PacketLogger logger(
+      []() -> PacketBuffer& { return RingBuffer::get(); },
+      [&buffer]() -> RecordBuffer* { return buffer.get(); });
+  auto callbacks = std::make_shared<::testing::StrictMock<MockCallbacks>>();
+  TraceWriter writer(
+      std::move(trace_dir.path().generic_string()),
+      "test-prefix",
+      *buffer,
+      callbacks);
+
+  using ::testing::_;
+  EXPECT_CALL(*callbacks, onTraceStart(kTraceID, 0, _)).Times(1);
+  EXPECT_CALL(*callbacks, onTraceEnd(kTraceID)).Times(1);
+
+  auto writeEntry = [&logger](EntryType type, int64_t extra) {
+    char payload[sizeof(StandardEntry) + 1]{};
+    StandardEntry entry{
+        .id = 1,
+        .type = type,
+        .timestamp = 123,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = extra,
+    };
+    StandardEntry::pack(entry, payload, sizeof(payload));
+    logger.write(payload, sizeof(payload));
+  };
+  auto cursor = buffer->currentHead();
+  writeEntry(EntryType::TRACE_START, kTraceID);
+  writeEntry(EntryType::MARK_PUSH, 0);
+  writeEntry(EntryType::TRACE_END, kTraceID);
+
+  writer.processTrace(cursor);
+
+  auto dir_iter = fs::recursive_directory_iterator(trace_dir.path());
+  auto file_count = std::count_if(
+      dir_iter,
+      fs::recursive_directory_iterator(),
+      [](const fs::directory_entry& x) {
+        return fs::is_regular_file(x.path());
+      });
+  EXPECT_EQ(file_count, 1);
+}
+
+TEST_F(TraceWriterTest, testPipelineWritesTrace) {
+  using ::testing::_;
+  writer_.enablePipeline(PipelineConfig{
+      .batch_packets = 2, .arena_batches = 4, .compression_queue_depth = 2});
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  writeTraceStart();
+  writeFillerEvent();
+  writeTraceEnd();
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  auto trace = getOnlyTraceFileContents();
+  EXPECT_NE(trace.find("key1|value1"), std::string::npos);
+  EXPECT_NE(trace.find("|MARK_PUSH|"), std::string::npos);
+  EXPECT_NE(trace.find("|TRACE_END|"), std::string::npos);
+}
+
+TEST_F(TraceWriterTest, testPipelineReadsAheadOfSlowEncoding) {
+  using ::testing::_;
+  writer_.enablePipeline(PipelineConfig{
+      .batch_packets = 1, .arena_batches = 64, .compression_queue_depth = 2});
+
+  std::promise<void> started;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  EXPECT_CALL(*callbacks_, onTraceStart(kTraceID, _, _))
+      .WillOnce(::testing::InvokeWithoutArgs([&] {
+        started.set_value();
+        released.wait();
+      }));
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID));
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  auto buffer_start = buffer_->currentHead();
+  writeTraceStart();
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(buffer_start, kTraceID);
+  started.get_future().wait();
+
+  // Lap the buffer several times while encoding is stuck, at a pace the
+  // reading stage can follow.
+  const size_t kFillers = 4 * kBufferSize;
+  for (size_t i = 0; i < kFillers; ++i) {
+    writeFillerEvent();
+    if (i % 2 == 1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  writeTraceEnd();
+  release.set_value();
+
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  auto trace = getOnlyTraceFileContents();
+  size_t fillers = 0;
+  for (auto pos = trace.find("|MARK_PUSH|"); pos != std::string::npos;
+       pos = trace.find("|MARK_PUSH|", pos + 1)) {
+    ++fillers;
+  }
+  EXPECT_EQ(fillers, kFillers);
+}
+
+TEST_F(TraceWriterTest, testPipelineAbortsWhenLapped) {
+  using ::testing::_;
+  // A single batch: reading waits for encoding to return it.
+  writer_.enablePipeline(PipelineConfig{
+      .batch_packets = 1, .arena_batches = 1, .compression_queue_depth = 2});
+
+  std::promise<void> started;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  EXPECT_CALL(*callbacks_, onTraceStart(kTraceID, _, _))
+      .WillOnce(::testing::InvokeWithoutArgs([&] {
+        started.set_value();
+        released.wait();
+      }));
+  EXPECT_CALL(*callbacks_, onTraceEnd(_)).Times(0);
+  EXPECT_CALL(
+      *callbacks_, onTraceAbort(kTraceID, AbortReason::MISSED_EVENT));
+
+  auto buffer_start = buffer_->currentHead();
+  writeTraceStart();
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(buffer_start, kTraceID);
+  started.get_future().wait();
+
+  for (size_t i = 0; i < 2 * kBufferSize; ++i) {
+    writeFillerEvent();
+  }
+  release.set_value();
+
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+}
+
+class TraceWriterShardedTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kShardCount = 3;
+  static constexpr size_t kShardSize = 10;
+
+  TraceWriterShardedTest()
+      : ::testing::Test(),
+        trace_dir_("trace-folder-"),
+        buffer_(kShardCount, kShardSize),
+        shard_(0),
+        logger_([this]() -> PacketBuffer& { return buffer_.shard(shard_); }),
+        callbacks_(std::make_shared<::testing::NiceMock<MockCallbacks>>()),
+        writer_(
+            std::move(trace_dir_.path().generic_string()),
+            "test-prefix",
+            buffer_,
+            callbacks_) {}
+
+  test::TemporaryDirectory trace_dir_;
+  ShardedTraceBuffer buffer_;
+  size_t shard_;
+  PacketLogger logger_;
+  std::shared_ptr<::testing::NiceMock<MockCallbacks>> callbacks_;
+  TraceWriter writer_;
+
+  void writeEntry(size_t shard, EntryType type, int64_t timestamp) {
+    shard_ = shard;
+    char payload[sizeof(StandardEntry) + 1]{};
+    StandardEntry entry{
+        .id = 1,
+        .type = type,
+        .timestamp = timestamp,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = kTraceID,
+    };
+    StandardEntry::pack(entry, payload, sizeof(payload));
+    logger_.write(payload, sizeof(payload));
+    // Like Logger does for sharded writes.
+    buffer_.notifyWrite();
+  }
+
+  std::string getOnlyTraceFileContents() {
+    auto dir_iter = fs::recursive_directory_iterator(trace_dir_.path());
+    auto file = std::find_if(
+        dir_iter,
+        fs::recursive_directory_iterator(),
+        [](const fs::directory_entry& x) {
+          return fs::is_regular_file(x.path());
+        });
+    EXPECT_NE(file, fs::recursive_directory_iterator());
+
+    std::stringstream output;
+    zstr::ifstream input(file->path().generic_string());
+    output << input.rdbuf();
+    return output.str();
+  }
+};
+
+TEST_F(TraceWriterShardedTest, testShardsAreMergedByTimestamp) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceStart(kTraceID, 0, _)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  writeEntry(1, EntryType::MARK_POP, 100); // before the trace
+  writeEntry(0, EntryType::TRACE_START, 123);
+  writeEntry(0, EntryType::TRACE_END, 130);
+  writeEntry(2, EntryType::MARK_PUSH, 125);
+  writeEntry(1, EntryType::MARK_FLAG, 140); // after the trace
+
+  auto traces = writer_.processShardedTrace(kTraceID);
+  EXPECT_EQ(traces.count(kTraceID), 1);
+
+  auto contents = getOnlyTraceFileContents();
+  EXPECT_NE(contents.find("MARK_PUSH"), std::string::npos);
+  EXPECT_EQ(contents.find("MARK_POP"), std::string::npos);
+  EXPECT_EQ(contents.find("MARK_FLAG"), std::string::npos);
+}
+
+TEST_F(TraceWriterShardedTest, testMissingStartProcessesNothing) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceStart(_, _, _)).Times(0);
+
+  writeEntry(0, EntryType::TRACE_START, 123);
+  writeEntry(1, EntryType::TRACE_END, 130);
+
+  auto traces = writer_.processShardedTrace(kSecondTraceID);
+  EXPECT_TRUE(traces.empty());
+}
+
+TEST_F(TraceWriterShardedTest, testSortsEntriesWithinShard) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+
+  writeEntry(0, EntryType::TRACE_START, 123);
+  // Two threads sharing shard 1 committed out of timestamp order.
+  writeEntry(1, EntryType::MARK_POP, 127);
+  writeEntry(1, EntryType::MARK_PUSH, 124);
+  writeEntry(0, EntryType::TRACE_END, 130);
+
+  writer_.processShardedTrace(kTraceID);
+
+  auto contents = getOnlyTraceFileContents();
+  auto push = contents.find("MARK_PUSH");
+  auto pop = contents.find("MARK_POP");
+  ASSERT_NE(push, std::string::npos);
+  ASSERT_NE(pop, std::string::npos);
+  EXPECT_LT(push, pop);
+}
+
+TEST_F(TraceWriterShardedTest, testWaitsForWritesInProgress) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+
+  writeEntry(0, EntryType::TRACE_START, 123);
+  // A write on shard 1 took its timestamp before the end of the trace but
+  // commits after it.
+  buffer_.watermark(1, 0).begin(124000);
+  writeEntry(0, EntryType::TRACE_END, 130000);
+
+  auto thread = std::thread([&] { writer_.processShardedTrace(kTraceID); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  writeEntry(1, EntryType::MARK_PUSH, 124000);
+  buffer_.watermark(1, 0).end();
+  buffer_.notifyWrite();
+  thread.join();
+
+  auto contents = getOnlyTraceFileContents();
+  EXPECT_NE(contents.find("MARK_PUSH"), std::string::npos);
+}
+
+TEST_F(TraceWriterShardedTest, testBusyLaneDoesNotHoldBackOthers) {
+  // One thread of the shard is always in the middle of a write while
+  // another one keeps starting new ones.
+  buffer_.watermark(1, 0).begin(100000);
+  buffer_.watermark(1, 1).begin(200000);
+  buffer_.watermark(1, 0).end();
+  buffer_.watermark(1, 0).begin(300000);
+  EXPECT_EQ(buffer_.lowestWatermark(1), 200000);
+
+  buffer_.watermark(1, 1).end();
+  EXPECT_EQ(buffer_.lowestWatermark(1), 300000);
+  buffer_.watermark(1, 0).end();
+  EXPECT_EQ(buffer_.lowestWatermark(1), ShardWatermark::kIdle);
+}
+
+TEST_F(TraceWriterShardedTest, testWaitForWriteWakesUpOnNotify) {
+  std::atomic<bool> written(false);
+  auto start = std::chrono::steady_clock::now();
+  auto thread = std::thread([&] {
+    buffer_.waitForWrite(
+        [&] { return written.load(); },
+        std::chrono::steady_clock::now() + std::chrono::seconds(30));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  written = true;
+  buffer_.notifyWrite();
+  thread.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+TEST_F(TraceWriterShardedTest, testTraceBackwardsReplaysAllShards) {
+  using ::testing::_;
+  constexpr int64_t kStart = kTraceBackdatingWindowUs * 1000 + 200;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  writeEntry(2, EntryType::MARK_FLAG, 100); // outside the window
+  writeEntry(1, EntryType::MARK_PUSH, kStart - 50);
+  writeEntry(2, EntryType::MARK_POP, kStart - 40);
+  writeEntry(0, EntryType::TRACE_BACKWARDS, kStart);
+  writeEntry(1, EntryType::TRACE_END, kStart + 10);
+
+  auto traces = writer_.processShardedTrace(kTraceID);
+  EXPECT_EQ(traces.count(kTraceID), 1);
+
+  auto contents = getOnlyTraceFileContents();
+  auto push = contents.find("MARK_PUSH");
+  auto pop = contents.find("MARK_POP");
+  ASSERT_NE(push, std::string::npos);
+  ASSERT_NE(pop, std::string::npos);
+  EXPECT_LT(push, pop);
+  EXPECT_EQ(contents.find("MARK_FLAG"), std::string::npos);
+  // Replayed once, not again when the live merge gets past them.
+  EXPECT_EQ(contents.find("MARK_PUSH", push + 1), std::string::npos);
+}
+
+TEST_F(TraceWriterShardedTest, testStringReferenceFollowsItsEntry) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+
+  writeEntry(0, EntryType::TRACE_START, 123);
+  writeEntry(1, EntryType::MARK_PUSH, 125);
+  // Interned bytes of the entry above, without a timestamp.
+  writeEntry(1, EntryType::STRING_REFERENCE, 0);
+  writeEntry(0, EntryType::TRACE_END, 130);
+
+  writer_.processShardedTrace(kTraceID);
+
+  auto contents = getOnlyTraceFileContents();
+  auto push = contents.find("MARK_PUSH");
+  auto reference = contents.find("STRING_REFERENCE");
+  ASSERT_NE(push, std::string::npos);
+  ASSERT_NE(reference, std::string::npos);
+  EXPECT_LT(push, reference);
+}
+
+TEST_F(TraceWriterShardedTest, testLoopMergesShards) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  writeEntry(2, EntryType::TRACE_START, 123);
+  writeEntry(1, EntryType::MARK_PUSH, 124);
+  writeEntry(0, EntryType::TRACE_END, 125);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(kTraceID);
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+}
+
+TEST_F(TraceWriterShardedTest, testRejectsPacketBufferOptions) {
+  EXPECT_THROW(writer_.enablePipeline(), std::invalid_argument);
+  EXPECT_THROW(writer_.enableResizing(), std::invalid_argument);
+}
+
+class TraceWriterResizableTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kBufferSize = 10;
+
+  TraceWriterResizableTest()
+      : ::testing::Test(),
+        trace_dir_("trace-folder-"),
+        buffer_(kBufferSize),
+        logger_(
+            [this]() -> PacketBuffer& { return buffer_.current(); },
+            []() -> RecordBuffer* { return nullptr; },
+            [this]() -> ResizableTraceBuffer* { return &buffer_; }),
+        callbacks_(std::make_shared<::testing::NiceMock<MockCallbacks>>()),
+        writer_(
+            std::move(trace_dir_.path().generic_string()),
+            "test-prefix",
+            buffer_,
+            callbacks_) {}
+
+  test::TemporaryDirectory trace_dir_;
+  ResizableTraceBuffer buffer_;
+  PacketLogger logger_;
+  std::shared_ptr<::testing::NiceMock<MockCallbacks>> callbacks_;
+  TraceWriter writer_;
+
+  TraceBuffer::Cursor writeEntry(EntryType type) {
+    char payload[sizeof(StandardEntry) + 1]{};
+    StandardEntry entry{
+        .id = 1,
+        .type = type,
+        .timestamp = 123,
+        .tid = 0,
+        .callid = 0,
+        .matchid = 0,
+        .extra = kTraceID,
+    };
+    StandardEntry::pack(entry, payload, sizeof(payload));
+    return logger_.writeAndGetCursor(payload, sizeof(payload));
+  }
+
+  std::string getOnlyTraceFileContents() {
+    auto dir_iter = fs::recursive_directory_iterator(trace_dir_.path());
+    auto file = std::find_if(
+        dir_iter,
+        fs::recursive_directory_iterator(),
+        [](const fs::directory_entry& x) {
+          return fs::is_regular_file(x.path());
+        });
+    EXPECT_NE(file, fs::recursive_directory_iterator());
+
+    std::stringstream output;
+    zstr::ifstream input(file->path().generic_string());
+    output << input.rdbuf();
+    return output.str();
+  }
+};
+
+TEST_F(TraceWriterResizableTest, testTraceFollowsResize) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  auto cursor = writeEntry(EntryType::TRACE_START);
+  writer_.submit(cursor, kTraceID);
+  writeEntry(EntryType::MARK_PUSH);
+  buffer_.resize(2 * kBufferSize);
+  writeEntry(EntryType::MARK_FLAG);
+  buffer_.resize(kBufferSize / 2);
+  writeEntry(EntryType::TRACE_END);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  auto contents = getOnlyTraceFileContents();
+  EXPECT_NE(contents.find("MARK_PUSH"), std::string::npos);
+  EXPECT_NE(contents.find("MARK_FLAG"), std::string::npos);
+}
+
+TEST_F(TraceWriterResizableTest, testPipelineFollowsResize) {
+  using ::testing::_;
+  writer_.enablePipeline(PipelineConfig{
+      .batch_packets = 2, .arena_batches = 4, .compression_queue_depth = 2});
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  auto cursor = writeEntry(EntryType::TRACE_START);
+  writer_.submit(cursor, kTraceID);
+  writeEntry(EntryType::MARK_PUSH);
+  buffer_.resize(2 * kBufferSize);
+  writeEntry(EntryType::MARK_FLAG);
+  buffer_.resize(kBufferSize / 2);
+  writeEntry(EntryType::TRACE_END);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+
+  auto contents = getOnlyTraceFileContents();
+  EXPECT_NE(contents.find("MARK_PUSH"), std::string::npos);
+  EXPECT_NE(contents.find("MARK_FLAG"), std::string::npos);
+}
+
+TEST_F(TraceWriterResizableTest, testWaitingWriterWakesUpOnResize) {
+  using ::testing::_;
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  auto cursor = writeEntry(EntryType::TRACE_START);
+  writer_.submit(cursor, kTraceID);
+
+  // Let the writer catch up and block on the head of the first buffer.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  buffer_.resize(2 * kBufferSize);
+  writeEntry(EntryType::TRACE_END);
+
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+}
+
+TEST_F(TraceWriterResizableTest, testGrowsWhenBehindAndShrinksWhenIdle) {
+  using ::testing::_;
+  writer_.enableResizing(ResizePolicy{
+      .max_slots = 4 * kBufferSize, .grow_percent = 50, .check_interval = 1});
+  EXPECT_CALL(*callbacks_, onTraceEnd(kTraceID)).Times(1);
+  EXPECT_CALL(*callbacks_, onTraceAbort(_, _)).Times(0);
+
+  auto cursor = writeEntry(EntryType::TRACE_START);
+  for (size_t i = 0; i < kBufferSize / 2; ++i) {
+    writeEntry(EntryType::MARK_PUSH);
+  }
+  writeEntry(EntryType::TRACE_END);
+  writer_.processTrace(cursor);
+  size_t grown = buffer_.acquire()->buffer().capacity();
+  EXPECT_EQ(grown, 2 * kBufferSize);
+
+  auto thread = std::thread([&] { writer_.loop(); });
+  // Let the loop find nothing to process.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  size_t shrunk = buffer_.acquire()->buffer().capacity();
+  EXPECT_EQ(shrunk, size_t{kBufferSize});
+
+  writer_.submit(TraceWriter::kStopLoopTraceID);
+  thread.join();
+}
+
 } // namespace profilo
 } // namespace facebook
@@ -0,0 +1,371 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <profilo/StringTable.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/StackTable.h>
+#include <profilo/writer/StackTraceInvertingVisitor.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/VisitorPipeline.h>
+
+using namespace facebook::profilo::entries;
+using namespace facebook::profilo::writer;
+
+namespace facebook {
+namespace profilo {
+
+namespace {
+
+using TextPipeline =
+    Pipeline<InvertFrames, TruncateTimestamps, DeltaEncode, EntryPrinter>;
+
+//
+// Feeds the same mix of entries, with values spanning the whole range of
+// each field, to a visitor.
+//
+void visitEntries(EntryVisitor& visitor) {
+  std::mt19937_64 rng(1234);
+  std::vector<int64_t> frames(64);
+  const char bytes[] = "some/path/libfoo.so";
+
+  for (int32_t i = 0; i < 2000; ++i) {
+    auto value = static_cast<int64_t>(rng());
+    switch (i % 3) {
+      case 0:
+        visitor.visit(StandardEntry{
+            .id = i,
+            .type = EntryType::MARK_PUSH,
+            .timestamp = value & std::numeric_limits<int64_t>::max(),
+            .tid = static_cast<int32_t>(rng()),
+            .callid = static_cast<int32_t>(rng()),
+            .matchid = static_cast<int32_t>(rng()),
+            .extra = value,
+        });
+        break;
+      case 1:
+        for (auto& frame : frames) {
+          frame = static_cast<int64_t>(rng());
+        }
+        visitor.visit(FramesEntry{
+            .id = i,
+            .type = EntryType::STACK_FRAME,
+            .timestamp = value & 0xffffffffff,
+            .tid = static_cast<int32_t>(rng()),
+            .matchid = static_cast<int32_t>(rng()),
+            .frames = {.values = frames.data(),
+                       .size = static_cast<uint16_t>(rng() % frames.size())},
+        });
+        break;
+      default:
+        visitor.visit(BytesEntry{
+            .id = i,
+            .type = EntryType::STRING_VALUE,
+            .matchid = static_cast<int32_t>(rng()),
+            .bytes = {.values = reinterpret_cast<const uint8_t*>(bytes),
+                      .size = static_cast<uint16_t>(rng() % sizeof(bytes))},
+        });
+        break;
+    }
+  }
+}
+
+class RecordingVisitor : public EntryVisitor {
+ public:
+  std::vector<std::string> entries;
+
+  void visit(const StandardEntry& entry) override {
+    std::ostringstream out;
+    out << entry.id << '|' << entry.timestamp << '|' << entry.extra;
+    entries.push_back(out.str());
+  }
+
+  void visit(const FramesEntry& entry) override {
+    std::ostringstream out;
+    out << entry.id << '|' << entry.timestamp;
+    for (size_t idx = 0; idx < entry.frames.size; ++idx) {
+      out << '|' << entry.frames.values[idx];
+    }
+    entries.push_back(out.str());
+  }
+
+  void visit(const BytesEntry& entry) override {
+    entries.emplace_back(
+        reinterpret_cast<const char*>(entry.bytes.values), entry.bytes.size);
+  }
+};
+
+} // namespace
+
+TEST(VisitorPipelineTest, testTextPipelineMatchesVisitorChain) {
+  std::stringstream chained;
+  PrintEntryVisitor print(chained);
+  DeltaEncodingVisitor delta(print);
+  TimestampTruncatingVisitor truncate(delta);
+  StackTraceInvertingVisitor invert(truncate);
+  visitEntries(invert);
+
+  std::stringstream fused;
+  TextPipeline pipeline(
+      InvertFrames(), TruncateTimestamps(), DeltaEncode(), fused);
+  visitEntries(pipeline);
+
+  ASSERT_FALSE(chained.str().empty());
+  EXPECT_EQ(fused.str(), chained.str());
+}
+
+TEST(VisitorPipelineTest, testVisitorSink) {
+  RecordingVisitor chained;
+  TimestampTruncatingVisitor truncate(chained);
+  StackTraceInvertingVisitor invert(truncate);
+  visitEntries(invert);
+
+  RecordingVisitor fused;
+  Pipeline<InvertFrames, TruncateTimestamps, RecordingVisitor&> pipeline(
+      InvertFrames(), TruncateTimestamps(), fused);
+  visitEntries(pipeline);
+
+  EXPECT_EQ(fused.entries, chained.entries);
+}
+
+TEST(VisitorPipelineTest, testStageAccess) {
+  std::stringstream stream;
+  Pipeline<DeltaEncode, EntryPrinter> pipeline(DeltaEncode(), stream);
+
+  pipeline.visit(StandardEntry{
+      .id = 10,
+      .type = EntryType::TRACE_START,
+      .timestamp = 123,
+      .tid = 0,
+      .callid = 1,
+      .matchid = 2,
+      .extra = 3,
+  });
+  // A stage can be driven directly, for instance to reset its state.
+  pipeline.stage<0>() = DeltaEncode();
+  pipeline.visit(StandardEntry{
+      .id = 11,
+      .type = EntryType::TRACE_END,
+      .timestamp = 124,
+      .tid = 1,
+      .callid = 2,
+      .matchid = 3,
+      .extra = 0,
+  });
+
+  EXPECT_EQ(
+      stream.str(),
+      "10|TRACE_START|123|0|1|2|3\n"
+      "11|TRACE_END|124|1|2|3|0\n");
+}
+
+TEST(VisitorPipelineTest, testInvertFramesRejectsDeepStacks) {
+  std::stringstream stream;
+  Pipeline<InvertFrames, EntryPrinter> pipeline(InvertFrames(), stream);
+  std::vector<int64_t> frames(MAX_STACK_DEPTH + 1);
+
+  EXPECT_THROW(
+      pipeline.visit(FramesEntry{
+          .id = 1,
+          .type = EntryType::STACK_FRAME,
+          .timestamp = 1,
+          .tid = 1,
+          .matchid = 0,
+          .frames = {.values = frames.data(),
+                     .size = static_cast<uint16_t>(frames.size())},
+      }),
+      std::invalid_argument);
+}
+
+namespace {
+
+FramesEntry makeStack(int32_t id, std::vector<int64_t>& frames) {
+  return FramesEntry{
+      .id = id,
+      .type = EntryType::STACK_FRAME,
+      .timestamp = 100 + id,
+      .tid = 7,
+      .matchid = 3,
+      .frames = {.values = frames.data(),
+                 .size = static_cast<uint16_t>(frames.size())},
+  };
+}
+
+} // namespace
+
+TEST(VisitorPipelineTest, testInternStacksDefinesEachStackOnce) {
+  std::stringstream stream;
+  Pipeline<InternStacks, EntryPrinter> pipeline(InternStacks(), stream);
+  std::vector<int64_t> first = {10, 20, 30};
+  std::vector<int64_t> second = {10, 20};
+
+  pipeline.visit(makeStack(1, first));
+  pipeline.visit(makeStack(2, second));
+  pipeline.visit(makeStack(3, first));
+
+  EXPECT_EQ(pipeline.stage<0>().stacks().size(), 2);
+  EXPECT_EQ(
+      stream.str(),
+      "1|STACK_DEFINITION|101|7|0|1|10\n"
+      "1|STACK_DEFINITION|101|7|0|1|20\n"
+      "1|STACK_DEFINITION|101|7|0|1|30\n"
+      "1|STACK_SAMPLE|101|7|1|3|45\n"
+      "2|STACK_DEFINITION|102|7|0|2|10\n"
+      "2|STACK_DEFINITION|102|7|0|2|20\n"
+      "2|STACK_SAMPLE|102|7|2|3|45\n"
+      "3|STACK_SAMPLE|103|7|1|3|45\n");
+}
+
+TEST(VisitorPipelineTest, testInternStacksPassesNewStacksOnceFull) {
+  std::stringstream stream;
+  Pipeline<InternStacks, EntryPrinter> pipeline(InternStacks(4), stream);
+  std::vector<int64_t> first = {10, 20, 30};
+  std::vector<int64_t> second = {40, 50};
+
+  pipeline.visit(makeStack(1, first));
+  pipeline.visit(makeStack(2, second));
+  pipeline.visit(makeStack(3, first));
+
+  EXPECT_EQ(
+      stream.str(),
+      "1|STACK_DEFINITION|101|7|0|1|10\n"
+      "1|STACK_DEFINITION|101|7|0|1|20\n"
+      "1|STACK_DEFINITION|101|7|0|1|30\n"
+      "1|STACK_SAMPLE|101|7|1|3|45\n"
+      "2|STACK_FRAME|102|7|0|3|40\n"
+      "2|STACK_FRAME|102|7|0|3|50\n"
+      "3|STACK_SAMPLE|103|7|1|3|45\n");
+}
+
+TEST(StackTableTest, testPrefixesAndEmptyStacksAreDistinct) {
+  StackTable table;
+  std::vector<int64_t> stack = {1, 2, 3};
+  std::vector<int64_t> prefix = {1, 2};
+
+  EXPECT_EQ(table.intern(stack.data(), stack.size()), std::make_pair(1, true));
+  EXPECT_EQ(
+      table.intern(prefix.data(), prefix.size()), std::make_pair(2, true));
+  EXPECT_EQ(table.intern(nullptr, 0), std::make_pair(3, true));
+  EXPECT_EQ(
+      table.intern(stack.data(), stack.size()), std::make_pair(1, false));
+  EXPECT_EQ(table.intern(nullptr, 0), std::make_pair(3, false));
+}
+
+namespace {
+
+BytesEntry makeString(int32_t id, EntryType type, const char* string) {
+  return BytesEntry{
+      .id = id,
+      .type = type,
+      .matchid = id - 1,
+      .bytes = {.values = reinterpret_cast<const uint8_t*>(string),
+                .size = static_cast<uint16_t>(strlen(string))},
+  };
+}
+
+StandardEntry makeMark(int32_t id, int64_t timestamp) {
+  return StandardEntry{
+      .id = id,
+      .type = EntryType::MARK_PUSH,
+      .timestamp = timestamp,
+      .tid = 7,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  };
+}
+
+} // namespace
+
+TEST(VisitorPipelineTest, testInternStringsWritesEachStringOnce) {
+  std::stringstream stream;
+  Pipeline<InternStrings, EntryPrinter> pipeline(InternStrings(), stream);
+
+  pipeline.visit(makeMark(1, 100));
+  pipeline.visit(makeString(2, EntryType::STRING_NAME, "measure"));
+  pipeline.visit(makeMark(3, 200));
+  pipeline.visit(makeString(4, EntryType::STRING_NAME, "layout"));
+  pipeline.visit(makeString(5, EntryType::STRING_KEY, "measure"));
+  pipeline.visit(makeString(6, EntryType::STRING_VALUE, "layout"));
+
+  EXPECT_EQ(
+      stream.str(),
+      "1|MARK_PUSH|100|7|0|0|0\n"
+      "2|STRING_NAME|1|measure\n"
+      "3|MARK_PUSH|200|7|0|0|0\n"
+      "4|STRING_NAME|3|layout\n"
+      "5|STRING_REFERENCE|200|7|1|4|56\n"
+      "6|STRING_REFERENCE|200|7|2|5|57\n");
+}
+
+TEST(VisitorPipelineTest, testInternStringsCountsStringsOnceFull) {
+  std::stringstream stream;
+  Pipeline<InternStrings, EntryPrinter> pipeline(InternStrings(8), stream);
+
+  pipeline.visit(makeString(1, EntryType::STRING_NAME, "measure"));
+  pipeline.visit(makeString(2, EntryType::STRING_NAME, "layout"));
+  pipeline.visit(makeString(3, EntryType::STRING_NAME, "measure"));
+  pipeline.visit(makeString(4, EntryType::STRING_NAME, "layout"));
+
+  // "layout" doesn't fit but still takes ID 2.
+  EXPECT_EQ(
+      stream.str(),
+      "1|STRING_NAME|0|measure\n"
+      "2|STRING_NAME|1|layout\n"
+      "3|STRING_REFERENCE|0|0|1|2|83\n"
+      "4|STRING_NAME|3|layout\n");
+}
+
+TEST(VisitorPipelineTest, testResolveStrings) {
+  logger::StringTable strings;
+  const std::string name = "Choreographer#doFrame";
+  auto id = strings.intern(
+      reinterpret_cast<const uint8_t*>(name.data()), name.size());
+  std::stringstream stream;
+  Pipeline<ResolveStrings, EntryPrinter> pipeline(
+      ResolveStrings(strings), stream);
+
+  for (int32_t callid : {static_cast<int32_t>(id), 1234}) {
+    pipeline.visit(StandardEntry{
+        .id = 10,
+        .type = EntryType::STRING_REFERENCE,
+        .timestamp = 0,
+        .tid = 0,
+        .callid = callid,
+        .matchid = 9,
+        .extra = static_cast<int64_t>(EntryType::STRING_NAME),
+    });
+  }
+
+  EXPECT_EQ(
+      stream.str(),
+      "10|STRING_NAME|9|Choreographer#doFrame\n"
+      "10|STRING_REFERENCE|0|0|1234|9|83\n");
+}
+
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,121 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//
+// Compares the cost of writing entries through an intermediate stack copy
+// against packing them straight into the claimed ring buffer slot, for the
+// entry shapes that dominate traces. Single-threaded, output follows the
+// layout of google-benchmark's console reporter.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <profilo/Logger.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::logger;
+
+namespace {
+
+constexpr size_t kBufferSlots = 1000;
+constexpr size_t kIterations = 1000000;
+
+// The previous Logger::write body: pack on the stack, then copy.
+template <class T>
+void writeCopy(PacketLogger& logger, const T& entry) {
+  auto size = detail::calculatePackedSize(entry, false, 0);
+  char payload[size];
+  detail::packEntry(entry, false, payload, size, 0);
+  logger.write(payload, size);
+}
+
+template <class T>
+void writeInPlace(PacketLogger& logger, const T& entry) {
+  auto size = detail::calculatePackedSize(entry, false, 0);
+  logger.writeInPlace(size, [&entry](void* dst, size_t dst_size) {
+    detail::packEntry(entry, false, dst, dst_size, 0);
+  });
+}
+
+template <class WriteFn>
+void run(const char* name, WriteFn write_fn) {
+  TraceBufferHolder buffer = TraceBuffer::allocate(kBufferSlots);
+  PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kIterations; ++i) {
+    write_fn(logger);
+  }
+  auto elapsed = std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start);
+
+  std::printf(
+      "%-32s %10.1f ns %12zu\n",
+      name,
+      elapsed.count() / kIterations,
+      kIterations);
+}
+
+template <class T>
+void compare(const char* copy_name, const char* in_place_name, const T& entry) {
+  run(copy_name, [&](PacketLogger& logger) { writeCopy(logger, entry); });
+  run(in_place_name,
+      [&](PacketLogger& logger) { writeInPlace(logger, entry); });
+}
+
+} // namespace
+
+int main() {
+  std::printf("%-32s %13s %12s\n", "Benchmark", "Time", "Iterations");
+  std::printf("%s\n", std::string(59, '-').c_str());
+
+  StandardEntry standard{};
+  standard.type = EntryType::MARK_PUSH;
+  standard.timestamp = 123456789012;
+  standard.tid = 4242;
+  standard.callid = 17;
+  standard.extra = 99;
+  compare("BM_StandardEntry/copy", "BM_StandardEntry/in_place", standard);
+
+  std::vector<int64_t> frames(32);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    frames[i] = 0x7f0000000000 + i * 64;
+  }
+  FramesEntry shallow{};
+  shallow.type = EntryType::STACK_FRAME;
+  shallow.timestamp = 123456789012;
+  shallow.tid = 4242;
+  shallow.frames.values = frames.data();
+  shallow.frames.size = 2;
+  compare("BM_FramesEntry/2/copy", "BM_FramesEntry/2/in_place", shallow);
+
+  FramesEntry deep = shallow;
+  deep.frames.size = frames.size();
+  compare("BM_FramesEntry/32/copy", "BM_FramesEntry/32/in_place", deep);
+
+  std::vector<uint8_t> bytes(1024, 'x');
+  BytesEntry string{};
+  string.type = EntryType::STRING_VALUE;
+  string.bytes.values = bytes.data();
+  string.bytes.size = bytes.size();
+  compare("BM_BytesEntry/1024/copy", "BM_BytesEntry/1024/in_place", string);
+  return 0;
+}
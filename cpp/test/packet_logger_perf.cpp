@@ -0,0 +1,138 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Compares packets/sec of the batched PacketLogger write path against the
+// previous one-ticket-per-packet path, at 1 to 16 concurrent writers.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <profilo/PacketLogger.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::logger;
+
+namespace {
+
+constexpr size_t kBufferSlots = 1000;
+constexpr size_t kWritesPerThread = 20000;
+// A full-depth FramesEntry and a StandardEntry, respectively.
+constexpr size_t kPayloadSizes[] = {2064, 38};
+constexpr size_t kThreadCounts[] = {1, 2, 4, 8, 16};
+
+// The pre-batching PacketLogger loop: one ticket claim per packet.
+void writePerPacket(
+    PacketBuffer& buffer,
+    std::atomic<uint32_t>& stream_ids,
+    const char* payload,
+    size_t size) {
+  StreamID stream_id = stream_ids.fetch_add(1, std::memory_order_relaxed);
+  const auto kOnePacketSize = sizeof(Packet::data);
+  size_t offset = 0;
+  while (offset < size) {
+    auto remaining = size - offset;
+    uint8_t write_size = std::min(kOnePacketSize, remaining);
+    Packet packet{.stream = stream_id,
+                  .start = offset == 0,
+                  .next = remaining > kOnePacketSize,
+                  .size = write_size,
+                  .data = {}};
+    std::memcpy(packet.data, payload + offset, write_size);
+    buffer.write(packet);
+    offset += write_size;
+  }
+}
+
+template <typename WriteFn>
+double measurePacketsPerSec(size_t threads, size_t size, WriteFn write_fn) {
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      std::vector<char> payload(size, 'x');
+      while (!go.load()) {
+      }
+      for (size_t i = 0; i < kWritesPerThread; ++i) {
+        write_fn(payload.data(), size);
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start);
+
+  const auto kOnePacketSize = sizeof(Packet::data);
+  size_t packets_per_write = (size + kOnePacketSize - 1) / kOnePacketSize;
+  return threads * kWritesPerThread * packets_per_write / elapsed.count();
+}
+
+} // namespace
+
+int main() {
+  std::printf(
+      "%8s %8s %16s %16s %8s\n",
+      "bytes",
+      "threads",
+      "per-packet pk/s",
+      "batched pk/s",
+      "speedup");
+
+  for (auto size : kPayloadSizes) {
+    for (auto threads : kThreadCounts) {
+      double per_packet;
+      {
+        TraceBufferHolder buffer = TraceBuffer::allocate(kBufferSlots);
+        std::atomic<uint32_t> stream_ids{0};
+        per_packet =
+            measurePacketsPerSec(threads, size, [&](const char* p, size_t s) {
+              writePerPacket(*buffer, stream_ids, p, s);
+            });
+      }
+
+      double batched;
+      {
+        TraceBufferHolder buffer = TraceBuffer::allocate(kBufferSlots);
+        PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+        batched =
+            measurePacketsPerSec(threads, size, [&](const char* p, size_t s) {
+              logger.write(const_cast<char*>(p), s);
+            });
+      }
+
+      std::printf(
+          "%8zu %8zu %16.0f %16.0f %7.2fx\n",
+          size,
+          threads,
+          per_packet,
+          batched,
+          batched / per_packet);
+    }
+  }
+  return 0;
+}
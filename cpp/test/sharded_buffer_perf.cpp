@@ -0,0 +1,99 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Compares write throughput of a single shared trace buffer against a
+// ShardedTraceBuffer, at 1 to 16 concurrent writers.
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <profilo/PacketLogger.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+
+using namespace facebook::profilo;
+using namespace facebook::profilo::logger;
+
+namespace {
+
+constexpr size_t kSlotsPerBuffer = 1000;
+constexpr size_t kShardCount = 8;
+constexpr size_t kWritesPerThread = 200000;
+// A packed StandardEntry, one packet per write.
+constexpr size_t kPayloadSize = 35;
+constexpr size_t kThreadCounts[] = {1, 2, 4, 8, 16};
+
+double measureWritesPerSec(size_t threads, PacketLogger& logger) {
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      char payload[kPayloadSize] = {};
+      while (!go.load()) {
+      }
+      for (size_t i = 0; i < kWritesPerThread; ++i) {
+        logger.write(payload, sizeof(payload));
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  auto elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start);
+
+  return threads * kWritesPerThread / elapsed.count();
+}
+
+} // namespace
+
+int main() {
+  std::printf(
+      "%8s %16s %16s %8s\n", "threads", "single w/s", "sharded w/s", "speedup");
+
+  for (auto threads : kThreadCounts) {
+    double single;
+    {
+      TraceBufferHolder buffer = TraceBuffer::allocate(kSlotsPerBuffer);
+      PacketLogger logger([&]() -> PacketBuffer& { return *buffer; });
+      single = measureWritesPerSec(threads, logger);
+    }
+
+    double sharded;
+    {
+      ShardedTraceBuffer buffer(kShardCount, kSlotsPerBuffer);
+      PacketLogger logger(
+          [&]() -> PacketBuffer& { return buffer.shardForCurrentThread(); });
+      sharded = measureWritesPerSec(threads, logger);
+    }
+
+    std::printf(
+        "%8zu %16.0f %16.0f %7.2fx\n",
+        threads,
+        single,
+        sharded,
+        sharded / single);
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/AsyncStreambuf.h>
+
+#include <stdexcept>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+AsyncStreambuf::AsyncStreambuf(
+    std::unique_ptr<std::streambuf> target,
+    size_t chunk_size,
+    size_t queue_depth)
+    : target_(std::move(target)),
+      chunk_size_(chunk_size),
+      pending_(queue_depth),
+      // One chunk is always being filled.
+      free_(queue_depth + 1),
+      current_(new char[chunk_size]),
+      failed_(false),
+      worker_() {
+  if (chunk_size == 0 || queue_depth == 0) {
+    throw std::invalid_argument("chunk_size and queue_depth must be positive");
+  }
+  for (size_t i = 0; i < queue_depth; ++i) {
+    free_.push(std::unique_ptr<char[]>(new char[chunk_size]));
+  }
+  setp(current_.get(), current_.get() + chunk_size_);
+  worker_ = std::thread([this] { work(); });
+}
+
+AsyncStreambuf::~AsyncStreambuf() {
+  // No sync, the target completes its output when destroyed.
+  handOff(nullptr);
+  pending_.close();
+  worker_.join();
+}
+
+AsyncStreambuf::int_type AsyncStreambuf::overflow(int_type ch) {
+  if (!handOff(nullptr)) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int AsyncStreambuf::sync() {
+  std::promise<bool> synced;
+  auto result = synced.get_future();
+  if (!handOff(&synced)) {
+    return -1;
+  }
+  return result.get() ? 0 : -1;
+}
+
+bool AsyncStreambuf::handOff(std::promise<bool>* synced) {
+  if (failed_.load()) {
+    return false;
+  }
+  size_t size = pptr() - pbase();
+  if (size == 0 && synced == nullptr) {
+    return true;
+  }
+  if (!pending_.push(Chunk{std::move(current_), size, synced}) ||
+      !free_.pop(current_)) {
+    return false;
+  }
+  setp(current_.get(), current_.get() + chunk_size_);
+  return true;
+}
+
+void AsyncStreambuf::work() {
+  Chunk chunk;
+  while (pending_.pop(chunk)) {
+    if (!failed_.load()) {
+      bool success;
+      try {
+        success = target_->sputn(chunk.data.get(), chunk.size) ==
+            static_cast<std::streamsize>(chunk.size);
+        if (success && chunk.synced != nullptr) {
+          success = target_->pubsync() == 0;
+        }
+      } catch (...) {
+        success = false;
+      }
+      if (!success) {
+        failed_.store(true);
+      }
+    }
+    if (chunk.synced != nullptr) {
+      chunk.synced->set_value(!failed_.load());
+    }
+    free_.push(std::move(chunk.data));
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,79 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <streambuf>
+#include <thread>
+
+#include <profilo/writer/BoundedQueue.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Moves writes to `target` onto a thread of their own: written bytes are
+// collected in chunks of chunk_size bytes and up to queue_depth full
+// chunks wait for the thread. Used to take compression off the thread
+// that encodes the trace.
+//
+// sync() returns once everything written so far has reached the target
+// and the target has been synced. Errors on the thread, including
+// exceptions, surface as failed writes or syncs.
+//
+class AsyncStreambuf : public std::streambuf {
+ public:
+  AsyncStreambuf(
+      std::unique_ptr<std::streambuf> target,
+      size_t chunk_size,
+      size_t queue_depth);
+  ~AsyncStreambuf() override;
+
+  AsyncStreambuf(const AsyncStreambuf&) = delete;
+  AsyncStreambuf& operator=(const AsyncStreambuf&) = delete;
+
+ protected:
+  int_type overflow(int_type ch) override;
+  int sync() override;
+
+ private:
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size;
+    // Set once the chunk and a target sync are done, if requested.
+    std::promise<bool>* synced;
+  };
+
+  std::unique_ptr<std::streambuf> target_;
+  const size_t chunk_size_;
+  BoundedQueue<Chunk> pending_;
+  BoundedQueue<std::unique_ptr<char[]>> free_;
+  std::unique_ptr<char[]> current_;
+  std::atomic<bool> failed_;
+  std::thread worker_;
+
+  bool handOff(std::promise<bool>* synced);
+  void work();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
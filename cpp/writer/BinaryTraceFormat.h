@@ -0,0 +1,119 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Binary trace file layout, written instead of the text format for traces
+// started with kBinaryTraceFormatFlag.
+//
+// Integers are LEB128 varints, signed ones zigzag-encoded; strings are a
+// varint length followed by the bytes.
+//
+//   file    := magic version header_count (key value)* block* end
+//   magic   := "dtbin\n"
+//   header  := "id", "prec" and the trace headers, as string pairs
+//   block   := rows frame_count
+//              new_type_count (type name)*
+//              new_string_count
+//              column{type, id, timestamp, tid, callid, matchid, extra}
+//              frames strings
+//   end     := a block with 0 rows
+//
+// Each column, frames and strings section is prefixed by its size in bytes
+// so readers can skip what they don't need. Every entry is one row:
+//  - type holds the EntryType shifted left by two, with the entry kind in
+//    the low bits (BinaryEntryKind); type names are given once per trace,
+//    in the block where the type first appears;
+//  - the other columns hold the difference to the previous row of the
+//    block;
+//  - frames entries have their depth in extra and their frames, root first,
+//    appended to the frames section as differences to the previous frame;
+//  - bytes entries have the index of their payload in the trace-wide
+//    string table in extra; payloads are added to the table, and written
+//    to the strings section, the first time they occur. Their timestamp,
+//    tid and callid repeat the previous row.
+// Timestamps are in units of 10^-prec seconds.
+//
+constexpr char kBinaryTraceMagic[] = "dtbin\n";
+constexpr size_t kBinaryTraceMagicSize = sizeof(kBinaryTraceMagic) - 1;
+
+constexpr uint32_t kBinaryTraceFormatVersion = 4;
+
+// Trace flag selecting this format. Must match Trace.FLAG_BINARY_FORMAT.
+constexpr int32_t kBinaryTraceFormatFlag = 1 << 2;
+
+enum BinaryEntryKind {
+  STANDARD_ENTRY = 0,
+  FRAMES_ENTRY = 1,
+  BYTES_ENTRY = 2,
+};
+
+constexpr int kBinaryEntryKindBits = 2;
+
+namespace detail {
+
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+      static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline void appendVarint(std::string& dst, uint64_t value) {
+  while (value >= 0x80) {
+    dst.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  dst.push_back(static_cast<char>(value));
+}
+
+inline void appendString(std::string& dst, const void* data, size_t size) {
+  appendVarint(dst, size);
+  dst.append(static_cast<const char*>(data), size);
+}
+
+//
+// Reads a varint from [data + offset, data + size), advancing offset.
+//
+inline uint64_t readVarint(const char* data, size_t& offset, size_t size) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64 && offset < size; shift += 7) {
+    auto byte = static_cast<uint8_t>(data[offset++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Malformed varint in binary trace");
+}
+
+} // namespace detail
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,219 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/BinaryTraceReader.h>
+
+#include <array>
+#include <cstring>
+#include <limits>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using detail::zigzagDecode;
+
+namespace {
+
+constexpr int kColumns = 7;
+
+[[noreturn]] void malformed(const char* what) {
+  throw std::runtime_error(std::string("Malformed binary trace: ") + what);
+}
+
+} // namespace
+
+BinaryTraceReader::BinaryTraceReader(std::istream& stream)
+    : stream_(stream), version_(0), headers_(), strings_(), done_(false) {
+  char magic[kBinaryTraceMagicSize];
+  if (!stream_.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kBinaryTraceMagic, sizeof(magic)) != 0) {
+    throw std::runtime_error("Not a binary trace");
+  }
+
+  version_ = readVarint();
+  if (version_ != kBinaryTraceFormatVersion) {
+    throw std::runtime_error(
+        "Unsupported binary trace version " + std::to_string(version_));
+  }
+
+  auto count = readVarint();
+  for (uint64_t i = 0; i < count; ++i) {
+    auto key = readString();
+    auto value = readString();
+    headers_.emplace_back(std::move(key), std::move(value));
+  }
+}
+
+uint64_t BinaryTraceReader::readVarint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    auto byte = stream_.get();
+    if (byte == std::char_traits<char>::eof()) {
+      malformed("truncated");
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  malformed("varint too long");
+}
+
+std::string BinaryTraceReader::readString() {
+  auto size = readVarint();
+  std::string value;
+  value.resize(size);
+  if (size > 0 && !stream_.read(&value[0], size)) {
+    malformed("truncated");
+  }
+  return value;
+}
+
+bool BinaryTraceReader::readBlock(EntryVisitor& visitor) {
+  if (done_) {
+    return false;
+  }
+
+  auto rows = readVarint();
+  if (rows == 0) {
+    done_ = true;
+    return false;
+  }
+  auto frame_count = readVarint();
+  auto new_types = readVarint();
+  for (uint64_t i = 0; i < new_types; ++i) {
+    // Type names are for readers without the EntryType enum.
+    readVarint();
+    readString();
+  }
+  auto new_strings = readVarint();
+
+  std::array<std::string, kColumns> columns;
+  for (auto& column : columns) {
+    column = readString();
+  }
+  auto frames_section = readString();
+  auto strings_section = readString();
+
+  size_t offset = 0;
+  for (uint64_t i = 0; i < new_strings; ++i) {
+    auto size = detail::readVarint(
+        strings_section.data(), offset, strings_section.size());
+    if (size > strings_section.size() - offset) {
+      malformed("string out of bounds");
+    }
+    strings_.emplace_back(strings_section, offset, size);
+    offset += size;
+  }
+
+  std::vector<int64_t> frames(frame_count);
+  int64_t frame = 0;
+  offset = 0;
+  for (auto& value : frames) {
+    frame += zigzagDecode(detail::readVarint(
+        frames_section.data(), offset, frames_section.size()));
+    value = frame;
+  }
+
+  std::array<size_t, kColumns> offsets{};
+  std::array<int64_t, kColumns> values{};
+  size_t next_frame = 0;
+  for (uint64_t row = 0; row < rows; ++row) {
+    for (int column = 0; column < kColumns; ++column) {
+      auto raw = detail::readVarint(
+          columns[column].data(), offsets[column], columns[column].size());
+      if (column == 0) {
+        values[column] = raw;
+      } else {
+        values[column] += zigzagDecode(raw);
+      }
+    }
+
+    auto kind = values[0] & ((1 << kBinaryEntryKindBits) - 1);
+    auto type = static_cast<EntryType>(values[0] >> kBinaryEntryKindBits);
+    int32_t id = values[1];
+    int64_t timestamp = values[2];
+    int32_t tid = values[3];
+    int32_t callid = values[4];
+    int32_t matchid = values[5];
+    int64_t extra = values[6];
+
+    switch (kind) {
+      case STANDARD_ENTRY: {
+        StandardEntry entry{
+            .id = id,
+            .type = type,
+            .timestamp = timestamp,
+            .tid = tid,
+            .callid = callid,
+            .matchid = matchid,
+            .extra = extra,
+        };
+        visitor.visit(entry);
+        break;
+      }
+      case FRAMES_ENTRY: {
+        if (extra < 0 || extra > std::numeric_limits<uint16_t>::max() ||
+            static_cast<size_t>(extra) > frames.size() - next_frame) {
+          malformed("frames out of bounds");
+        }
+        FramesEntry entry{
+            .id = id,
+            .type = type,
+            .timestamp = timestamp,
+            .tid = tid,
+            .matchid = matchid,
+            .frames = {.values = frames.data() + next_frame,
+                       .size = static_cast<uint16_t>(extra)},
+        };
+        next_frame += extra;
+        visitor.visit(entry);
+        break;
+      }
+      case BYTES_ENTRY: {
+        if (extra < 0 || static_cast<size_t>(extra) >= strings_.size() ||
+            strings_[extra].size() > std::numeric_limits<uint16_t>::max()) {
+          malformed("string index out of bounds");
+        }
+        auto& payload = strings_[extra];
+        BytesEntry entry{
+            .id = id,
+            .type = type,
+            .matchid = matchid,
+            .bytes = {.values =
+                          reinterpret_cast<const uint8_t*>(payload.data()),
+                      .size = static_cast<uint16_t>(payload.size())},
+        };
+        visitor.visit(entry);
+        break;
+      }
+      default:
+        malformed("unknown entry kind");
+    }
+  }
+  return true;
+}
+
+void BinaryTraceReader::read(EntryVisitor& visitor) {
+  while (readBlock(visitor)) {
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BinaryTraceFormat.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// Reads traces written by BinaryTraceWriter. Entries are passed to the
+// visitor with their absolute values; frames and bytes point into the
+// reader and are only valid during the visit() call. Throws
+// std::runtime_error on malformed or truncated input.
+//
+class BinaryTraceReader {
+ public:
+  // Reads the file header.
+  explicit BinaryTraceReader(std::istream& stream);
+
+  uint32_t version() const {
+    return version_;
+  }
+
+  const std::vector<std::pair<std::string, std::string>>& headers() const {
+    return headers_;
+  }
+
+  //
+  // Visits the entries of the next block. Returns false once the end of
+  // the trace has been reached.
+  //
+  bool readBlock(EntryVisitor& visitor);
+
+  // Visits every remaining entry.
+  void read(EntryVisitor& visitor);
+
+ private:
+  std::istream& stream_;
+  uint32_t version_;
+  std::vector<std::pair<std::string, std::string>> headers_;
+  std::vector<std::string> strings_;
+  bool done_;
+
+  uint64_t readVarint();
+  std::string readString();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,190 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/BinaryTraceWriter.h>
+
+#include <cstring>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using detail::appendString;
+using detail::appendVarint;
+using detail::zigzagEncode;
+
+BinaryTraceWriter::BinaryTraceWriter(
+    std::ostream& stream,
+    const std::string& trace_id,
+    size_t timestamp_precision,
+    const std::vector<std::pair<std::string, std::string>>& headers)
+    : stream_(stream),
+      columns_(),
+      last_values_(),
+      frames_(),
+      last_frame_(0),
+      types_(),
+      strings_(),
+      rows_(0),
+      frame_count_(0),
+      new_types_(0),
+      new_strings_(0),
+      known_types_(),
+      string_ids_(),
+      finished_(false) {
+  std::string header(kBinaryTraceMagic, kBinaryTraceMagicSize);
+  appendVarint(header, kBinaryTraceFormatVersion);
+  appendVarint(header, headers.size() + 2);
+
+  auto precision = std::to_string(timestamp_precision);
+  appendString(header, "id", 2);
+  appendString(header, trace_id.data(), trace_id.size());
+  appendString(header, "prec", 4);
+  appendString(header, precision.data(), precision.size());
+  for (auto const& entry : headers) {
+    appendString(header, entry.first.data(), entry.first.size());
+    appendString(header, entry.second.data(), entry.second.size());
+  }
+  stream_.write(header.data(), header.size());
+}
+
+void BinaryTraceWriter::visit(const StandardEntry& entry) {
+  appendRow(
+      STANDARD_ENTRY,
+      entry.type,
+      entry.id,
+      entry.timestamp,
+      entry.tid,
+      entry.callid,
+      entry.matchid,
+      entry.extra);
+}
+
+void BinaryTraceWriter::visit(const FramesEntry& entry) {
+  for (size_t idx = 0; idx < entry.frames.size; ++idx) {
+    int64_t frame = entry.frames.values[idx];
+    appendVarint(frames_, zigzagEncode(frame - last_frame_));
+    last_frame_ = frame;
+  }
+  frame_count_ += entry.frames.size;
+
+  appendRow(
+      FRAMES_ENTRY,
+      entry.type,
+      entry.id,
+      entry.timestamp,
+      entry.tid,
+      last_values_[CALLID],
+      entry.matchid,
+      entry.frames.size);
+}
+
+void BinaryTraceWriter::visit(const BytesEntry& entry) {
+  std::string payload(
+      reinterpret_cast<const char*>(entry.bytes.values), entry.bytes.size);
+  auto result = string_ids_.emplace(std::move(payload), string_ids_.size());
+  if (result.second) {
+    auto& added = result.first->first;
+    appendString(strings_, added.data(), added.size());
+    ++new_strings_;
+  }
+
+  appendRow(
+      BYTES_ENTRY,
+      entry.type,
+      entry.id,
+      last_values_[TIMESTAMP],
+      last_values_[TID],
+      last_values_[CALLID],
+      entry.matchid,
+      result.first->second);
+}
+
+void BinaryTraceWriter::appendRow(
+    BinaryEntryKind kind,
+    EntryType type,
+    int64_t id,
+    int64_t timestamp,
+    int64_t tid,
+    int64_t callid,
+    int64_t matchid,
+    int64_t extra) {
+  auto type_id = static_cast<int>(type);
+  if (known_types_.insert(type_id).second) {
+    auto name = to_string(type);
+    appendVarint(types_, type_id);
+    appendString(types_, name, std::strlen(name));
+    ++new_types_;
+  }
+  appendVarint(columns_[TYPE], (type_id << kBinaryEntryKindBits) | kind);
+
+  const int64_t values[] = {0, id, timestamp, tid, callid, matchid, extra};
+  for (int column = ID; column < kColumns; ++column) {
+    appendVarint(
+        columns_[column], zigzagEncode(values[column] - last_values_[column]));
+    last_values_[column] = values[column];
+  }
+
+  if (++rows_ == kBlockRows) {
+    flushBlock();
+  }
+}
+
+void BinaryTraceWriter::flushBlock() {
+  std::string block;
+  appendVarint(block, rows_);
+  appendVarint(block, frame_count_);
+  appendVarint(block, new_types_);
+  block += types_;
+  appendVarint(block, new_strings_);
+  for (auto& column : columns_) {
+    appendString(block, column.data(), column.size());
+  }
+  appendString(block, frames_.data(), frames_.size());
+  appendString(block, strings_.data(), strings_.size());
+  stream_.write(block.data(), block.size());
+
+  for (auto& column : columns_) {
+    column.clear();
+  }
+  last_values_.fill(0);
+  frames_.clear();
+  last_frame_ = 0;
+  types_.clear();
+  strings_.clear();
+  rows_ = 0;
+  frame_count_ = 0;
+  new_types_ = 0;
+  new_strings_ = 0;
+}
+
+void BinaryTraceWriter::finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  if (rows_ > 0) {
+    flushBlock();
+  }
+  std::string end;
+  appendVarint(end, 0);
+  stream_.write(end.data(), end.size());
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
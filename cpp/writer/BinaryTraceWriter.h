@@ -0,0 +1,93 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BinaryTraceFormat.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// Writes entries to `stream` in the binary trace format, see
+// BinaryTraceFormat.h. Entries are buffered into blocks of up to
+// kBlockRows rows, finish() writes the last block and the end marker.
+//
+class BinaryTraceWriter : public EntryVisitor {
+ public:
+  static constexpr size_t kBlockRows = 4096;
+
+  BinaryTraceWriter(
+      std::ostream& stream,
+      const std::string& trace_id,
+      size_t timestamp_precision,
+      const std::vector<std::pair<std::string, std::string>>& headers);
+
+  BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+  BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+  void visit(const StandardEntry& entry) override;
+  void visit(const FramesEntry& entry) override;
+  void visit(const BytesEntry& entry) override;
+
+  void finish();
+
+ private:
+  enum Column { TYPE, ID, TIMESTAMP, TID, CALLID, MATCHID, EXTRA, kColumns };
+
+  std::ostream& stream_;
+  std::array<std::string, kColumns> columns_;
+  std::array<int64_t, kColumns> last_values_;
+  std::string frames_;
+  int64_t last_frame_;
+  std::string types_;
+  std::string strings_;
+  size_t rows_;
+  size_t frame_count_;
+  size_t new_types_;
+  size_t new_strings_;
+  std::unordered_set<int> known_types_;
+  std::unordered_map<std::string, uint32_t> string_ids_;
+  bool finished_;
+
+  void appendRow(
+      BinaryEntryKind kind,
+      EntryType type,
+      int64_t id,
+      int64_t timestamp,
+      int64_t tid,
+      int64_t callid,
+      int64_t matchid,
+      int64_t extra);
+  void flushBlock();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
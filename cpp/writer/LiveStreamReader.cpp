@@ -0,0 +1,131 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LiveStreamReader.h"
+
+#include <profilo/writer/PacketReassembler.h>
+
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+FdStreamSink::FdStreamSink(int fd) : fd_(fd) {}
+
+void FdStreamSink::onEntry(const void* data, size_t size) {
+  uint32_t length = size;
+  writeFully(&length, sizeof(length));
+  writeFully(data, size);
+}
+
+void FdStreamSink::onLoss(uint64_t packets) {
+  uint32_t marker = 0;
+  writeFully(&marker, sizeof(marker));
+  writeFully(&packets, sizeof(packets));
+}
+
+void FdStreamSink::writeFully(const void* data, size_t size) {
+  auto bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    auto ret = ::write(fd_, bytes, size);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::system_category(), "write");
+    }
+    bytes += ret;
+    size -= ret;
+  }
+}
+
+LiveStreamReader::LiveStreamReader(
+    TraceBuffer& buffer,
+    std::shared_ptr<StreamSink> sink,
+    double resume_fraction)
+    : buffer_(buffer),
+      sink_(std::move(sink)),
+      resume_fraction_(resume_fraction),
+      stopped_(false),
+      lost_packets_(0) {
+  if (&buffer == &RingBuffer::get() &&
+      (RingBuffer::getRecordBuffer() != nullptr ||
+       RingBuffer::getShardedBuffer() != nullptr ||
+       RingBuffer::getResizableBuffer() != nullptr)) {
+    throw std::invalid_argument("The trace buffer doesn't use plain packets");
+  }
+}
+
+void LiveStreamReader::loop() {
+  auto callback = [this](const void* data, size_t size) {
+    sink_->onEntry(data, size);
+  };
+  std::unique_ptr<PacketReassembler> reassembler(
+      new PacketReassembler(callback));
+
+  auto cursor = buffer_.currentHead();
+  while (true) {
+    alignas(4) Packet packet;
+    if (buffer_.waitAndTryRead(packet, cursor)) {
+      // Only wakeups are empty, writers never send empty payloads.
+      if (packet.size == 0 && stopped_.load()) {
+        // Everything written before stop() has been forwarded.
+        return;
+      }
+      reassembler->process(packet);
+      cursor.moveForward();
+      continue;
+    }
+    if (stopped_.load()) {
+      // Lapped, the wakeup from stop() may be gone already.
+      return;
+    }
+
+    //
+    // The slot has been overwritten since we got here. Move back into the
+    // readable window and start over with the streams, their beginning may
+    // be gone. A torn read skips just the packet that was torn.
+    //
+    auto tail = buffer_.currentTail(resume_fraction_);
+    uint64_t lost = std::max<uint64_t>(1, cursor.stepsTo(tail));
+    cursor.moveForward(lost);
+
+    lost_packets_.fetch_add(lost, std::memory_order_relaxed);
+    sink_->onLoss(lost);
+    reassembler.reset(new PacketReassembler(callback));
+  }
+}
+
+void LiveStreamReader::stop() {
+  stopped_.store(true);
+
+  Packet wakeup{.stream = Packet::kPacketIdNone,
+                .start = false,
+                .next = false,
+                .size = 0,
+                .data = {}};
+  buffer_.write(wakeup);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
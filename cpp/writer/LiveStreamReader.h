@@ -0,0 +1,118 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <profilo/logger/buffer/RingBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Receives the entries read by a LiveStreamReader, in serialized form
+// (see EntryParser). Called on the reader thread.
+//
+struct StreamSink {
+  virtual ~StreamSink() {}
+
+  virtual void onEntry(const void* data, size_t size) = 0;
+
+  //
+  // The reader fell behind the writers and skipped `packets` packets.
+  // Entries that had only been partially read at that point are dropped.
+  //
+  virtual void onLoss(uint64_t packets) = 0;
+};
+
+//
+// Forwards entries to a pipe or a connected stream socket. Every entry is
+// framed as a uint32_t length followed by the entry bytes; a loss is framed
+// as a zero length followed by the uint64_t packet count, both in host byte
+// order. Throws std::system_error if the fd cannot be written to. The fd is
+// not owned. Writes to a closed pipe raise SIGPIPE unless it is ignored.
+//
+class FdStreamSink : public StreamSink {
+ public:
+  explicit FdStreamSink(int fd);
+
+  void onEntry(const void* data, size_t size) override;
+  void onLoss(uint64_t packets) override;
+
+ private:
+  const int fd_;
+
+  void writeFully(const void* data, size_t size);
+};
+
+//
+// A reader that tails a TraceBuffer independently of the TraceWriter,
+// starting from the writes that happen after loop() is entered. Readers
+// never slow down writers, so a reader that cannot keep up is lapped; when
+// that happens it resumes at `resume_fraction` into the readable window
+// (see LockFreeRingBuffer::currentTail) and reports the skipped packets to
+// the sink.
+//
+// This is a library API: neither the Java API nor the JNI layer starts a
+// reader. Embedders run loop() on a thread of their own and pick the
+// transport through the sink. Only plain packet buffers are supported.
+// The constructor throws std::invalid_argument for RingBuffer::get() when
+// the process uses the record, sharded or resizable format instead, since
+// get() is then the no-op buffer.
+//
+class LiveStreamReader {
+ public:
+  LiveStreamReader(
+      TraceBuffer& buffer,
+      std::shared_ptr<StreamSink> sink,
+      double resume_fraction = 0.5);
+
+  //
+  // Read and forward entries until stop() is called.
+  //
+  void loop();
+
+  //
+  // Makes loop() return once it has forwarded the entries written before
+  // the call. Writes an empty packet to the buffer to mark that point and to
+  // wake up a reader waiting for the next write. A reader that is lapped
+  // after the call returns right away.
+  //
+  void stop();
+
+  //
+  // Total number of packets skipped because the reader was lapped.
+  //
+  uint64_t lostPackets() const {
+    return lost_packets_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  TraceBuffer& buffer_;
+  std::shared_ptr<StreamSink> sink_;
+  const double resume_fraction_;
+  std::atomic<bool> stopped_;
+  std::atomic<uint64_t> lost_packets_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
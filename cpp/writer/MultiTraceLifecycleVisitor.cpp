@@ -23,6 +23,8 @@
 #include <memory>
 #include <sstream>
 #include <system_error>
+#include <utility>
+#include <vector>
 
 #include <profilo/writer/PacketReassembler.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
@@ -38,7 +40,8 @@ MultiTraceLifecycleVisitor::MultiTraceLifecycleVisitor(
     const std::string& trace_prefix,
     std::shared_ptr<TraceCallbacks> callbacks,
     const std::vector<std::pair<std::string, std::string>>& headers,
-    std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback)
+    std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback,
+    size_t compression_queue_depth)
     :
 
       folder_(folder),
@@ -48,6 +51,9 @@ MultiTraceLifecycleVisitor::MultiTraceLifecycleVisitor(
       visitors_(),
       consumed_traces_(),
       trace_backward_callback_(trace_backward_callback),
+      compression_queue_depth_(compression_queue_depth),
+      shared_encoder_(),
+      shared_outputs_(),
       done_(false) {}
 
 void MultiTraceLifecycleVisitor::visit(const StandardEntry& entry) {
@@ -56,10 +62,17 @@ void MultiTraceLifecycleVisitor::visit(const StandardEntry& entry) {
     case EntryType::TRACE_BACKWARDS:
     case EntryType::TRACE_START: {
       int64_t trace_id = entry.extra;
+      // A repeated start aborts the trace, and closes its output.
+      stopSharing(trace_id);
       visitors_.emplace(
           trace_id,
           TraceLifecycleVisitor(
-              folder_, trace_prefix_, callbacks_, trace_headers_, trace_id));
+              folder_,
+              trace_prefix_,
+              callbacks_,
+              trace_headers_,
+              trace_id,
+              compression_queue_depth_));
 
       visitors_.at(trace_id).visit(entry);
       consumed_traces_.insert(trace_id);
@@ -68,6 +81,7 @@ void MultiTraceLifecycleVisitor::visit(const StandardEntry& entry) {
         trace_backward_callback_(visitors_.at(trace_id));
       }
 
+      shareEncoding();
       break;
     }
     case EntryType::TRACE_END:
@@ -76,12 +90,17 @@ void MultiTraceLifecycleVisitor::visit(const StandardEntry& entry) {
       int64_t trace_id = entry.extra;
       auto visitor = visitors_.find(trace_id);
       if (visitor != visitors_.end()) {
+        stopSharing(trace_id);
         visitor->second.visit(entry);
         visitors_.erase(trace_id);
       }
       break;
     }
     default: {
+      if (!shared_outputs_.empty()) {
+        shared_encoder_.visit(entry);
+      }
+      // Shared traces don't encode the entry again, but may still act on it.
       for (auto&& visitor_entry : visitors_) {
         visitor_entry.second.visit(entry);
       }
@@ -94,18 +113,28 @@ void MultiTraceLifecycleVisitor::visit(const StandardEntry& entry) {
 }
 
 void MultiTraceLifecycleVisitor::visit(const FramesEntry& entry) {
+  if (!shared_outputs_.empty()) {
+    shared_encoder_.visit(entry);
+  }
   for (auto&& visitor_entry : visitors_) {
     visitor_entry.second.visit(entry);
   }
 }
 
 void MultiTraceLifecycleVisitor::visit(const BytesEntry& entry) {
+  if (!shared_outputs_.empty()) {
+    shared_encoder_.visit(entry);
+  }
   for (auto&& visitor_entry : visitors_) {
     visitor_entry.second.visit(entry);
   }
 }
 
 void MultiTraceLifecycleVisitor::abort(AbortReason reason) {
+  for (auto&& shared : shared_outputs_) {
+    shared_encoder_.detach(*shared.second);
+  }
+  shared_outputs_.clear();
   for (auto&& visitor_entry : visitors_) {
     visitor_entry.second.abort(reason);
   }
@@ -113,6 +142,36 @@ void MultiTraceLifecycleVisitor::abort(AbortReason reason) {
   done_ = true;
 }
 
+void MultiTraceLifecycleVisitor::shareEncoding() {
+  std::vector<std::pair<int64_t, std::ostream*>> text_traces;
+  for (auto&& visitor_entry : visitors_) {
+    auto output = visitor_entry.second.textOutput();
+    if (output != nullptr) {
+      text_traces.emplace_back(visitor_entry.first, output);
+    }
+  }
+  // A trace on its own keeps encoding its entries, its file doesn't need
+  // segments.
+  if (text_traces.size() < 2) {
+    return;
+  }
+  for (auto&& trace : text_traces) {
+    if (shared_outputs_.count(trace.first) == 0) {
+      shared_encoder_.attach(*trace.second);
+      visitors_.at(trace.first).startSharing();
+      shared_outputs_.emplace(trace);
+    }
+  }
+}
+
+void MultiTraceLifecycleVisitor::stopSharing(int64_t trace_id) {
+  auto shared = shared_outputs_.find(trace_id);
+  if (shared != shared_outputs_.end()) {
+    shared_encoder_.detach(*shared->second);
+    shared_outputs_.erase(shared);
+  }
+}
+
 bool MultiTraceLifecycleVisitor::done() {
   return done_;
 }
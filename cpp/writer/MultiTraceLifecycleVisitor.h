@@ -20,6 +20,7 @@
 
 #include <profilo/logger/buffer/RingBuffer.h>
 #include <profilo/writer/AbortReason.h>
+#include <profilo/writer/SharedTextEncoder.h>
 #include <profilo/writer/TraceCallbacks.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
 
@@ -29,6 +30,11 @@ namespace writer {
 
 using namespace facebook::profilo::entries;
 
+//
+// Writes every trace in progress. While text traces overlap, the entries
+// they all get are encoded once, by a SharedTextEncoder, rather than by
+// each of them.
+//
 class MultiTraceLifecycleVisitor : public EntryVisitor {
  public:
   MultiTraceLifecycleVisitor(
@@ -37,7 +43,8 @@ class MultiTraceLifecycleVisitor : public EntryVisitor {
       std::shared_ptr<TraceCallbacks> callbacks,
       const std::vector<std::pair<std::string, std::string>>& headers,
       std::function<void(TraceLifecycleVisitor& visitor)>
-          trace_backward_callback);
+          trace_backward_callback,
+      size_t compression_queue_depth = 0);
   virtual void visit(const StandardEntry& entry) override;
   virtual void visit(const FramesEntry& entry) override;
   virtual void visit(const BytesEntry& entry) override;
@@ -55,8 +62,16 @@ class MultiTraceLifecycleVisitor : public EntryVisitor {
   std::unordered_map<int64_t, TraceLifecycleVisitor> visitors_;
   std::unordered_set<int64_t> consumed_traces_;
   std::function<void(TraceLifecycleVisitor& visitor)> trace_backward_callback_;
+  size_t compression_queue_depth_;
+
+  SharedTextEncoder shared_encoder_;
+  // Traces attached to shared_encoder_ and their outputs.
+  std::unordered_map<int64_t, std::ostream*> shared_outputs_;
 
   bool done_;
+
+  void shareEncoding();
+  void stopSharing(int64_t trace_id);
 };
 
 } // namespace writer
@@ -0,0 +1,250 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/PacketBufferReader.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/BoundedQueue.h>
+#include <profilo/writer/MultiTraceLifecycleVisitor.h>
+#include <profilo/writer/PacketReassembler.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+// How long a partly filled batch waits for more packets before it's handed
+// to the encoding stage anyway. Also bounds how long the reading stage
+// takes to notice the end of the trace.
+constexpr auto kBatchHandOffInterval = std::chrono::milliseconds(5);
+
+//
+// Packets read by the reading stage of the pipeline. A batch holds
+// consecutive packets from a single buffer.
+//
+struct PacketBatch {
+  explicit PacketBatch(size_t capacity)
+      : packets(new Packet[capacity]),
+        count(0),
+        buffer(nullptr),
+        first(0),
+        generation(),
+        lost(false) {}
+
+  std::unique_ptr<Packet[]> packets;
+  size_t count;
+  TraceBuffer* buffer;
+  // Cursor of packets[0].
+  TraceBuffer::Cursor first;
+  std::shared_ptr<ResizableTraceBuffer::Generation> generation;
+  // The packet after the last one was lost.
+  bool lost;
+};
+
+} // namespace
+
+PacketBufferReader::PacketBufferReader(
+    TraceBuffer& buffer,
+    TraceBackwardsCallback trace_backwards_callback)
+    : buffer_(&buffer),
+      trace_backwards_callback_(trace_backwards_callback),
+      current_(),
+      pipelined_(false),
+      pipeline_() {}
+
+PacketBufferReader::PacketBufferReader(
+    TraceBackwardsCallback trace_backwards_callback)
+    : buffer_(nullptr),
+      trace_backwards_callback_(trace_backwards_callback),
+      current_(),
+      pipelined_(false),
+      pipeline_() {}
+
+TraceBuffer::Cursor PacketBufferReader::currentTail() {
+  return buffer_->currentTail();
+}
+
+void PacketBufferReader::enablePipeline(PipelineConfig config) {
+  if (config.batch_packets == 0 || config.arena_batches == 0) {
+    throw std::invalid_argument("Pipeline batches must not be empty");
+  }
+  pipelined_ = true;
+  pipeline_ = config;
+}
+
+size_t PacketBufferReader::compressionQueueDepth() const {
+  return pipelined_ ? pipeline_.compression_queue_depth : 0;
+}
+
+PacketBufferReader::Position PacketBufferReader::start(
+    TraceBuffer::Cursor& /* cursor */,
+    std::shared_ptr<void> /* pinned */) {
+  return Position{buffer_, nullptr, 0};
+}
+
+void PacketBufferReader::read(
+    MultiTraceLifecycleVisitor& visitor,
+    TraceBuffer::Cursor& cursor,
+    int64_t /* trace_id */,
+    std::shared_ptr<void> pinned) {
+  current_ = start(cursor, std::move(pinned));
+  if (pipelined_) {
+    readPacketsPipelined(visitor, cursor);
+  } else {
+    readPackets(visitor, cursor);
+  }
+  // Don't hold on to buffers that may be retired before the next trace.
+  current_ = Position();
+}
+
+void PacketBufferReader::traceBackwards(
+    entries::EntryVisitor& visitor,
+    TraceBuffer::Cursor& cursor) {
+  if (trace_backwards_callback_ != nullptr) {
+    trace_backwards_callback_(visitor, *current_.buffer, cursor);
+  }
+}
+
+void PacketBufferReader::readPackets(
+    MultiTraceLifecycleVisitor& visitor,
+    TraceBuffer::Cursor& cursor) {
+  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
+    EntryParser::parse(data, size, visitor);
+  });
+
+  while (!visitor.done()) {
+    prepare(current_, cursor);
+    alignas(4) Packet packet;
+    if (!current_.buffer->waitAndTryRead(packet, cursor)) {
+      // Missed event, abort.
+      visitor.abort(AbortReason::MISSED_EVENT);
+      break;
+    }
+    reassembler.process(packet);
+    cursor.moveForward();
+  }
+}
+
+void PacketBufferReader::readPacketsPipelined(
+    MultiTraceLifecycleVisitor& visitor,
+    TraceBuffer::Cursor& cursor) {
+  std::vector<std::unique_ptr<PacketBatch>> arena;
+  BoundedQueue<PacketBatch*> free_batches(pipeline_.arena_batches);
+  BoundedQueue<PacketBatch*> full_batches(pipeline_.arena_batches);
+  for (size_t i = 0; i < pipeline_.arena_batches; ++i) {
+    arena.emplace_back(new PacketBatch(pipeline_.batch_packets));
+    free_batches.push(arena.back().get());
+  }
+  std::atomic<bool> stop(false);
+
+  //
+  // Reading stage: only copies packets out of the buffer, so that it keeps
+  // up with the writers.
+  //
+  std::thread reader([&, cursor]() mutable {
+    auto position = current_;
+    PacketBatch* batch = nullptr;
+    auto deadline = std::chrono::steady_clock::now();
+
+    auto handOff = [&] {
+      full_batches.push(batch);
+      batch = nullptr;
+    };
+
+    while (!stop.load()) {
+      prepare(position, cursor);
+      if (batch != nullptr && batch->buffer != position.buffer) {
+        handOff();
+      }
+      if (batch == nullptr) {
+        free_batches.pop(batch);
+        batch->count = 0;
+        batch->buffer = position.buffer;
+        batch->first = cursor;
+        batch->generation = position.generation;
+        batch->lost = false;
+        deadline = std::chrono::steady_clock::now() + kBatchHandOffInterval;
+      }
+
+      auto result = position.buffer->waitAndTryReadUntil(
+          batch->packets[batch->count], cursor, deadline);
+      if (result == logger::lfrb::ReadResult::TIMEDOUT) {
+        if (batch->count > 0) {
+          handOff();
+        } else {
+          deadline = std::chrono::steady_clock::now() + kBatchHandOffInterval;
+        }
+        continue;
+      }
+      if (result == logger::lfrb::ReadResult::LOST) {
+        batch->lost = true;
+        handOff();
+        break;
+      }
+      cursor.moveForward();
+      if (++batch->count == pipeline_.batch_packets) {
+        handOff();
+      }
+    }
+
+    if (batch != nullptr) {
+      free_batches.push(batch);
+    }
+    full_batches.close();
+  });
+
+  //
+  // Encoding stage, on this thread: callbacks and the trace backwards
+  // callback see the cursor and buffer of the packet being processed.
+  //
+  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
+    EntryParser::parse(data, size, visitor);
+  });
+
+  PacketBatch* batch;
+  while (full_batches.pop(batch)) {
+    if (!visitor.done()) {
+      current_.buffer = batch->buffer;
+      current_.generation = batch->generation;
+      cursor = batch->first;
+      for (size_t i = 0; i < batch->count && !visitor.done(); ++i) {
+        reassembler.process(batch->packets[i]);
+        cursor.moveForward();
+      }
+      if (batch->lost && !visitor.done()) {
+        // Missed event, abort.
+        visitor.abort(AbortReason::MISSED_EVENT);
+      }
+    }
+    if (visitor.done()) {
+      stop.store(true);
+    }
+    batch->generation = nullptr;
+    free_batches.push(batch);
+  }
+  reader.join();
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/writer/TraceBufferReader.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using TraceBackwardsCallback = std::function<
+    void(entries::EntryVisitor&, TraceBuffer&, TraceBuffer::Cursor&)>;
+
+//
+// Reads and reassembles the packets of a packet buffer, on the calling
+// thread or in stages, see PipelineConfig.
+//
+class PacketBufferReader : public TraceBufferReader {
+ public:
+  PacketBufferReader(
+      TraceBuffer& buffer,
+      TraceBackwardsCallback trace_backwards_callback);
+
+  TraceBuffer::Cursor currentTail() override;
+
+  void read(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor,
+      int64_t trace_id,
+      std::shared_ptr<void> pinned) override;
+
+  void traceBackwards(
+      entries::EntryVisitor& visitor,
+      TraceBuffer::Cursor& cursor) override;
+
+  size_t compressionQueueDepth() const override;
+
+  void enablePipeline(PipelineConfig config) override;
+
+ protected:
+  using GenerationPtr = std::shared_ptr<ResizableTraceBuffer::Generation>;
+
+  //
+  // The buffer a reading thread is at. In a resizable buffer, also the
+  // generation that owns it.
+  //
+  struct Position {
+    TraceBuffer* buffer;
+    GenerationPtr generation;
+    // Packets left to read before looking at the buffer size again.
+    size_t unchecked;
+  };
+
+  explicit PacketBufferReader(TraceBackwardsCallback trace_backwards_callback);
+
+  //
+  // Returns where a trace starting at the cursor is read from, moving the
+  // cursor if it's not reachable there.
+  //
+  virtual Position start(
+      TraceBuffer::Cursor& cursor,
+      std::shared_ptr<void> pinned);
+
+  //
+  // Called by the reading thread before every packet it reads.
+  //
+  virtual void prepare(
+      Position& /* position */,
+      TraceBuffer::Cursor& /* cursor */) {}
+
+ private:
+  TraceBuffer* buffer_;
+  TraceBackwardsCallback trace_backwards_callback_;
+  // Where the packet being reassembled was read from.
+  Position current_;
+
+  bool pipelined_;
+  PipelineConfig pipeline_;
+
+  void readPackets(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor);
+  void readPacketsPipelined(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor);
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
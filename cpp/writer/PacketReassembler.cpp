@@ -14,95 +14,165 @@
  * limitations under the License.
  */
 
+
 #include "PacketReassembler.h"
 
 #include <algorithm>
+#include <cstring>
 
 namespace facebook {
 namespace profilo {
 namespace writer {
 
-using detail::PacketStream;
+namespace detail {
 
-PacketReassembler::PacketReassembler(
-    PacketReassembler::PayloadCallback callback)
-    : active_streams_(),
-      pooled_streams_(kStreamPoolSize),
-      callback_(std::move(callback)) {}
+StreamTable::StreamTable() : slots_(kInitialCapacity), size_(0) {}
 
-namespace {
+size_t StreamTable::homeSlot(StreamID stream) const {
+  // Stream IDs are handed out sequentially, scramble them before masking.
+  uint32_t hash = stream * 0x9e3779b9u;
+  hash ^= hash >> 16;
+  return hash & (slots_.size() - 1);
+}
 
-inline void appendToStream(PacketStream& stream, Packet const& packet) {
-  auto prev_size = stream.data.size();
-  auto next_size = prev_size + packet.size;
-  stream.data.resize(next_size);
+PacketStream* StreamTable::find(StreamID stream) {
+  auto mask = slots_.size() - 1;
+  for (auto idx = homeSlot(stream); slots_[idx].used; idx = (idx + 1) & mask) {
+    if (slots_[idx].stream == stream) {
+      return &slots_[idx];
+    }
+  }
+  return nullptr;
+}
 
-  char* data = static_cast<char*>(stream.data.data());
-  std::memcpy(data + prev_size, packet.data, packet.size);
+PacketStream& StreamTable::insert(StreamID stream) {
+  // Keep the load factor at or below 1/2.
+  if ((size_ + 1) * 2 > slots_.size()) {
+    grow();
+  }
+  auto mask = slots_.size() - 1;
+  auto idx = homeSlot(stream);
+  while (slots_[idx].used) {
+    idx = (idx + 1) & mask;
+  }
+  auto& entry = slots_[idx];
+  entry = PacketStream{};
+  entry.stream = stream;
+  entry.used = true;
+  ++size_;
+  return entry;
 }
 
-inline void appendToStreamReverse(PacketStream& stream, Packet const& packet) {
-  auto prev_size = stream.data.size();
-  auto next_size = prev_size + packet.size;
-  stream.data.resize(next_size);
+void StreamTable::erase(PacketStream& entry) {
+  auto mask = slots_.size() - 1;
+  size_t hole = &entry - slots_.data();
+  //
+  // Move back every entry after the hole whose probe sequence runs through
+  // it, up to the next free slot. Entries whose home slot lies cyclically
+  // in (hole, idx] are reachable without it and stay where they are.
+  //
+  for (auto idx = (hole + 1) & mask; slots_[idx].used; idx = (idx + 1) & mask) {
+    auto home = homeSlot(slots_[idx].stream);
+    bool reachable = hole <= idx ? (hole < home && home <= idx)
+                                 : (hole < home || home <= idx);
+    if (!reachable) {
+      slots_[hole] = slots_[idx];
+      hole = idx;
+    }
+  }
+  slots_[hole].used = false;
+  --size_;
+}
 
-  char* data = static_cast<char*>(stream.data.data());
-  std::memcpy(data + prev_size, packet.data, packet.size);
-  std::reverse(data + prev_size, data + prev_size + packet.size);
+void StreamTable::grow() {
+  std::vector<PacketStream> old(slots_.size() * 2);
+  old.swap(slots_);
+  auto mask = slots_.size() - 1;
+  for (auto const& entry : old) {
+    if (!entry.used) {
+      continue;
+    }
+    auto idx = homeSlot(entry.stream);
+    while (slots_[idx].used) {
+      idx = (idx + 1) & mask;
+    }
+    slots_[idx] = entry;
+  }
 }
 
-} // anonymous namespace
+} // namespace detail
 
-PacketStream PacketReassembler::newStream() {
-  if (!pooled_streams_.empty()) {
-    // Take a pooled stream and remove the moved-from instance.
-    PacketStream stream = std::move(*pooled_streams_.begin());
-    pooled_streams_.pop_front();
-    return stream;
+using detail::PacketChunk;
+using detail::PacketStream;
+
+PacketReassembler::PacketReassembler(
+    PacketReassembler::PayloadCallback callback)
+    : streams_(),
+      chunks_(),
+      free_chunks_(kNoChunk),
+      payload_(),
+      callback_(std::move(callback)) {}
+
+uint32_t PacketReassembler::newChunk(Packet const& packet) {
+  uint32_t idx;
+  if (free_chunks_ != kNoChunk) {
+    idx = free_chunks_;
+    free_chunks_ = chunks_[idx].next;
   } else {
-    // No pooled stream to use, make a new one.
-    return PacketStream{};
+    idx = chunks_.size();
+    chunks_.emplace_back();
   }
+  auto& chunk = chunks_[idx];
+  chunk.next = kNoChunk;
+  chunk.size = std::min<size_t>(packet.size, sizeof(chunk.data));
+  std::memcpy(chunk.data, packet.data, chunk.size);
+  return idx;
 }
 
-void PacketReassembler::recycleStream(PacketStream stream) {
-  // Return to pool, if necessary. Otherwise, release via RAII.
-  if (pooled_streams_.size() < kStreamPoolSize) {
-    // Changes the `size` to 0 but the `capacity` will not be affected.
-    stream.data.resize(0);
-    pooled_streams_.push_back(std::move(stream));
+void PacketReassembler::startStream(Packet const& packet) {
+  auto chunk = newChunk(packet);
+  auto& stream = streams_.insert(packet.stream);
+  stream.head = chunk;
+  stream.tail = chunk;
+  stream.size = chunks_[chunk].size;
+}
+
+void PacketReassembler::flushStream(PacketStream& stream) {
+  payload_.resize(stream.size);
+  auto out = payload_.data();
+  for (auto idx = stream.head; idx != kNoChunk; idx = chunks_[idx].next) {
+    std::memcpy(out, chunks_[idx].data, chunks_[idx].size);
+    out += chunks_[idx].size;
   }
+
+  // Hand the whole chain to the free list at once.
+  chunks_[stream.tail].next = free_chunks_;
+  free_chunks_ = stream.head;
+  streams_.erase(stream);
+
+  callback_(payload_.data(), payload_.size());
 }
 
 void PacketReassembler::process(Packet const& packet) {
   //
-  // Collect packets into active_streams_, inside PacketStream objects.
+  // Collect packets into streams_, chained in arrival order.
   //
   // Last packet within the stream flushes to the callback.
-  // The PacketStream object can then be moved to pooled_stream_ for reuse.
   //
 
   // Is this part of an existing stream?
-  if (active_streams_.size() > 0) {
-    for (auto it = active_streams_.begin(), end = active_streams_.end();
-         it != end;
-         ++it) {
-      auto& stream = *it;
-
-      if (stream.stream == packet.stream) {
-        appendToStream(stream, packet);
-
-        if (!packet.next) {
-          // Flush the stream
-          callback_(stream.data.data(), stream.data.size());
-
-          PacketStream temp_stream = std::move(*it);
-          active_streams_.erase(it); // remove moved-from instance
-
-          recycleStream(std::move(temp_stream));
-        }
-        return; // packet is handled
+  if (streams_.size() > 0) {
+    auto stream = streams_.find(packet.stream);
+    if (stream != nullptr) {
+      auto chunk = newChunk(packet);
+      chunks_[stream->tail].next = chunk;
+      stream->tail = chunk;
+      stream->size += chunks_[chunk].size;
+
+      if (!packet.next) {
+        flushStream(*stream);
       }
+      return; // packet is handled
     }
   }
 
@@ -110,43 +180,31 @@ void PacketReassembler::process(Packet const& packet) {
     callback_(packet.data, packet.size);
   } else if (packet.start) { // Ignore if we only started from the middle of the
                              // packet
-    PacketStream stream = newStream();
-    stream.stream = packet.stream;
-    appendToStream(stream, packet);
-    active_streams_.push_front(std::move(stream));
+    startStream(packet);
   }
 }
 
 void PacketReassembler::processBackwards(Packet const& packet) {
   //
-  // Collect packets into active_streams_, inside PacketStream objects.
+  // Collect packets into streams_. Packets arrive last to first, so each
+  // one is chained in front of the previous one.
   //
-  // Last packet within the stream flushes to the callback.
-  // The PacketStream object can then be moved to pooled_stream_ for reuse.
+  // First packet within the stream flushes to the callback.
   //
 
   // Is this part of an existing stream?
-  if (active_streams_.size() > 0) {
-    for (auto it = active_streams_.begin(), end = active_streams_.end();
-         it != end;
-         ++it) {
-      auto& stream = *it;
-
-      if (stream.stream == packet.stream) {
-        appendToStreamReverse(stream, packet);
-
-        if (packet.start) {
-          // Flush the stream
-          std::reverse(stream.data.begin(), stream.data.end());
-          callback_(stream.data.data(), stream.data.size());
-
-          PacketStream temp_stream = std::move(*it);
-          active_streams_.erase(it); // remove moved-from instance
-
-          recycleStream(std::move(temp_stream));
-        }
-        return; // packet is handled
+  if (streams_.size() > 0) {
+    auto stream = streams_.find(packet.stream);
+    if (stream != nullptr) {
+      auto chunk = newChunk(packet);
+      chunks_[chunk].next = stream->head;
+      stream->head = chunk;
+      stream->size += chunks_[chunk].size;
+
+      if (packet.start) {
+        flushStream(*stream);
       }
+      return; // packet is handled
     }
   }
 
@@ -154,10 +212,7 @@ void PacketReassembler::processBackwards(Packet const& packet) {
     callback_(packet.data, packet.size);
   } else if (!packet.next) { // Ignore if we only started from the middle of the
                              // packet
-    PacketStream stream = newStream();
-    stream.stream = packet.stream;
-    appendToStreamReverse(stream, packet);
-    active_streams_.push_front(std::move(stream));
+    startStream(packet);
   }
 }
 
@@ -14,12 +14,13 @@
  * limitations under the License.
  */
 
+
 #pragma once
 
 #include <profilo/logger/buffer/Packet.h>
 
+#include <cstdint>
 #include <functional>
-#include <list>
 #include <vector>
 
 namespace facebook {
@@ -30,15 +31,53 @@ using namespace logger;
 namespace writer {
 namespace detail {
 
+//
+// A payload being reassembled. Its packets sit in a chain of arena chunks,
+// from head to tail in payload order.
+//
 struct PacketStream {
   StreamID stream;
-  std::vector<char> data;
+  bool used;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t size;
+};
+
+//
+// Open-addressed hash table of the payloads being reassembled, keyed by
+// StreamID, with linear probing. Erasing shifts the entries that follow
+// back instead of leaving tombstones, so lookups stay short however many
+// streams come and go.
+//
+class StreamTable {
+ public:
+  StreamTable();
+
+  // Returns nullptr if the stream is not in the table.
+  PacketStream* find(StreamID stream);
+  // The stream must not be in the table already. The returned reference
+  // is valid until the next insert() or erase().
+  PacketStream& insert(StreamID stream);
+  void erase(PacketStream& entry);
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 16;
+
+  std::vector<PacketStream> slots_;
+  size_t size_;
+
+  size_t homeSlot(StreamID stream) const;
+  void grow();
+};
 
-  PacketStream() = default;
-  PacketStream(PacketStream&& other) = default;
-  PacketStream(PacketStream const& other) = delete;
-  PacketStream& operator=(PacketStream const& other) = delete;
-  PacketStream& operator=(PacketStream&& other) = default;
+struct PacketChunk {
+  uint32_t next;
+  uint16_t size;
+  char data[sizeof(Packet::data)];
 };
 
 } // namespace detail
@@ -52,15 +91,20 @@ class PacketReassembler {
   void processBackwards(Packet const& packet);
 
  private:
-  static constexpr auto kStreamPoolSize = 8;
+  static constexpr uint32_t kNoChunk = UINT32_MAX;
 
-  std::list<detail::PacketStream> active_streams_;
-  std::list<detail::PacketStream> pooled_streams_;
+  detail::StreamTable streams_;
+  // Packet arena. Chunks of flushed streams go on the free list and are
+  // reused, so the arena only grows with the number of packets in flight.
+  std::vector<detail::PacketChunk> chunks_;
+  uint32_t free_chunks_;
+  // Contiguous copy of the payload being flushed.
+  std::vector<char> payload_;
   PayloadCallback callback_;
 
-  detail::PacketStream newStream();
-  void startNewStream(Packet& packet);
-  void recycleStream(detail::PacketStream stream);
+  uint32_t newChunk(Packet const& packet);
+  void startStream(Packet const& packet);
+  void flushStream(detail::PacketStream& stream);
 };
 
 } // namespace writer
@@ -14,63 +14,25 @@
  * limitations under the License.
  */
 
+
 #include <profilo/writer/PrintEntryVisitor.h>
-#include <fmt/format.h>
 
 namespace facebook {
 namespace profilo {
 namespace writer {
 
-PrintEntryVisitor::PrintEntryVisitor(std::ostream& stream) : stream_(stream) {}
+PrintEntryVisitor::PrintEntryVisitor(std::ostream& stream) : printer_(stream) {}
 
 void PrintEntryVisitor::visit(const StandardEntry& data) {
-  stream_ << fmt::format_int{data.id}.c_str();
-  stream_ << '|';
-  stream_ << entries::to_string((EntryType)data.type);
-  stream_ << '|';
-  stream_ << fmt::format_int{data.timestamp}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.tid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.callid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.matchid}.c_str();
-  stream_ << '|';
-  stream_ << fmt::format_int{data.extra}.c_str();
-  stream_ << '\n';
+  printer_.visit(data);
 }
 
 void PrintEntryVisitor::visit(const FramesEntry& data) {
-  for (size_t idx = 0; idx < data.frames.size; ++idx) {
-    stream_ << fmt::format_int{data.id}.c_str();
-    stream_ << '|';
-    stream_ << entries::to_string((EntryType)data.type);
-    stream_ << '|';
-    stream_ << fmt::format_int{data.timestamp}.c_str();
-    stream_ << '|';
-    stream_ << fmt::format_int{data.tid}.c_str();
-    stream_ << "|0|";
-    stream_ << fmt::format_int{data.matchid}.c_str();
-    stream_ << '|';
-    stream_ << fmt::format_int{data.frames.values[idx]}.c_str();
-    stream_ << '\n';
-  }
+  printer_.visit(data);
 }
 
 void PrintEntryVisitor::visit(const BytesEntry& data) {
-  stream_ << fmt::format_int{data.id}.c_str();
-  stream_ << '|';
-  stream_ << entries::to_string((EntryType)data.type);
-  stream_ << '|';
-  stream_ << fmt::format_int{data.matchid}.c_str();
-  stream_ << '|';
-  {
-    char _bytes_buf[data.bytes.size + 1];
-    memset(_bytes_buf, 0, data.bytes.size + 1);
-    memcpy(_bytes_buf, data.bytes.values, data.bytes.size);
-    stream_ << _bytes_buf;
-  }
-  stream_ << '\n';
+  printer_.visit(data);
 }
 
 } // namespace writer
@@ -14,8 +14,13 @@
  * limitations under the License.
  */
 
+
 #pragma once
 
+#include <cstring>
+#include <ostream>
+
+#include <fmt/format.h>
 #include <profilo/entries/EntryParser.h>
 
 namespace facebook {
@@ -24,6 +29,92 @@ namespace writer {
 
 using namespace entries;
 
+//
+// Formats entries as lines of the text trace format. Each line is put
+// together in a buffer and written to the stream in one call. Defined in
+// the header so that it can be inlined into a writer::Pipeline.
+//
+class EntryPrinter {
+ public:
+  explicit EntryPrinter(std::ostream& stream) : stream_(stream), line_() {}
+
+  void visit(const StandardEntry& data) {
+    append(data.id);
+    append('|');
+    append(entries::to_string((EntryType)data.type));
+    append('|');
+    append(data.timestamp);
+    append('|');
+    append(data.tid);
+    append('|');
+    append(data.callid);
+    append('|');
+    append(data.matchid);
+    append('|');
+    append(data.extra);
+    append('\n');
+    flush();
+  }
+
+  void visit(const FramesEntry& data) {
+    for (size_t idx = 0; idx < data.frames.size; ++idx) {
+      append(data.id);
+      append('|');
+      append(entries::to_string((EntryType)data.type));
+      append('|');
+      append(data.timestamp);
+      append('|');
+      append(data.tid);
+      append("|0|");
+      append(data.matchid);
+      append('|');
+      append(data.frames.values[idx]);
+      append('\n');
+    }
+    flush();
+  }
+
+  void visit(const BytesEntry& data) {
+    append(data.id);
+    append('|');
+    append(entries::to_string((EntryType)data.type));
+    append('|');
+    append(data.matchid);
+    append('|');
+    // The bytes are printed as a string, up to the first NUL.
+    auto bytes = reinterpret_cast<const char*>(data.bytes.values);
+    line_.append(bytes, bytes + strnlen(bytes, data.bytes.size));
+    append('\n');
+    flush();
+  }
+
+ private:
+  std::ostream& stream_;
+  fmt::memory_buffer line_;
+
+  void append(int64_t value) {
+    fmt::format_int formatted{value};
+    line_.append(formatted.data(), formatted.data() + formatted.size());
+  }
+
+  void append(int32_t value) {
+    append(static_cast<int64_t>(value));
+  }
+
+  void append(char ch) {
+    line_.push_back(ch);
+  }
+
+  void append(const char* str) {
+    line_.append(str, str + std::strlen(str));
+  }
+
+  void flush() {
+    stream_.write(line_.data(), line_.size());
+    line_.clear();
+  }
+};
+
 class PrintEntryVisitor : public EntryVisitor {
  public:
   PrintEntryVisitor() = delete;
@@ -38,7 +129,7 @@ class PrintEntryVisitor : public EntryVisitor {
   virtual void visit(const BytesEntry& data);
 
  private:
-  std::ostream& stream_;
+  EntryPrinter printer_;
 };
 
 } // namespace writer
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/RecordBufferReader.h>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/MultiTraceLifecycleVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+RecordBufferReader::RecordBufferReader(
+    RecordBuffer& buffer,
+    RecordTraceBackwardsCallback trace_backwards_callback)
+    : buffer_(buffer),
+      trace_backwards_callback_(trace_backwards_callback),
+      record_(new char[RecordBuffer::kMaxRecordSize]) {}
+
+TraceBuffer::Cursor RecordBufferReader::currentTail() {
+  return buffer_.currentTail();
+}
+
+void RecordBufferReader::read(
+    MultiTraceLifecycleVisitor& visitor,
+    TraceBuffer::Cursor& cursor,
+    int64_t /* trace_id */,
+    std::shared_ptr<void> /* pinned */) {
+  while (!visitor.done()) {
+    uint32_t size;
+    if (!buffer_.waitAndTryRead(
+            record_.get(), RecordBuffer::kMaxRecordSize, cursor, size)) {
+      // Missed event, abort.
+      visitor.abort(AbortReason::MISSED_EVENT);
+      break;
+    }
+    EntryParser::parse(record_.get(), size, visitor);
+    cursor.moveForward(RecordBuffer::recordSpan(size));
+  }
+}
+
+void RecordBufferReader::traceBackwards(
+    entries::EntryVisitor& visitor,
+    TraceBuffer::Cursor& cursor) {
+  if (trace_backwards_callback_ != nullptr) {
+    trace_backwards_callback_(visitor, buffer_, cursor);
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,63 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <profilo/logger/buffer/RingBuffer.h>
+#include <profilo/writer/TraceBufferReader.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using RecordTraceBackwardsCallback = std::function<
+    void(entries::EntryVisitor&, RecordBuffer&, RecordBuffer::Cursor&)>;
+
+//
+// Reads variable-length records. Records hold whole entries, so no
+// reassembly is needed.
+//
+class RecordBufferReader : public TraceBufferReader {
+ public:
+  RecordBufferReader(
+      RecordBuffer& buffer,
+      RecordTraceBackwardsCallback trace_backwards_callback);
+
+  TraceBuffer::Cursor currentTail() override;
+
+  void read(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor,
+      int64_t trace_id,
+      std::shared_ptr<void> pinned) override;
+
+  void traceBackwards(
+      entries::EntryVisitor& visitor,
+      TraceBuffer::Cursor& cursor) override;
+
+ private:
+  RecordBuffer& buffer_;
+  RecordTraceBackwardsCallback trace_backwards_callback_;
+  // Holds the record being read.
+  std::unique_ptr<char[]> record_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,119 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/ResizableBufferReader.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+ResizableBufferReader::ResizableBufferReader(
+    ResizableTraceBuffer& buffer,
+    TraceBackwardsCallback trace_backwards_callback)
+    : PacketBufferReader(trace_backwards_callback),
+      buffer_(buffer),
+      resizing_(false),
+      resize_policy_(),
+      base_slots_(0) {}
+
+TraceBuffer::Cursor ResizableBufferReader::currentTail() {
+  return buffer_.acquire()->buffer().currentTail();
+}
+
+std::shared_ptr<void> ResizableBufferReader::pin() {
+  return buffer_.acquire();
+}
+
+void ResizableBufferReader::enableResizing(ResizePolicy policy) {
+  if (policy.grow_percent == 0 || policy.check_interval == 0) {
+    throw std::invalid_argument("Resize thresholds must not be 0");
+  }
+  resizing_ = true;
+  resize_policy_ = policy;
+  base_slots_ = buffer_.acquire()->buffer().capacity();
+}
+
+PacketBufferReader::Position ResizableBufferReader::start(
+    TraceBuffer::Cursor& cursor,
+    std::shared_ptr<void> pinned) {
+  auto generation = pinned != nullptr
+      ? std::static_pointer_cast<ResizableTraceBuffer::Generation>(pinned)
+      : buffer_.acquire();
+  // Writes from before the generation was captured are not reachable.
+  if (cursor < generation->buffer().begin()) {
+    cursor = generation->buffer().begin();
+  }
+  followResizes(generation, cursor);
+  auto buffer = &generation->buffer();
+  return Position{buffer, std::move(generation), 0};
+}
+
+void ResizableBufferReader::prepare(
+    Position& position,
+    TraceBuffer::Cursor& cursor) {
+  followResizes(position.generation, cursor);
+  position.buffer = &position.generation->buffer();
+  if (position.unchecked-- == 0) {
+    position.unchecked = resize_policy_.check_interval - 1;
+    growIfBehind(position.generation, cursor);
+  }
+}
+
+void ResizableBufferReader::followResizes(
+    GenerationPtr& generation,
+    TraceBuffer::Cursor& cursor) {
+  while (generation->isSealed() && !(cursor < generation->end())) {
+    generation = generation->next();
+    cursor = generation->buffer().begin();
+  }
+}
+
+void ResizableBufferReader::growIfBehind(
+    const GenerationPtr& generation,
+    const TraceBuffer::Cursor& cursor) {
+  // A sealed generation is done growing, its successor is what writers use.
+  if (!resizing_ || generation->isSealed()) {
+    return;
+  }
+  auto& buffer = generation->buffer();
+  size_t capacity = buffer.capacity();
+  if (capacity >= resize_policy_.max_slots) {
+    return;
+  }
+  auto unread = cursor.stepsTo(buffer.currentHead());
+  if (unread * 100 < capacity * resize_policy_.grow_percent) {
+    return;
+  }
+  buffer_.resize(std::min(capacity * 2, resize_policy_.max_slots));
+}
+
+void ResizableBufferReader::onIdle() {
+  if (!resizing_) {
+    return;
+  }
+  // Traces submitted from now on hold the generation they started in.
+  if (buffer_.acquire()->buffer().capacity() > base_slots_) {
+    buffer_.resize(base_slots_);
+  }
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
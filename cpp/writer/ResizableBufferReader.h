@@ -0,0 +1,72 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
+#include <profilo/writer/PacketBufferReader.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Reads a packet buffer that may be resized while a trace is read. The
+// buffer generation holding the cursor is pinned when the trace is
+// submitted and followed across resizes from there.
+//
+class ResizableBufferReader : public PacketBufferReader {
+ public:
+  ResizableBufferReader(
+      ResizableTraceBuffer& buffer,
+      TraceBackwardsCallback trace_backwards_callback);
+
+  TraceBuffer::Cursor currentTail() override;
+
+  std::shared_ptr<void> pin() override;
+
+  void onIdle() override;
+
+  void enableResizing(ResizePolicy policy) override;
+
+ protected:
+  Position start(TraceBuffer::Cursor& cursor, std::shared_ptr<void> pinned)
+      override;
+
+  void prepare(Position& position, TraceBuffer::Cursor& cursor) override;
+
+ private:
+  ResizableTraceBuffer& buffer_;
+
+  bool resizing_;
+  ResizePolicy resize_policy_;
+  // Size the buffer shrinks back to, in slots.
+  size_t base_slots_;
+
+  static void followResizes(
+      GenerationPtr& generation,
+      TraceBuffer::Cursor& cursor);
+  void growIfBehind(
+      const GenerationPtr& generation,
+      const TraceBuffer::Cursor& cursor);
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
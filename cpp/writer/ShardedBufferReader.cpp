@@ -0,0 +1,386 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <profilo/writer/ShardedBufferReader.h>
+
+#include <algorithm>
+#include <queue>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/MultiTraceLifecycleVisitor.h>
+#include <profilo/writer/PacketReassembler.h>
+#include <profilo/writer/trace_backwards.h>
+#include <util/common.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+// Callers take an entry's timestamp a little before the write starts and
+// raises its shard's watermark. Shards with no write in progress are only
+// merged up to this long ago.
+constexpr int64_t kShardWriteDelayNs = 1000000;
+
+// Writes that don't go through the Logger don't wake up the reader, it
+// checks the shards at least this often.
+constexpr auto kShardWaitTimeout = std::chrono::milliseconds(50);
+
+//
+// Extracts what the shard merge needs to know about an entry.
+// BytesEntry and STRING_REFERENCE have no timestamp of their own. They take
+// the highest one read from the shard so far, which keeps them after the
+// entry they annotate.
+//
+class MergeKeyVisitor : public EntryVisitor {
+ public:
+  int64_t timestamp = 0;
+  bool trace_start = false;
+  int64_t trace_id = 0;
+
+  void visit(const StandardEntry& entry) override {
+    trace_start = entry.type == EntryType::TRACE_START ||
+        entry.type == EntryType::TRACE_BACKWARDS;
+    trace_id = entry.extra;
+    if (entry.type == EntryType::STRING_REFERENCE) {
+      timestamp = highest_;
+    } else {
+      setTimestamp(entry.timestamp);
+    }
+  }
+
+  void visit(const FramesEntry& entry) override {
+    trace_start = false;
+    setTimestamp(entry.timestamp);
+  }
+
+  void visit(const BytesEntry& /* entry */) override {
+    trace_start = false;
+    timestamp = highest_;
+  }
+
+ private:
+  int64_t highest_ = 0;
+
+  void setTimestamp(int64_t value) {
+    timestamp = value;
+    highest_ = std::max(highest_, value);
+  }
+};
+
+int64_t lowestWatermark(ShardedTraceBuffer& buffer) {
+  int64_t lowest = ShardWatermark::kIdle;
+  for (size_t i = 0; i < buffer.shardCount(); ++i) {
+    lowest = std::min(lowest, buffer.lowestWatermark(i));
+  }
+  return lowest;
+}
+
+} // namespace
+
+//
+// Reads a shard ahead of the merge, without blocking, and keeps the
+// reassembled entries that have not been merged yet ordered by timestamp.
+// Threads sharing the shard may have committed them in a different order.
+//
+class ShardReader {
+ public:
+  struct PendingEntry {
+    int64_t timestamp;
+    // Read order, breaks ties between equal timestamps.
+    uint64_t sequence;
+    bool trace_start;
+    int64_t trace_id;
+    std::vector<char> data;
+  };
+
+  enum class State { READY, IDLE, LOST };
+
+  //
+  // Reads everything in the shard, from its tail on.
+  //
+  explicit ShardReader(TraceBuffer& buffer)
+      : ShardReader(buffer, false, TraceBuffer::Cursor{0}, 0) {}
+
+  //
+  // Reads the shard from its tail up to `end` and keeps only the entries
+  // from `from` on.
+  //
+  ShardReader(TraceBuffer& buffer, TraceBuffer::Cursor end, int64_t from)
+      : ShardReader(buffer, true, end, from) {}
+
+  ShardReader(const ShardReader&) = delete;
+  ShardReader& operator=(const ShardReader&) = delete;
+
+  //
+  // Reads everything committed to the shard so far.
+  //
+  State poll() {
+    while (cursor_ < limit()) {
+      alignas(4) Packet packet;
+      if (!buffer_.tryRead(packet, cursor_)) {
+        if (cursor_ < buffer_.currentTail()) {
+          // Lapped by the writers.
+          return State::LOST;
+        }
+        // The write is still in progress.
+        break;
+      }
+      reassembler_.process(packet);
+      cursor_.moveForward();
+    }
+    return pending_.empty() ? State::IDLE : State::READY;
+  }
+
+  //
+  // Returns true if poll() would read a packet or find it's been lapped.
+  //
+  bool hasNewPackets() {
+    if (!(cursor_ < limit())) {
+      return false;
+    }
+    alignas(4) Packet packet;
+    return buffer_.tryRead(packet, cursor_) ||
+        cursor_ < buffer_.currentTail();
+  }
+
+  const TraceBuffer::Cursor& cursor() const {
+    return cursor_;
+  }
+
+  bool empty() const {
+    return pending_.empty();
+  }
+
+  const PendingEntry& front() const {
+    return pending_.top();
+  }
+
+  void pop() {
+    pending_.pop();
+  }
+
+ private:
+  struct Later {
+    bool operator()(const PendingEntry& a, const PendingEntry& b) const {
+      return a.timestamp != b.timestamp ? a.timestamp > b.timestamp
+                                        : a.sequence > b.sequence;
+    }
+  };
+
+  TraceBuffer& buffer_;
+  TraceBuffer::Cursor cursor_;
+  bool bounded_;
+  TraceBuffer::Cursor end_;
+  int64_t from_;
+  MergeKeyVisitor keys_;
+  uint64_t sequence_;
+  std::priority_queue<PendingEntry, std::vector<PendingEntry>, Later>
+      pending_;
+  PacketReassembler reassembler_;
+
+  ShardReader(
+      TraceBuffer& buffer,
+      bool bounded,
+      TraceBuffer::Cursor end,
+      int64_t from)
+      : buffer_(buffer),
+        cursor_(buffer.currentTail()),
+        bounded_(bounded),
+        end_(end),
+        from_(from),
+        keys_(),
+        sequence_(0),
+        pending_(),
+        reassembler_([this](const void* data, size_t size) {
+          EntryParser::parse(data, size, keys_);
+          if (bounded_ && keys_.timestamp < from_) {
+            return;
+          }
+          auto bytes = static_cast<const char*>(data);
+          pending_.push(PendingEntry{
+              keys_.timestamp,
+              sequence_++,
+              keys_.trace_start,
+              keys_.trace_id,
+              std::vector<char>(bytes, bytes + size)});
+        }) {}
+
+  TraceBuffer::Cursor limit() {
+    auto head = buffer_.currentHead();
+    return bounded_ && end_ < head ? end_ : head;
+  }
+};
+
+namespace {
+
+//
+// Returns the reader with the earliest entry pending, or nullptr if there
+// is none.
+//
+ShardReader* earliest(const std::vector<std::unique_ptr<ShardReader>>& readers) {
+  ShardReader* next = nullptr;
+  for (auto& reader : readers) {
+    if (!reader->empty() &&
+        (next == nullptr ||
+         reader->front().timestamp < next->front().timestamp)) {
+      next = reader.get();
+    }
+  }
+  return next;
+}
+
+} // namespace
+
+ShardedBufferReader::ShardedBufferReader(ShardedTraceBuffer& buffer)
+    : buffer_(buffer), readers_(), merging_timestamp_(0) {}
+
+ShardedBufferReader::~ShardedBufferReader() = default;
+
+TraceBuffer::Cursor ShardedBufferReader::currentTail() {
+  // Cursors are ignored, any one will do.
+  return buffer_.shard(0).currentTail();
+}
+
+void ShardedBufferReader::traceBackwards(
+    entries::EntryVisitor& visitor,
+    TraceBuffer::Cursor& /* cursor */) {
+  // Everything before the TRACE_BACKWARDS entry is behind the live
+  // readers, and has been skipped while looking for it.
+  auto until = merging_timestamp_;
+  auto from = until - kTraceBackdatingWindowUs * 1000;
+  std::vector<std::unique_ptr<ShardReader>> replays;
+  for (size_t i = 0; i < readers_.size(); ++i) {
+    auto end = readers_[i]->cursor();
+    replays.emplace_back(new ShardReader(buffer_.shard(i), end, from));
+    while (replays.back()->poll() == ShardReader::State::LOST) {
+      // Overwritten by newer writes, carry on from what's left.
+      replays.back().reset(new ShardReader(buffer_.shard(i), end, from));
+    }
+  }
+
+  ShardReader* next;
+  while ((next = earliest(replays)) != nullptr &&
+         next->front().timestamp < until) {
+    auto& entry = next->front();
+    EntryParser::parse(entry.data.data(), entry.data.size(), visitor);
+    next->pop();
+  }
+}
+
+void ShardedBufferReader::read(
+    MultiTraceLifecycleVisitor& visitor,
+    TraceBuffer::Cursor& /* cursor */,
+    int64_t trace_id,
+    std::shared_ptr<void> /* pinned */) {
+  readers_.clear();
+  for (size_t i = 0; i < buffer_.shardCount(); ++i) {
+    readers_.emplace_back(new ShardReader(buffer_.shard(i)));
+  }
+
+  bool started = false;
+  while (!visitor.done()) {
+    // Entries up to the watermark can't be preceded by anything not read
+    // yet, as long as it's taken before the shards are read.
+    int64_t now = monotonicTime();
+    int64_t shard_watermark = lowestWatermark(buffer_);
+    int64_t watermark = std::min(now - kShardWriteDelayNs, shard_watermark);
+
+    bool lost = false;
+    bool all_idle = true;
+    for (size_t i = 0; i < readers_.size(); ++i) {
+      auto state = readers_[i]->poll();
+      if (state == ShardReader::State::LOST) {
+        if (started) {
+          lost = true;
+          break;
+        }
+        // Nothing of the trace has been consumed yet, catch up with the tail.
+        readers_[i].reset(new ShardReader(buffer_.shard(i)));
+        all_idle = false;
+        continue;
+      }
+      if (state == ShardReader::State::READY) {
+        all_idle = false;
+      }
+    }
+
+    if (lost) {
+      // Missed event, abort.
+      visitor.abort(AbortReason::MISSED_EVENT);
+      break;
+    }
+
+    bool merged = false;
+    while (!visitor.done()) {
+      auto next = earliest(readers_);
+      if (next == nullptr || next->front().timestamp > watermark) {
+        break;
+      }
+
+      auto& entry = next->front();
+      if (!started) {
+        started = entry.trace_start && entry.trace_id == trace_id;
+      }
+      if (started) {
+        merging_timestamp_ = entry.timestamp;
+        EntryParser::parse(entry.data.data(), entry.data.size(), visitor);
+      }
+      next->pop();
+      merged = true;
+    }
+
+    if (!merged && !visitor.done()) {
+      if (!started && all_idle) {
+        // Read everything without finding the start, it's been overwritten.
+        break;
+      }
+      auto deadline = std::chrono::steady_clock::now() + kShardWaitTimeout;
+      auto next = earliest(readers_);
+      if (next != nullptr && next->front().timestamp <= shard_watermark) {
+        // Only held back by writes that may not have begun yet. Both
+        // clocks are CLOCK_MONOTONIC.
+        auto due = std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds(
+                    next->front().timestamp + kShardWriteDelayNs)));
+        deadline = std::min(deadline, due);
+      }
+      waitForWrites(shard_watermark, deadline);
+    }
+  }
+  readers_.clear();
+}
+
+void ShardedBufferReader::waitForWrites(
+    int64_t watermark,
+    std::chrono::steady_clock::time_point deadline) {
+  buffer_.waitForWrite(
+      [this, watermark]() {
+        for (auto& reader : readers_) {
+          if (reader->hasNewPackets()) {
+            return true;
+          }
+        }
+        return lowestWatermark(buffer_) != watermark;
+      },
+      deadline);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+#include <profilo/writer/TraceBufferReader.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+class ShardReader;
+
+//
+// Merges the shards of a ShardedTraceBuffer by timestamp. Shards have no
+// common cursor, so traces are located by their ID instead: every shard is
+// scanned from its tail, entries up to the TRACE_START (or TRACE_BACKWARDS)
+// of the trace are skipped and the rest goes to the visitor in timestamp
+// order. The start entry must have been written before the trace is read,
+// otherwise no trace is processed.
+//
+// Backwards traces replay what's left of every shard from before the
+// TRACE_BACKWARDS entry, within the backdating window, merged the same way.
+//
+class ShardedBufferReader : public TraceBufferReader {
+ public:
+  explicit ShardedBufferReader(ShardedTraceBuffer& buffer);
+  ~ShardedBufferReader() override;
+
+  TraceBuffer::Cursor currentTail() override;
+
+  void read(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor,
+      int64_t trace_id,
+      std::shared_ptr<void> pinned) override;
+
+  void traceBackwards(
+      entries::EntryVisitor& visitor,
+      TraceBuffer::Cursor& cursor) override;
+
+ private:
+  ShardedTraceBuffer& buffer_;
+  // Live readers of the trace being read, one per shard.
+  std::vector<std::unique_ptr<ShardReader>> readers_;
+  // Timestamp of the entry being merged.
+  int64_t merging_timestamp_;
+
+  //
+  // Blocks until a shard has something new to merge, the shard watermarks
+  // have changed from `watermark` or the deadline, whichever comes first.
+  //
+  void waitForWrites(
+      int64_t watermark,
+      std::chrono::steady_clock::time_point deadline);
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/SharedTextEncoder.h>
+
+#include <algorithm>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+std::unique_ptr<TextTracePipeline> makeTextTracePipeline(std::ostream& output) {
+  return std::make_unique<TextTracePipeline>(
+      InvertFrames(),
+      TruncateTimestamps(),
+      ResolveStrings(),
+      InternStacks(),
+      InternStrings(),
+      DeltaEncode(),
+      output);
+}
+
+StandardEntry makeSegmentStart() {
+  return StandardEntry{
+      .id = 0,
+      .type = EntryType::SEGMENT_START,
+      .timestamp = 0,
+      .tid = 0,
+      .callid = 0,
+      .matchid = 0,
+      .extra = 0,
+  };
+}
+
+SharedTextEncoder::SharedTextEncoder()
+    : tee_(), stream_(&tee_), pipeline_(nullptr), restart_(true) {}
+
+void SharedTextEncoder::attach(std::ostream& output) {
+  tee_.outputs.push_back(&output);
+  restart_ = true;
+}
+
+void SharedTextEncoder::detach(std::ostream& output) {
+  auto& outputs = tee_.outputs;
+  outputs.erase(
+      std::remove(outputs.begin(), outputs.end(), &output), outputs.end());
+}
+
+void SharedTextEncoder::visit(const StandardEntry& entry) {
+  pipeline().visit(entry);
+}
+
+void SharedTextEncoder::visit(const FramesEntry& entry) {
+  pipeline().visit(entry);
+}
+
+void SharedTextEncoder::visit(const BytesEntry& entry) {
+  pipeline().visit(entry);
+}
+
+TextTracePipeline& SharedTextEncoder::pipeline() {
+  if (restart_) {
+    // Attached traces may start anywhere, reset the encoding state for them.
+    pipeline_ = makeTextTracePipeline(stream_);
+    pipeline_->visit(makeSegmentStart());
+    restart_ = false;
+  }
+  return *pipeline_;
+}
+
+SharedTextEncoder::TeeStreambuf::int_type
+SharedTextEncoder::TeeStreambuf::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof())) {
+    return traits_type::not_eof(ch);
+  }
+  for (auto output : outputs) {
+    output->put(traits_type::to_char_type(ch));
+  }
+  return ch;
+}
+
+std::streamsize SharedTextEncoder::TeeStreambuf::xsputn(
+    const char* data,
+    std::streamsize size) {
+  for (auto output : outputs) {
+    output->write(data, size);
+  }
+  return size;
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
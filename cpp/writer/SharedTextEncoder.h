@@ -0,0 +1,97 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/PrintEntryVisitor.h>
+#include <profilo/writer/VisitorPipeline.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace facebook::profilo::entries;
+
+// outputTime = truncate(current) - truncate(prev)
+using TextTracePipeline = Pipeline<
+    InvertFrames,
+    TruncateTimestamps,
+    ResolveStrings,
+    InternStacks,
+    InternStrings,
+    DeltaEncode,
+    EntryPrinter>;
+
+std::unique_ptr<TextTracePipeline> makeTextTracePipeline(std::ostream& output);
+
+//
+// Starts a segment of a text trace: the entries after it are encoded from
+// scratch, with no deltas, stacks or strings carried over from before.
+//
+StandardEntry makeSegmentStart();
+
+//
+// Encodes entries once for several text traces and writes the result to
+// all of them, so that overlapping traces don't each encode the same
+// entries. Attaching a trace starts a new segment in every attached trace,
+// from which the new one can be decoded on its own.
+//
+class SharedTextEncoder : public EntryVisitor {
+ public:
+  SharedTextEncoder();
+
+  SharedTextEncoder(const SharedTextEncoder&) = delete;
+  SharedTextEncoder& operator=(const SharedTextEncoder&) = delete;
+
+  void attach(std::ostream& output);
+  void detach(std::ostream& output);
+
+  virtual void visit(const StandardEntry& entry) override;
+  virtual void visit(const FramesEntry& entry) override;
+  virtual void visit(const BytesEntry& entry) override;
+
+ private:
+  //
+  // Writes everything to each of the outputs. EntryPrinter writes whole
+  // lines, so there is no buffering here.
+  //
+  class TeeStreambuf : public std::streambuf {
+   public:
+    std::vector<std::ostream*> outputs;
+
+   protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+  };
+
+  TeeStreambuf tee_;
+  std::ostream stream_;
+  std::unique_ptr<TextTracePipeline> pipeline_;
+  bool restart_;
+
+  TextTracePipeline& pipeline();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
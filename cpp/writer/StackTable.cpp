@@ -0,0 +1,73 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/StackTable.h>
+
+#include <algorithm>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+uint64_t hashStack(const int64_t* frames, size_t size) {
+  // FNV-1a over whole frames, which is plenty to spread addresses.
+  uint64_t hash = 0xcbf29ce484222325ull ^ size;
+  for (size_t idx = 0; idx < size; ++idx) {
+    hash = (hash ^ static_cast<uint64_t>(frames[idx])) * 0x100000001b3ull;
+  }
+  return hash ^ (hash >> 29);
+}
+
+} // namespace
+
+constexpr size_t StackTable::kDefaultMaxFrames;
+
+StackTable::StackTable(size_t max_frames)
+    : max_frames_(max_frames), frames_(), stacks_(), ids_() {}
+
+std::pair<int32_t, bool> StackTable::intern(
+    const int64_t* frames,
+    size_t size) {
+  auto hash = hashStack(frames, size);
+  auto range = ids_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (equals(stacks_[it->second - 1], frames, size)) {
+      return std::make_pair(it->second, false);
+    }
+  }
+
+  if (frames_.size() + size > max_frames_) {
+    return std::make_pair(0, false);
+  }
+  stacks_.push_back(Stack{frames_.size(), size});
+  frames_.insert(frames_.end(), frames, frames + size);
+  auto id = static_cast<int32_t>(stacks_.size());
+  ids_.emplace(hash, id);
+  return std::make_pair(id, true);
+}
+
+bool StackTable::equals(const Stack& stack, const int64_t* frames, size_t size)
+    const {
+  return stack.size == size &&
+      std::equal(frames, frames + size, frames_.begin() + stack.offset);
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
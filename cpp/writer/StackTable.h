@@ -0,0 +1,70 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// Assigns IDs to the distinct stacks of a trace. IDs are handed out in
+// order, starting at 1, and the table stops growing once it holds
+// max_frames frames in total; intern() returns 0 for new stacks from then
+// on.
+//
+class StackTable {
+ public:
+  static constexpr size_t kDefaultMaxFrames = 1 << 20;
+
+  explicit StackTable(size_t max_frames = kDefaultMaxFrames);
+
+  //
+  // Returns the ID of the stack, and whether it was added by this call, or
+  // {0, false} if the stack is new and the table is full.
+  //
+  std::pair<int32_t, bool> intern(const int64_t* frames, size_t size);
+
+  size_t size() const {
+    return stacks_.size();
+  }
+
+ private:
+  struct Stack {
+    size_t offset;
+    size_t size;
+  };
+
+  const size_t max_frames_;
+  // All stacks back to back, stacks_ indexes into it by ID - 1.
+  std::vector<int64_t> frames_;
+  std::vector<Stack> stacks_;
+  // Stack hash to ID, collisions are told apart by their frames.
+  std::unordered_multimap<uint64_t, int32_t> ids_;
+
+  bool equals(const Stack& stack, const int64_t* frames, size_t size) const;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
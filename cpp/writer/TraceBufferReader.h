@@ -0,0 +1,136 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+#include <profilo/entries/EntryParser.h>
+#include <profilo/logger/buffer/RingBuffer.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+class MultiTraceLifecycleVisitor;
+
+//
+// Splits the processing of packet buffers in stages: a thread reads
+// packets off the buffer into a staging arena, the thread processing the
+// trace reassembles and encodes them, and another thread compresses the
+// output. Reading doesn't wait for encoding or compression, so it falls
+// behind the writers, and misses events, much less often.
+//
+struct PipelineConfig {
+  // Packets per batch handed from the reading stage to the encoding stage.
+  size_t batch_packets = 256;
+  // Batches in the staging arena. Reading stalls once they are all waiting
+  // to be encoded.
+  size_t arena_batches = 64;
+  // Chunks of encoded output waiting for the compression stage. 0 keeps
+  // compression on the encoding thread.
+  size_t compression_queue_depth = 8;
+};
+
+//
+// When the writer resizes a ResizableTraceBuffer. While a trace is
+// processed, the buffer doubles whenever the packets not read yet take up
+// grow_percent of it. Once there are no traces left to process it goes
+// back to the size it had when resizing was enabled, which also drops the
+// history a later TRACE_BACKWARDS could have used.
+//
+struct ResizePolicy {
+  // The buffer doesn't grow past this many slots.
+  size_t max_slots = 64 * 1024;
+  // Share of the buffer, in percent, the unread packets may take up.
+  size_t grow_percent = 75;
+  // Packets read between two looks at the buffer.
+  size_t check_interval = 256;
+};
+
+//
+// Reads the entries of traces out of one kind of trace buffer for
+// TraceWriter, which takes care of queueing the traces and of writing them
+// out. There is one implementation per buffer format.
+//
+class TraceBufferReader {
+ public:
+  virtual ~TraceBufferReader() = default;
+
+  //
+  // Returns the cursor a trace submitted without one is looked for from.
+  //
+  virtual TraceBuffer::Cursor currentTail() = 0;
+
+  //
+  // Called when a trace is submitted. Returns what has to be kept alive
+  // until the trace is read, if anything, for read() to pick up.
+  //
+  virtual std::shared_ptr<void> pin() {
+    return nullptr;
+  }
+
+  //
+  // Feeds the entries from the cursor on to the visitor until it's done.
+  // Buffers without cursors look for the start of trace_id instead.
+  // pinned is what pin() returned when the trace was submitted, or nullptr
+  // if it wasn't.
+  //
+  virtual void read(
+      MultiTraceLifecycleVisitor& visitor,
+      TraceBuffer::Cursor& cursor,
+      int64_t trace_id,
+      std::shared_ptr<void> pinned) = 0;
+
+  //
+  // Visits the entries written before the TRACE_BACKWARDS read() is at.
+  // Only called from within read(), by its visitor.
+  //
+  virtual void traceBackwards(
+      entries::EntryVisitor& visitor,
+      TraceBuffer::Cursor& cursor) = 0;
+
+  //
+  // Chunks of encoded output the visitor passed to read() should queue for
+  // a separate compression thread, 0 for none.
+  //
+  virtual size_t compressionQueueDepth() const {
+    return 0;
+  }
+
+  //
+  // Called between traces when no other trace is waiting to be read.
+  //
+  virtual void onIdle() {}
+
+  //
+  // See TraceWriter::enablePipeline() and TraceWriter::enableResizing().
+  // Readers that don't support them throw std::invalid_argument.
+  //
+  virtual void enablePipeline(PipelineConfig /* config */) {
+    throw std::invalid_argument("The buffer can't be read in stages");
+  }
+
+  virtual void enableResizing(ResizePolicy /* policy */) {
+    throw std::invalid_argument("The buffer is not resizable");
+  }
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -18,6 +18,8 @@
 #pragma once
 
 #include <profilo/writer/AbortReason.h>
+#include <profilo/writer/TraceChunks.h>
+#include <profilo/writer/TraceCompression.h>
 
 namespace facebook {
 namespace profilo {
@@ -26,9 +28,28 @@ namespace writer {
 struct TraceCallbacks {
   virtual ~TraceCallbacks() {}
 
+  //
+  // Compression settings for the trace file, called right before
+  // onTraceStart(). Defaults to the codec selected by the trace flags.
+  //
+  virtual CompressionConfig getCompressionConfig(
+      int64_t /* trace_id */,
+      int32_t flags) {
+    return CompressionConfig::forFlags(flags);
+  }
+
   virtual void
   onTraceStart(int64_t trace_id, int32_t flags, std::string trace_file) = 0;
 
+  //
+  // Called for chunked trace files once `chunk` is complete in the file
+  // passed to onTraceStart(). Data up to the end of its footer won't
+  // change anymore, so it can be uploaded ahead of onTraceEnd().
+  //
+  virtual void onTraceChunk(
+      int64_t /* trace_id */,
+      const TraceChunk& /* chunk */) {}
+
   virtual void onTraceEnd(int64_t trace_id) = 0;
 
   virtual void onTraceAbort(int64_t trace_id, AbortReason reason) = 0;
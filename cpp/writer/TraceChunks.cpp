@@ -0,0 +1,279 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/TraceChunks.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+constexpr char kFooterMagic[] = {'P', 'C', 'H', 'K'};
+// Magic, index and the four 64-bit fields of TraceChunk.
+constexpr size_t kFooterPayloadSize = 4 + 4 + 4 * 8;
+
+// Any of 0x184D2A50 to 0x184D2A5F marks a skippable frame for both LZ4
+// and zstd.
+constexpr uint32_t kSkippableFrameMagic = 0x184D2A5E;
+constexpr size_t kSkippableFramePrefix = 8;
+
+// gzip member header with FEXTRA set, followed by the extra field length
+// and a subfield header; then an empty final deflate block, CRC32 and
+// ISIZE, all zero.
+constexpr size_t kGzipFooterPrefix = 10 + 2 + 4;
+constexpr size_t kGzipFooterSuffix = 2 + 4 + 4;
+
+template <class T>
+void putLittleEndian(std::string& out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+template <class T>
+T getLittleEndian(const char* data) {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<T>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+std::string footerPayload(const TraceChunk& chunk) {
+  std::string payload(kFooterMagic, sizeof(kFooterMagic));
+  putLittleEndian(payload, chunk.index);
+  putLittleEndian(payload, chunk.raw_offset);
+  putLittleEndian(payload, chunk.raw_size);
+  putLittleEndian(payload, chunk.file_offset);
+  putLittleEndian(payload, chunk.file_size);
+  return payload;
+}
+
+bool parseFooterPayload(const char* data, TraceChunk& chunk) {
+  if (std::memcmp(data, kFooterMagic, sizeof(kFooterMagic)) != 0) {
+    return false;
+  }
+  data += sizeof(kFooterMagic);
+  chunk.index = getLittleEndian<uint32_t>(data);
+  chunk.raw_offset = getLittleEndian<uint64_t>(data + 4);
+  chunk.raw_size = getLittleEndian<uint64_t>(data + 12);
+  chunk.file_offset = getLittleEndian<uint64_t>(data + 20);
+  chunk.file_size = getLittleEndian<uint64_t>(data + 28);
+  return true;
+}
+
+} // namespace
+
+std::string makeChunkFooter(CompressionCodec codec, const TraceChunk& chunk) {
+  auto payload = footerPayload(chunk);
+  std::string footer;
+  switch (codec) {
+    case CompressionCodec::LZ4:
+    case CompressionCodec::ZSTD:
+      putLittleEndian(footer, kSkippableFrameMagic);
+      putLittleEndian(footer, static_cast<uint32_t>(payload.size()));
+      footer += payload;
+      return footer;
+    case CompressionCodec::ZLIB: {
+      // ID1, ID2, CM = deflate, FLG = FEXTRA, MTIME, XFL, OS = unknown
+      const char header[] = {
+          '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff'};
+      footer.append(header, sizeof(header));
+      putLittleEndian(footer, static_cast<uint16_t>(4 + payload.size()));
+      footer += "PC";
+      putLittleEndian(footer, static_cast<uint16_t>(payload.size()));
+      footer += payload;
+      footer.append("\x03\x00", 2);
+      footer.append(8, '\0');
+      return footer;
+    }
+  }
+  throw std::invalid_argument("Unknown compression codec");
+}
+
+std::vector<TraceChunk> parseChunkIndex(const std::string& data) {
+  size_t prefix;
+  size_t suffix;
+  if (data.compare(0, 2, "\x1f\x8b") == 0) {
+    prefix = kGzipFooterPrefix;
+    suffix = kGzipFooterSuffix;
+  } else {
+    prefix = kSkippableFramePrefix;
+    suffix = 0;
+  }
+
+  //
+  // Find the last footer that follows its chunk: anything after it is
+  // either an incomplete chunk or trailing frames without data.
+  //
+  std::vector<TraceChunk> chunks;
+  TraceChunk chunk{};
+  size_t pos = data.size() < kFooterPayloadSize + suffix
+      ? 0
+      : data.size() - kFooterPayloadSize - suffix + 1;
+  while (pos-- > prefix) {
+    if (parseFooterPayload(data.data() + pos, chunk) &&
+        chunk.file_offset + chunk.file_size == pos - prefix) {
+      chunks.push_back(chunk);
+      break;
+    }
+  }
+
+  // Walk back from there, each chunk starts right after the previous footer.
+  while (!chunks.empty() && chunks.back().index > 0) {
+    auto end = chunks.back().file_offset;
+    if (end < prefix + kFooterPayloadSize + suffix) {
+      return {};
+    }
+    pos = end - suffix - kFooterPayloadSize;
+    if (!parseFooterPayload(data.data() + pos, chunk) ||
+        chunk.index + 1 != chunks.back().index ||
+        chunk.file_offset + chunk.file_size != pos - prefix) {
+      return {};
+    }
+    chunks.push_back(chunk);
+  }
+  std::reverse(chunks.begin(), chunks.end());
+  return chunks;
+}
+
+std::vector<TraceChunk> readChunkIndex(const std::string& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    throw std::system_error(
+        errno, std::system_category(), "Could not open " + path);
+  }
+  std::string contents(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return parseChunkIndex(contents);
+}
+
+ChunkingStreambuf::ChunkingStreambuf(
+    std::streambuf* file,
+    std::unique_ptr<std::streambuf> target,
+    CompressionCodec codec,
+    size_t chunk_size,
+    std::chrono::milliseconds chunk_interval,
+    ChunkCallback on_chunk)
+    : file_(file),
+      target_(std::move(target)),
+      codec_(codec),
+      chunk_size_(chunk_size),
+      chunk_interval_(chunk_interval),
+      on_chunk_(std::move(on_chunk)),
+      chunk_(),
+      chunk_start_(Clock::now()) {
+  auto offset = file_->pubseekoff(0, std::ios::cur, std::ios::out);
+  if (offset == std::streampos(-1)) {
+    throw std::invalid_argument("file must report its position");
+  }
+  chunk_.file_offset = offset;
+}
+
+ChunkingStreambuf::~ChunkingStreambuf() {
+  try {
+    cut();
+  } catch (...) {
+    // As with the compressing buffers, call sync() to see errors.
+  }
+}
+
+ChunkingStreambuf::int_type ChunkingStreambuf::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof())) {
+    return traits_type::not_eof(ch);
+  }
+  if (traits_type::eq_int_type(target_->sputc(ch), traits_type::eof()) ||
+      !written(1)) {
+    return traits_type::eof();
+  }
+  return ch;
+}
+
+std::streamsize ChunkingStreambuf::xsputn(
+    const char* data,
+    std::streamsize size) {
+  auto put = target_->sputn(data, size);
+  if (put > 0 && !written(put)) {
+    return 0;
+  }
+  return put;
+}
+
+int ChunkingStreambuf::sync() {
+  return cut() ? 0 : -1;
+}
+
+bool ChunkingStreambuf::written(size_t size) {
+  if (chunk_.raw_size == 0) {
+    chunk_start_ = Clock::now();
+  }
+  chunk_.raw_size += size;
+  if (chunk_size_ > 0 && chunk_.raw_size >= chunk_size_) {
+    return cut();
+  }
+  if (chunk_interval_.count() > 0 &&
+      Clock::now() - chunk_start_ >= chunk_interval_) {
+    return cut();
+  }
+  return true;
+}
+
+bool ChunkingStreambuf::cut() {
+  if (chunk_.raw_size == 0) {
+    return true;
+  }
+  // Completes the target's frame, and with it the chunk's data.
+  if (target_->pubsync() != 0) {
+    return false;
+  }
+  auto end = file_->pubseekoff(0, std::ios::cur, std::ios::out);
+  if (end == std::streampos(-1)) {
+    return false;
+  }
+  chunk_.file_size = static_cast<uint64_t>(end) - chunk_.file_offset;
+
+  auto footer = makeChunkFooter(codec_, chunk_);
+  if (file_->sputn(footer.data(), footer.size()) !=
+          static_cast<std::streamsize>(footer.size()) ||
+      file_->pubsync() != 0) {
+    return false;
+  }
+
+  auto done = chunk_;
+  chunk_.index += 1;
+  chunk_.raw_offset += chunk_.raw_size;
+  chunk_.raw_size = 0;
+  chunk_.file_offset += chunk_.file_size + footer.size();
+  chunk_.file_size = 0;
+  if (on_chunk_) {
+    on_chunk_(done);
+  }
+  return true;
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,121 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <profilo/writer/TraceCompression.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// A self-contained piece of a chunked trace file: one or more complete
+// compressed frames, followed by a footer frame that describes them.
+// Every decompressor that reads the whole file skips the footers, see
+// makeChunkFooter().
+//
+struct TraceChunk {
+  uint32_t index;
+  // Where the chunk's data sits in the decompressed trace.
+  uint64_t raw_offset;
+  uint64_t raw_size;
+  // Where the chunk's compressed frames sit in the file, footer excluded.
+  uint64_t file_offset;
+  uint64_t file_size;
+};
+
+//
+// Returns the footer frame for `chunk` in the framing of `codec`: an LZ4
+// or zstd skippable frame, or an empty gzip member carrying the chunk in
+// an extra field.
+//
+std::string makeChunkFooter(CompressionCodec codec, const TraceChunk& chunk);
+
+//
+// Lists the complete chunks of a chunked trace file, given its contents,
+// in file order. Data after the last complete chunk, as left by a writer
+// that died mid-chunk, is ignored. Returns an empty list for files without
+// chunk footers.
+//
+std::vector<TraceChunk> parseChunkIndex(const std::string& contents);
+
+//
+// Same as above, reading the file at `path`. Throws std::system_error if
+// the file can't be read.
+//
+std::vector<TraceChunk> readChunkIndex(const std::string& path);
+
+//
+// Cuts what is written through it into chunks. Writes go to `target`,
+// which compresses them into `file`. Once a chunk holds chunk_size bytes,
+// or chunk_interval has passed since it started, the target is synced to
+// complete its frame, the chunk footer is appended to `file` and
+// on_chunk is called. Intervals are checked on writes, an idle trace
+// doesn't cut chunks. sync() cuts a chunk early.
+//
+// A zero chunk_size or chunk_interval disables that limit. `file` must
+// support seeking to its current position and must outlive this buffer.
+//
+class ChunkingStreambuf : public std::streambuf {
+ public:
+  using ChunkCallback = std::function<void(const TraceChunk&)>;
+
+  ChunkingStreambuf(
+      std::streambuf* file,
+      std::unique_ptr<std::streambuf> target,
+      CompressionCodec codec,
+      size_t chunk_size,
+      std::chrono::milliseconds chunk_interval,
+      ChunkCallback on_chunk = nullptr);
+  ~ChunkingStreambuf() override;
+
+  ChunkingStreambuf(const ChunkingStreambuf&) = delete;
+  ChunkingStreambuf& operator=(const ChunkingStreambuf&) = delete;
+
+ protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char* data, std::streamsize size) override;
+  int sync() override;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::streambuf* file_;
+  std::unique_ptr<std::streambuf> target_;
+  const CompressionCodec codec_;
+  const size_t chunk_size_;
+  const std::chrono::milliseconds chunk_interval_;
+  ChunkCallback on_chunk_;
+  TraceChunk chunk_;
+  Clock::time_point chunk_start_;
+
+  bool written(size_t size);
+  bool cut();
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,356 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <profilo/writer/TraceCompression.h>
+
+#ifdef PROFILO_WITH_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef PROFILO_WITH_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <zstr/zstr.hpp>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+namespace {
+
+//
+// Collects writes in a buffer of buffer_size bytes and hands it to
+// compress() when full. Subclasses stream the compressed bytes to the sink
+// through emit() and must call finish() from their destructor.
+//
+class CompressingStreambuf : public std::streambuf {
+ public:
+  CompressingStreambuf(std::streambuf* sink, size_t buffer_size)
+      : sink_(sink), input_(buffer_size), frame_open_(false) {
+    setp(input_.data(), input_.data() + input_.size());
+  }
+
+ protected:
+  //
+  // Compresses [data, data + size), then completes the frame if `end` is
+  // set. Returns false if the sink fails.
+  //
+  virtual bool compress(const char* data, size_t size, bool end) = 0;
+
+  bool emit(const char* data, size_t size) {
+    return sink_->sputn(data, size) == static_cast<std::streamsize>(size);
+  }
+
+  void finish() noexcept {
+    try {
+      sync();
+    } catch (...) {
+      // Same as std::basic_filebuf::~basic_filebuf(): errors on destruction
+      // are lost, call sync() explicitly to see them.
+    }
+  }
+
+  int_type overflow(int_type ch) override {
+    if (!compressInput(false)) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  int sync() override {
+    if (!frame_open_ && pptr() == pbase()) {
+      // Nothing written since the last frame, don't emit an empty one.
+      return 0;
+    }
+    return compressInput(true) ? 0 : -1;
+  }
+
+ private:
+  std::streambuf* sink_;
+  std::vector<char> input_;
+  bool frame_open_;
+
+  bool compressInput(bool end) {
+    size_t size = pptr() - pbase();
+    bool success = compress(pbase(), size, end);
+    frame_open_ = !end;
+    setp(input_.data(), input_.data() + input_.size());
+    return success;
+  }
+};
+
+#ifdef PROFILO_WITH_LZ4
+class Lz4Streambuf : public CompressingStreambuf {
+ public:
+  Lz4Streambuf(std::streambuf* sink, const CompressionConfig& config)
+      : CompressingStreambuf(sink, config.buffer_size),
+        context_(nullptr),
+        preferences_(),
+        output_(),
+        frame_started_(false) {
+    check(LZ4F_createCompressionContext(&context_, LZ4F_VERSION));
+    preferences_.compressionLevel = config.level;
+    // Bound for compressing a full input buffer on top of whatever the
+    // context still holds, or for the frame header and footer.
+    output_.resize(
+        LZ4F_compressBound(config.buffer_size, &preferences_) +
+        LZ4F_HEADER_SIZE_MAX);
+  }
+
+  ~Lz4Streambuf() override {
+    finish();
+    LZ4F_freeCompressionContext(context_);
+  }
+
+ protected:
+  bool compress(const char* data, size_t size, bool end) override {
+    if (!frame_started_) {
+      auto written = check(LZ4F_compressBegin(
+          context_, output_.data(), output_.size(), &preferences_));
+      if (!emit(output_.data(), written)) {
+        return false;
+      }
+      frame_started_ = true;
+    }
+    if (size > 0) {
+      auto written = check(LZ4F_compressUpdate(
+          context_, output_.data(), output_.size(), data, size, nullptr));
+      if (!emit(output_.data(), written)) {
+        return false;
+      }
+    }
+    if (end) {
+      auto written = check(LZ4F_compressEnd(
+          context_, output_.data(), output_.size(), nullptr));
+      frame_started_ = false;
+      return emit(output_.data(), written);
+    }
+    return true;
+  }
+
+ private:
+  LZ4F_cctx* context_;
+  LZ4F_preferences_t preferences_;
+  std::vector<char> output_;
+  bool frame_started_;
+
+  static size_t check(size_t result) {
+    if (LZ4F_isError(result)) {
+      throw std::runtime_error(
+          std::string("LZ4 compression failed: ") +
+          LZ4F_getErrorName(result));
+    }
+    return result;
+  }
+};
+#endif
+
+#ifdef PROFILO_WITH_ZSTD
+class ZstdStreambuf : public CompressingStreambuf {
+ public:
+  ZstdStreambuf(std::streambuf* sink, const CompressionConfig& config)
+      : CompressingStreambuf(sink, config.buffer_size),
+        context_(ZSTD_createCCtx()),
+        output_(ZSTD_CStreamOutSize()) {
+    if (context_ == nullptr) {
+      throw std::runtime_error("Could not allocate zstd context");
+    }
+    check(ZSTD_CCtx_setParameter(
+        context_, ZSTD_c_compressionLevel, config.level));
+    if (config.dictionary != nullptr) {
+      // Applies to every frame compressed with this context. The context
+      // keeps its own copy, the byReference variant is only in zstd's
+      // experimental API.
+      check(ZSTD_CCtx_loadDictionary(
+          context_, config.dictionary->data(), config.dictionary->size()));
+    }
+  }
+
+  ~ZstdStreambuf() override {
+    finish();
+    ZSTD_freeCCtx(context_);
+  }
+
+ protected:
+  bool compress(const char* data, size_t size, bool end) override {
+    ZSTD_inBuffer input{data, size, 0};
+    auto mode = end ? ZSTD_e_end : ZSTD_e_continue;
+    while (true) {
+      ZSTD_outBuffer output{output_.data(), output_.size(), 0};
+      auto remaining =
+          check(ZSTD_compressStream2(context_, &output, &input, mode));
+      if (!emit(output_.data(), output.pos)) {
+        return false;
+      }
+      if (end ? remaining == 0 : input.pos == input.size) {
+        return true;
+      }
+    }
+  }
+
+ private:
+  ZSTD_CCtx* context_;
+  std::vector<char> output_;
+
+  static size_t check(size_t result) {
+    if (ZSTD_isError(result)) {
+      throw std::runtime_error(
+          std::string("zstd compression failed: ") +
+          ZSTD_getErrorName(result));
+    }
+    return result;
+  }
+};
+#endif
+
+} // namespace
+
+constexpr size_t CompressionConfig::kDefaultChunkSize;
+constexpr std::chrono::milliseconds CompressionConfig::kDefaultChunkInterval;
+
+int CompressionConfig::defaultLevel(CompressionCodec codec) {
+  switch (codec) {
+    case CompressionCodec::ZLIB:
+      return 3;
+    case CompressionCodec::LZ4:
+      // Fast mode; levels 3 and up switch to LZ4 HC.
+      return 0;
+    case CompressionCodec::ZSTD:
+      return 3;
+  }
+  throw std::invalid_argument("Unknown compression codec");
+}
+
+CompressionConfig CompressionConfig::forFlags(int32_t flags) {
+  CompressionConfig config;
+  if ((flags & kCompressionZstdFlag) &&
+      isCodecAvailable(CompressionCodec::ZSTD)) {
+    config.codec = CompressionCodec::ZSTD;
+  } else if (
+      (flags & kCompressionLz4Flag) &&
+      isCodecAvailable(CompressionCodec::LZ4)) {
+    config.codec = CompressionCodec::LZ4;
+  }
+  config.level = defaultLevel(config.codec);
+  if (flags & kChunkedTraceFlag) {
+    config.chunk_size = kDefaultChunkSize;
+    config.chunk_interval = kDefaultChunkInterval;
+  }
+  return config;
+}
+
+bool isCodecAvailable(CompressionCodec codec) {
+  switch (codec) {
+    case CompressionCodec::ZLIB:
+      return true;
+    case CompressionCodec::LZ4:
+#ifdef PROFILO_WITH_LZ4
+      return true;
+#else
+      return false;
+#endif
+    case CompressionCodec::ZSTD:
+#ifdef PROFILO_WITH_ZSTD
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+std::unique_ptr<std::streambuf> makeCompressingStreambuf(
+    std::streambuf* sink,
+    const CompressionConfig& config) {
+  if (config.buffer_size == 0) {
+    throw std::invalid_argument("buffer_size must be positive");
+  }
+  switch (config.codec) {
+    case CompressionCodec::ZLIB:
+      return std::make_unique<zstr::ostreambuf>(
+          sink, config.buffer_size, config.level);
+    case CompressionCodec::LZ4:
+#ifdef PROFILO_WITH_LZ4
+      return std::make_unique<Lz4Streambuf>(sink, config);
+#else
+      throw std::invalid_argument("Built without LZ4");
+#endif
+    case CompressionCodec::ZSTD:
+#ifdef PROFILO_WITH_ZSTD
+      return std::make_unique<ZstdStreambuf>(sink, config);
+#else
+      throw std::invalid_argument("Built without zstd");
+#endif
+  }
+  throw std::invalid_argument("Unknown compression codec");
+}
+
+std::shared_ptr<const std::string> loadCompressionDictionary(
+    const std::string& path) {
+  std::ifstream input(path, std::ifstream::in | std::ifstream::binary);
+  if (!input) {
+    throw std::runtime_error("Could not open compression dictionary " + path);
+  }
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return std::make_shared<const std::string>(contents.str());
+}
+
+std::string trainCompressionDictionary(
+    const std::vector<std::string>& samples,
+    size_t capacity) {
+#ifdef PROFILO_WITH_ZSTD
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (auto const& sample : samples) {
+    buffer += sample;
+    sizes.push_back(sample.size());
+  }
+
+  std::string dictionary(capacity, '\0');
+  auto size = ZDICT_trainFromBuffer(
+      &dictionary[0],
+      dictionary.size(),
+      buffer.data(),
+      sizes.data(),
+      sizes.size());
+  if (ZDICT_isError(size)) {
+    throw std::runtime_error(
+        std::string("Could not train compression dictionary: ") +
+        ZDICT_getErrorName(size));
+  }
+  dictionary.resize(size);
+  return dictionary;
+#else
+  (void)samples;
+  (void)capacity;
+  throw std::runtime_error("Built without zstd");
+#endif
+}
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -0,0 +1,120 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+//
+// zlib is always available. LZ4 and zstd are not part of the NDK, builds
+// that provide them opt in with `-c profilo.lz4=true` and
+// `-c profilo.zstd=true`, see cpp/writer/BUCK.
+//
+enum class CompressionCodec {
+  // gzip-framed deflate through zstr, what trace files have always used.
+  ZLIB = 0,
+  // LZ4 frames: several times cheaper than zlib, at a lower ratio.
+  LZ4 = 1,
+  // Zstandard frames: denser than zlib at a similar cost, and can use a
+  // dictionary trained on representative traces.
+  ZSTD = 2,
+};
+
+// Trace flags selecting the codec; traces with neither use zlib. Must match
+// Trace.FLAG_COMPRESSION_LZ4 and Trace.FLAG_COMPRESSION_ZSTD.
+constexpr int32_t kCompressionLz4Flag = 1 << 3;
+constexpr int32_t kCompressionZstdFlag = 1 << 4;
+// Trace flag for chunked trace files, see CompressionConfig::chunk_size.
+// Must match Trace.FLAG_CHUNKED_FILE.
+constexpr int32_t kChunkedTraceFlag = 1 << 5;
+
+struct CompressionConfig {
+  CompressionCodec codec = CompressionCodec::ZLIB;
+  // Codec specific, see defaultLevel().
+  int level = 3;
+  // Size of the input and output buffers, in bytes.
+  size_t buffer_size = 512 * 1024;
+  // Raw zstd dictionary, as produced by `zstd --train` or
+  // trainCompressionDictionary(). Ignored by the other codecs. The same
+  // dictionary has to be given to the decompressor.
+  std::shared_ptr<const std::string> dictionary = nullptr;
+  // If either is positive, the trace file is written in independently
+  // decompressible chunks of about chunk_size uncompressed bytes, cut
+  // at least every chunk_interval, see ChunkingStreambuf. Otherwise the
+  // file is a single chunk without a footer.
+  size_t chunk_size = 0;
+  std::chrono::milliseconds chunk_interval{0};
+
+  static constexpr size_t kDefaultChunkSize = 1024 * 1024;
+  static constexpr std::chrono::milliseconds kDefaultChunkInterval{5000};
+
+  static int defaultLevel(CompressionCodec codec);
+
+  //
+  // The codec selected by the trace flags, at its default level, and the
+  // default chunking if the trace is chunked. Falls back to zlib if the
+  // selected codec isn't built in.
+  //
+  static CompressionConfig forFlags(int32_t flags);
+};
+
+//
+// Returns true if this build can compress with `codec`.
+//
+bool isCodecAvailable(CompressionCodec codec);
+
+//
+// Returns a stream buffer that compresses everything written to it into
+// `sink`. sync() completes the current frame, so the output is readable
+// up to that point, and further writes start a new one. The returned
+// buffer must be destroyed before the sink.
+//
+// Throws std::invalid_argument for an invalid config, including codecs
+// that aren't built in, and std::runtime_error if the codec fails to
+// initialize.
+//
+std::unique_ptr<std::streambuf> makeCompressingStreambuf(
+    std::streambuf* sink,
+    const CompressionConfig& config);
+
+//
+// Reads a raw zstd dictionary from `path`.
+//
+std::shared_ptr<const std::string> loadCompressionDictionary(
+    const std::string& path);
+
+//
+// Trains a zstd dictionary of up to `capacity` bytes on the given samples,
+// typically uncompressed trace files or chunks of them. Throws
+// std::runtime_error if built without zstd.
+//
+std::string trainCompressionDictionary(
+    const std::vector<std::string>& samples,
+    size_t capacity = 112 * 1024);
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
@@ -23,11 +23,12 @@
 #include <sstream>
 #include <system_error>
 
-#include <profilo/writer/DeltaEncodingVisitor.h>
+#include <profilo/writer/AsyncStreambuf.h>
 #include <profilo/writer/PrintEntryVisitor.h>
-#include <profilo/writer/StackTraceInvertingVisitor.h>
-#include <profilo/writer/TimestampTruncatingVisitor.h>
+#include <profilo/writer/SharedTextEncoder.h>
+#include <profilo/writer/TraceChunks.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
+#include <profilo/writer/VisitorPipeline.h>
 
 namespace facebook {
 namespace profilo {
@@ -37,6 +38,17 @@ using namespace facebook::profilo::entries;
 
 namespace {
 
+static_assert(
+    TraceLifecycleVisitor::kTimestampPrecision == 6,
+    "TruncateTimestamps only truncates to microseconds");
+
+// Delta-encoding and string deduplication happen in BinaryTraceWriter.
+using BinaryTracePipeline = Pipeline<
+    InvertFrames,
+    TruncateTimestamps,
+    ResolveStrings,
+    BinaryTraceWriter&>;
+
 std::string getTraceID(int64_t trace_id) {
   const char* kBase64Alphabet =
       "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -108,17 +120,22 @@ TraceLifecycleVisitor::TraceLifecycleVisitor(
     const std::string& trace_prefix,
     std::shared_ptr<TraceCallbacks> callbacks,
     const std::vector<std::pair<std::string, std::string>>& headers,
-    int64_t trace_id)
+    int64_t trace_id,
+    size_t compression_queue_depth)
     :
 
       folder_(folder),
       trace_prefix_(trace_prefix),
       trace_headers_(headers),
       output_(nullptr),
+      output_buf_(nullptr),
       delegates_(),
+      binary_writer_(nullptr),
       expected_trace_(trace_id),
+      compression_queue_depth_(compression_queue_depth),
       callbacks_(callbacks),
-      done_(false) {}
+      done_(false),
+      shared_(false) {}
 
 void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
   auto type = static_cast<EntryType>(entry.type);
@@ -130,6 +147,7 @@ void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
       }
       // write before we clean up state
       if (hasDelegate()) {
+        stopSharing();
         delegates_.back()->visit(entry);
       }
       onTraceEnd(trace_id);
@@ -147,6 +165,7 @@ void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
 
       // write before we clean up state
       if (hasDelegate()) {
+        stopSharing();
         delegates_.back()->visit(entry);
       }
       onTraceAbort(trace_id, reason);
@@ -164,13 +183,13 @@ void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
       if (expected_trace_ == entry.extra) {
         thread_priority_ = std::make_unique<ScopedThreadPriority>(entry.callid);
       }
-      if (hasDelegate()) {
+      if (encodesEntries()) {
         delegates_.back()->visit(entry);
       }
       break;
     }
     default: {
-      if (hasDelegate()) {
+      if (encodesEntries()) {
         delegates_.back()->visit(entry);
       }
     }
@@ -178,13 +197,13 @@ void TraceLifecycleVisitor::visit(const StandardEntry& entry) {
 }
 
 void TraceLifecycleVisitor::visit(const FramesEntry& entry) {
-  if (hasDelegate()) {
+  if (encodesEntries()) {
     delegates_.back()->visit(entry);
   }
 }
 
 void TraceLifecycleVisitor::visit(const BytesEntry& entry) {
-  if (hasDelegate()) {
+  if (encodesEntries()) {
     delegates_.back()->visit(entry);
   }
 }
@@ -193,6 +212,27 @@ void TraceLifecycleVisitor::abort(AbortReason reason) {
   onTraceAbort(expected_trace_, reason);
 }
 
+std::ostream* TraceLifecycleVisitor::textOutput() {
+  if (!hasDelegate() || binary_writer_ != nullptr) {
+    return nullptr;
+  }
+  return output_.get();
+}
+
+void TraceLifecycleVisitor::startSharing() {
+  shared_ = textOutput() != nullptr;
+}
+
+void TraceLifecycleVisitor::stopSharing() {
+  if (!shared_) {
+    return;
+  }
+  shared_ = false;
+  // Whatever the shared encoder wrote last, start over.
+  delegates_.back() = makeTextTracePipeline(*output_);
+  delegates_.back()->visit(makeSegmentStart());
+}
+
 void TraceLifecycleVisitor::onTraceStart(int64_t trace_id, int32_t flags) {
   if (trace_id != expected_trace_) {
     return;
@@ -246,25 +286,50 @@ void TraceLifecycleVisitor::onTraceStart(int64_t trace_id, int32_t flags) {
       trace_file, std::ofstream::out | std::ofstream::binary);
   output_->exceptions(std::ofstream::badbit | std::ofstream::failbit);
 
-  zstr::ostreambuf* output_buf_ = new zstr::ostreambuf(
-      output_->rdbuf(), // wrap the ofstream buffer
-      512 * 1024, // input and output buffers
-      3 // compression level
-  );
+  auto compression = callbacks_.get() != nullptr
+      ? callbacks_->getCompressionConfig(trace_id, flags)
+      : CompressionConfig::forFlags(flags);
+  // wrap the ofstream buffer
+  output_buf_ = makeCompressingStreambuf(output_->rdbuf(), compression);
+  if (compression_queue_depth_ > 0) {
+    output_buf_ = std::make_unique<AsyncStreambuf>(
+        std::move(output_buf_),
+        kCompressionChunkSize,
+        compression_queue_depth_);
+  }
+  if (compression.chunk_size > 0 || compression.chunk_interval.count() > 0) {
+    auto callbacks = callbacks_;
+    output_buf_ = std::make_unique<ChunkingStreambuf>(
+        output_->rdbuf(),
+        std::move(output_buf_),
+        compression.codec,
+        compression.chunk_size,
+        compression.chunk_interval,
+        [callbacks, trace_id](const TraceChunk& chunk) {
+          if (callbacks.get() != nullptr) {
+            callbacks->onTraceChunk(trace_id, chunk);
+          }
+        });
+  }
 
   // Disable ofstream buffering
   output_->rdbuf()->pubsetbuf(nullptr, 0);
   // Replace ofstream buffer with the compressed one
-  output_->basic_ios<char>::rdbuf(output_buf_);
-
-  writeHeaders(*output_, trace_id_string);
-
-  // outputTime = truncate(current) - truncate(prev)
-  delegates_.emplace_back(new PrintEntryVisitor(*output_));
-  delegates_.emplace_back(new DeltaEncodingVisitor(*delegates_.back()));
-  delegates_.emplace_back(
-      new TimestampTruncatingVisitor(*delegates_.back(), kTimestampPrecision));
-  delegates_.emplace_back(new StackTraceInvertingVisitor(*delegates_.back()));
+  output_->basic_ios<char>::rdbuf(output_buf_.get());
+
+  if (flags & kBinaryTraceFormatFlag) {
+    binary_writer_ = new BinaryTraceWriter(
+        *output_, trace_id_string, kTimestampPrecision, trace_headers_);
+    delegates_.emplace_back(binary_writer_);
+    delegates_.emplace_back(new BinaryTracePipeline(
+        InvertFrames(),
+        TruncateTimestamps(),
+        ResolveStrings(),
+        *binary_writer_));
+  } else {
+    writeHeaders(*output_, trace_id_string);
+    delegates_.emplace_back(makeTextTracePipeline(*output_));
+  }
 
   if (callbacks_.get() != nullptr) {
     callbacks_->onTraceStart(trace_id, flags, trace_file);
@@ -290,9 +355,15 @@ void TraceLifecycleVisitor::onTraceEnd(int64_t trace_id) {
 }
 
 void TraceLifecycleVisitor::cleanupState() {
+  if (binary_writer_ != nullptr) {
+    binary_writer_->finish();
+    binary_writer_ = nullptr;
+  }
   delegates_.clear();
+  shared_ = false;
   thread_priority_ = nullptr;
   output_->flush();
+  output_buf_ = nullptr;
   output_->close();
   output_ = nullptr;
 }
@@ -18,18 +18,19 @@
 
 #include <errno.h>
 #include <deque>
+#include <fstream>
 #include <memory>
+#include <streambuf>
 #include <utility>
 #include <vector>
 
 #include <profilo/entries/Entry.h>
 #include <profilo/entries/EntryParser.h>
 #include <profilo/writer/AbortReason.h>
+#include <profilo/writer/BinaryTraceWriter.h>
 #include <profilo/writer/ScopedThreadPriority.h>
 #include <profilo/writer/TraceCallbacks.h>
 
-#include <zstr/zstr.hpp>
-
 namespace facebook {
 namespace profilo {
 namespace writer {
@@ -41,14 +42,26 @@ class TraceLifecycleVisitor : public EntryVisitor {
   // Timestamp precision is microsec by default.
   static const size_t kTimestampPrecision = 6;
 
-  static const size_t kTraceFormatVersion = 3;
+  // Version 4 writes stacks once, see InternStacks, version 5 strings,
+  // see InternStrings, version 6 may restart the encoding mid-trace, see
+  // SharedTextEncoder.
+  static const size_t kTraceFormatVersion = 6;
+
+  // Size of the chunks handed to the compression thread.
+  static const size_t kCompressionChunkSize = 64 * 1024;
 
+  //
+  // compression_queue_depth: if positive, compression runs on a thread of
+  //                          its own, with up to this many chunks of
+  //                          output waiting for it. See AsyncStreambuf.
+  //
   TraceLifecycleVisitor(
       const std::string& folder,
       const std::string& trace_prefix,
       std::shared_ptr<TraceCallbacks> callbacks,
       const std::vector<std::pair<std::string, std::string>>& headers,
-      int64_t trace_id);
+      int64_t trace_id,
+      size_t compression_queue_depth = 0);
 
   virtual void visit(const StandardEntry& entry) override;
   virtual void visit(const FramesEntry& entry) override;
@@ -56,6 +69,20 @@ class TraceLifecycleVisitor : public EntryVisitor {
 
   void abort(AbortReason reason);
 
+  //
+  // The stream a text trace in progress is written to, nullptr for binary
+  // traces and traces that are not in progress.
+  //
+  std::ostream* textOutput();
+
+  //
+  // Stops encoding the entries all traces get, a SharedTextEncoder writes
+  // them to textOutput() instead. Entries for this trace alone, like its
+  // TRACE_END, are still encoded here, in a segment of their own. Has no
+  // effect if textOutput() is nullptr.
+  //
+  void startSharing();
+
   inline bool done() const {
     return done_;
   }
@@ -65,21 +92,35 @@ class TraceLifecycleVisitor : public EntryVisitor {
   const std::string trace_prefix_;
   const std::vector<std::pair<std::string, std::string>> trace_headers_;
   std::unique_ptr<std::ofstream> output_;
+  // Compresses, and possibly chunks, into the file buffer of output_.
+  // Declared after it so that it's destroyed first.
+  std::unique_ptr<std::streambuf> output_buf_;
 
-  // chain of delegates
+  // The visitor pipeline for the trace format is last, anything it
+  // refers to comes before it.
   std::deque<std::unique_ptr<EntryVisitor>> delegates_;
+  // The first delegate, for traces in the binary format.
+  BinaryTraceWriter* binary_writer_;
   int64_t expected_trace_;
+  size_t compression_queue_depth_;
   std::shared_ptr<TraceCallbacks> callbacks_;
   bool done_;
+  // Set by startSharing().
+  bool shared_;
   std::unique_ptr<ScopedThreadPriority> thread_priority_;
 
   inline bool hasDelegate() {
     return !delegates_.empty();
   }
 
+  inline bool encodesEntries() {
+    return hasDelegate() && !shared_;
+  }
+
   void onTraceStart(int64_t trace_id, int32_t flags);
   void onTraceAbort(int64_t trace_id, AbortReason reason);
   void onTraceEnd(int64_t trace_id);
+  void stopSharing();
   void cleanupState();
   void writeHeaders(std::ostream& output, std::string id);
 };
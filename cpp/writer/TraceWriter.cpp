@@ -29,6 +29,8 @@
 #include <profilo/writer/DeltaEncodingVisitor.h>
 #include <profilo/writer/MultiTraceLifecycleVisitor.h>
 #include <profilo/writer/PacketReassembler.h>
+#include <profilo/writer/ResizableBufferReader.h>
+#include <profilo/writer/ShardedBufferReader.h>
 #include <profilo/writer/TraceLifecycleVisitor.h>
 #include <profilo/writer/TraceWriter.h>
 
@@ -45,61 +47,135 @@ TraceWriter::TraceWriter(
     std::shared_ptr<TraceCallbacks> callbacks,
     std::vector<std::pair<std::string, std::string>>&& headers,
     TraceBackwardsCallback trace_backwards_callback)
+    : TraceWriter(
+          std::move(folder),
+          std::move(trace_prefix),
+          std::unique_ptr<TraceBufferReader>(
+              new PacketBufferReader(buffer, trace_backwards_callback)),
+          callbacks,
+          std::move(headers)) {}
+
+TraceWriter::TraceWriter(
+    const std::string&& folder,
+    const std::string&& trace_prefix,
+    RecordBuffer& buffer,
+    std::shared_ptr<TraceCallbacks> callbacks,
+    std::vector<std::pair<std::string, std::string>>&& headers,
+    RecordTraceBackwardsCallback trace_backwards_callback)
+    : TraceWriter(
+          std::move(folder),
+          std::move(trace_prefix),
+          std::unique_ptr<TraceBufferReader>(
+              new RecordBufferReader(buffer, trace_backwards_callback)),
+          callbacks,
+          std::move(headers)) {}
+
+TraceWriter::TraceWriter(
+    const std::string&& folder,
+    const std::string&& trace_prefix,
+    ShardedTraceBuffer& buffer,
+    std::shared_ptr<TraceCallbacks> callbacks,
+    std::vector<std::pair<std::string, std::string>>&& headers)
+    : TraceWriter(
+          std::move(folder),
+          std::move(trace_prefix),
+          std::unique_ptr<TraceBufferReader>(new ShardedBufferReader(buffer)),
+          callbacks,
+          std::move(headers)) {}
+
+TraceWriter::TraceWriter(
+    const std::string&& folder,
+    const std::string&& trace_prefix,
+    ResizableTraceBuffer& buffer,
+    std::shared_ptr<TraceCallbacks> callbacks,
+    std::vector<std::pair<std::string, std::string>>&& headers,
+    TraceBackwardsCallback trace_backwards_callback)
+    : TraceWriter(
+          std::move(folder),
+          std::move(trace_prefix),
+          std::unique_ptr<TraceBufferReader>(
+              new ResizableBufferReader(buffer, trace_backwards_callback)),
+          callbacks,
+          std::move(headers)) {}
+
+TraceWriter::TraceWriter(
+    const std::string&& folder,
+    const std::string&& trace_prefix,
+    std::unique_ptr<TraceBufferReader> reader,
+    std::shared_ptr<TraceCallbacks> callbacks,
+    std::vector<std::pair<std::string, std::string>>&& headers)
     : wakeup_mutex_(),
       wakeup_cv_(),
       wakeup_trace_ids_(),
       trace_folder_(std::move(folder)),
       trace_prefix_(std::move(trace_prefix)),
-      buffer_(buffer),
+      reader_(std::move(reader)),
       trace_headers_(std::move(headers)),
-      callbacks_(callbacks),
-      trace_backwards_callback_(trace_backwards_callback) {}
+      callbacks_(callbacks) {}
+
+void TraceWriter::enablePipeline(PipelineConfig config) {
+  reader_->enablePipeline(config);
+}
+
+void TraceWriter::enableResizing(ResizePolicy policy) {
+  reader_->enableResizing(policy);
+}
 
 std::unordered_set<int64_t> TraceWriter::processTrace(
     TraceBuffer::Cursor& cursor) {
+  // The cursor is all packet and record buffers need to find the trace.
+  return processTrace(cursor, /* trace_id */ 0, nullptr);
+}
+
+std::unordered_set<int64_t> TraceWriter::processShardedTrace(int64_t trace_id) {
+  auto cursor = reader_->currentTail();
+  return processTrace(cursor, trace_id, nullptr);
+}
+
+std::unordered_set<int64_t> TraceWriter::processTrace(
+    TraceBuffer::Cursor& cursor,
+    int64_t trace_id,
+    std::shared_ptr<void> pinned) {
   MultiTraceLifecycleVisitor visitor(
       trace_folder_,
       trace_prefix_,
       callbacks_,
       trace_headers_,
       [this, &cursor](TraceLifecycleVisitor& visitor) {
-        if (trace_backwards_callback_ == nullptr) {
-          return;
-        }
-        trace_backwards_callback_(visitor, buffer_, cursor);
-      });
-
-  PacketReassembler reassembler([&visitor](const void* data, size_t size) {
-    EntryParser::parse(data, size, visitor);
-  });
-
-  while (!visitor.done()) {
-    alignas(4) Packet packet;
-    if (!buffer_.waitAndTryRead(packet, cursor)) {
-      // Missed event, abort.
-      visitor.abort(AbortReason::MISSED_EVENT);
-      break;
-    }
-    reassembler.process(packet);
-    cursor.moveForward();
-  }
+        reader_->traceBackwards(visitor, cursor);
+      },
+      reader_->compressionQueueDepth());
 
+  reader_->read(visitor, cursor, trace_id, std::move(pinned));
   return visitor.getConsumedTraces();
 }
 
 void TraceWriter::loop() {
   while (true) {
+    bool idle;
+    {
+      std::lock_guard<std::mutex> lock(wakeup_mutex_);
+      idle = wakeup_trace_ids_.empty();
+    }
+    if (idle) {
+      reader_->onIdle();
+    }
+
     int64_t trace_id;
     // dummy call, no default constructor
-    TraceBuffer::Cursor cursor = buffer_.currentTail();
+    TraceBuffer::Cursor cursor = reader_->currentTail();
+    std::shared_ptr<void> pinned;
 
     {
       std::unique_lock<std::mutex> lock(wakeup_mutex_);
-      wakeup_cv_.wait(lock, [this, &trace_id, &cursor] {
+      wakeup_cv_.wait(lock, [this, &trace_id, &cursor, &pinned] {
         if (this->wakeup_trace_ids_.empty()) {
           return false;
         }
-        std::tie(cursor, trace_id) = this->wakeup_trace_ids_.front();
+        auto& item = this->wakeup_trace_ids_.front();
+        cursor = item.cursor;
+        trace_id = item.trace_id;
+        pinned = std::move(item.pinned);
         this->wakeup_trace_ids_.pop();
         return true;
       });
@@ -111,12 +187,12 @@ void TraceWriter::loop() {
     }
 
     {
-      auto consumed_traces = processTrace(cursor);
+      auto consumed_traces = processTrace(cursor, trace_id, std::move(pinned));
       // Cleanup of processed traces from the wakeup queue
       std::lock_guard<std::mutex> lock(wakeup_mutex_);
       while (!wakeup_trace_ids_.empty()) {
         auto& item = wakeup_trace_ids_.front();
-        if (consumed_traces.find(item.second) == consumed_traces.end()) {
+        if (consumed_traces.find(item.trace_id) == consumed_traces.end()) {
           break;
         }
         wakeup_trace_ids_.pop();
@@ -126,15 +202,16 @@ void TraceWriter::loop() {
 }
 
 void TraceWriter::submit(TraceBuffer::Cursor cursor, int64_t trace_id) {
+  auto pinned = reader_->pin();
   {
     std::lock_guard<std::mutex> lock(wakeup_mutex_);
-    wakeup_trace_ids_.push(std::make_pair(cursor, trace_id));
+    wakeup_trace_ids_.push(PendingTrace{cursor, trace_id, std::move(pinned)});
   }
   wakeup_cv_.notify_all();
 }
 
 void TraceWriter::submit(int64_t trace_id) {
-  submit(buffer_.currentTail(), trace_id);
+  submit(reader_->currentTail(), trace_id);
 }
 
 } // namespace writer
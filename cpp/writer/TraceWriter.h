@@ -27,17 +27,18 @@
 
 #include <profilo/LogEntry.h>
 #include <profilo/entries/EntryParser.h>
+#include <profilo/logger/buffer/ResizableTraceBuffer.h>
 #include <profilo/logger/buffer/RingBuffer.h>
-#include <profilo/writer/PacketReassembler.h>
+#include <profilo/logger/buffer/ShardedTraceBuffer.h>
+#include <profilo/writer/PacketBufferReader.h>
+#include <profilo/writer/RecordBufferReader.h>
+#include <profilo/writer/TraceBufferReader.h>
 #include <profilo/writer/TraceCallbacks.h>
 
 namespace facebook {
 namespace profilo {
 namespace writer {
 
-using TraceBackwardsCallback = std::function<
-    void(entries::EntryVisitor&, TraceBuffer&, TraceBuffer::Cursor&)>;
-
 class TraceWriter {
  public:
   static const int64_t kStopLoopTraceID = 0;
@@ -58,6 +59,75 @@ class TraceWriter {
           std::vector<std::pair<std::string, std::string>>(),
       TraceBackwardsCallback trace_backwards_callback = nullptr);
 
+  //
+  // Same as above but reads variable-length records instead of packets.
+  // Records hold whole entries, so no reassembly is needed.
+  //
+  TraceWriter(
+      const std::string&& folder,
+      const std::string&& trace_prefix,
+      RecordBuffer& buffer,
+      std::shared_ptr<TraceCallbacks> callbacks = nullptr,
+      std::vector<std::pair<std::string, std::string>>&& headers =
+          std::vector<std::pair<std::string, std::string>>(),
+      RecordTraceBackwardsCallback trace_backwards_callback = nullptr);
+
+  //
+  // Same as above but merges the shards of a ShardedTraceBuffer by
+  // timestamp. Cursors passed to submit() are ignored in this mode, traces
+  // are located by their ID instead.
+  //
+  TraceWriter(
+      const std::string&& folder,
+      const std::string&& trace_prefix,
+      ShardedTraceBuffer& buffer,
+      std::shared_ptr<TraceCallbacks> callbacks = nullptr,
+      std::vector<std::pair<std::string, std::string>>&& headers =
+          std::vector<std::pair<std::string, std::string>>());
+
+  //
+  // Same as the first constructor but reads a buffer that may be resized
+  // while a trace is processed. The buffer generation holding the cursor
+  // is captured by submit() and followed across resizes from there.
+  //
+  TraceWriter(
+      const std::string&& folder,
+      const std::string&& trace_prefix,
+      ResizableTraceBuffer& buffer,
+      std::shared_ptr<TraceCallbacks> callbacks = nullptr,
+      std::vector<std::pair<std::string, std::string>>&& headers =
+          std::vector<std::pair<std::string, std::string>>(),
+      TraceBackwardsCallback trace_backwards_callback = nullptr);
+
+  //
+  // Reads traces with the given reader, for buffers the constructors above
+  // don't cover.
+  //
+  TraceWriter(
+      const std::string&& folder,
+      const std::string&& trace_prefix,
+      std::unique_ptr<TraceBufferReader> reader,
+      std::shared_ptr<TraceCallbacks> callbacks = nullptr,
+      std::vector<std::pair<std::string, std::string>>&& headers =
+          std::vector<std::pair<std::string, std::string>>());
+
+  //
+  // Processes traces in stages from now on, see PipelineConfig. Only
+  // applies to packet buffers, plain or resizable; others throw
+  // std::invalid_argument. Not to be called while a trace is processed.
+  //
+  // TRACE_BACKWARDS is handled once the encoding stage reaches it, by which
+  // time the entries before it may have been overwritten.
+  //
+  void enablePipeline(PipelineConfig config = PipelineConfig());
+
+  //
+  // Lets the writer grow and shrink the buffer from now on, see
+  // ResizePolicy. Only applies to resizable buffers; others throw
+  // std::invalid_argument. Not to be called while a trace is processed.
+  //
+  void enableResizing(ResizePolicy policy = ResizePolicy());
+
   //
   // Wait until a submit() call and then process a submitted trace ID.
   //
@@ -72,6 +142,12 @@ class TraceWriter {
   //
   std::unordered_set<int64_t> processTrace(TraceBuffer::Cursor& cursor);
 
+  //
+  // Sharded mode counterpart of processTrace(), which locates the trace by
+  // its ID instead, see ShardedBufferReader.
+  //
+  std::unordered_set<int64_t> processShardedTrace(int64_t trace_id);
+
   //
   // Submit a trace ID for processing. Walk will start from `cursor`.
   // Will wake up the thread and let it run until the trace is finished.
@@ -89,17 +165,28 @@ class TraceWriter {
   void submit(int64_t trace_id);
 
  private:
+  struct PendingTrace {
+    TraceBuffer::Cursor cursor;
+    int64_t trace_id;
+    // What the reader pinned on submission, see TraceBufferReader::pin().
+    std::shared_ptr<void> pinned;
+  };
+
   std::mutex wakeup_mutex_;
   std::condition_variable wakeup_cv_;
-  std::queue<std::pair<TraceBuffer::Cursor, int64_t>> wakeup_trace_ids_;
+  std::queue<PendingTrace> wakeup_trace_ids_;
 
   const std::string trace_folder_;
   const std::string trace_prefix_;
-  TraceBuffer& buffer_;
+  std::unique_ptr<TraceBufferReader> reader_;
   std::vector<std::pair<std::string, std::string>> trace_headers_;
 
   std::shared_ptr<TraceCallbacks> callbacks_;
-  TraceBackwardsCallback trace_backwards_callback_;
+
+  std::unordered_set<int64_t> processTrace(
+      TraceBuffer::Cursor& cursor,
+      int64_t trace_id,
+      std::shared_ptr<void> pinned);
 };
 
 } // namespace writer
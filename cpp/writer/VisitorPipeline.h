@@ -0,0 +1,424 @@
+/**
+ * Copyright 2004-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Needed for MAX_STACK_DEPTH
+#include <profiler/Constants.h>
+
+#include <profilo/StringTable.h>
+#include <profilo/entries/EntryParser.h>
+#include <profilo/writer/StackTable.h>
+#include <profilo/writer/TimestampTruncatingVisitor.h>
+
+namespace facebook {
+namespace profilo {
+namespace writer {
+
+using namespace entries;
+
+//
+// A chain of entry visitors fused at compile time. Entries come in through
+// the EntryVisitor interface and from there on every stage calls the next
+// one directly, so the compiler can inline the whole chain.
+//
+// All types but the last are stages: each one is called as
+// stage(entry, next) for the three entry types and passes what it makes of
+// the entry on with next(entry), any number of times. The last type is the
+// sink, called as sink.visit(entry); any EntryVisitor, or a reference to
+// one, will do.
+//
+//   Pipeline<InvertFrames, TruncateTimestamps, DeltaEncode, EntryPrinter>
+//       pipeline(InvertFrames(), TruncateTimestamps(), DeltaEncode(), out);
+//   EntryParser::parse(data, size, pipeline);
+//
+template <class... Stages>
+class Pipeline : public EntryVisitor {
+ public:
+  template <class... Args>
+  explicit Pipeline(Args&&... stages) : stages_(std::forward<Args>(stages)...) {
+    static_assert(sizeof...(Args) == sizeof...(Stages), "one per stage");
+  }
+
+  void visit(const StandardEntry& entry) override {
+    push<0>(entry);
+  }
+
+  void visit(const FramesEntry& entry) override {
+    push<0>(entry);
+  }
+
+  void visit(const BytesEntry& entry) override {
+    push<0>(entry);
+  }
+
+  template <size_t I>
+  typename std::tuple_element<I, std::tuple<Stages...>>::type& stage() {
+    return std::get<I>(stages_);
+  }
+
+ private:
+  static constexpr size_t kSink = sizeof...(Stages) - 1;
+
+  std::tuple<Stages...> stages_;
+
+  template <size_t I>
+  struct Next {
+    Pipeline& pipeline;
+
+    template <class Entry>
+    void operator()(const Entry& entry) const {
+      pipeline.template push<I>(entry);
+    }
+  };
+
+  template <size_t I, class Entry>
+  typename std::enable_if<(I < kSink)>::type push(const Entry& entry) {
+    std::get<I>(stages_)(entry, Next<I + 1>{*this});
+  }
+
+  template <size_t I, class Entry>
+  typename std::enable_if<I == kSink>::type push(const Entry& entry) {
+    std::get<I>(stages_).visit(entry);
+  }
+};
+
+//
+// Pipeline stages equivalent to the visitors of the same purpose.
+//
+
+// Reverses the frames of a FramesEntry, see StackTraceInvertingVisitor.
+class InvertFrames {
+ public:
+  InvertFrames() : stack_(std::make_unique<int64_t[]>(MAX_STACK_DEPTH)) {}
+
+  template <class Entry, class Next>
+  void operator()(const Entry& entry, const Next& next) {
+    next(entry);
+  }
+
+  template <class Next>
+  void operator()(const FramesEntry& entry, const Next& next) {
+    if (entry.frames.size > MAX_STACK_DEPTH) {
+      throw std::invalid_argument("entry.frames.size > MAX_STACK_DEPTH");
+    }
+    std::reverse_copy(
+        entry.frames.values,
+        entry.frames.values + entry.frames.size,
+        stack_.get());
+
+    FramesEntry inverted(entry);
+    inverted.frames.values = stack_.get();
+    next(inverted);
+  }
+
+ private:
+  std::unique_ptr<int64_t[]> stack_;
+};
+
+// Rounds timestamps to microseconds, see TimestampTruncatingVisitor.
+class TruncateTimestamps {
+ public:
+  template <class Next>
+  void operator()(const StandardEntry& entry, const Next& next) {
+    next(truncate(entry));
+  }
+
+  template <class Next>
+  void operator()(const FramesEntry& entry, const Next& next) {
+    next(truncate(entry));
+  }
+
+  template <class Next>
+  void operator()(const BytesEntry& entry, const Next& next) {
+    next(entry);
+  }
+
+ private:
+  template <class Entry>
+  static Entry truncate(const Entry& entry) {
+    Entry copied(entry);
+    copied.timestamp = detail::div_1000(copied.timestamp + 500);
+    return copied;
+  }
+};
+
+// Replaces every field by its difference to the previous entry, one entry
+// per frame, see DeltaEncodingVisitor.
+class DeltaEncode {
+ public:
+  DeltaEncode() : last_values_() {}
+
+  template <class Next>
+  void operator()(const StandardEntry& entry, const Next& next) {
+    StandardEntry encoded(entry);
+    encoded.id = minus(entry.id, last_values_.id);
+    encoded.timestamp = minus(entry.timestamp, last_values_.timestamp);
+    encoded.tid = minus(entry.tid, last_values_.tid);
+    encoded.callid = minus(entry.callid, last_values_.callid);
+    encoded.matchid = minus(entry.matchid, last_values_.matchid);
+    encoded.extra = minus(entry.extra, last_values_.extra);
+
+    last_values_.id = entry.id;
+    last_values_.timestamp = entry.timestamp;
+    last_values_.tid = entry.tid;
+    last_values_.callid = entry.callid;
+    last_values_.matchid = entry.matchid;
+    last_values_.extra = entry.extra;
+
+    next(encoded);
+  }
+
+  template <class Next>
+  void operator()(const FramesEntry& entry, const Next& next) {
+    int64_t frame[1];
+    FramesEntry encoded(entry);
+    encoded.frames.values = frame;
+    encoded.frames.size = 1;
+
+    for (int32_t idx = 0; idx < entry.frames.size; ++idx) {
+      int32_t id = minus(entry.id, -idx);
+      int64_t current_frame = entry.frames.values[idx];
+
+      encoded.id = minus(id, last_values_.id);
+      encoded.timestamp = minus(entry.timestamp, last_values_.timestamp);
+      encoded.tid = minus(entry.tid, last_values_.tid);
+      encoded.matchid = minus(entry.matchid, last_values_.matchid);
+      frame[0] = minus(current_frame, last_values_.extra);
+
+      // FramesEntries don't use callid, it keeps its previous value.
+      last_values_.id = id;
+      last_values_.timestamp = entry.timestamp;
+      last_values_.tid = entry.tid;
+      last_values_.matchid = entry.matchid;
+      last_values_.extra = current_frame;
+
+      next(encoded);
+    }
+  }
+
+  template <class Next>
+  void operator()(const BytesEntry& entry, const Next& next) {
+    // BytesEntry is not delta-encoded
+    next(entry);
+  }
+
+ private:
+  struct {
+    int32_t id;
+    int64_t timestamp;
+    int32_t tid;
+    int32_t callid;
+    int32_t matchid;
+    int64_t extra;
+  } last_values_;
+
+  // Wrapping subtraction, as DeltaEncodingVisitor gets from -fwrapv.
+  template <class T>
+  static T minus(T a, T b) {
+    using U = typename std::make_unsigned<T>::type;
+    return static_cast<T>(static_cast<U>(a) - static_cast<U>(b));
+  }
+};
+
+//
+// Writes every distinct stack once. The first time a stack is seen, it is
+// passed on as a STACK_DEFINITION frames entry with the stack ID as its
+// matchid. Every sample, that one included, becomes a STACK_SAMPLE with
+// the stack ID as callid, and the frames entry type as extra. Once the
+// table is full, new stacks are passed on as they are.
+//
+class InternStacks {
+ public:
+  explicit InternStacks(size_t max_frames = StackTable::kDefaultMaxFrames)
+      : stacks_(max_frames) {}
+
+  template <class Entry, class Next>
+  void operator()(const Entry& entry, const Next& next) {
+    next(entry);
+  }
+
+  template <class Next>
+  void operator()(const FramesEntry& entry, const Next& next) {
+    auto interned = stacks_.intern(entry.frames.values, entry.frames.size);
+    if (interned.first == 0) {
+      next(entry);
+      return;
+    }
+    if (interned.second) {
+      FramesEntry definition(entry);
+      definition.type = EntryType::STACK_DEFINITION;
+      definition.matchid = interned.first;
+      next(definition);
+    }
+
+    StandardEntry sample{};
+    sample.id = entry.id;
+    sample.type = EntryType::STACK_SAMPLE;
+    sample.timestamp = entry.timestamp;
+    sample.tid = entry.tid;
+    sample.callid = interned.first;
+    sample.matchid = entry.matchid;
+    sample.extra = static_cast<int64_t>(entry.type);
+    next(sample);
+  }
+
+  const StackTable& stacks() const {
+    return stacks_;
+  }
+
+ private:
+  StackTable stacks_;
+};
+
+//
+// Turns the STRING_REFERENCE entries written by
+// Logger::writeInternedBytes() back into the bytes entries they stand for.
+// References the string table doesn't know are passed on as they are.
+//
+class ResolveStrings {
+ public:
+  explicit ResolveStrings(
+      const logger::StringTable& strings = logger::StringTable::get())
+      : strings_(&strings) {}
+
+  template <class Entry, class Next>
+  void operator()(const Entry& entry, const Next& next) {
+    next(entry);
+  }
+
+  template <class Next>
+  void operator()(const StandardEntry& entry, const Next& next) {
+    if (entry.type != EntryType::STRING_REFERENCE) {
+      next(entry);
+      return;
+    }
+    auto string = strings_->lookup(static_cast<uint32_t>(entry.callid));
+    if (string.data == nullptr) {
+      next(entry);
+      return;
+    }
+    BytesEntry resolved{};
+    resolved.id = entry.id;
+    resolved.type = static_cast<EntryType>(entry.extra);
+    resolved.matchid = entry.matchid;
+    resolved.bytes.values = const_cast<uint8_t*>(string.data);
+    resolved.bytes.size = static_cast<uint16_t>(string.size);
+    next(resolved);
+  }
+
+ private:
+  const logger::StringTable* strings_;
+};
+
+//
+// Writes every distinct string once per trace. Each STRING_NAME,
+// STRING_KEY or STRING_VALUE entry that is passed on takes the next string
+// ID, starting at 1; repeats of its string become STRING_REFERENCE
+// entries with that ID as callid, the original matchid, and the original
+// type as extra. References take the timestamp and tid of the entry
+// before them, so they delta-encode to next to nothing.
+//
+// Once the table holds max_bytes of strings, new strings still take IDs
+// but aren't remembered.
+//
+class InternStrings {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 4 * 1024 * 1024;
+
+  explicit InternStrings(size_t max_bytes = kDefaultMaxBytes)
+      : max_bytes_(max_bytes),
+        bytes_(0),
+        next_id_(1),
+        ids_(),
+        key_(),
+        last_timestamp_(0),
+        last_tid_(0) {}
+
+  template <class Next>
+  void operator()(const StandardEntry& entry, const Next& next) {
+    last_timestamp_ = entry.timestamp;
+    last_tid_ = entry.tid;
+    next(entry);
+  }
+
+  template <class Next>
+  void operator()(const FramesEntry& entry, const Next& next) {
+    last_timestamp_ = entry.timestamp;
+    last_tid_ = entry.tid;
+    next(entry);
+  }
+
+  template <class Next>
+  void operator()(const BytesEntry& entry, const Next& next) {
+    if (entry.type != EntryType::STRING_NAME &&
+        entry.type != EntryType::STRING_KEY &&
+        entry.type != EntryType::STRING_VALUE) {
+      next(entry);
+      return;
+    }
+    // The text format ends strings at the first NUL.
+    auto bytes = reinterpret_cast<const char*>(entry.bytes.values);
+    key_.assign(bytes, strnlen(bytes, entry.bytes.size));
+
+    auto it = ids_.find(key_);
+    if (it == ids_.end()) {
+      if (bytes_ + key_.size() <= max_bytes_) {
+        bytes_ += key_.size();
+        ids_.emplace(key_, next_id_);
+      }
+      ++next_id_;
+      next(entry);
+      return;
+    }
+
+    StandardEntry reference{};
+    reference.id = entry.id;
+    reference.type = EntryType::STRING_REFERENCE;
+    reference.timestamp = last_timestamp_;
+    reference.tid = last_tid_;
+    reference.callid = it->second;
+    reference.matchid = entry.matchid;
+    reference.extra = static_cast<int64_t>(entry.type);
+    next(reference);
+  }
+
+ private:
+  const size_t max_bytes_;
+  size_t bytes_;
+  int32_t next_id_;
+  std::unordered_map<std::string, int32_t> ids_;
+  // Reused for lookups.
+  std::string key_;
+  int64_t last_timestamp_;
+  int32_t last_tid_;
+};
+
+} // namespace writer
+} // namespace profilo
+} // namespace facebook
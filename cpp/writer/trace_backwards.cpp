@@ -17,6 +17,7 @@
 #include "trace_backwards.h"
 
 #include <profilo/entries/EntryParser.h>
+#include <profilo/logger/buffer/CheckpointIndex.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 #include <profilo/writer/PacketReassembler.h>
 
@@ -24,6 +25,36 @@ namespace facebook {
 namespace profilo {
 namespace writer {
 
+namespace {
+
+class TimestampVisitor : public entries::EntryVisitor {
+ public:
+  int64_t timestamp = -1;
+
+  void visit(const entries::StandardEntry& entry) override {
+    timestamp = entry.timestamp;
+  }
+
+  void visit(const entries::FramesEntry& entry) override {
+    timestamp = entry.timestamp;
+  }
+
+  void visit(const entries::BytesEntry&) override {}
+};
+
+// Returns the timestamp of the single packet entry at `cursor`, or -1.
+int64_t entryTimestamp(TraceBuffer& buffer, const TraceBuffer::Cursor& cursor) {
+  alignas(4) Packet packet;
+  if (!buffer.tryRead(packet, cursor) || !packet.start || packet.next) {
+    return -1;
+  }
+  TimestampVisitor visitor;
+  entries::EntryParser::parse(packet.data, packet.size, visitor);
+  return visitor.timestamp;
+}
+
+} // namespace
+
 void traceBackwards(
     entries::EntryVisitor& visitor,
     TraceBuffer& buffer,
@@ -32,15 +63,68 @@ void traceBackwards(
     entries::EntryParser::parse(data, size, visitor);
   });
 
-  TraceBuffer::Cursor backCursor{cursor};
-  backCursor.moveBackward(); // Move back before trace start
+  TraceBuffer::Cursor readCursor = buffer.currentTail();
+  auto start = entryTimestamp(buffer, cursor);
+  TraceBuffer::Cursor checkpoint{0};
+  if (start >= 0 &&
+      CheckpointIndex::get().find(
+          buffer, start - kTraceBackdatingWindowUs * 1000, checkpoint) &&
+      readCursor < checkpoint) {
+    readCursor = checkpoint;
+  }
 
   alignas(4) Packet packet;
-  while (buffer.tryRead(packet, backCursor)) {
-    reassembler.processBackwards(packet);
-    if (!backCursor.moveBackward()) {
-      break; // done
+  while (readCursor < cursor) {
+    if (!buffer.tryRead(packet, readCursor)) {
+      // Overwritten by newer writes, carry on from what's left.
+      auto tail = buffer.currentTail();
+      if (!(readCursor < tail)) {
+        break;
+      }
+      readCursor = tail;
+      continue;
+    }
+    reassembler.process(packet);
+    readCursor.moveForward();
+  }
+}
+
+void traceBackwards(
+    entries::EntryVisitor& visitor,
+    RecordBuffer& buffer,
+    RecordBuffer::Cursor& cursor,
+    std::vector<char>& scratch) {
+  scratch.resize(RecordBuffer::kMaxRecordSize);
+  char* record = scratch.data();
+  uint32_t size;
+
+  RecordBuffer::Cursor readCursor = buffer.currentTail();
+  int64_t start = -1;
+  if (buffer.tryRead(record, scratch.size(), cursor, size)) {
+    TimestampVisitor timestampVisitor;
+    entries::EntryParser::parse(record, size, timestampVisitor);
+    start = timestampVisitor.timestamp;
+  }
+  RecordBuffer::Cursor checkpoint{0};
+  if (start >= 0 &&
+      CheckpointIndex::get().find(
+          buffer, start - kTraceBackdatingWindowUs * 1000, checkpoint) &&
+      readCursor < checkpoint) {
+    readCursor = checkpoint;
+  }
+
+  while (readCursor < cursor) {
+    if (!buffer.tryRead(record, scratch.size(), readCursor, size)) {
+      // Overwritten by newer writes, carry on from what's left.
+      auto tail = buffer.currentTail();
+      if (!(readCursor < tail)) {
+        break;
+      }
+      readCursor = tail;
+      continue;
     }
+    entries::EntryParser::parse(record, size, visitor);
+    readCursor.moveForward(RecordBuffer::recordSpan(size));
   }
 }
 
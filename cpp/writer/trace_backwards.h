@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <cstdint>
+#include <vector>
+
 #include <profilo/entries/EntryParser.h>
 #include <profilo/logger/buffer/RingBuffer.h>
 
@@ -21,11 +24,30 @@ namespace facebook {
 namespace profilo {
 namespace writer {
 
+// How far back a trace started with TRACE_BACKWARDS goes, in microseconds.
+constexpr int64_t kTraceBackdatingWindowUs = 10 * 1000 * 1000;
+
+//
+// Visits the entries written before `cursor`, the TRACE_BACKWARDS entry,
+// in the order they were written. Starts from the CheckpointIndex entry
+// just before the backdating window, if there is one, or from the oldest
+// entry in the buffer otherwise. Packets and records alike.
+//
 void traceBackwards(
     entries::EntryVisitor& visitor,
     TraceBuffer& buffer,
     TraceBuffer::Cursor& cursor);
 
+//
+// Records are read into `scratch`, which grows to hold the largest one.
+// Callers keep it across calls, so that it's only allocated once.
+//
+void traceBackwards(
+    entries::EntryVisitor& visitor,
+    RecordBuffer& buffer,
+    RecordBuffer::Cursor& cursor,
+    std::vector<char>& scratch);
+
 } // namespace writer
 } // namespace profilo
 } // namespace facebook
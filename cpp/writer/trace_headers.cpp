@@ -24,6 +24,7 @@
 #include <system_error>
 #include <vector>
 
+#include <profilo/writer/trace_backwards.h>
 #include <util/common.h>
 
 namespace facebook {
@@ -61,10 +62,8 @@ std::vector<std::pair<std::string, std::string>> calculateHeaders() {
     }
   }
   {
-    static constexpr int kBackTracingWindowMicroSeconds =
-        10000000; // 10 seconds
     std::stringstream ss;
-    ss << kBackTracingWindowMicroSeconds;
+    ss << kTraceBackdatingWindowUs;
     result.push_back(std::make_pair("trace_backdating_window", ss.str()));
   }
 
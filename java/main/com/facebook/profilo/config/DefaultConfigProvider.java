@@ -25,6 +25,11 @@ public class DefaultConfigProvider implements ConfigProvider {
   public static final int DEFAULT_UPLOAD_BYTES_PER_UPDATE = 10000 / 24;
   public static final int DEFAULT_BUFFER_SIZE = -1;
   public static final boolean DEFAULT_IS_MMAP_BUFFER = false;
+  public static final boolean DEFAULT_IS_PIPELINED_TRACE_WRITER = false;
+  public static final boolean DEFAULT_IS_RECORD_BUFFER = false;
+  public static final int DEFAULT_BUFFER_SHARD_COUNT = 0;
+  public static final boolean DEFAULT_IS_RESIZABLE_BUFFER = false;
+  public static final int DEFAULT_STRING_TABLE_SIZE = 0;
 
   public static final Config DEFAULT_CONFIG =
       new Config() {
@@ -81,6 +86,31 @@ public class DefaultConfigProvider implements ConfigProvider {
             public boolean isMmapBuffer() {
               return DEFAULT_IS_MMAP_BUFFER;
             }
+
+            @Override
+            public boolean isRecordBuffer() {
+              return DEFAULT_IS_RECORD_BUFFER;
+            }
+
+            @Override
+            public int getBufferShardCount() {
+              return DEFAULT_BUFFER_SHARD_COUNT;
+            }
+
+            @Override
+            public boolean isResizableBuffer() {
+              return DEFAULT_IS_RESIZABLE_BUFFER;
+            }
+
+            @Override
+            public int getStringTableSize() {
+              return DEFAULT_STRING_TABLE_SIZE;
+            }
+
+            @Override
+            public boolean isPipelinedTraceWriter() {
+              return DEFAULT_IS_PIPELINED_TRACE_WRITER;
+            }
           };
         }
 
@@ -26,4 +26,37 @@ public interface SystemControlConfig {
 
   /** @return true if the buffer will be allocated on disk in mmaped region. */
   boolean isMmapBuffer();
+
+  /**
+   * @return true if entries are stored as variable-length records rather than fixed-size packets.
+   *     Mmaped buffers always use packets.
+   */
+  boolean isRecordBuffer();
+
+  /**
+   * @return the number of independent buffers the buffer slots are split between, each written by
+   *     a fixed subset of threads and merged by timestamp when traces are written. 0 keeps a single
+   *     buffer. Ignored for record and mmaped buffers.
+   */
+  int getBufferShardCount();
+
+  /**
+   * @return true if the trace writer may grow the buffer while it falls behind the writers and
+   *     shrink it back once idle. Ignored for record, sharded and mmaped buffers.
+   */
+  boolean isResizableBuffer();
+
+  /**
+   * @return how many distinct strings, such as section names, the logger can intern and log by ID.
+   *     Strings past that are logged in full. 0 uses the default. This is a global process lifetime
+   *     setting.
+   */
+  int getStringTableSize();
+
+  /**
+   * @return true if the trace writer reads, encodes and compresses traces on separate threads.
+   *     Backward traces started while another trace is written may then miss their earliest
+   *     entries.
+   */
+  boolean isPipelinedTraceWriter();
 }
@@ -70,6 +70,11 @@ public final class ProfiloConstants {
   public static final String TRACE_CONFIG_PARAM_TRACE_TIMEOUT_MS = "trace_config.trace_timeout_ms";
   public static final String TRACE_CONFIG_PARAM_LOGGER_PRIORITY = "trace_config.logger_priority";
   public static final int TRACE_CONFIG_PARAM_LOGGER_PRIORITY_DEFAULT = 5;
+  public static final String TRACE_CONFIG_PARAM_COMPRESSION_LEVEL =
+      "trace_config.compression_level";
+  public static final int TRACE_CONFIG_PARAM_COMPRESSION_LEVEL_DEFAULT = Integer.MIN_VALUE;
+  public static final String TRACE_CONFIG_PARAM_COMPRESSION_BUFFER_SIZE =
+      "trace_config.compression_buffer_size";
   public static final String TRACE_CONFIG_PARAM_POST_TRACE_EXTENSION_MSEC =
       "trace_config.post_trace_extension_ms";
   public static final int TRACE_CONFIG_PARAM_POST_TRACE_EXTENSION_MSEC_DEFAULT = 0;
@@ -80,4 +85,15 @@ public final class ProfiloConstants {
       "provider.stack_trace.use_thread_specific_profiler";
   public static final String PROVIDER_PARAM_STACK_TRACE_THREAD_DETECT_INTERVAL_MS =
       "provider.stack_trace.thread_detect_interval_ms";
+  // Number of per-thread stack slot rings and slots in each, 0 for defaults.
+  public static final String PROVIDER_PARAM_STACK_TRACE_SLOT_RINGS =
+      "provider.stack_trace.slot_rings";
+  public static final String PROVIDER_PARAM_STACK_TRACE_SLOTS_PER_RING =
+      "provider.stack_trace.slots_per_ring";
+  // Bounds for adapting the sampling interval to the profiler's overhead.
+  // The interval stays fixed unless max > min > 0.
+  public static final String PROVIDER_PARAM_STACK_TRACE_MIN_SAMPLING_RATE_MS =
+      "provider.stack_trace.min_sampling_rate_ms";
+  public static final String PROVIDER_PARAM_STACK_TRACE_MAX_SAMPLING_RATE_MS =
+      "provider.stack_trace.max_sampling_rate_ms";
 }
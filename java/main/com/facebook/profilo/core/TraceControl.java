@@ -340,7 +340,15 @@ public final class TraceControl {
           nextContext.mTraceConfigExtras.getIntParam(
               ProfiloConstants.TRACE_CONFIG_PARAM_TRACE_TIMEOUT_MS, TRACE_TIMEOUT_MS);
     }
-    Logger.postCreateTrace(nextContext.traceId, flags, timeout);
+    int compressionLevel =
+        nextContext.mTraceConfigExtras.getIntParam(
+            ProfiloConstants.TRACE_CONFIG_PARAM_COMPRESSION_LEVEL,
+            ProfiloConstants.TRACE_CONFIG_PARAM_COMPRESSION_LEVEL_DEFAULT);
+    int compressionBufferSize =
+        nextContext.mTraceConfigExtras.getIntParam(
+            ProfiloConstants.TRACE_CONFIG_PARAM_COMPRESSION_BUFFER_SIZE, 0);
+    Logger.postCreateTrace(
+        nextContext.traceId, flags, timeout, compressionLevel, compressionBufferSize);
 
     int logger_priority =
         nextContext.mTraceConfigExtras.getIntParam(
@@ -223,7 +223,18 @@ public final class TraceOrchestrator
       }
 
       // using process name as a unique prefix for each process
-      Logger.initialize(bufferSize, folder, mProcessName, this, this, mMmapBufferManager);
+      Logger.initialize(
+          bufferSize,
+          folder,
+          mProcessName,
+          this,
+          this,
+          mMmapBufferManager,
+          initialConfig.getSystemControl().isRecordBuffer(),
+          initialConfig.getSystemControl().getBufferShardCount(),
+          initialConfig.getSystemControl().isResizableBuffer(),
+          initialConfig.getSystemControl().getStringTableSize(),
+          initialConfig.getSystemControl().isPipelinedTraceWriter());
 
       // Complete a normal config update; this is somewhat wasteful but ensures consistency
       performConfigTransition(initialConfig);
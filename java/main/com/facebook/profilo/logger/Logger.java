@@ -47,6 +47,10 @@ public final class Logger {
   private static LoggerCallbacks sLoggerCallbacks;
   private static int sRingBufferSize;
   private static @Nullable MmapBufferManager sMmapBufferManager;
+  private static boolean sRecordBuffer;
+  private static int sBufferShardCount;
+  private static boolean sResizableBuffer;
+  private static boolean sPipelinedTraceWriter;
 
   public static void initialize(
       int ringBufferSize,
@@ -54,8 +58,16 @@ public final class Logger {
       String filePrefix,
       NativeTraceWriterCallbacks nativeTraceWriterCallbacks,
       LoggerCallbacks loggerCallbacks,
-      @Nullable MmapBufferManager mmapBufferManager) {
+      @Nullable MmapBufferManager mmapBufferManager,
+      boolean recordBuffer,
+      int bufferShardCount,
+      boolean resizableBuffer,
+      int stringTableSize,
+      boolean pipelinedTraceWriter) {
     SoLoader.loadLibrary("profilo");
+    if (stringTableSize > 0) {
+      nativeInitStringTable(stringTableSize);
+    }
     TraceEvents.sInitialized = true;
 
     sInitialized = true;
@@ -66,6 +78,10 @@ public final class Logger {
     sRingBufferSize = ringBufferSize;
     sWorker = new AtomicReference<>(null);
     sMmapBufferManager = mmapBufferManager;
+    sRecordBuffer = recordBuffer;
+    sBufferShardCount = bufferShardCount;
+    sResizableBuffer = resizableBuffer;
+    sPipelinedTraceWriter = pipelinedTraceWriter;
   }
 
   public static void stopTraceWriter() {
@@ -74,6 +90,18 @@ public final class Logger {
     }
   }
 
+  /**
+   * Switches the calling thread between blocking writes, the default, and non-blocking writes.
+   * Non-blocking writes are dropped rather than wait for a writer that got lapped; meant for
+   * latency-sensitive threads, such as the UI thread. Each trace is annotated with the number of
+   * writes dropped while it ran.
+   */
+  public static void setBlockingWritesForCurrentThread(boolean blocking) {
+    if (sInitialized) {
+      nativeSetBlockingWrites(blocking);
+    }
+  }
+
   public static final int SKIP_PROVIDER_CHECK = 1 << 0;
   public static final int FILL_TIMESTAMP = 1 << 1;
   public static final int FILL_TID = 1 << 2;
@@ -111,7 +139,8 @@ public final class Logger {
     }
   }
 
-  public static void postCreateTrace(long traceId, int flags, int timeoutMs) {
+  public static void postCreateTrace(
+      long traceId, int flags, int timeoutMs, int compressionLevel, int compressionBufferSize) {
     if (!sInitialized) {
       return;
     }
@@ -124,7 +153,8 @@ public final class Logger {
     }
 
     if (useDefaultInit) {
-      nativeInitRingBuffer(sRingBufferSize);
+      nativeInitRingBuffer(
+          sRingBufferSize, sRecordBuffer, sBufferShardCount, sResizableBuffer);
     }
 
     // Do not trigger trace writer for memory-only trace
@@ -133,8 +163,12 @@ public final class Logger {
     }
 
     startWorkerThreadIfNecessary();
+    NativeTraceWriter writer = sTraceWriter;
+    if (writer != null) {
+      writer.setTraceCompression(traceId, compressionLevel, compressionBufferSize);
+    }
     loggerWriteAndWakeupTraceWriter(
-        sTraceWriter, traceId, EntryType.TRACE_START, timeoutMs, flags, traceId);
+        writer, traceId, EntryType.TRACE_START, timeoutMs, flags, traceId);
   }
 
   public static void postCreateBackwardTrace(long traceId, int flags) {
@@ -222,7 +256,10 @@ public final class Logger {
     try {
       writer =
           new NativeTraceWriter(
-              sTraceDirectory.getCanonicalPath(), sFilePrefix, sNativeTraceWriterCallbacks);
+              sTraceDirectory.getCanonicalPath(),
+              sFilePrefix,
+              sNativeTraceWriterCallbacks,
+              sPipelinedTraceWriter);
     } catch (IOException e) {
       throw new IllegalArgumentException("Could not get canonical path of trace directory");
     }
@@ -248,5 +285,10 @@ public final class Logger {
     thread.start();
   }
 
-  private static native void nativeInitRingBuffer(int size);
+  private static native void nativeInitRingBuffer(
+      int size, boolean records, int shards, boolean resizable);
+
+  private static native void nativeInitStringTable(int strings);
+
+  private static native void nativeSetBlockingWrites(boolean blocking);
 }
@@ -21,6 +21,15 @@ public final class Trace {
   // Configuration flags
   public static final int FLAG_MANUAL = 1;
   public static final int FLAG_MEMORY_ONLY = 1 << 1;
+  // Write the trace file in the binary format instead of the text one.
+  public static final int FLAG_BINARY_FORMAT = 1 << 2;
+  // Compress the trace file with LZ4 (cheaper) or zstd (denser) instead of
+  // zlib. Native builds without the codec still write zlib.
+  public static final int FLAG_COMPRESSION_LZ4 = 1 << 3;
+  public static final int FLAG_COMPRESSION_ZSTD = 1 << 4;
+  // Cut the trace file into self-contained chunks as it is written, so that
+  // completed parts can be uploaded before the trace ends.
+  public static final int FLAG_CHUNKED_FILE = 1 << 5;
 
   private long mID;
   private final File mLogFile;
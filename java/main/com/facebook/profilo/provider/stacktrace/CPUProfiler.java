@@ -131,7 +131,11 @@ public class CPUProfiler {
       int samplingRateMs,
       boolean useThreadSpecificProfiler,
       int threadDetectIntervalMs,
-      boolean wallClockModeEnabled) {
+      boolean wallClockModeEnabled,
+      int stackSlotRings,
+      int stackSlotsPerRing,
+      int minSamplingRateMs,
+      int maxSamplingRateMs) {
     // We always trace the main thread.
     StackTraceWhitelist.add(Process.myPid());
 
@@ -141,7 +145,11 @@ public class CPUProfiler {
             samplingRateMs,
             useThreadSpecificProfiler,
             threadDetectIntervalMs,
-            wallClockModeEnabled);
+            wallClockModeEnabled,
+            stackSlotRings,
+            stackSlotsPerRing,
+            minSamplingRateMs,
+            maxSamplingRateMs);
   }
 
   public static void loggerLoop() {
@@ -151,11 +159,12 @@ public class CPUProfiler {
     nativeLoggerLoop();
   }
 
-  public static void resetFrameworkNamesSet() {
+  /** Makes the profiler log the frame names it already knows into the new trace. */
+  public static void onTraceStarted() {
     if (!sInitialized) {
       return;
     }
-    nativeResetFrameworkNamesSet();
+    nativeOnTraceStarted();
   }
 
   /** Note: Init correctness is guaranteed for Main Thread only at this point. */
@@ -168,7 +177,11 @@ public class CPUProfiler {
       int samplingRateMs,
       boolean useThreadSpecificProfiler,
       int threadDetectIntervalMs,
-      boolean wallClockModeEnabled);
+      boolean wallClockModeEnabled,
+      int stackSlotRings,
+      int stackSlotsPerRing,
+      int minSamplingRateMs,
+      int maxSamplingRateMs);
 
   @DoNotStrip
   private static native void nativeStopProfiling();
@@ -177,5 +190,5 @@ public class CPUProfiler {
   private static native void nativeLoggerLoop();
 
   @DoNotStrip
-  private static native void nativeResetFrameworkNamesSet();
+  private static native void nativeOnTraceStarted();
 }
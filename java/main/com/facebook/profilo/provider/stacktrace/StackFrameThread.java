@@ -102,6 +102,10 @@ public final class StackFrameThread extends BaseTraceProvider {
       int sampleRateMs,
       boolean useThreadSpecificProfiler,
       int threadDetectIntervalMs,
+      int stackSlotRings,
+      int stackSlotsPerRing,
+      int minSampleRateMs,
+      int maxSampleRateMs,
       int enabledProviders) {
     if (!initProfiler()) {
       return false;
@@ -125,6 +129,9 @@ public final class StackFrameThread extends BaseTraceProvider {
         mSystemClockTimeIntervalMs = nativeSystemClockTickIntervalMs();
       }
       sampleRateMs = Math.max(sampleRateMs, mSystemClockTimeIntervalMs);
+      if (minSampleRateMs > 0) {
+        minSampleRateMs = Math.max(minSampleRateMs, mSystemClockTimeIntervalMs);
+      }
     }
     // For now, we'll just keep an eye on the main thread. Eventually we
     // might want to pass a list of all the interesting threads.
@@ -135,7 +142,11 @@ public final class StackFrameThread extends BaseTraceProvider {
             sampleRateMs,
             useThreadSpecificProfiler,
             threadDetectIntervalMs,
-            wallClockModeEnabled);
+            wallClockModeEnabled,
+            stackSlotRings,
+            stackSlotsPerRing,
+            minSampleRateMs,
+            maxSampleRateMs);
     if (!started) {
       return false;
     }
@@ -178,6 +189,14 @@ public final class StackFrameThread extends BaseTraceProvider {
                 ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_USE_THREAD_SPECIFIC_PROFILER, false),
             context.mTraceConfigExtras.getIntParam(
                 ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_THREAD_DETECT_INTERVAL_MS, 0),
+            context.mTraceConfigExtras.getIntParam(
+                ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_SLOT_RINGS, 0),
+            context.mTraceConfigExtras.getIntParam(
+                ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_SLOTS_PER_RING, 0),
+            context.mTraceConfigExtras.getIntParam(
+                ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_MIN_SAMPLING_RATE_MS, 0),
+            context.mTraceConfigExtras.getIntParam(
+                ProfiloConstants.PROVIDER_PARAM_STACK_TRACE_MAX_SAMPLING_RATE_MS, 0),
             context.enabledProviders);
     if (!enabled) {
       return;
@@ -275,7 +294,7 @@ public final class StackFrameThread extends BaseTraceProvider {
 
   @Override
   protected void onTraceStarted(TraceContext context, ExtraDataFileProvider dataFileProvider) {
-    CPUProfiler.resetFrameworkNamesSet();
+    CPUProfiler.onTraceStarted();
   }
 
   @DoNotStrip
@@ -25,15 +25,34 @@ public final class NativeTraceWriter {
 
   @DoNotStrip private HybridData mHybridData;
 
+  /**
+   * @param pipelined read, encode and compress traces on separate threads. Backward traces started
+   *     while another trace is written may miss their earliest entries in this mode.
+   */
   public NativeTraceWriter(
-      String traceFolder, String tracePrefix, NativeTraceWriterCallbacks callbacks) {
-    mHybridData = initHybrid(traceFolder, tracePrefix, callbacks);
+      String traceFolder,
+      String tracePrefix,
+      NativeTraceWriterCallbacks callbacks,
+      boolean pipelined) {
+    mHybridData = initHybrid(traceFolder, tracePrefix, callbacks, pipelined);
   }
 
   private static native HybridData initHybrid(
-      String traceFolder, String tracePrefix, NativeTraceWriterCallbacks callbacks);
+      String traceFolder,
+      String tracePrefix,
+      NativeTraceWriterCallbacks callbacks,
+      boolean pipelined);
 
   public native void loop();
 
+  /**
+   * Overrides the compression level and buffer size of a trace, on top of the codec selected by
+   * its flags. Must be called before the trace start is posted.
+   *
+   * @param level codec specific level, or Integer.MIN_VALUE for the codec's default
+   * @param bufferSize compression buffer size in bytes, or 0 for the default
+   */
+  public native void setTraceCompression(long traceId, int level, int bufferSize);
+
   public native String getTraceFolder(long traceID);
 }
@@ -248,7 +248,7 @@ public class TraceControlTest extends PowerMockTest {
     assertThat(mTraceControl.startTrace(TRACE_CONTROLLER_ID, flags, new Object(), 0)).isTrue();
 
     verifyStatic(Logger.class);
-    Logger.postCreateTrace(anyLong(), eq(flags), anyInt());
+    Logger.postCreateTrace(anyLong(), eq(flags), anyInt(), anyInt(), anyInt());
 
     verify(mTraceControlHandler)
         .onTraceStart(
@@ -261,7 +261,7 @@ public class TraceControlTest extends PowerMockTest {
     assertThat(mTraceControl.startTrace(TRACE_CONTROLLER_ID, flags, new Object(), 0)).isTrue();
 
     verifyStatic(Logger.class, times(1));
-    Logger.postCreateTrace(anyLong(), eq(flags), anyInt());
+    Logger.postCreateTrace(anyLong(), eq(flags), anyInt(), anyInt(), anyInt());
     verifyStatic(Logger.class, never());
     Logger.postCreateBackwardTrace(anyLong(), eq(flags));
 
@@ -15,13 +15,13 @@ limitations under the License.
 """
 
 
+from .importer.compression import open_trace_file
 from .importer.trace_file import TraceFile
 from .importer.interpreter import TraceFileInterpreter
 
 if __name__ == "__main__":
     import sys
-    import gzip
-    with gzip.open(sys.argv[1]) as f:
+    with open_trace_file(sys.argv[1]) as f:
         tracefile = TraceFile.from_file(f)
         interpreter = TraceFileInterpreter(tracefile)
         trace = interpreter.interpret()
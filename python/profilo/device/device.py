@@ -20,10 +20,11 @@ import subprocess
 import os
 import datetime
 import sys
-import gzip
 import zipfile
 from io import BytesIO
 
+from ..importer.compression import decompress
+
 
 # Traces go to the files/profilo directory when they are created, then moved into the
 # files/profilo/upload/ directory for uploading, and then moved back to files/profilo once
@@ -41,6 +42,7 @@ _PROFILO_DIR = 'files/profilo/'
 _TRACE_FILE_EXT = ".log"
 _TRACE_FILE_EXPRESSION = '*' + _TRACE_FILE_EXT
 _PROFILO_HEADER_START = 'dt\n'.encode("utf-8")
+_PROFILO_BINARY_HEADER_START = 'dtbin\n'.encode("utf-8")
 
 # -t to order by modified time for a nice default ordering.
 _ADB_CMD_BASE = ['adb', 'shell', 'run-as']
@@ -79,13 +81,14 @@ def _get_data_dir_full_path(package):
     return subprocess.check_output(command).decode("utf-8").strip()
 
 
-def _is_profilo_trace(gzip_file):
+def _is_profilo_trace(content):
     try:
-        data = gzip_file.read()
-        if not data.startswith(_PROFILO_HEADER_START):
+        data = decompress(content)
+        if not data.startswith(_PROFILO_HEADER_START) and \
+           not data.startswith(_PROFILO_BINARY_HEADER_START):
             return False
     except IOError:
-        # Not a gzipped file
+        # Not a compressed file, or a corrupt one (DecompressionError).
         return False
 
     return True
@@ -100,8 +103,9 @@ def _validate_trace(package, data_dir_path, file_path):
 
     A file is a "profilo trace" if:
 
-        a) It is a gzipped file
-        b) It starts with the magic _PROFILO_HEADER_START bytes
+        a) It is compressed with gzip, LZ4 or zstd
+        b) It starts with the magic _PROFILO_HEADER_START or
+           _PROFILO_BINARY_HEADER_START bytes
     """
     full_path = "/data/data/{package}/{path}".format(
                 package=package, path=file_path)
@@ -129,12 +133,10 @@ def _validate_trace(package, data_dir_path, file_path):
                 if info_file.filename.startswith("extra/"):
                     continue
                 f = zipped.open(info_file)
-                gz = gzip.GzipFile(fileobj=BytesIO(f.read()))
-                if not _is_profilo_trace(gz):
+                if not _is_profilo_trace(f.read()):
                     return False
     else:
-        gz = gzip.GzipFile(fileobj=BytesIO(content))
-        if not _is_profilo_trace(gz):
+        if not _is_profilo_trace(content):
             return False
 
     return True
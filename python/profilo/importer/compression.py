@@ -0,0 +1,87 @@
+"""
+Copyright 2018-present, Facebook, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+
+import gzip
+import zlib
+
+GZIP_MAGIC = b"\x1f\x8b"
+LZ4_MAGIC = b"\x04\x22\x4d\x18"
+ZSTD_MAGIC = b"\x28\xb5\x2f\xfd"
+
+
+def open_trace_file(path):
+    """
+    Opens a trace file for reading, decompressing it according to its magic
+    bytes. Uncompressed files are returned as is. LZ4 and zstd traces need
+    the lz4 and zstandard packages respectively.
+    """
+    with open(path, "rb") as f:
+        magic = f.read(4)
+
+    if magic.startswith(GZIP_MAGIC):
+        return gzip.open(path, "rb")
+    if magic == LZ4_MAGIC:
+        import lz4.frame
+        return lz4.frame.open(path, "rb")
+    if magic == ZSTD_MAGIC:
+        import zstandard
+        return zstandard.ZstdDecompressor().stream_reader(
+            open(path, "rb"), read_across_frames=True, closefd=True)
+    return open(path, "rb")
+
+
+class DecompressionError(IOError):
+    """
+    Raised by decompress() for corrupt or truncated contents, whatever the
+    codec.
+    """
+
+
+def decompress(data):
+    """
+    Decompresses the contents of a trace file according to its magic bytes.
+    Uncompressed contents are returned as is. Raises DecompressionError if
+    the contents can't be decompressed.
+    """
+    if data.startswith(GZIP_MAGIC):
+        try:
+            return gzip.decompress(data)
+        except (EOFError, OSError, zlib.error) as e:
+            raise DecompressionError("Invalid gzip trace: {}".format(e))
+    if data.startswith(LZ4_MAGIC):
+        import lz4.frame
+        # Traces are written as a sequence of frames, chunked traces
+        # interleave them with skippable index frames.
+        output = []
+        try:
+            while data:
+                decompressor = lz4.frame.LZ4FrameDecompressor()
+                output.append(decompressor.decompress(data))
+                data = decompressor.unused_data
+        except RuntimeError as e:
+            # lz4 reports frame errors as RuntimeError.
+            raise DecompressionError("Invalid LZ4 trace: {}".format(e))
+        return b"".join(output)
+    if data.startswith(ZSTD_MAGIC):
+        import zstandard
+        try:
+            reader = zstandard.ZstdDecompressor().stream_reader(
+                data, read_across_frames=True)
+            return reader.read()
+        except zstandard.ZstdError as e:
+            raise DecompressionError("Invalid zstd trace: {}".format(e))
+    return data
@@ -85,4 +85,28 @@ ANNOTATION_NAMES = {
     8126491: "PROF_ERR_SIG_CRASHES",
     8126492: "PROF_ERR_SLOT_MISSES",
     8126493: "PROF_ERR_STACK_OVERFLOWS",
+    8126495: "CPU_SAMPLING_INTERVAL_MS",
+    8126502: "LOGGER_ERR_DROPPED_WRITES",
+    8126503: "PROF_SAMPLING_JITTER_AVG_US",
+    8126504: "PROF_SAMPLING_JITTER_MAX_US",
+    8126505: "PROF_SAMPLING_MISSED_TICKS",
+    8126506: "PROF_LOGGER_CPU_TIME_US",
+}
+
+
+# Entry types that STACK_SAMPLE entries can stand for, see
+# cpp/generated/EntryType.h.
+STACK_FRAME_TYPES = {
+    45: "STACK_FRAME",
+    67: "JAVASCRIPT_STACK_FRAME",
+    99: "NATIVE_STACK_FRAME",
+}
+
+
+# Entry types that STRING_REFERENCE entries can stand for, see
+# cpp/generated/EntryType.h.
+STRING_TYPES = {
+    56: "STRING_KEY",
+    57: "STRING_VALUE",
+    83: "STRING_NAME",
 }
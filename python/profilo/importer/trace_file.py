@@ -17,6 +17,8 @@ limitations under the License.
 
 from collections import namedtuple
 
+from .constants import STACK_FRAME_TYPES, STRING_TYPES
+
 class TraceEntry(object):
     @staticmethod
     def construct(line):
@@ -89,6 +91,12 @@ class TraceFile(object):
                 entries.append(entry)
                 continue
 
+            if entry.type == "SEGMENT_START":
+                # The entries after it are encoded from scratch.
+                entries.append(entry)
+                last_entry = None
+                continue
+
             if not last_entry:
                 # First entry is not delta-encoded but timestamp may
                 # still be truncated.
@@ -119,6 +127,56 @@ class TraceFile(object):
             last_entry = delta_entry
         return entries
 
+    @staticmethod
+    def __resolve_stacks(entries):
+        # Stacks are written once, as STACK_DEFINITION frames, and referred
+        # to by ID from STACK_SAMPLE entries. Expand every sample back to
+        # one entry per frame, as if the stack had been written in full.
+        stacks = {}
+        for entry in entries:
+            if entry.type == "STACK_DEFINITION":
+                stacks.setdefault(entry.arg2, []).append(entry.arg3)
+            elif entry.type == "SEGMENT_START":
+                # Last stage to look at segments, drop the marker.
+                stacks = {}
+            elif entry.type == "STACK_SAMPLE":
+                type = STACK_FRAME_TYPES[entry.arg3]
+                for frame in stacks.get(entry.arg1, []):
+                    yield StandardEntry(
+                        id=entry.id,
+                        type=type,
+                        timestamp=entry.timestamp,
+                        tid=entry.tid,
+                        arg1=0,
+                        arg2=entry.arg2,
+                        arg3=frame,
+                    )
+            else:
+                yield entry
+
+    @staticmethod
+    def __resolve_strings(entries):
+        # Every string entry in the file implicitly takes the next string ID,
+        # starting at 1. Repeats are written as STRING_REFERENCE entries
+        # pointing at that ID.
+        strings = [None]
+        for entry in entries:
+            if entry.type in ["STRING_KEY", "STRING_VALUE", "STRING_NAME"]:
+                strings.append(entry.data)
+                yield entry
+            elif entry.type == "SEGMENT_START":
+                strings = [None]
+                yield entry
+            elif entry.type == "STRING_REFERENCE":
+                yield BytesEntry(
+                    id=entry.id,
+                    type=STRING_TYPES[entry.arg3],
+                    arg1=entry.arg2,
+                    data=strings[entry.arg1],
+                )
+            else:
+                yield entry
+
     @staticmethod
     def from_string(data):
 
@@ -134,14 +192,162 @@ class TraceFile(object):
         # generate them on demand.
         gen_entries = (TraceEntry.construct(line) for line in data.split("\n") if len(line.strip()) > 0)
         entries = TraceFile.__delta_decode_entries(headers, gen_entries)
+        entries = TraceFile.__resolve_strings(entries)
+        entries = list(TraceFile.__resolve_stacks(entries))
 
         return TraceFile(headers=headers, entries=entries)
 
+    @staticmethod
+    def from_binary(data):
+        return BinaryTraceParser(data).parse()
+
     @staticmethod
     def from_file(fd):
         with fd:
-            data = fd.read().decode("utf-8")
-            return TraceFile.from_string(data)
+            data = fd.read()
+            if data.startswith(BinaryTraceParser.MAGIC):
+                return TraceFile.from_binary(data)
+            return TraceFile.from_string(data.decode("utf-8"))
+
+class BinaryTraceParser(object):
+    """
+    Reads the binary trace format, see cpp/writer/BinaryTraceFormat.h.
+    Produces the same entries as the text format.
+    """
+
+    MAGIC = b"dtbin\n"
+    VERSION = 4
+
+    STANDARD_ENTRY = 0
+    FRAMES_ENTRY = 1
+    BYTES_ENTRY = 2
+    KIND_BITS = 2
+    COLUMNS = 7
+
+    def __init__(self, data):
+        super(BinaryTraceParser, self).__init__()
+        self.data = bytearray(data)
+        self.offset = len(self.MAGIC)
+        self.type_names = {}
+        self.strings = []
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            if self.offset >= len(self.data):
+                raise ValueError("Malformed binary trace: truncated varint")
+            byte = self.data[self.offset]
+            self.offset += 1
+            value |= (byte & 0x7f) << shift
+            if byte & 0x80 == 0:
+                return value
+            shift += 7
+
+    def svarint(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def bytes(self):
+        size = self.varint()
+        end = self.offset + size
+        if end > len(self.data):
+            raise ValueError("Malformed binary trace: truncated section")
+        value = bytes(self.data[self.offset:end])
+        self.offset = end
+        return value
+
+    def string(self):
+        return self.bytes().decode("utf-8")
+
+    def section(self, count):
+        # Decodes count zigzag varints from a size-prefixed section.
+        parser = BinaryTraceParser(self.bytes())
+        parser.offset = 0
+        return [parser.svarint() for _ in range(count)]
+
+    def parse(self):
+        version = self.varint()
+        if version != self.VERSION:
+            raise ValueError(
+                "Unsupported binary trace version {}".format(version))
+        headers = {}
+        for _ in range(self.varint()):
+            key = self.string()
+            headers[key] = self.string()
+        headers['ver'] = str(version)
+
+        precision = int(headers.get('prec', 0))
+        timestamp_multiplier = pow(10, (9 - precision))
+
+        entries = []
+        while self.parse_block(entries, timestamp_multiplier):
+            pass
+        return TraceFile(headers=headers, entries=entries)
+
+    def parse_block(self, entries, timestamp_multiplier):
+        rows = self.varint()
+        if rows == 0:
+            return False
+        frame_count = self.varint()
+        for _ in range(self.varint()):
+            type_id = self.varint()
+            self.type_names[type_id] = self.string()
+        new_strings = self.varint()
+
+        types = BinaryTraceParser(self.bytes())
+        types.offset = 0
+        types = [types.varint() for _ in range(rows)]
+        columns = [self.section(rows) for _ in range(self.COLUMNS - 1)]
+
+        frames = self.section(frame_count)
+        for idx in range(1, len(frames)):
+            frames[idx] += frames[idx - 1]
+
+        strings = BinaryTraceParser(self.bytes())
+        strings.offset = 0
+        for _ in range(new_strings):
+            self.strings.append(strings.bytes().decode("utf-8"))
+
+        values = [0] * (self.COLUMNS - 1)
+        next_frame = 0
+        for row in range(rows):
+            for column in range(self.COLUMNS - 1):
+                values[column] += columns[column][row]
+            id, timestamp, tid, callid, matchid, extra = values
+            kind = types[row] & ((1 << self.KIND_BITS) - 1)
+            type = self.type_names[types[row] >> self.KIND_BITS]
+
+            if kind == self.BYTES_ENTRY:
+                entries.append(BytesEntry(
+                    id=id,
+                    type=type,
+                    arg1=matchid,
+                    data=self.strings[extra],
+                ))
+            elif kind == self.FRAMES_ENTRY:
+                for idx in range(extra):
+                    entries.append(StandardEntry(
+                        id=id,
+                        type=type,
+                        timestamp=timestamp * timestamp_multiplier,
+                        tid=tid,
+                        arg1=0,
+                        arg2=matchid,
+                        arg3=frames[next_frame + idx],
+                    ))
+                next_frame += extra
+            else:
+                entries.append(StandardEntry(
+                    id=id,
+                    type=type,
+                    timestamp=timestamp * timestamp_multiplier,
+                    tid=tid,
+                    arg1=callid,
+                    arg2=matchid,
+                    arg3=extra,
+                ))
+        return True
 
 if __name__ == "__main__":
     import sys
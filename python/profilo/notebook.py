@@ -16,18 +16,15 @@ limitations under the License.
 
 
 
+from .importer.compression import open_trace_file
 from .importer.trace_file import TraceFile
 from .importer.interpreter import TraceFileInterpreter
 
 import os.path
-import gzip
 
 def open_trace(filepath):
     filepath = os.path.expanduser(filepath)
-    if filepath.endswith('gz'):
-        fd = gzip.open(filepath, mode='rb')
-    else:
-        fd = open(filepath, mode='rb')
+    fd = open_trace_file(filepath)
 
     interpreter = TraceFileInterpreter(TraceFile.from_file(fd))
     return interpreter.interpret()